@@ -19,6 +19,7 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := libalsautils
 LOCAL_SRC_FILES := \
 	alsa_device_profile.c \
+	alsa_device_profile_cache.c \
 	alsa_device_proxy.c \
 	alsa_logging.c \
 	alsa_format.c
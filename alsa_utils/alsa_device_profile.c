@@ -22,6 +22,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cutils/properties.h>
 
 #include <log/log.h>
@@ -36,6 +37,14 @@
 
 #define DEFAULT_PERIOD_SIZE 1024
 
+/* Limits of the adaptive period sizing */
+#define ADAPTIVE_MIN_PERIOD_US      1000
+#define ADAPTIVE_MAX_PERIOD_US      (4 * PERIOD_DURATION_US)
+#define ADAPTIVE_MIN_PERIOD_COUNT   2   /* raised to the minimum of the device */
+#define ADAPTIVE_MAX_PERIOD_COUNT   8
+/* Streaming without an XRUN for this long allows a shorter buffer */
+#define ADAPTIVE_SHRINK_AFTER_MS    (60 * 1000)
+
 static const char * const format_string_map[] = {
     "AUDIO_FORMAT_PCM_16_BIT",      /* "PCM_FORMAT_S16_LE", */
     "AUDIO_FORMAT_PCM_32_BIT",      /* "PCM_FORMAT_S32_LE", */
@@ -70,12 +79,20 @@ static void profile_reset(alsa_device_profile* profile)
     profile->min_period_size = profile->max_period_size = 0;
     profile->min_channel_count = profile->max_channel_count = DEFAULT_CHANNEL_COUNT;
 
+    /* what was learned applies to the device, but keep the mode */
+    const bool adaptive = profile->adaptive.enabled;
+    memset(&profile->adaptive, 0, sizeof(profile->adaptive));
+    profile->adaptive.enabled = adaptive;
+    profile->adaptive.period_us = ADAPTIVE_MIN_PERIOD_US;
+    profile->adaptive.period_count = ADAPTIVE_MIN_PERIOD_COUNT;
+
     profile->is_valid = false;
 }
 
 void profile_init(alsa_device_profile* profile, int direction)
 {
     profile->direction = direction;
+    profile->adaptive.enabled = property_get_bool("ro.audio.usb.adaptive_period", false);
     profile_reset(profile);
 }
 
@@ -104,6 +121,25 @@ static unsigned int round_to_16_mult(unsigned int size)
     return (size + 15) & ~15;   /* 0xFFFFFFF0; */
 }
 
+/*
+ * Returns the period size of the supplied duration at the supplied sample rate,
+ * within the limits of the device.
+ */
+static unsigned profile_calc_period_size(alsa_device_profile* profile, unsigned sample_rate,
+                                         unsigned period_us)
+{
+    unsigned num_sample_frames = ((uint64_t)sample_rate * period_us) / 1000000;
+
+    if (num_sample_frames < profile->min_period_size) {
+        num_sample_frames = profile->min_period_size;
+    }
+    num_sample_frames = round_to_16_mult(num_sample_frames);
+    if (profile->max_period_size != 0 && num_sample_frames > profile->max_period_size) {
+        num_sample_frames = profile->max_period_size & ~15;
+    }
+    return num_sample_frames;
+}
+
 /*
  * Returns the system defined minimum period size based on the supplied sample rate.
  */
@@ -114,22 +150,145 @@ unsigned profile_calc_min_period_size(alsa_device_profile* profile, unsigned sam
         return DEFAULT_PERIOD_SIZE;
     } else {
         unsigned period_us = property_get_int32("ro.audio.usb.period_us", PERIOD_DURATION_US);
-        unsigned num_sample_frames = ((uint64_t)sample_rate * period_us) / 1000000;
-
-        if (num_sample_frames < profile->min_period_size) {
-            num_sample_frames = profile->min_period_size;
-        }
-        return round_to_16_mult(num_sample_frames);
+        return profile_calc_period_size(profile, sample_rate, period_us);
     }
 }
 
 unsigned int profile_get_period_size(alsa_device_profile* profile, unsigned sample_rate)
 {
-    unsigned int period_size = profile_calc_min_period_size(profile, sample_rate);
+    unsigned int period_size;
+    if (profile != NULL && profile->adaptive.enabled) {
+        period_size = profile_calc_period_size(profile, sample_rate, profile->adaptive.period_us);
+    } else {
+        period_size = profile_calc_min_period_size(profile, sample_rate);
+    }
     ALOGV("profile_get_period_size(rate:%d) = %d", sample_rate, period_size);
     return period_size;
 }
 
+unsigned int profile_get_period_count(alsa_device_profile* profile)
+{
+    unsigned int period_count = profile->default_config.period_count;
+    /* the default is the minimum of the device */
+    if (profile->adaptive.enabled && profile->adaptive.period_count > period_count) {
+        period_count = profile->adaptive.period_count;
+    }
+    return period_count;
+}
+
+/*
+ * Returns the fewest periods the adaptive sizing uses, the minimum of the device once known.
+ */
+static unsigned profile_min_period_count(const alsa_device_profile* profile)
+{
+    return profile->default_config.period_count > ADAPTIVE_MIN_PERIOD_COUNT ?
+            profile->default_config.period_count : ADAPTIVE_MIN_PERIOD_COUNT;
+}
+
+/*
+ * Keeps the adaptive period count at or above the minimum of the device, so that it is
+ * the count profile_get_period_count() returns.
+ */
+static void profile_clamp_adaptive_period_count(alsa_device_profile* profile)
+{
+    const unsigned min_count = profile_min_period_count(profile);
+    if (profile->adaptive.period_count < min_count) {
+        profile->adaptive.period_count = min_count;
+    }
+}
+
+/*
+ * Adaptive period sizing
+ */
+void profile_set_adaptive_period(alsa_device_profile* profile, bool enabled)
+{
+    profile->adaptive.enabled = enabled;
+}
+
+const profile_adaptive_period * profile_get_adaptive_period(const alsa_device_profile* profile)
+{
+    return &profile->adaptive;
+}
+
+static void profile_grow_period(profile_adaptive_period* adaptive)
+{
+    if (adaptive->period_us < ADAPTIVE_MAX_PERIOD_US) {
+        adaptive->period_us *= 2;
+        if (adaptive->period_us > ADAPTIVE_MAX_PERIOD_US) {
+            adaptive->period_us = ADAPTIVE_MAX_PERIOD_US;
+        }
+    } else if (adaptive->period_count < ADAPTIVE_MAX_PERIOD_COUNT) {
+        adaptive->period_count++;
+    } else {
+        return;
+    }
+    adaptive->increases++;
+}
+
+static void profile_shrink_period(profile_adaptive_period* adaptive, unsigned min_count)
+{
+    if (adaptive->period_count > min_count) {
+        adaptive->period_count--;
+    } else if (adaptive->period_us > ADAPTIVE_MIN_PERIOD_US) {
+        adaptive->period_us -= adaptive->period_us / 4;
+        if (adaptive->period_us < ADAPTIVE_MIN_PERIOD_US) {
+            adaptive->period_us = ADAPTIVE_MIN_PERIOD_US;
+        }
+    } else {
+        return;
+    }
+    adaptive->decreases++;
+}
+
+/*
+ * Reports the timing of a stream that used the current choice, when it stops.
+ * The margin of the buffer is the time the client can be late without an XRUN,
+ * all the periods but the one being transferred.
+ */
+void profile_report_period_stats(alsa_device_profile* profile, unsigned duration_ms,
+                                 unsigned max_jitter_us, unsigned xruns)
+{
+    profile_adaptive_period* adaptive = &profile->adaptive;
+    if (!adaptive->enabled) {
+        return;
+    }
+
+    /* the stream used the count of profile_get_period_count() */
+    profile_clamp_adaptive_period_count(profile);
+    const unsigned period_us = adaptive->period_us;
+    const unsigned period_count = adaptive->period_count;
+    adaptive->xruns += xruns;
+    if (max_jitter_us > adaptive->max_jitter_us) {
+        adaptive->max_jitter_us = max_jitter_us;
+    }
+
+    const unsigned margin_us = period_us * (period_count - 1);
+    if (xruns > 0 || adaptive->max_jitter_us * 2 > margin_us) {
+        profile_grow_period(adaptive);
+    } else {
+        adaptive->clean_ms += duration_ms;
+        if (adaptive->clean_ms < ADAPTIVE_SHRINK_AFTER_MS) {
+            return;
+        }
+        /* only if the shorter buffer would still leave twice the jitter */
+        profile_adaptive_period shorter = *adaptive;
+        profile_shrink_period(&shorter, profile_min_period_count(profile));
+        if (shorter.max_jitter_us * 2 > shorter.period_us * (shorter.period_count - 1)) {
+            return;
+        }
+        *adaptive = shorter;
+    }
+
+    if (adaptive->period_us != period_us || adaptive->period_count != period_count) {
+        ALOGI("card:%d device:%d period %u us x %u -> %u us x %u (jitter %u us, xruns %u)",
+              profile->card, profile->device, period_us, period_count,
+              adaptive->period_us, adaptive->period_count, max_jitter_us, xruns);
+    }
+    /* observe the new choice from scratch */
+    adaptive->clean_ms = 0;
+    adaptive->max_jitter_us = 0;
+}
+
 /*
  * Sample Rate
  */
@@ -316,23 +475,14 @@ static unsigned profile_enum_channel_counts(alsa_device_profile* profile, unsign
 }
 
 /*
- * Reads and decodes configuration info from the specified ALSA card/device.
+ * Decodes configuration info from the hardware parameters of the specified ALSA card/device.
  */
-static int read_alsa_device_config(alsa_device_profile * profile, struct pcm_config * config)
+static int read_alsa_device_config(alsa_device_profile * profile,
+                                   struct pcm_params * alsa_hw_params, struct pcm_config * config)
 {
     ALOGV("usb:audio_hw - read_alsa_device_config(c:%d d:%d t:0x%X)",
           profile->card, profile->device, profile->direction);
 
-    if (profile->card < 0 || profile->device < 0) {
-        return -EINVAL;
-    }
-
-    struct pcm_params * alsa_hw_params =
-        pcm_params_get(profile->card, profile->device, profile->direction);
-    if (alsa_hw_params == NULL) {
-        return -EINVAL;
-    }
-
     profile->min_period_size = pcm_params_get_min(alsa_hw_params, PCM_PARAM_PERIOD_SIZE);
     profile->max_period_size = pcm_params_get_max(alsa_hw_params, PCM_PARAM_PERIOD_SIZE);
 
@@ -374,8 +524,6 @@ static int read_alsa_device_config(alsa_device_profile * profile, struct pcm_con
         ret = -EINVAL;
     }
 
-    pcm_params_free(alsa_hw_params);
-
     return ret;
 }
 
@@ -385,12 +533,11 @@ bool profile_read_device_info(alsa_device_profile* profile)
         return false;
     }
 
-    /* let's get some defaults */
-    read_alsa_device_config(profile, &profile->default_config);
-    ALOGV("default_config chans:%d rate:%d format:%d count:%d size:%d",
-          profile->default_config.channels, profile->default_config.rate,
-          profile->default_config.format, profile->default_config.period_count,
-          profile->default_config.period_size);
+    if (profile_load_from_cache(profile)) {
+        profile->is_valid = true;
+        profile_clamp_adaptive_period_count(profile);
+        return true;
+    }
 
     struct pcm_params * alsa_hw_params = pcm_params_get(profile->card,
                                                         profile->device,
@@ -399,6 +546,13 @@ bool profile_read_device_info(alsa_device_profile* profile)
         return false;
     }
 
+    /* let's get some defaults */
+    read_alsa_device_config(profile, alsa_hw_params, &profile->default_config);
+    ALOGV("default_config chans:%d rate:%d format:%d count:%d size:%d",
+          profile->default_config.channels, profile->default_config.rate,
+          profile->default_config.format, profile->default_config.period_count,
+          profile->default_config.period_size);
+
     /* Formats */
     struct pcm_mask * format_mask = pcm_params_get_mask(alsa_hw_params, PCM_PARAM_FORMAT);
     profile_enum_sample_formats(profile, format_mask);
@@ -413,7 +567,11 @@ bool profile_read_device_info(alsa_device_profile* profile)
             profile, pcm_params_get_min(alsa_hw_params, PCM_PARAM_RATE),
             pcm_params_get_max(alsa_hw_params, PCM_PARAM_RATE));
 
+    pcm_params_free(alsa_hw_params);
+
     profile->is_valid = true;
+    profile_clamp_adaptive_period_count(profile);
+    profile_save_to_cache(profile);
 
     return true;
 }
@@ -636,4 +794,14 @@ void profile_dump(const alsa_device_profile* profile, int fd)
     dprintf(fd, "    period_size: %d\n", profile->default_config.period_size);
     dprintf(fd, "    period_count: %d\n", profile->default_config.period_count);
     dprintf(fd, "    format: %d\n", profile->default_config.format);
+
+    const profile_adaptive_period* adaptive = &profile->adaptive;
+    if (adaptive->enabled) {
+        dprintf(fd, "  Adaptive Period:\n");
+        dprintf(fd, "    period: %u us x %u\n", adaptive->period_us, adaptive->period_count);
+        dprintf(fd, "    max jitter: %u us, clean: %u ms\n",
+                adaptive->max_jitter_us, adaptive->clean_ms);
+        dprintf(fd, "    xruns: %u, increases: %u, decreases: %u\n",
+                adaptive->xruns, adaptive->increases, adaptive->decreases);
+    }
 }
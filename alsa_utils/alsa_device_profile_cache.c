@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "alsa_device_profile_cache"
+/*#define LOG_NDEBUG 0*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <cutils/properties.h>
+
+#include <log/log.h>
+
+#include "include/alsa_device_profile.h"
+
+/*
+ * Probing a USB device opens it once for each candidate sample rate, which takes hundreds
+ * of milliseconds. The probed attributes are stored in one file per card device and
+ * direction, and reused while the identity of the USB device is unchanged.
+ *
+ * The identity is the vendor and product ids, the serial number, and a hash of the raw
+ * USB descriptors, which change with the firmware and describe the supported formats.
+ * Cards that are not USB devices are not cached.
+ */
+
+#define PROFILE_CACHE_DIR_PROPERTY  "ro.audio.usb.profile_cache_dir"
+#define PROFILE_CACHE_DIR_DEFAULT   "/data/misc/audioserver"
+
+#define PROFILE_CACHE_MAGIC     0x41505543  /* "CUPA" */
+#define PROFILE_CACHE_VERSION   1
+
+#define FNV_OFFSET_BASIS    0xcbf29ce484222325ULL
+#define FNV_PRIME           0x100000001b3ULL
+
+typedef struct {
+    unsigned vendor_id;
+    unsigned product_id;
+    char serial[128];           /* empty if the device has no serial number */
+    uint64_t descriptor_hash;   /* of the USB device and configuration descriptors */
+    int device;
+    int direction;
+} profile_cache_key;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              /* sizeof(profile_cache_record) */
+    profile_cache_key key;
+
+    enum pcm_format formats[MAX_PROFILE_FORMATS];
+    unsigned sample_rates[MAX_PROFILE_SAMPLE_RATES];
+    unsigned channel_counts[MAX_PROFILE_CHANNEL_COUNTS];
+    struct pcm_config default_config;
+    unsigned min_period_size;
+    unsigned max_period_size;
+    unsigned min_channel_count;
+    unsigned max_channel_count;
+
+    uint64_t checksum;          /* of all the preceding bytes */
+} profile_cache_record;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/*
+ * Reads a short text file into buffer, without the trailing new line.
+ * Returns the length of the string, or -1 if the file can't be read.
+ */
+static ssize_t read_string(const char *path, char *buffer, size_t size)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t length = read(fd, buffer, size - 1);
+    close(fd);
+    if (length < 0) {
+        return -1;
+    }
+    while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r')) {
+        length--;
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+static bool read_cache_key(const alsa_device_profile* profile, profile_cache_key* key)
+{
+    char path[PATH_MAX];
+    char buffer[128];
+
+    memset(key, 0, sizeof(*key));
+    key->device = profile->device;
+    key->direction = profile->direction;
+
+    /* Only USB cards have a usbid, as "vvvv:pppp" */
+    snprintf(path, sizeof(path), "/proc/asound/card%d/usbid", profile->card);
+    if (read_string(path, buffer, sizeof(buffer)) < 0
+            || sscanf(buffer, "%x:%x", &key->vendor_id, &key->product_id) != 2) {
+        return false;
+    }
+
+    /* The card device is a USB interface, and the USB device is its parent. */
+    snprintf(path, sizeof(path), "/sys/class/sound/card%d/device/../serial", profile->card);
+    if (read_string(path, key->serial, sizeof(key->serial)) < 0) {
+        key->serial[0] = '\0';
+    }
+
+    snprintf(path, sizeof(path), "/sys/class/sound/card%d/device/../descriptors",
+             profile->card);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGW("read_cache_key() can't open %s: %s", path, strerror(errno));
+        return false;
+    }
+    uint64_t hash = FNV_OFFSET_BASIS;
+    size_t total = 0;
+    ssize_t length;
+    uint8_t descriptors[512];
+    while ((length = read(fd, descriptors, sizeof(descriptors))) > 0) {
+        hash = fnv1a(hash, descriptors, length);
+        total += length;
+    }
+    close(fd);
+    if (length < 0 || total == 0) {
+        return false;
+    }
+    key->descriptor_hash = hash;
+    return true;
+}
+
+static bool get_cache_path(const profile_cache_key* key, char *path, size_t size)
+{
+    char dir[PROPERTY_VALUE_MAX];
+    property_get(PROFILE_CACHE_DIR_PROPERTY, dir, PROFILE_CACHE_DIR_DEFAULT);
+    if (dir[0] == '\0') {
+        return false; /* disabled */
+    }
+
+    const uint64_t identity = fnv1a(key->descriptor_hash, key->serial, strlen(key->serial));
+    snprintf(path, size, "%s/usb_profile_%04x_%04x_%016" PRIx64 "_%d_%s", dir,
+             key->vendor_id, key->product_id, identity, key->device,
+             key->direction == PCM_OUT ? "out" : "in");
+    return true;
+}
+
+/*
+ * Returns true if the array has a terminator, and only values in [min, max] before it.
+ */
+static bool is_valid_list(const unsigned *values, size_t size, unsigned min, unsigned max)
+{
+    for (size_t index = 0; index < size; index++) {
+        if (values[index] == 0) {
+            return index > 0;
+        }
+        if (values[index] < min || values[index] > max) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool is_valid_record(const profile_cache_record* record, const profile_cache_key* key)
+{
+    if (record->magic != PROFILE_CACHE_MAGIC || record->version != PROFILE_CACHE_VERSION
+            || record->size != sizeof(*record)
+            || record->checksum != fnv1a(FNV_OFFSET_BASIS, record,
+                                         offsetof(profile_cache_record, checksum))) {
+        return false;
+    }
+    if (memcmp(&record->key, key, sizeof(*key)) != 0) {
+        return false;
+    }
+
+    /* The attributes are used as table indices, so check them as well as the checksum. */
+    size_t index;
+    for (index = 0; index < MAX_PROFILE_FORMATS; index++) {
+        if (record->formats[index] == PCM_FORMAT_INVALID) {
+            break;
+        }
+        if (record->formats[index] < 0 || record->formats[index] > PCM_FORMAT_S24_3LE) {
+            return false;
+        }
+    }
+    return index > 0 && index < MAX_PROFILE_FORMATS
+            && is_valid_list(record->sample_rates, MAX_PROFILE_SAMPLE_RATES, 8000, 192000)
+            && is_valid_list(record->channel_counts, MAX_PROFILE_CHANNEL_COUNTS,
+                             1, MAX_PROFILE_CHANNEL_COUNTS - 1)
+            && record->min_channel_count <= record->max_channel_count
+            && record->min_period_size <= record->max_period_size;
+}
+
+bool profile_load_from_cache(alsa_device_profile* profile)
+{
+    profile_cache_key key;
+    char path[PATH_MAX];
+    if (!read_cache_key(profile, &key) || !get_cache_path(&key, path, sizeof(path))) {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGV("profile_load_from_cache() no entry %s", path);
+        return false;
+    }
+    profile_cache_record record;
+    ssize_t length = read(fd, &record, sizeof(record));
+    close(fd);
+    if (length != sizeof(record) || !is_valid_record(&record, &key)) {
+        ALOGW("profile_load_from_cache() removing invalid entry %s", path);
+        unlink(path);
+        return false;
+    }
+
+    memcpy(profile->formats, record.formats, sizeof(profile->formats));
+    memcpy(profile->sample_rates, record.sample_rates, sizeof(profile->sample_rates));
+    memcpy(profile->channel_counts, record.channel_counts, sizeof(profile->channel_counts));
+    profile->default_config = record.default_config;
+    profile->min_period_size = record.min_period_size;
+    profile->max_period_size = record.max_period_size;
+    profile->min_channel_count = record.min_channel_count;
+    profile->max_channel_count = record.max_channel_count;
+    ALOGV("profile_load_from_cache() loaded %s", path);
+    return true;
+}
+
+void profile_save_to_cache(const alsa_device_profile* profile)
+{
+    profile_cache_record record;
+    char path[PATH_MAX];
+    char temp_path[PATH_MAX + sizeof(".tmp")];
+
+    /* zero the padding, which is part of the checksum */
+    memset(&record, 0, sizeof(record));
+    if (!profile->is_valid || !read_cache_key(profile, &record.key)
+            || !get_cache_path(&record.key, path, sizeof(path))) {
+        return;
+    }
+
+    record.magic = PROFILE_CACHE_MAGIC;
+    record.version = PROFILE_CACHE_VERSION;
+    record.size = sizeof(record);
+    memcpy(record.formats, profile->formats, sizeof(record.formats));
+    memcpy(record.sample_rates, profile->sample_rates, sizeof(record.sample_rates));
+    memcpy(record.channel_counts, profile->channel_counts, sizeof(record.channel_counts));
+    record.default_config = profile->default_config;
+    record.min_period_size = profile->min_period_size;
+    record.max_period_size = profile->max_period_size;
+    record.min_channel_count = profile->min_channel_count;
+    record.max_channel_count = profile->max_channel_count;
+    record.checksum = fnv1a(FNV_OFFSET_BASIS, &record, offsetof(profile_cache_record, checksum));
+
+    /* Write a temporary file and rename it, so readers never see a partial entry. */
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        ALOGW("profile_save_to_cache() can't create %s: %s", temp_path, strerror(errno));
+        return;
+    }
+    bool ok = write(fd, &record, sizeof(record)) == sizeof(record);
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp_path, path) != 0) {
+        ALOGW("profile_save_to_cache() can't write %s", path);
+        unlink(temp_path);
+        return;
+    }
+    ALOGV("profile_save_to_cache() saved %s", path);
+}
+
+void profile_invalidate_cache(alsa_device_profile* profile)
+{
+    profile_cache_key key;
+    char path[PATH_MAX];
+    if (read_cache_key(profile, &key) && get_cache_path(&key, path, sizeof(path))) {
+        ALOGV("profile_invalidate_cache() removing %s", path);
+        unlink(path);
+    }
+}
@@ -21,6 +21,12 @@
 #include <log/log.h>
 
 #include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cutils/properties.h>
 
 #include "include/alsa_device_proxy.h"
 
@@ -29,6 +35,20 @@
 #define DEFAULT_PERIOD_SIZE     1024
 #define DEFAULT_PERIOD_COUNT    2
 
+/* Upper bound of a wait for the device in the mmap modes, in periods. */
+#define MMAP_WAIT_TIMEOUT_PERIODS   4
+
+/* Timestamps must span this long before the rate of the device is measured,
+ * and the fit restarts after this long so that it follows slow changes of the rate. */
+#define RATE_BASELINE_MIN_NS    1000000000LL
+#define RATE_BASELINE_MAX_NS    60000000000LL
+/* Bounds of a plausible device rate, relative to the nominal rate */
+#define RATE_RATIO_MIN          0.95
+#define RATE_RATIO_MAX          1.05
+/* Weight of a new timestamp in the filtered position and in the mean jitter */
+#define POSITION_FILTER_GAIN    0.25
+#define JITTER_FILTER_GAIN      (1.0 / 16)
+
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
 static const unsigned format_byte_size_map[] = {
@@ -74,7 +94,7 @@ void proxy_prepare(alsa_device_proxy * proxy, alsa_device_profile* profile,
               config->channels, proxy->alsa_config.channels);
     }
 
-    proxy->alsa_config.period_count = profile->default_config.period_count;
+    proxy->alsa_config.period_count = profile_get_period_count(profile);
     proxy->alsa_config.period_size =
             profile_get_period_size(proxy->profile, proxy->alsa_config.rate);
 
@@ -86,26 +106,42 @@ void proxy_prepare(alsa_device_proxy * proxy, alsa_device_profile* profile,
     }
 
     proxy->pcm = NULL;
-    // config format should be checked earlier against profile.
-    if (config->format >= 0 && (size_t)config->format < ARRAY_SIZE(format_byte_size_map)) {
-        proxy->frame_size = format_byte_size_map[config->format] * proxy->alsa_config.channels;
+    proxy->transfer_mode = PROXY_TRANSFER_RW;
+    proxy->mmap_offset = 0;
+    proxy->running = false;
+    // The format may have been replaced by the default of the profile above.
+    if (proxy->alsa_config.format >= 0
+            && (size_t)proxy->alsa_config.format < ARRAY_SIZE(format_byte_size_map)) {
+        proxy->frame_size =
+                format_byte_size_map[proxy->alsa_config.format] * proxy->alsa_config.channels;
     } else {
         proxy->frame_size = 1;
     }
+
+    proxy_set_delay_us(proxy, property_get_int32("ro.audio.usb.delay_us", 0));
+    memset(&proxy->position, 0, sizeof(proxy->position));
+    proxy->position.rate_ratio = 1.0;
+
+    proxy->xrun_preroll_frames = 0;
+    memset(&proxy->xruns, 0, sizeof(proxy->xruns));
 }
 
-int proxy_open(alsa_device_proxy * proxy)
+void proxy_set_transfer_mode(alsa_device_proxy * proxy, proxy_transfer_mode_t mode)
 {
-    alsa_device_profile* profile = proxy->profile;
-    ALOGV("proxy_open(card:%d device:%d %s)", profile->card, profile->device,
-          profile->direction == PCM_OUT ? "PCM_OUT" : "PCM_IN");
+    proxy->transfer_mode = mode;
+}
 
-    if (profile->card < 0 || profile->device < 0) {
-        return -EINVAL;
-    }
+proxy_transfer_mode_t proxy_get_transfer_mode(const alsa_device_proxy * proxy)
+{
+    return proxy->transfer_mode;
+}
+
+static int proxy_open_pcm(alsa_device_proxy * proxy, unsigned int flags)
+{
+    alsa_device_profile* profile = proxy->profile;
 
     proxy->pcm = pcm_open(profile->card, profile->device,
-            profile->direction | PCM_MONOTONIC, &proxy->alsa_config);
+            profile->direction | PCM_MONOTONIC | PCM_NORESTART | flags, &proxy->alsa_config);
     if (proxy->pcm == NULL) {
         return -ENOMEM;
     }
@@ -123,6 +159,44 @@ int proxy_open(alsa_device_proxy * proxy)
     return 0;
 }
 
+int proxy_open(alsa_device_proxy * proxy)
+{
+    alsa_device_profile* profile = proxy->profile;
+    ALOGV("proxy_open(card:%d device:%d %s)", profile->card, profile->device,
+          profile->direction == PCM_OUT ? "PCM_OUT" : "PCM_IN");
+
+    if (profile->card < 0 || profile->device < 0) {
+        return -EINVAL;
+    }
+
+    proxy->running = false;
+    proxy->position.valid = false;
+    proxy->last_transfer_ns = 0;
+    proxy->max_lateness_ns = 0;
+    proxy->transferred_at_open = proxy->transferred;
+    proxy->xruns_at_open = proxy->xruns.count;
+    if (proxy->transfer_mode != PROXY_TRANSFER_RW) {
+        unsigned int flags = PCM_MMAP;
+        if (proxy->transfer_mode == PROXY_TRANSFER_MMAP_NOIRQ) {
+            flags |= PCM_NOIRQ;
+        }
+        // The stream is started explicitly once a period is queued,
+        // and waits are woken up for each period.
+        proxy->alsa_config.start_threshold = proxy->alsa_config.period_size;
+        proxy->alsa_config.avail_min = proxy->alsa_config.period_size;
+        if (proxy_open_pcm(proxy, flags) == 0) {
+            return 0;
+        }
+        ALOGW("proxy_open() mmap mode %d not supported, using read/write",
+              proxy->transfer_mode);
+        proxy->transfer_mode = PROXY_TRANSFER_RW;
+        proxy->alsa_config.start_threshold = 0;
+        proxy->alsa_config.avail_min = 0;
+    }
+
+    return proxy_open_pcm(proxy, 0);
+}
+
 void proxy_close(alsa_device_proxy * proxy)
 {
     ALOGV("proxy_close() [pcm:%p]", proxy->pcm);
@@ -130,7 +204,17 @@ void proxy_close(alsa_device_proxy * proxy)
     if (proxy->pcm != NULL) {
         pcm_close(proxy->pcm);
         proxy->pcm = NULL;
+
+        // Let the profile adapt the period of the next stream to the timing of this one.
+        const uint64_t frames = proxy->transferred - proxy->transferred_at_open;
+        if (frames > 0) {
+            profile_report_period_stats(proxy->profile,
+                    frames * 1000 / proxy->alsa_config.rate,
+                    proxy->max_lateness_ns / 1000,
+                    proxy->xruns.count - proxy->xruns_at_open);
+        }
     }
+    proxy->running = false;
 }
 
 /*
@@ -176,7 +260,89 @@ unsigned proxy_get_latency(const alsa_device_proxy * proxy)
                / proxy_get_sample_rate(proxy);
 }
 
-int proxy_get_presentation_position(const alsa_device_proxy * proxy,
+/*
+ * Position
+ */
+void proxy_set_delay_us(alsa_device_proxy * proxy, unsigned delay_us)
+{
+    proxy->delay_frames = (uint64_t)delay_us * proxy->alsa_config.rate / 1000000;
+}
+
+double proxy_get_rate_ratio(const alsa_device_proxy * proxy)
+{
+    return proxy->position.rate_ratio;
+}
+
+int64_t proxy_get_timestamp_jitter_ns(const alsa_device_proxy * proxy)
+{
+    return (int64_t)proxy->position.jitter_ns;
+}
+
+static void proxy_restart_rate_fit(proxy_position_filter *filter, int64_t frames,
+                                   int64_t time_ns)
+{
+    filter->anchor_ns = time_ns;
+    filter->anchor_frames = frames;
+    filter->sum_t = filter->sum_f = filter->sum_tt = filter->sum_tf = 0;
+    filter->count = 1; /* the anchor, at the origin */
+}
+
+/*
+ * Adds a timestamp of the device position to the filter, and returns the filtered position.
+ *
+ * The rate is the slope of a least squares fit of the positions over up to a minute, so the
+ * error of the hardware pointer, which moves by at least a USB packet, averages out.
+ * The position is predicted at the measured rate and corrected by a fraction of the error.
+ * A large error, such as after an XRUN or while the stream is stopped, resets the filter.
+ */
+static double proxy_filter_position(alsa_device_proxy * proxy, int64_t frames, int64_t time_ns)
+{
+    proxy_position_filter *filter = &proxy->position;
+    const double rate = proxy->alsa_config.rate;
+
+    if (filter->valid) {
+        const double elapsed_ns = time_ns - filter->time_ns;
+        const double predicted =
+                filter->frames + elapsed_ns * rate * filter->rate_ratio / 1000000000;
+        const double error = frames - predicted;
+        if (fabs(error) <= proxy->alsa_config.period_size) {
+            filter->frames = predicted + error * POSITION_FILTER_GAIN;
+            filter->time_ns = time_ns;
+            filter->jitter_ns += (fabs(error) * 1000000000 / rate - filter->jitter_ns)
+                    * JITTER_FILTER_GAIN;
+
+            const int64_t baseline_ns = time_ns - filter->anchor_ns;
+            const double t = baseline_ns / 1000000000.0;
+            const double f = frames - filter->anchor_frames;
+            filter->sum_t += t;
+            filter->sum_f += f;
+            filter->sum_tt += t * t;
+            filter->sum_tf += t * f;
+            filter->count++;
+            if (baseline_ns >= RATE_BASELINE_MIN_NS) {
+                const double n = filter->count;
+                const double ratio = (n * filter->sum_tf - filter->sum_t * filter->sum_f)
+                        / ((n * filter->sum_tt - filter->sum_t * filter->sum_t) * rate);
+                if (ratio >= RATE_RATIO_MIN && ratio <= RATE_RATIO_MAX) {
+                    filter->rate_ratio = ratio;
+                }
+            }
+            if (baseline_ns >= RATE_BASELINE_MAX_NS) {
+                proxy_restart_rate_fit(filter, frames, time_ns);
+            }
+            return filter->frames;
+        }
+        ALOGV("proxy_filter_position() reset, error %.1f frames", error);
+    }
+
+    filter->valid = true;
+    filter->time_ns = time_ns;
+    filter->frames = frames;
+    proxy_restart_rate_fit(filter, frames, time_ns);
+    return filter->frames;
+}
+
+int proxy_get_presentation_position(alsa_device_proxy * proxy,
         uint64_t *frames, struct timespec *timestamp)
 {
     int ret = -EPERM; // -1
@@ -188,12 +354,26 @@ int proxy_get_presentation_position(const alsa_device_proxy * proxy,
         if (avail > kernel_buffer_size) {
             ALOGE("available frames(%u) > buffer size(%zu)", avail, kernel_buffer_size);
         } else {
-            int64_t signed_frames = proxy->transferred - kernel_buffer_size + avail;
-            // It is possible to compensate for additional driver and device delay
-            // by changing signed_frames.  Example:
-            // signed_frames -= 20 /* ms */ * proxy->alsa_config.rate / 1000;
+            // For playback, avail is the free space in the buffer, and frames are played
+            // after the delay. For capture, it is the frames captured but not read yet,
+            // and frames were captured before the delay.
+            int64_t signed_frames;
+            if (proxy->profile->direction == PCM_OUT) {
+                signed_frames = proxy->transferred - kernel_buffer_size + avail
+                        - proxy->delay_frames;
+            } else {
+                signed_frames = proxy->transferred + avail + proxy->delay_frames;
+            }
             if (signed_frames >= 0) {
-                *frames = signed_frames;
+                const int64_t time_ns =
+                        timestamp->tv_sec * 1000000000LL + timestamp->tv_nsec;
+                const double filtered = proxy_filter_position(proxy, signed_frames, time_ns);
+                uint64_t position = filtered > 0 ? (uint64_t)filtered : 0;
+                if (position < proxy->position.reported) {
+                    position = proxy->position.reported;
+                }
+                proxy->position.reported = position;
+                *frames = position;
                 ret = 0;
             }
         }
@@ -201,21 +381,362 @@ int proxy_get_presentation_position(const alsa_device_proxy * proxy,
     return ret;
 }
 
+/*
+ * XRUNs
+ */
+static int64_t proxy_get_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void proxy_set_xrun_preroll_frames(alsa_device_proxy * proxy, unsigned frames)
+{
+    proxy->xrun_preroll_frames = frames;
+}
+
+const proxy_xrun_stats * proxy_get_xrun_stats(const alsa_device_proxy * proxy)
+{
+    return &proxy->xruns;
+}
+
+static void proxy_record_xrun(alsa_device_proxy * proxy)
+{
+    proxy_xrun_stats *xruns = &proxy->xruns;
+    const int64_t now_ns = proxy_get_time_ns();
+    xruns->times_ns[xruns->count % PROXY_XRUN_HISTORY_SIZE] = now_ns;
+    xruns->count++;
+    if (xruns->recovery_start_ns == 0) {
+        xruns->recovery_start_ns = now_ns;
+    }
+    ALOGW("%s #%" PRIu64 " (card:%d device:%d)",
+          proxy->profile->direction == PCM_OUT ? "underrun" : "overrun", xruns->count,
+          proxy->profile->card, proxy->profile->device);
+}
+
+/*
+ * Measures how late a transfer of frames returned, compared to the time the device takes
+ * to play or capture them. Transfers that return early, such as while the buffer is filled
+ * at the start, are not late.
+ */
+static void proxy_measure_wakeup(alsa_device_proxy * proxy, unsigned int frames)
+{
+    const int64_t now_ns = proxy_get_time_ns();
+    if (proxy->last_transfer_ns != 0) {
+        const int64_t duration_ns = (int64_t)frames * 1000000000 / proxy->alsa_config.rate;
+        const int64_t lateness_ns = now_ns - proxy->last_transfer_ns - duration_ns;
+        if (lateness_ns > proxy->max_lateness_ns) {
+            proxy->max_lateness_ns = lateness_ns;
+        }
+    }
+    proxy->last_transfer_ns = now_ns;
+}
+
+/*
+ * Completes the recovery from an XRUN, if any, with the result of a transfer.
+ */
+static void proxy_end_recovery(alsa_device_proxy * proxy, int ret)
+{
+    proxy_xrun_stats *xruns = &proxy->xruns;
+    if (xruns->recovery_start_ns == 0) {
+        return;
+    }
+    if (ret == 0) {
+        xruns->last_recovery_ns = proxy_get_time_ns() - xruns->recovery_start_ns;
+        if (xruns->last_recovery_ns > xruns->max_recovery_ns) {
+            xruns->max_recovery_ns = xruns->last_recovery_ns;
+        }
+    } else {
+        xruns->failed_recoveries++;
+    }
+    xruns->recovery_start_ns = 0;
+}
+
+/*
+ * mmap
+ */
+static int proxy_start(alsa_device_proxy * proxy)
+{
+    int ret = pcm_start(proxy->pcm);
+    if (ret == 0) {
+        proxy->running = true;
+    } else {
+        ALOGE("proxy_start() pcm_start() failed: %s", pcm_get_error(proxy->pcm));
+    }
+    return ret;
+}
+
+int proxy_wait(alsa_device_proxy * proxy, unsigned int frames)
+{
+    if (proxy->transfer_mode == PROXY_TRANSFER_RW) {
+        return -ENOSYS;
+    }
+
+    const unsigned int buffer_size =
+            proxy->alsa_config.period_size * proxy->alsa_config.period_count;
+    const unsigned int rate = proxy->alsa_config.rate;
+    if (frames > buffer_size) {
+        frames = buffer_size;
+    }
+
+    for (;;) {
+        int avail = pcm_mmap_avail(proxy->pcm);
+        if (avail < 0) {
+            return avail;
+        }
+        if ((unsigned int)avail > buffer_size) {
+            // The device got ahead of the client. Prepare to start again on the next transfer.
+            proxy_record_xrun(proxy);
+            proxy->running = false;
+            pcm_prepare(proxy->pcm);
+            return -EPIPE;
+        }
+        if ((unsigned int)avail >= frames) {
+            return avail;
+        }
+        if (!proxy->running) {
+            // Capture starts on the first wait. Playback starts early when the client waits
+            // for room in a full buffer that is still short of the start threshold.
+            int ret = proxy_start(proxy);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+        if (proxy->transfer_mode == PROXY_TRANSFER_MMAP_NOIRQ) {
+            // There are no period interrupts to wake up on, so sleep until the missing
+            // frames should have been transferred by the device.
+            usleep(((uint64_t)(frames - avail) * 1000000 + rate - 1) / rate);
+        } else {
+            const int timeout_ms =
+                    proxy->alsa_config.period_size * MMAP_WAIT_TIMEOUT_PERIODS * 1000 / rate + 1;
+            int ret = pcm_wait(proxy->pcm, timeout_ms);
+            if (ret < 0) {
+                if (ret == -EPIPE) {
+                    proxy_record_xrun(proxy);
+                    proxy->running = false;
+                    pcm_prepare(proxy->pcm);
+                }
+                return ret;
+            }
+            if (ret == 0) {
+                ALOGW("proxy_wait() timed out after %d ms", timeout_ms);
+                return -ETIMEDOUT;
+            }
+        }
+    }
+}
+
+int proxy_mmap_begin(alsa_device_proxy * proxy, void **buffer, unsigned int *frames)
+{
+    if (proxy->transfer_mode == PROXY_TRANSFER_RW) {
+        return -ENOSYS;
+    }
+
+    void *areas;
+    unsigned int offset;
+    int ret = pcm_mmap_begin(proxy->pcm, &areas, &offset, frames);
+    if (ret < 0) {
+        return ret;
+    }
+    proxy->mmap_offset = offset;
+    *buffer = (uint8_t *)areas + pcm_frames_to_bytes(proxy->pcm, offset);
+    return 0;
+}
+
+/*
+ * Releases frames of the area from proxy_mmap_begin(), without counting them as transferred.
+ */
+static int proxy_mmap_release(alsa_device_proxy * proxy, unsigned int frames)
+{
+    int ret = pcm_mmap_commit(proxy->pcm, proxy->mmap_offset, frames);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (!proxy->running && proxy->profile->direction == PCM_OUT) {
+        const unsigned int buffer_size =
+                proxy->alsa_config.period_size * proxy->alsa_config.period_count;
+        int avail = pcm_mmap_avail(proxy->pcm);
+        if (avail >= 0
+                && buffer_size - (unsigned int)avail >= proxy->alsa_config.start_threshold) {
+            return proxy_start(proxy);
+        }
+    }
+    return 0;
+}
+
+int proxy_mmap_commit(alsa_device_proxy * proxy, unsigned int frames)
+{
+    if (proxy->transfer_mode == PROXY_TRANSFER_RW) {
+        return -ENOSYS;
+    }
+
+    int ret = proxy_mmap_release(proxy, frames);
+    if (ret == 0) {
+        proxy->transferred += frames;
+    }
+    proxy_end_recovery(proxy, ret);
+    return ret;
+}
+
+/*
+ * Queues frames of silence for playback.
+ * The silence is not counted as transferred, so positions only count the client's frames.
+ */
+static int proxy_write_silence(alsa_device_proxy * proxy, unsigned int frames)
+{
+    // All the formats of format_byte_size_map are signed, so silence is zero.
+    static const uint8_t zeros[4096];
+
+    // Leave room for at least a period of the client's frames, so that they don't block.
+    const unsigned int max_silence =
+            proxy->alsa_config.period_size * (proxy->alsa_config.period_count - 1);
+    if (frames > max_silence) {
+        frames = max_silence;
+    }
+    while (frames > 0) {
+        unsigned int n;
+        int ret;
+        if (proxy->transfer_mode == PROXY_TRANSFER_RW) {
+            const unsigned int max_frames = sizeof(zeros) / proxy->frame_size;
+            n = frames < max_frames ? frames : max_frames;
+            ret = pcm_write(proxy->pcm, zeros, n * proxy->frame_size);
+        } else {
+            void *buffer;
+            n = frames;
+            ret = proxy_mmap_begin(proxy, &buffer, &n);
+            if (ret < 0 || n == 0) {
+                return ret;
+            }
+            memset(buffer, 0, pcm_frames_to_bytes(proxy->pcm, n));
+            ret = proxy_mmap_release(proxy, n);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        frames -= n;
+    }
+    return 0;
+}
+
+/*
+ * Copy count bytes between data and the DMA buffer, waking up for at most a period at a time.
+ */
+static int proxy_mmap_transfer(alsa_device_proxy * proxy, void *data, unsigned int count)
+{
+    uint8_t *bytes = data;
+    unsigned int frames = pcm_bytes_to_frames(proxy->pcm, count);
+    bool recovered = false;
+    while (frames > 0) {
+        const unsigned int wanted = frames < proxy->alsa_config.period_size ?
+                frames : proxy->alsa_config.period_size;
+        int ret = proxy_wait(proxy, wanted);
+        if (ret == -EPIPE && !recovered) {
+            // proxy_wait() prepared the stream again. Continue with the remaining frames.
+            recovered = true;
+            if (proxy->profile->direction == PCM_OUT) {
+                ret = proxy_write_silence(proxy, proxy->xrun_preroll_frames);
+                if (ret < 0) {
+                    return ret;
+                }
+            }
+            continue;
+        }
+        if (ret < 0) {
+            return ret;
+        }
+
+        void *buffer;
+        unsigned int n = frames;
+        ret = proxy_mmap_begin(proxy, &buffer, &n);
+        if (ret < 0) {
+            return ret;
+        }
+        const unsigned int n_bytes = pcm_frames_to_bytes(proxy->pcm, n);
+        if (proxy->profile->direction == PCM_OUT) {
+            memcpy(buffer, bytes, n_bytes);
+        } else {
+            memcpy(bytes, buffer, n_bytes);
+        }
+        ret = proxy_mmap_commit(proxy, n);
+        if (ret < 0) {
+            return ret;
+        }
+        bytes += n_bytes;
+        frames -= n;
+    }
+    return 0;
+}
+
 /*
  * I/O
  */
 int proxy_write(alsa_device_proxy * proxy, const void *data, unsigned int count)
 {
-    int ret = pcm_write(proxy->pcm, data, count);
+    int ret;
+    if (proxy->transfer_mode != PROXY_TRANSFER_RW) {
+        ret = proxy_mmap_transfer(proxy, (void *)data, count);
+    } else {
+        // With PCM_NORESTART, pcm_write() reports an underrun, and prepares the stream
+        // again on the next call.
+        ret = pcm_write(proxy->pcm, data, count);
+        if (ret == -EPIPE) {
+            proxy_record_xrun(proxy);
+            ret = proxy_write_silence(proxy, proxy->xrun_preroll_frames);
+            if (ret == 0) {
+                ret = pcm_write(proxy->pcm, data, count);
+            }
+        }
+        if (ret == 0) {
+            proxy->transferred += count / proxy->frame_size;
+        }
+    }
     if (ret == 0) {
-        proxy->transferred += count / proxy->frame_size;
+        proxy_measure_wakeup(proxy, count / proxy->frame_size);
     }
+    proxy_end_recovery(proxy, ret);
     return ret;
 }
 
-int proxy_read(const alsa_device_proxy * proxy, void *data, unsigned int count)
+/*
+ * pcm_read() ignores PCM_NORESTART, and restarts the stream after an overrun by itself.
+ * So the overrun is detected before reading: the stream read from before is no longer
+ * running, or its buffer is full.
+ */
+static bool proxy_capture_overrun(alsa_device_proxy * proxy)
+{
+    if (!proxy->running) {
+        return false;
+    }
+    unsigned int avail;
+    struct timespec timestamp;
+    if (pcm_get_htimestamp(proxy->pcm, &avail, &timestamp) != 0) {
+        return true;
+    }
+    return avail >= proxy->alsa_config.period_size * proxy->alsa_config.period_count;
+}
+
+int proxy_read(alsa_device_proxy * proxy, void *data, unsigned int count)
 {
-    return pcm_read(proxy->pcm, data, count);
+    int ret;
+    if (proxy->transfer_mode != PROXY_TRANSFER_RW) {
+        ret = proxy_mmap_transfer(proxy, data, count);
+    } else {
+        if (proxy_capture_overrun(proxy)) {
+            proxy_record_xrun(proxy);
+        }
+        ret = pcm_read(proxy->pcm, data, count);
+        proxy->running = ret == 0;
+        if (ret == 0) {
+            proxy->transferred += count / proxy->frame_size;
+        }
+    }
+    if (ret == 0) {
+        proxy_measure_wakeup(proxy, count / proxy->frame_size);
+    }
+    proxy_end_recovery(proxy, ret);
+    return ret;
 }
 
 /*
@@ -229,5 +750,30 @@ void proxy_dump(const alsa_device_proxy* proxy, int fd)
         dprintf(fd, "  period_size: %d\n", proxy->alsa_config.period_size);
         dprintf(fd, "  period_count: %d\n", proxy->alsa_config.period_count);
         dprintf(fd, "  format: %d\n", proxy->alsa_config.format);
+        dprintf(fd, "  transfer_mode: %s\n",
+                proxy->transfer_mode == PROXY_TRANSFER_MMAP ? "mmap" :
+                proxy->transfer_mode == PROXY_TRANSFER_MMAP_NOIRQ ? "mmap_noirq" : "read/write");
+        dprintf(fd, "  delay_frames: %u\n", proxy->delay_frames);
+        dprintf(fd, "  rate_ratio: %.6f\n", proxy->position.rate_ratio);
+        dprintf(fd, "  timestamp_jitter_us: %.1f\n", proxy->position.jitter_ns / 1000);
+
+        const proxy_xrun_stats *xruns = &proxy->xruns;
+        dprintf(fd, "  xruns: %" PRIu64 " (failed recoveries: %" PRIu64 ")\n",
+                xruns->count, xruns->failed_recoveries);
+        dprintf(fd, "  xrun_preroll_frames: %u\n", proxy->xrun_preroll_frames);
+        dprintf(fd, "  max_wakeup_lateness_us: %" PRId64 "\n", proxy->max_lateness_ns / 1000);
+        if (xruns->count > 0) {
+            dprintf(fd, "  recovery_ms last: %.3f max: %.3f\n",
+                    xruns->last_recovery_ns / 1000000.0, xruns->max_recovery_ns / 1000000.0);
+            dprintf(fd, "  last xruns (ms ago):");
+            const int64_t now_ns = proxy_get_time_ns();
+            uint64_t index = xruns->count;
+            while (index > 0 && xruns->count - index < PROXY_XRUN_HISTORY_SIZE) {
+                index--;
+                dprintf(fd, " %" PRId64,
+                        (now_ns - xruns->times_ns[index % PROXY_XRUN_HISTORY_SIZE]) / 1000000);
+            }
+            dprintf(fd, "\n");
+        }
     }
 }
@@ -35,6 +35,18 @@
 #define DEFAULT_SAMPLE_FORMAT       PCM_FORMAT_S16_LE
 #define DEFAULT_CHANNEL_COUNT       2
 
+/* Period sizing adapted to the scheduling of the client, see profile_report_period_stats() */
+typedef struct {
+    bool enabled;
+    unsigned period_us;         /* the current choice */
+    unsigned period_count;      /* at least the minimum of the device, once read */
+    unsigned max_jitter_us;     /* largest wake-up jitter reported since the last change */
+    unsigned clean_ms;          /* streamed since the last change or XRUN */
+    unsigned xruns;             /* total reported */
+    unsigned increases;         /* number of changes to a longer buffer */
+    unsigned decreases;         /* number of changes to a shorter buffer */
+} profile_adaptive_period;
+
 typedef struct  {
     int card;
     int device;
@@ -56,6 +68,8 @@ typedef struct  {
 
     unsigned min_channel_count;
     unsigned max_channel_count;
+
+    profile_adaptive_period adaptive;
 } alsa_device_profile;
 
 void profile_init(alsa_device_profile* profile, int direction);
@@ -64,8 +78,17 @@ bool profile_is_valid(alsa_device_profile* profile);
 bool profile_is_cached_for(alsa_device_profile* profile, int card, int device);
 void profile_decache(alsa_device_profile* profile);
 
+/* Probes the device, or restores the attributes cached from an earlier probe */
 bool profile_read_device_info(alsa_device_profile* profile);
 
+/* Persistent cache of probed attributes, keyed by the USB identity of the card.
+ * The directory is set by the ro.audio.usb.profile_cache_dir property; empty disables it.
+ * Entries are checked against the current identity of the device when loaded.
+ * Invalidate the entry of a profile when the device rejects the cached attributes. */
+bool profile_load_from_cache(alsa_device_profile* profile);
+void profile_save_to_cache(const alsa_device_profile* profile);
+void profile_invalidate_cache(alsa_device_profile* profile);
+
 /* Audio Config Strings Methods */
 char * profile_get_sample_rate_strs(alsa_device_profile* profile);
 char * profile_get_format_strs(alsa_device_profile* profile);
@@ -87,6 +110,20 @@ bool profile_is_channel_count_valid(alsa_device_profile* profile, unsigned count
 /* Utility */
 unsigned profile_calc_min_period_size(alsa_device_profile* profile, unsigned sample_rate);
 unsigned int profile_get_period_size(alsa_device_profile* profile, unsigned sample_rate);
+unsigned int profile_get_period_count(alsa_device_profile* profile);
+
+/* Adaptive period sizing.
+ * When enabled, by profile_set_adaptive_period() or the ro.audio.usb.adaptive_period property,
+ * profile_get_period_size() and profile_get_period_count() start from a 1 ms period and the
+ * minimum period count of the device, and follow
+ * the timing reported at the end of each stream: the buffer doubles after an XRUN, or when the
+ * wake-up jitter takes more than half of the margin of the buffer, and shrinks by a quarter
+ * after a minute of clean streaming with jitter that leaves a margin at the shorter size.
+ * The choice applies to the next stream, and is reset when the device is decached. */
+void profile_set_adaptive_period(alsa_device_profile* profile, bool enabled);
+void profile_report_period_stats(alsa_device_profile* profile, unsigned duration_ms,
+                                 unsigned max_jitter_us, unsigned xruns);
+const profile_adaptive_period * profile_get_adaptive_period(const alsa_device_profile* profile);
 
 /* Debugging */
 void profile_dump(const alsa_device_profile* profile, int fd);
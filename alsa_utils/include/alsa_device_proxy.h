@@ -17,10 +17,51 @@
 #ifndef ANDROID_SYSTEM_MEDIA_ALSA_UTILS_ALSA_DEVICE_PROXY_H
 #define ANDROID_SYSTEM_MEDIA_ALSA_UTILS_ALSA_DEVICE_PROXY_H
 
+#include <stdbool.h>
+
 #include <tinyalsa/asoundlib.h>
 
 #include "alsa_device_profile.h"
 
+/* How data is transferred between the client and the device */
+typedef enum {
+    PROXY_TRANSFER_RW,          /* pcm_write() and pcm_read(), one system call per transfer */
+    PROXY_TRANSFER_MMAP,        /* directly through the mmap'ed DMA buffer,
+                                 * waiting for period interrupts when the buffer is full */
+    PROXY_TRANSFER_MMAP_NOIRQ,  /* as PROXY_TRANSFER_MMAP, without period interrupts;
+                                 * waits sleep for the time until enough frames are available */
+} proxy_transfer_mode_t;
+
+/* Filtered device position, updated by proxy_get_presentation_position() */
+typedef struct {
+    bool valid;             /* false until the first timestamp after proxy_open() */
+    int64_t anchor_ns;      /* time and position of the first timestamp of the fit */
+    double anchor_frames;
+    double sum_t;           /* sums for a least squares fit of the position to the time, */
+    double sum_f;           /* relative to the anchor, in seconds and frames */
+    double sum_tt;
+    double sum_tf;
+    unsigned count;         /* number of timestamps in the fit */
+    int64_t time_ns;        /* time of the last timestamp */
+    double frames;          /* filtered position at time_ns */
+    double rate_ratio;      /* measured device rate / nominal rate, kept over standby */
+    double jitter_ns;       /* mean deviation of the timestamps from the filtered position */
+    uint64_t reported;      /* last position returned, so that it never decreases */
+} proxy_position_filter;
+
+#define PROXY_XRUN_HISTORY_SIZE 8
+
+/* Underruns (PCM_OUT) or overruns (PCM_IN), and the recoveries from them */
+typedef struct {
+    uint64_t count;
+    int64_t times_ns[PROXY_XRUN_HISTORY_SIZE]; /* CLOCK_MONOTONIC times of the last events,
+                                                * the latest at (count - 1) % SIZE */
+    int64_t recovery_start_ns;  /* time of the XRUN being recovered from, or 0 */
+    int64_t last_recovery_ns;   /* from the XRUN until the next successful transfer */
+    int64_t max_recovery_ns;
+    uint64_t failed_recoveries; /* XRUNs after which the next transfer failed */
+} proxy_xrun_stats;
+
 typedef struct {
     alsa_device_profile* profile;
 
@@ -30,16 +71,48 @@ typedef struct {
 
     size_t frame_size;    /* valid after proxy_prepare(), the frame size in bytes */
     uint64_t transferred; /* the total frames transferred, not cleared on standby */
+
+    proxy_transfer_mode_t transfer_mode; /* PROXY_TRANSFER_RW after proxy_prepare() */
+    unsigned int mmap_offset; /* offset in frames of the area from proxy_mmap_begin() */
+    bool running;         /* true once the stream is started, for capture in read/write mode
+                             once a read succeeded */
+
+    unsigned delay_frames; /* device delay beyond the DMA buffer, see proxy_set_delay_us() */
+    proxy_position_filter position;
+
+    unsigned xrun_preroll_frames; /* silence written after an underrun, 0 by default */
+    proxy_xrun_stats xruns;
+
+    /* wake-up timing since proxy_open(), reported to the profile by proxy_close() */
+    int64_t last_transfer_ns;   /* when the last transfer returned, or 0 */
+    int64_t max_lateness_ns;    /* longest time a transfer took beyond its duration */
+    uint64_t transferred_at_open;
+    uint64_t xruns_at_open;
 } alsa_device_proxy;
 
 
 /* State */
 void proxy_prepare(alsa_device_proxy * proxy, alsa_device_profile * profile,
                    struct pcm_config * config);
+/* Select the transfer mode after proxy_prepare() and before proxy_open().
+ * proxy_open() falls back to PROXY_TRANSFER_RW if the device does not support mmap. */
+void proxy_set_transfer_mode(alsa_device_proxy * proxy, proxy_transfer_mode_t mode);
+proxy_transfer_mode_t proxy_get_transfer_mode(const alsa_device_proxy * proxy);
 int proxy_open(alsa_device_proxy * proxy);
 void proxy_close(alsa_device_proxy * proxy);
-int proxy_get_presentation_position(const alsa_device_proxy * proxy,
+/* Returns the number of frames played (PCM_OUT) or captured (PCM_IN) at the device
+ * at *timestamp, on CLOCK_MONOTONIC. The position is filtered to remove the jitter of
+ * the hardware pointer, follows the measured device rate, and never decreases. */
+int proxy_get_presentation_position(alsa_device_proxy * proxy,
         uint64_t *frames, struct timespec *timestamp);
+/* Sets the delay between the DMA buffer and the converter, for example as measured for a
+ * USB device. The default is the ro.audio.usb.delay_us property, or 0. */
+void proxy_set_delay_us(alsa_device_proxy * proxy, unsigned delay_us);
+/* Returns the measured ratio of the device sample rate to the nominal rate, 1.0 until
+ * timestamps over at least a second have been seen. */
+double proxy_get_rate_ratio(const alsa_device_proxy * proxy);
+/* Returns the mean deviation of the device timestamps from the filtered position, in ns */
+int64_t proxy_get_timestamp_jitter_ns(const alsa_device_proxy * proxy);
 
 /* Attributes */
 unsigned proxy_get_sample_rate(const alsa_device_proxy * proxy);
@@ -49,8 +122,28 @@ unsigned int proxy_get_period_size(const alsa_device_proxy * proxy);
 unsigned proxy_get_latency(const alsa_device_proxy * proxy);
 
 /* I/O */
+/* An XRUN during proxy_write() is counted and the transfer is retried once on the restarted
+ * stream, after the pre-roll silence. An overrun before proxy_read() is counted, and the read
+ * restarts the stream. */
 int proxy_write(alsa_device_proxy * proxy, const void *data, unsigned int count);
-int proxy_read(const alsa_device_proxy * proxy, void *data, unsigned int count);
+int proxy_read(alsa_device_proxy * proxy, void *data, unsigned int count);
+
+/* XRUNs */
+/* Sets the frames of silence queued before the data when playback restarts after an underrun,
+ * so that the device has a margin again. At most the buffer size less a period is queued. */
+void proxy_set_xrun_preroll_frames(alsa_device_proxy * proxy, unsigned frames);
+const proxy_xrun_stats * proxy_get_xrun_stats(const alsa_device_proxy * proxy);
+
+/* Direct access to the DMA buffer in the mmap transfer modes.
+ * proxy_wait() returns the number of frames available once at least the requested number
+ * can be transferred without blocking, or a negative error such as -EPIPE after an XRUN.
+ * proxy_mmap_begin() returns the next contiguous area of at most *frames frames
+ * in the DMA buffer, to be rendered into or read from in place, and updates *frames.
+ * proxy_mmap_commit() then releases the number of frames transferred, and starts the stream
+ * when enough frames have been queued. They return -ENOSYS in PROXY_TRANSFER_RW mode. */
+int proxy_wait(alsa_device_proxy * proxy, unsigned int frames);
+int proxy_mmap_begin(alsa_device_proxy * proxy, void **buffer, unsigned int *frames);
+int proxy_mmap_commit(alsa_device_proxy * proxy, unsigned int frames);
 
 /* Debugging */
 void proxy_dump(const alsa_device_proxy * proxy, int fd);
@@ -6,8 +6,10 @@ LOCAL_MODULE := libaudioutils
 LOCAL_MODULE_TAGS := optional
 
 LOCAL_SRC_FILES:= \
+	channel_mix.c \
 	channels.c \
 	conversion.cpp \
+	fft.c \
 	fifo.c \
 	fixedfft.cpp.arm \
 	format.c \
@@ -35,8 +37,12 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := libaudioutils
 LOCAL_MODULE_TAGS := optional
 LOCAL_SRC_FILES := \
+	channel_mix.c \
 	channels.c \
+	conversion.cpp \
+	fft.c \
 	fifo.c \
+	fixedfft.cpp \
 	format.c \
 	limiter.c \
 	minifloat.c \
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <audio_utils/channel_mix.h>
+#include <audio_utils/primitives.h>
+#include "private/simd.h"
+
+/* index of a channel bit within a positional channel mask */
+static inline uint32_t channel_index(uint32_t bits, uint32_t channel)
+{
+    return popcount(bits & (channel - 1));
+}
+
+static void channel_mix_fold(struct audio_utils_channel_mix *mix, uint32_t dst_bits,
+        uint32_t src_index, uint32_t channel, float gain, uint32_t flags)
+{
+    if (dst_bits & channel) {
+        mix->coefs[src_index][channel_index(dst_bits, channel)] += gain;
+        return;
+    }
+
+    switch (channel) {
+    case AUDIO_CHANNEL_OUT_FRONT_LEFT:
+    case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
+        if (dst_bits & AUDIO_CHANNEL_OUT_FRONT_CENTER) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_CENTER,
+                    gain * M_SQRT1_2, flags);
+        }
+        break;
+    case AUDIO_CHANNEL_OUT_FRONT_CENTER:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_LEFT,
+                gain * M_SQRT1_2, flags);
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_RIGHT,
+                gain * M_SQRT1_2, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_LOW_FREQUENCY:
+        if (flags & AUDIO_UTILS_CHANNEL_MIX_FLAG_MIX_LFE) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_LEFT,
+                    gain * M_SQRT1_2, flags);
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_RIGHT,
+                    gain * M_SQRT1_2, flags);
+        }
+        break;
+    case AUDIO_CHANNEL_OUT_BACK_LEFT:
+        if (dst_bits & AUDIO_CHANNEL_OUT_SIDE_LEFT) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_SIDE_LEFT,
+                    gain, flags);
+        } else {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_LEFT,
+                    gain * M_SQRT1_2, flags);
+        }
+        break;
+    case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+        if (dst_bits & AUDIO_CHANNEL_OUT_SIDE_RIGHT) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_SIDE_RIGHT,
+                    gain, flags);
+        } else {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_RIGHT,
+                    gain * M_SQRT1_2, flags);
+        }
+        break;
+    case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+        if (dst_bits & AUDIO_CHANNEL_OUT_BACK_LEFT) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_BACK_LEFT,
+                    gain, flags);
+        } else {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_LEFT,
+                    gain * M_SQRT1_2, flags);
+        }
+        break;
+    case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+        if (dst_bits & AUDIO_CHANNEL_OUT_BACK_RIGHT) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_BACK_RIGHT,
+                    gain, flags);
+        } else {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_RIGHT,
+                    gain * M_SQRT1_2, flags);
+        }
+        break;
+    case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_LEFT, gain, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_RIGHT, gain, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_BACK_CENTER: {
+        static const uint32_t kBack =
+                AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
+        static const uint32_t kSide =
+                AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
+        if ((dst_bits & kBack) == kBack) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_BACK_LEFT,
+                    gain * M_SQRT1_2, flags);
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_BACK_RIGHT,
+                    gain * M_SQRT1_2, flags);
+        } else if ((dst_bits & kSide) == kSide) {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_SIDE_LEFT,
+                    gain * M_SQRT1_2, flags);
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_SIDE_RIGHT,
+                    gain * M_SQRT1_2, flags);
+        } else {
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_LEFT,
+                    gain * 0.5f, flags);
+            channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_RIGHT,
+                    gain * 0.5f, flags);
+        }
+    } break;
+    case AUDIO_CHANNEL_OUT_TOP_CENTER:
+    case AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_CENTER,
+                gain * M_SQRT1_2, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_LEFT,
+                gain * M_SQRT1_2, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_FRONT_RIGHT,
+                gain * M_SQRT1_2, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_BACK_LEFT,
+                gain * M_SQRT1_2, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_TOP_BACK_CENTER:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_BACK_CENTER,
+                gain * M_SQRT1_2, flags);
+        break;
+    case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
+        channel_mix_fold(mix, dst_bits, src_index, AUDIO_CHANNEL_OUT_BACK_RIGHT,
+                gain * M_SQRT1_2, flags);
+        break;
+    default:
+        break;
+    }
+}
+
+static void channel_mix_init_positional(struct audio_utils_channel_mix *mix,
+        uint32_t dst_bits, uint32_t src_bits, uint32_t flags)
+{
+    static const uint32_t kStereo = AUDIO_CHANNEL_OUT_STEREO;
+
+    if (mix->dst_channels == 1 && mix->src_channels > 1) {
+        // mono is the average of the stereo downmix
+        struct audio_utils_channel_mix stereo;
+        memset(&stereo, 0, sizeof(stereo));
+        stereo.src_channels = mix->src_channels;
+        stereo.dst_channels = 2;
+        channel_mix_init_positional(&stereo, kStereo, src_bits, flags);
+        for (uint32_t i = 0; i < mix->src_channels; ++i) {
+            mix->coefs[i][0] = (stereo.coefs[i][0] + stereo.coefs[i][1]) * 0.5f;
+        }
+        return;
+    }
+    if (mix->src_channels == 1 && (dst_bits & kStereo) == kStereo) {
+        // mono is copied to both front channels
+        mix->coefs[0][channel_index(dst_bits, AUDIO_CHANNEL_OUT_FRONT_LEFT)] = 1.0f;
+        mix->coefs[0][channel_index(dst_bits, AUDIO_CHANNEL_OUT_FRONT_RIGHT)] = 1.0f;
+        return;
+    }
+
+    uint32_t src_index = 0;
+    for (uint32_t bits = src_bits; bits != 0; bits &= bits - 1) {
+        const uint32_t channel = bits & -bits;
+        channel_mix_fold(mix, dst_bits, src_index++, channel, 1.0f, flags);
+    }
+}
+
+int audio_utils_channel_mix_init(struct audio_utils_channel_mix *mix,
+        audio_channel_mask_t dst_mask, audio_channel_mask_t src_mask, uint32_t flags)
+{
+    if (mix == NULL) {
+        return -EINVAL;
+    }
+    const uint32_t dst_channels = audio_channel_count_from_out_mask(dst_mask);
+    const uint32_t src_channels = audio_channel_count_from_out_mask(src_mask);
+    if (dst_channels == 0 || dst_channels > AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS ||
+            src_channels == 0 || src_channels > AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS) {
+        return -EINVAL;
+    }
+
+    memset(mix, 0, sizeof(*mix));
+    mix->dst_channels = dst_channels;
+    mix->src_channels = src_channels;
+
+    if (audio_channel_mask_get_representation(dst_mask) == AUDIO_CHANNEL_REPRESENTATION_INDEX ||
+            audio_channel_mask_get_representation(src_mask) ==
+                    AUDIO_CHANNEL_REPRESENTATION_INDEX) {
+        for (uint32_t i = 0; i < dst_channels && i < src_channels; ++i) {
+            mix->coefs[i][i] = 1.0f;
+        }
+        return 0;
+    }
+
+    channel_mix_init_positional(mix,
+            audio_channel_mask_get_bits(dst_mask) & AUDIO_CHANNEL_OUT_ALL,
+            audio_channel_mask_get_bits(src_mask) & AUDIO_CHANNEL_OUT_ALL, flags);
+    return 0;
+}
+
+/*
+ * Each source sample is broadcast and multiplied by the row of gains to all destination
+ * channels, accumulating up to 8 destination channels in two vectors. Stereo destinations
+ * only fill half a vector that way, so they mix two frames per vector instead.
+ * The i16 variant widens samples to float on load and clamps on store.
+ */
+#define CHANNEL_MIX_KERNEL(mix, dst, src, count, LOAD, STORE) \
+{ \
+    const uint32_t src_channels = (mix)->src_channels; \
+    const uint32_t dst_channels = (mix)->dst_channels; \
+    size_t i = 0; \
+    CHANNEL_MIX_STEREO_BLOCKS(mix, dst, src, count, LOAD, STORE) \
+    for (; i < count; ++i) { \
+        float out[AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS]; \
+        CHANNEL_MIX_FRAME(mix, out, src + i * src_channels, LOAD) \
+        for (uint32_t d = 0; d < dst_channels; ++d) { \
+            (dst)[i * dst_channels + d] = STORE(out[d]); \
+        } \
+    } \
+}
+
+#ifdef AUDIO_UTILS_SIMD
+
+#define CHANNEL_MIX_FRAME(mix, out, in, LOAD) \
+{ \
+    audio_v4f acc0 = {0, 0, 0, 0}; \
+    audio_v4f acc1 = {0, 0, 0, 0}; \
+    for (uint32_t s = 0; s < src_channels; ++s) { \
+        const float x = LOAD((in)[s]); \
+        audio_v4f c0, c1; \
+        AUDIO_SIMD_LOAD(c0, &(mix)->coefs[s][0]); \
+        AUDIO_SIMD_LOAD(c1, &(mix)->coefs[s][4]); \
+        acc0 += c0 * x; \
+        acc1 += c1 * x; \
+    } \
+    AUDIO_SIMD_STORE(out, acc0); \
+    AUDIO_SIMD_STORE(out + 4, acc1); \
+}
+
+#define CHANNEL_MIX_STEREO_BLOCKS(mix, dst, src, count, LOAD, STORE) \
+    if (dst_channels == 2) { \
+        for (; i + 2 <= count; i += 2) { \
+            const typeof(*(src)) *in = (src) + i * src_channels; \
+            audio_v4f acc = {0, 0, 0, 0}; \
+            for (uint32_t s = 0; s < src_channels; ++s) { \
+                const float c0 = (mix)->coefs[s][0]; \
+                const float c1 = (mix)->coefs[s][1]; \
+                const float x0 = LOAD(in[s]); \
+                const float x1 = LOAD(in[src_channels + s]); \
+                const audio_v4f c = {c0, c1, c0, c1}; \
+                const audio_v4f x = {x0, x0, x1, x1}; \
+                acc += c * x; \
+            } \
+            for (int d = 0; d < 4; ++d) { \
+                (dst)[i * 2 + d] = STORE(acc[d]); \
+            } \
+        } \
+    }
+
+#else
+
+#define CHANNEL_MIX_FRAME(mix, out, in, LOAD) \
+{ \
+    for (uint32_t d = 0; d < dst_channels; ++d) { \
+        out[d] = 0; \
+    } \
+    for (uint32_t s = 0; s < src_channels; ++s) { \
+        const float x = LOAD((in)[s]); \
+        for (uint32_t d = 0; d < dst_channels; ++d) { \
+            out[d] += (mix)->coefs[s][d] * x; \
+        } \
+    } \
+}
+
+#define CHANNEL_MIX_STEREO_BLOCKS(mix, dst, src, count, LOAD, STORE)
+
+#endif
+
+#define CHANNEL_MIX_IDENTITY(x) (x)
+
+void audio_utils_channel_mix_float(const struct audio_utils_channel_mix *mix,
+        float *dst, const float *src, size_t count)
+{
+    CHANNEL_MIX_KERNEL(mix, dst, src, count, CHANNEL_MIX_IDENTITY, CHANNEL_MIX_IDENTITY)
+}
+
+void audio_utils_channel_mix_i16(const struct audio_utils_channel_mix *mix,
+        int16_t *dst, const int16_t *src, size_t count)
+{
+    CHANNEL_MIX_KERNEL(mix, dst, src, count, float_from_i16, clamp16_from_float)
+}
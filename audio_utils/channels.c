@@ -17,6 +17,7 @@
 #include <string.h>
 #include <audio_utils/channels.h>
 #include "private/private.h"
+#include "private/simd.h"
 
 /*
  * Clamps a 24-bit value from a 32-bit sample
@@ -359,10 +360,430 @@ static size_t expand_channels(const void* in_buff, size_t in_buff_chans,
     }
 }
 
+/*
+ * Specialized kernels for the most common channel pairs.
+ *
+ * Expansions from stereo and contractions to stereo move whole stereo frames, so they are
+ * implemented on "units" of one stereo frame: 32 bits for 16 bit samples, 64 bits for
+ * 32 bit samples and 6 bytes for packed 24 bit samples. Expanding spreads each unit to
+ * every k-th unit of the output and zero fills the others; contracting gathers every k-th
+ * unit of the input.
+ *
+ * Like the macros above, expansions run from back to front and contractions from front to
+ * back, and every vector block is entirely loaded before it is stored, so in_buff and
+ * out_buff may be the same buffer.
+ */
+
+static inline void spread_units32(uint8_t *dst, const uint8_t *src, size_t count,
+                                  const size_t k)
+{
+    size_t blocks = 0;
+#ifdef AUDIO_UTILS_SIMD
+    blocks = count / 4;
+#endif
+    // remainder at the end of the buffer first, as we move back to front
+    for (size_t i = count; i > blocks * 4; ) {
+        --i;
+        uint32_t unit;
+        memcpy(&unit, src + i * 4, sizeof(unit));
+        memset(dst + (i * k + 1) * 4, 0, (k - 1) * 4);
+        memcpy(dst + i * k * 4, &unit, sizeof(unit));
+    }
+#ifdef AUDIO_UTILS_SIMD
+    const audio_v4i32 z = {0, 0, 0, 0};
+    while (blocks-- > 0) {
+        audio_v4i32 v;
+        AUDIO_SIMD_LOAD(v, src + blocks * 16);
+        uint8_t *out = dst + blocks * 16 * k;
+        if (k == 2) {
+            audio_v4i32 o0 = AUDIO_SIMD_SHUFFLE(v, z, 0, 4, 1, 4);
+            audio_v4i32 o1 = AUDIO_SIMD_SHUFFLE(v, z, 2, 4, 3, 4);
+            AUDIO_SIMD_STORE(out + 16, o1);
+            AUDIO_SIMD_STORE(out, o0);
+        } else if (k == 3) {
+            audio_v4i32 o0 = AUDIO_SIMD_SHUFFLE(v, z, 0, 4, 4, 1);
+            audio_v4i32 o1 = AUDIO_SIMD_SHUFFLE(v, z, 4, 4, 2, 4);
+            audio_v4i32 o2 = AUDIO_SIMD_SHUFFLE(v, z, 4, 3, 4, 4);
+            AUDIO_SIMD_STORE(out + 32, o2);
+            AUDIO_SIMD_STORE(out + 16, o1);
+            AUDIO_SIMD_STORE(out, o0);
+        } else /* k == 4 */ {
+            audio_v4i32 o0 = AUDIO_SIMD_SHUFFLE(v, z, 0, 4, 4, 4);
+            audio_v4i32 o1 = AUDIO_SIMD_SHUFFLE(v, z, 1, 4, 4, 4);
+            audio_v4i32 o2 = AUDIO_SIMD_SHUFFLE(v, z, 2, 4, 4, 4);
+            audio_v4i32 o3 = AUDIO_SIMD_SHUFFLE(v, z, 3, 4, 4, 4);
+            AUDIO_SIMD_STORE(out + 48, o3);
+            AUDIO_SIMD_STORE(out + 32, o2);
+            AUDIO_SIMD_STORE(out + 16, o1);
+            AUDIO_SIMD_STORE(out, o0);
+        }
+    }
+#endif
+}
+
+static inline void spread_units64(uint8_t *dst, const uint8_t *src, size_t count,
+                                  const size_t k)
+{
+    size_t blocks = 0;
+#ifdef AUDIO_UTILS_SIMD
+    blocks = count / 2;
+#endif
+    for (size_t i = count; i > blocks * 2; ) {
+        --i;
+        uint64_t unit;
+        memcpy(&unit, src + i * 8, sizeof(unit));
+        memset(dst + (i * k + 1) * 8, 0, (k - 1) * 8);
+        memcpy(dst + i * k * 8, &unit, sizeof(unit));
+    }
+#ifdef AUDIO_UTILS_SIMD
+    const audio_v2i64 z = {0, 0};
+    while (blocks-- > 0) {
+        audio_v2i64 v;
+        AUDIO_SIMD_LOAD(v, src + blocks * 16);
+        uint8_t *out = dst + blocks * 16 * k;
+        if (k == 2) {
+            audio_v2i64 o0 = AUDIO_SIMD_SHUFFLE(v, z, 0, 2);
+            audio_v2i64 o1 = AUDIO_SIMD_SHUFFLE(v, z, 1, 2);
+            AUDIO_SIMD_STORE(out + 16, o1);
+            AUDIO_SIMD_STORE(out, o0);
+        } else if (k == 3) {
+            audio_v2i64 o0 = AUDIO_SIMD_SHUFFLE(v, z, 0, 2);
+            audio_v2i64 o1 = AUDIO_SIMD_SHUFFLE(v, z, 2, 1);
+            AUDIO_SIMD_STORE(out + 32, z);
+            AUDIO_SIMD_STORE(out + 16, o1);
+            AUDIO_SIMD_STORE(out, o0);
+        } else /* k == 4 */ {
+            audio_v2i64 o0 = AUDIO_SIMD_SHUFFLE(v, z, 0, 2);
+            audio_v2i64 o2 = AUDIO_SIMD_SHUFFLE(v, z, 1, 2);
+            AUDIO_SIMD_STORE(out + 48, z);
+            AUDIO_SIMD_STORE(out + 32, o2);
+            AUDIO_SIMD_STORE(out + 16, z);
+            AUDIO_SIMD_STORE(out, o0);
+        }
+    }
+#endif
+}
+
+static inline void gather_units32(uint8_t *dst, const uint8_t *src, size_t count,
+                                  const size_t k)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 4 <= count; i += 4) {
+        const uint8_t *in = src + i * k * 4;
+        audio_v4i32 a, b, o;
+        AUDIO_SIMD_LOAD(a, in);
+        AUDIO_SIMD_LOAD(b, in + 16);
+        if (k == 2) {
+            o = AUDIO_SIMD_SHUFFLE(a, b, 0, 2, 4, 6);
+        } else if (k == 3) {
+            audio_v4i32 c;
+            AUDIO_SIMD_LOAD(c, in + 32);
+            audio_v4i32 t = AUDIO_SIMD_SHUFFLE(a, b, 0, 3, 6, 6);
+            o = AUDIO_SIMD_SHUFFLE(t, c, 0, 1, 2, 5);
+        } else /* k == 4 */ {
+            audio_v4i32 c, d;
+            AUDIO_SIMD_LOAD(c, in + 32);
+            AUDIO_SIMD_LOAD(d, in + 48);
+            audio_v4i32 t0 = AUDIO_SIMD_SHUFFLE(a, b, 0, 4, 0, 4);
+            audio_v4i32 t1 = AUDIO_SIMD_SHUFFLE(c, d, 0, 4, 0, 4);
+            o = AUDIO_SIMD_SHUFFLE(t0, t1, 0, 1, 4, 5);
+        }
+        AUDIO_SIMD_STORE(dst + i * 4, o);
+    }
+#endif
+    for (; i < count; ++i) {
+        uint32_t unit;
+        memcpy(&unit, src + i * k * 4, sizeof(unit));
+        memcpy(dst + i * 4, &unit, sizeof(unit));
+    }
+}
+
+static inline void gather_units64(uint8_t *dst, const uint8_t *src, size_t count,
+                                  const size_t k)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 2 <= count; i += 2) {
+        const uint8_t *in = src + i * k * 8;
+        audio_v2i64 a, b, o;
+        AUDIO_SIMD_LOAD(a, in);
+        if (k == 2) {
+            AUDIO_SIMD_LOAD(b, in + 16);
+            o = AUDIO_SIMD_SHUFFLE(a, b, 0, 2);
+        } else if (k == 3) {
+            AUDIO_SIMD_LOAD(b, in + 16);
+            o = AUDIO_SIMD_SHUFFLE(a, b, 0, 3);
+        } else /* k == 4 */ {
+            AUDIO_SIMD_LOAD(b, in + 32);
+            o = AUDIO_SIMD_SHUFFLE(a, b, 0, 2);
+        }
+        AUDIO_SIMD_STORE(dst + i * 8, o);
+    }
+#endif
+    for (; i < count; ++i) {
+        uint64_t unit;
+        memcpy(&unit, src + i * k * 8, sizeof(unit));
+        memcpy(dst + i * 8, &unit, sizeof(unit));
+    }
+}
+
+/* duplicates each mono sample to a stereo frame, back to front */
+static void expand_mono_to_stereo_16(int16_t *dst, const int16_t *src, size_t count)
+{
+    size_t blocks = 0;
+#ifdef AUDIO_UTILS_SIMD
+    blocks = count / 8;
+#endif
+    for (size_t i = count; i > blocks * 8; ) {
+        --i;
+        const int16_t sample = src[i];
+        dst[i * 2 + 1] = sample;
+        dst[i * 2] = sample;
+    }
+#ifdef AUDIO_UTILS_SIMD
+    while (blocks-- > 0) {
+        audio_v8i16 v;
+        AUDIO_SIMD_LOAD(v, src + blocks * 8);
+        audio_v8i16 o0 = AUDIO_SIMD_SHUFFLE(v, v, 0, 0, 1, 1, 2, 2, 3, 3);
+        audio_v8i16 o1 = AUDIO_SIMD_SHUFFLE(v, v, 4, 4, 5, 5, 6, 6, 7, 7);
+        AUDIO_SIMD_STORE(dst + blocks * 16 + 8, o1);
+        AUDIO_SIMD_STORE(dst + blocks * 16, o0);
+    }
+#endif
+}
+
+static void expand_mono_to_stereo_32(int32_t *dst, const int32_t *src, size_t count)
+{
+    size_t blocks = 0;
+#ifdef AUDIO_UTILS_SIMD
+    blocks = count / 4;
+#endif
+    for (size_t i = count; i > blocks * 4; ) {
+        --i;
+        const int32_t sample = src[i];
+        dst[i * 2 + 1] = sample;
+        dst[i * 2] = sample;
+    }
+#ifdef AUDIO_UTILS_SIMD
+    while (blocks-- > 0) {
+        audio_v4i32 v;
+        AUDIO_SIMD_LOAD(v, src + blocks * 4);
+        audio_v4i32 o0 = AUDIO_SIMD_SHUFFLE(v, v, 0, 0, 1, 1);
+        audio_v4i32 o1 = AUDIO_SIMD_SHUFFLE(v, v, 2, 2, 3, 3);
+        AUDIO_SIMD_STORE(dst + blocks * 8 + 4, o1);
+        AUDIO_SIMD_STORE(dst + blocks * 8, o0);
+    }
+#endif
+}
+
+/* averages stereo frames to mono, front to back.
+ * (l & r) + ((l ^ r) >> 1) is the same half adder as CONTRACT_TO_MONO, computed on
+ * 16 bit lanes without overflow.
+ */
+static void contract_stereo_to_mono_16(int16_t *dst, const int16_t *src, size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 8 <= count; i += 8) {
+        audio_v8i16 a, b;
+        AUDIO_SIMD_LOAD(a, src + i * 2);
+        AUDIO_SIMD_LOAD(b, src + i * 2 + 8);
+        audio_v8i16 l = AUDIO_SIMD_SHUFFLE(a, b, 0, 2, 4, 6, 8, 10, 12, 14);
+        audio_v8i16 r = AUDIO_SIMD_SHUFFLE(a, b, 1, 3, 5, 7, 9, 11, 13, 15);
+        audio_v8i16 o = (l & r) + ((l ^ r) >> 1);
+        AUDIO_SIMD_STORE(dst + i, o);
+    }
+#endif
+    for (; i < count; ++i) {
+        const int32_t l = src[i * 2];
+        const int32_t r = src[i * 2 + 1];
+        dst[i] = (l & r) + ((l ^ r) >> 1);
+    }
+}
+
+static void contract_stereo_to_mono_32(int32_t *dst, const int32_t *src, size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 4 <= count; i += 4) {
+        audio_v4i32 a, b;
+        AUDIO_SIMD_LOAD(a, src + i * 2);
+        AUDIO_SIMD_LOAD(b, src + i * 2 + 4);
+        audio_v4i32 l = AUDIO_SIMD_SHUFFLE(a, b, 0, 2, 4, 6);
+        audio_v4i32 r = AUDIO_SIMD_SHUFFLE(a, b, 1, 3, 5, 7);
+        audio_v4i32 o = (l & r) + ((l ^ r) >> 1);
+        AUDIO_SIMD_STORE(dst + i, o);
+    }
+#endif
+    for (; i < count; ++i) {
+        const int32_t l = src[i * 2];
+        const int32_t r = src[i * 2 + 1];
+        dst[i] = (l & r) + ((l ^ r) >> 1);
+    }
+}
+
+/* Packed 24 bit samples have no natural vector layout; these move whole 3 or 6 byte units
+ * and only unpack samples to average them. A sign extended 24 bit sample never needs
+ * clamping, so clamp24() is skipped.
+ */
+static void expand_mono_to_stereo_24(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = count; i-- > 0; ) {
+        uint8_t sample[3];
+        memcpy(sample, src + i * 3, 3);
+        memcpy(dst + i * 6 + 3, sample, 3);
+        memcpy(dst + i * 6, sample, 3);
+    }
+}
+
+static void spread_stereo_24(uint8_t *dst, const uint8_t *src, size_t count, size_t k)
+{
+    for (size_t i = count; i-- > 0; ) {
+        uint8_t frame[6];
+        memcpy(frame, src + i * 6, 6);
+        memset(dst + i * 6 * k + 6, 0, 6 * (k - 1));
+        memcpy(dst + i * 6 * k, frame, 6);
+    }
+}
+
+static void gather_stereo_24(uint8_t *dst, const uint8_t *src, size_t count, size_t k)
+{
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t frame[6];
+        memcpy(frame, src + i * 6 * k, 6);
+        memcpy(dst + i * 6, frame, 6);
+    }
+}
+
+static inline int32_t i32_from_packed24(const uint8_t *p)
+{
+#ifdef HAVE_BIG_ENDIAN
+    return (int32_t)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8) >> 8;
+#else
+    return (int32_t)((uint32_t)p[2] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[0] << 8) >> 8;
+#endif
+}
+
+static void contract_stereo_to_mono_24(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t sum = i32_from_packed24(src + i * 6) + i32_from_packed24(src + i * 6 + 3);
+        const uint8x3_t out = int32_to_uint8x3(sum >> 1);
+        memcpy(dst + i * 3, &out, 3);
+    }
+}
+
+/*
+ * Converts with a specialized kernel for 1->2, 2->1, 2->4, 2->6, 2->8, 6->2 and 8->2 channels
+ * of 2, 3 or 4 byte samples.
+ * Produces the same output as expand_channels() and contract_channels().
+ * returns
+ *   the number of BYTES of output data, or 0 if there is no specialized kernel.
+ */
+static size_t adjust_channels_specialized(const void* in_buff, size_t in_buff_chans,
+                                          void* out_buff, size_t out_buff_chans,
+                                          unsigned sample_size_in_bytes, size_t num_in_bytes)
+{
+    if (sample_size_in_bytes < 2 || sample_size_in_bytes > 4) {
+        return 0;
+    }
+    const size_t frames = num_in_bytes / (in_buff_chans * sample_size_in_bytes);
+    const size_t num_out_bytes = frames * out_buff_chans * sample_size_in_bytes;
+
+    if (in_buff_chans == 1 && out_buff_chans == 2) {
+        switch (sample_size_in_bytes) {
+        case 2:
+            expand_mono_to_stereo_16((int16_t *)out_buff, (const int16_t *)in_buff, frames);
+            break;
+        case 3:
+            expand_mono_to_stereo_24((uint8_t *)out_buff, (const uint8_t *)in_buff, frames);
+            break;
+        case 4:
+            expand_mono_to_stereo_32((int32_t *)out_buff, (const int32_t *)in_buff, frames);
+            break;
+        }
+        return num_out_bytes;
+    }
+    if (in_buff_chans == 2 && out_buff_chans == 1) {
+        switch (sample_size_in_bytes) {
+        case 2:
+            contract_stereo_to_mono_16((int16_t *)out_buff, (const int16_t *)in_buff, frames);
+            break;
+        case 3:
+            contract_stereo_to_mono_24((uint8_t *)out_buff, (const uint8_t *)in_buff, frames);
+            break;
+        case 4:
+            contract_stereo_to_mono_32((int32_t *)out_buff, (const int32_t *)in_buff, frames);
+            break;
+        }
+        return num_out_bytes;
+    }
+    if (in_buff_chans == 2 && (out_buff_chans == 4 || out_buff_chans == 6 ||
+            out_buff_chans == 8)) {
+        const size_t k = out_buff_chans / 2;
+        switch (sample_size_in_bytes) {
+        case 2:
+            if (k == 2) {
+                spread_units32((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 2);
+            } else if (k == 3) {
+                spread_units32((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 3);
+            } else {
+                spread_units32((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 4);
+            }
+            break;
+        case 3:
+            spread_stereo_24((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, k);
+            break;
+        case 4:
+            if (k == 2) {
+                spread_units64((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 2);
+            } else if (k == 3) {
+                spread_units64((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 3);
+            } else {
+                spread_units64((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 4);
+            }
+            break;
+        }
+        return num_out_bytes;
+    }
+    if ((in_buff_chans == 6 || in_buff_chans == 8) && out_buff_chans == 2) {
+        const size_t k = in_buff_chans / 2;
+        switch (sample_size_in_bytes) {
+        case 2:
+            if (k == 3) {
+                gather_units32((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 3);
+            } else {
+                gather_units32((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 4);
+            }
+            break;
+        case 3:
+            gather_stereo_24((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, k);
+            break;
+        case 4:
+            if (k == 3) {
+                gather_units64((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 3);
+            } else {
+                gather_units64((uint8_t *)out_buff, (const uint8_t *)in_buff, frames, 4);
+            }
+            break;
+        }
+        return num_out_bytes;
+    }
+    return 0;
+}
+
 size_t adjust_channels(const void* in_buff, size_t in_buff_chans,
                        void* out_buff, size_t out_buff_chans,
                        unsigned sample_size_in_bytes, size_t num_in_bytes)
 {
+    size_t num_out_bytes = adjust_channels_specialized(in_buff, in_buff_chans,
+                                                       out_buff, out_buff_chans,
+                                                       sample_size_in_bytes, num_in_bytes);
+    if (num_out_bytes != 0 || num_in_bytes == 0) {
+        return num_out_bytes;
+    }
+
     if (out_buff_chans > in_buff_chans) {
         return expand_channels(in_buff, in_buff_chans, out_buff,  out_buff_chans,
                                sample_size_in_bytes, num_in_bytes);
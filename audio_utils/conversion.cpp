@@ -21,46 +21,187 @@
 #include <audio_utils/conversion.h>
 #include <utils/Log.h>
 #include <audio_utils/limiter.h>
+#include "private/limiter_simd.h"
 
-// TODO: Speed up for special case of 2 channels?
-void mono_blend(void *buf, audio_format_t format, size_t channelCount, size_t frames, bool limit) {
-    if (channelCount < 2) {
-        return;
+// Stereo is by far the most common case, so it has dedicated kernels.
+// For stereo the mono sample of a frame is the sum of the frame with its channels swapped,
+// so frames never need to be deinterleaved.
+static void mono_blend_stereo_i16(int16_t *buf, size_t frames)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 4 <= frames; i += 4) {
+        audio_v8i16 a;
+        AUDIO_SIMD_LOAD(a, buf + i * 2);
+        const audio_v8i16 b = AUDIO_SIMD_SHUFFLE(a, a, 1, 0, 3, 2, 5, 4, 7, 6);
+        // floor((a + b) / 2) without overflow, then round to 0 like the division below
+        const audio_v8i16 floor_avg = (a & b) + ((a ^ b) >> 1);
+        const audio_v8i16 out = floor_avg + ((a ^ b) & (floor_avg >> 15) & 1);
+        AUDIO_SIMD_STORE(buf + i * 2, out);
     }
-    switch (format) {
-    case AUDIO_FORMAT_PCM_16_BIT: {
-        int16_t *out = (int16_t *)buf;
-        for (size_t i = 0; i < frames; ++i) {
-            const int16_t *in = out;
-            int accum = 0;
-            for (size_t j = 0; j < channelCount; ++j) {
-                accum += *in++;
-            }
-            accum /= channelCount; // round to 0
-            for (size_t j = 0; j < channelCount; ++j) {
-                *out++ = accum;
-            }
+#endif
+    for (; i < frames; ++i) {
+        const int16_t out = ((int)buf[i * 2] + buf[i * 2 + 1]) / 2; // round to 0
+        buf[i * 2] = out;
+        buf[i * 2 + 1] = out;
+    }
+}
+
+static void mono_blend_stereo_float(float *buf, size_t frames, bool limit)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    const float scale = limit ? M_SQRT1_2 : 0.5f;
+    for (; i + 2 <= frames; i += 2) {
+        audio_v4f a;
+        AUDIO_SIMD_LOAD(a, buf + i * 2);
+        audio_v4f out = (a + AUDIO_SIMD_SHUFFLE(a, a, 1, 0, 3, 2)) * scale;
+        if (limit) {
+            out = limiter_v4f(out);
         }
-    } break;
-    case AUDIO_FORMAT_PCM_FLOAT: {
-        float *out = (float *)buf;
-        const float recipdiv = 1. / channelCount;
-        for (size_t i = 0; i < frames; ++i) {
-            const float *in = out;
-            float accum = 0;
+        AUDIO_SIMD_STORE(buf + i * 2, out);
+    }
+#endif
+    for (; i < frames; ++i) {
+        float out = buf[i * 2] + buf[i * 2 + 1];
+        if (limit) {
+            out = limiter(out * M_SQRT1_2);
+        } else {
+            out *= 0.5f;
+        }
+        buf[i * 2] = out;
+        buf[i * 2 + 1] = out;
+    }
+}
+
+// Other channel counts accumulate four frames at a time, one vector lane per frame.
+// Common channel counts are template parameters, so the compiler can unroll the per frame
+// loops and divide by a constant; N == 0 uses the channelCount argument.
+template <size_t N>
+static void mono_blend_multichannel_i16(int16_t *buf, size_t channelCount, size_t frames)
+{
+    if (N != 0) {
+        channelCount = N;
+    }
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 4 <= frames; i += 4) {
+        int16_t *out = buf + i * channelCount;
+        audio_v4i32 accum = {0, 0, 0, 0};
+        for (size_t j = 0; j < channelCount; ++j) {
+            const audio_v4i32 in = {
+                out[j], out[channelCount + j], out[channelCount * 2 + j],
+                out[channelCount * 3 + j]
+            };
+            accum += in;
+        }
+        for (size_t k = 0; k < 4; ++k) {
+            const int16_t sample = accum[k] / (int)channelCount; // round to 0
             for (size_t j = 0; j < channelCount; ++j) {
-                accum += *in++;
-            }
-            if (limit && channelCount == 2) {
-                accum = limiter(accum * M_SQRT1_2);
-            } else {
-                accum *= recipdiv;
+                *out++ = sample;
             }
+        }
+    }
+#endif
+    int16_t *out = buf + i * channelCount;
+    for (; i < frames; ++i) {
+        const int16_t *in = out;
+        int accum = 0;
+        for (size_t j = 0; j < channelCount; ++j) {
+            accum += *in++;
+        }
+        accum /= (int)channelCount; // round to 0
+        for (size_t j = 0; j < channelCount; ++j) {
+            *out++ = accum;
+        }
+    }
+}
+
+template <size_t N>
+static void mono_blend_multichannel_float(float *buf, size_t channelCount, size_t frames)
+{
+    if (N != 0) {
+        channelCount = N;
+    }
+    const float recipdiv = 1. / channelCount;
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 4 <= frames; i += 4) {
+        float *out = buf + i * channelCount;
+        audio_v4f accum = {0, 0, 0, 0};
+        for (size_t j = 0; j < channelCount; ++j) {
+            const audio_v4f in = {
+                out[j], out[channelCount + j], out[channelCount * 2 + j],
+                out[channelCount * 3 + j]
+            };
+            accum += in;
+        }
+        accum *= recipdiv;
+        for (size_t k = 0; k < 4; ++k) {
+            const float sample = accum[k];
             for (size_t j = 0; j < channelCount; ++j) {
-                *out++ = accum;
+                *out++ = sample;
             }
         }
-    } break;
+    }
+#endif
+    float *out = buf + i * channelCount;
+    for (; i < frames; ++i) {
+        const float *in = out;
+        float accum = 0;
+        for (size_t j = 0; j < channelCount; ++j) {
+            accum += *in++;
+        }
+        accum *= recipdiv;
+        for (size_t j = 0; j < channelCount; ++j) {
+            *out++ = accum;
+        }
+    }
+}
+
+void mono_blend(void *buf, audio_format_t format, size_t channelCount, size_t frames, bool limit) {
+    if (channelCount < 2) {
+        return;
+    }
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        switch (channelCount) {
+        case 2:
+            mono_blend_stereo_i16((int16_t *)buf, frames);
+            break;
+        case 4:
+            mono_blend_multichannel_i16<4>((int16_t *)buf, channelCount, frames);
+            break;
+        case 6:
+            mono_blend_multichannel_i16<6>((int16_t *)buf, channelCount, frames);
+            break;
+        case 8:
+            mono_blend_multichannel_i16<8>((int16_t *)buf, channelCount, frames);
+            break;
+        default:
+            mono_blend_multichannel_i16<0>((int16_t *)buf, channelCount, frames);
+            break;
+        }
+        break;
+    case AUDIO_FORMAT_PCM_FLOAT:
+        switch (channelCount) {
+        case 2:
+            mono_blend_stereo_float((float *)buf, frames, limit);
+            break;
+        case 4:
+            mono_blend_multichannel_float<4>((float *)buf, channelCount, frames);
+            break;
+        case 6:
+            mono_blend_multichannel_float<6>((float *)buf, channelCount, frames);
+            break;
+        case 8:
+            mono_blend_multichannel_float<8>((float *)buf, channelCount, frames);
+            break;
+        default:
+            mono_blend_multichannel_float<0>((float *)buf, channelCount, frames);
+            break;
+        }
+        break;
     default:
         ALOGE("mono_blend: invalid format %d", format);
         break;
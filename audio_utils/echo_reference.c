@@ -21,9 +21,14 @@
 #include <inttypes.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include <cutils/atomic.h>
 #include <log/log.h>
 #include <system/audio.h>
+#include <audio_utils/channels.h>
+#include <audio_utils/primitives.h>
 #include <audio_utils/resampler.h>
 #include <audio_utils/echo_reference.h>
 
@@ -64,8 +69,36 @@ struct echo_reference {
     pthread_cond_t cond;                       // condition signaled when data is ready to read
     struct resampler_itfe *resampler;          // input resampler
     struct resampler_buffer_provider provider; // resampler buffer provider
+    volatile int32_t stats_seq;     // statistics sequence number, odd while stats are updated
+    struct echo_reference_stats stats; // statistics, only modified with lock held
 };
 
+// statistics are updated by read() and write() with er->lock held, so there is a single
+// writer at a time. echo_reference_get_stats() reads them without the lock and retries
+// until it observes the same even sequence number before and after copying.
+static void echo_reference_stats_begin_l(struct echo_reference *er)
+{
+    android_atomic_release_store(er->stats_seq + 1, &er->stats_seq);
+    android_memory_barrier();
+}
+
+static void echo_reference_stats_end_l(struct echo_reference *er)
+{
+    android_atomic_release_store(er->stats_seq + 1, &er->stats_seq);
+}
+
+static void echo_reference_stats_histogram_l(uint32_t *histogram, int64_t value, int64_t bin_ns,
+                                             int centered)
+{
+    int64_t bin = value / bin_ns + (centered ? ECHO_REFERENCE_HISTOGRAM_BINS / 2 : 0);
+    if (bin < 0) {
+        bin = 0;
+    } else if (bin >= ECHO_REFERENCE_HISTOGRAM_BINS) {
+        bin = ECHO_REFERENCE_HISTOGRAM_BINS - 1;
+    }
+    histogram[bin]++;
+}
+
 
 int echo_reference_get_next_buffer(struct resampler_buffer_provider *buffer_provider,
                                    struct resampler_buffer* buffer)
@@ -87,9 +120,9 @@ int echo_reference_get_next_buffer(struct resampler_buffer_provider *buffer_prov
 
     buffer->frame_count = (buffer->frame_count > er->wr_frames_in) ?
             er->wr_frames_in : buffer->frame_count;
-    // this is er->rd_channel_count here as we resample after stereo to mono conversion if any
-    buffer->i16 = (int16_t *)er->wr_src_buf + (er->wr_curr_frame_size - er->wr_frames_in) *
-            er->rd_channel_count;
+    // this is er->rd_frame_size here as we resample after channel conversion if any
+    buffer->raw = (char *)er->wr_src_buf + (er->wr_curr_frame_size - er->wr_frames_in) *
+            er->rd_frame_size;
 
     return 0;
 }
@@ -125,6 +158,51 @@ static void echo_reference_reset_l(struct echo_reference *er)
     er->prev_delta_sign = 0;
 }
 
+/* convert frame_count frames from the write channel count to the read channel count.
+ * A mono reference is the average of all playback channels, otherwise playback channels
+ * are kept in order, dropping extra channels or zero filling missing ones.
+ */
+static void echo_reference_adjust_channels_l(struct echo_reference *er, void *dst,
+                                             const void *src, size_t frame_count)
+{
+    if (er->rd_channel_count == 1 && er->wr_channel_count == 2) {
+        if (er->rd_format == AUDIO_FORMAT_PCM_FLOAT) {
+            downmix_to_mono_float_from_stereo_float((float *)dst, (const float *)src,
+                                                    frame_count);
+        } else {
+            downmix_to_mono_i16_from_stereo_i16((int16_t *)dst, (const int16_t *)src,
+                                                frame_count);
+        }
+    } else if (er->rd_channel_count == 1) {
+        const uint32_t channels = er->wr_channel_count;
+        if (er->rd_format == AUDIO_FORMAT_PCM_FLOAT) {
+            const float *src32 = (const float *)src;
+            float *dst32 = (float *)dst;
+            const float scale = 1.0f / channels;
+            while (frame_count--) {
+                float sum = 0;
+                for (uint32_t i = 0; i < channels; i++) {
+                    sum += *src32++;
+                }
+                *dst32++ = sum * scale;
+            }
+        } else {
+            const int16_t *src16 = (const int16_t *)src;
+            int16_t *dst16 = (int16_t *)dst;
+            while (frame_count--) {
+                int32_t sum = 0;
+                for (uint32_t i = 0; i < channels; i++) {
+                    sum += *src16++;
+                }
+                *dst16++ = (int16_t)(sum / (int32_t)channels);
+            }
+        }
+    } else {
+        adjust_channels(src, er->wr_channel_count, dst, er->rd_channel_count,
+                        audio_bytes_per_sample(er->rd_format), frame_count * er->wr_frame_size);
+    }
+}
+
 /* additional space in resampler buffer allowing for extra samples to be returned
  * by speex resampler when sample rates ratio is not an integer.
  */
@@ -184,7 +262,7 @@ static int echo_reference_write(struct echo_reference_itfe *echo_reference,
 
     void *srcBuf;
     size_t inFrames;
-    // do stereo to mono and down sampling if necessary
+    // do channel conversion and down sampling if necessary
     if (er->rd_channel_count != er->wr_channel_count ||
             er->rd_sampling_rate != er->wr_sampling_rate) {
         size_t wrBufSize = buffer->frame_count;
@@ -194,7 +272,7 @@ static int echo_reference_write(struct echo_reference_itfe *echo_reference,
         if (er->rd_sampling_rate != er->wr_sampling_rate) {
             inFrames = (buffer->frame_count * er->rd_sampling_rate) / er->wr_sampling_rate +
                                                     RESAMPLER_HEADROOM_SAMPLES;
-            // wr_buf is not only used as resampler output but also for stereo to mono conversion
+            // wr_buf is not only used as resampler output but also for channel conversion
             // output so buffer size is driven by both write and read sample rates
             if (inFrames > wrBufSize) {
                 wrBufSize = inFrames;
@@ -209,14 +287,7 @@ static int echo_reference_write(struct echo_reference_itfe *echo_reference,
         }
 
         if (er->rd_channel_count != er->wr_channel_count) {
-            // must be stereo to mono
-            int16_t *src16 = (int16_t *)buffer->raw;
-            int16_t *dst16 = (int16_t *)er->wr_buf;
-            size_t frames = buffer->frame_count;
-            while (frames--) {
-                *dst16++ = (int16_t)(((int32_t)*src16 + (int32_t)*(src16 + 1)) >> 1);
-                src16 += 2;
-            }
+            echo_reference_adjust_channels_l(er, er->wr_buf, buffer->raw, buffer->frame_count);
         }
         if (er->wr_sampling_rate != er->rd_sampling_rate) {
             if (er->resampler == NULL) {
@@ -225,12 +296,21 @@ static int echo_reference_write(struct echo_reference_itfe *echo_reference,
                       er->wr_sampling_rate, er->rd_sampling_rate);
                 er->provider.get_next_buffer = echo_reference_get_next_buffer;
                 er->provider.release_buffer = echo_reference_release_buffer;
-                rc = create_resampler(er->wr_sampling_rate,
-                                 er->rd_sampling_rate,
-                                 er->rd_channel_count,
-                                 RESAMPLER_QUALITY_DEFAULT,
-                                 &er->provider,
-                                 &er->resampler);
+                if (er->rd_format == AUDIO_FORMAT_PCM_FLOAT) {
+                    rc = create_resampler_float(er->wr_sampling_rate,
+                                     er->rd_sampling_rate,
+                                     er->rd_channel_count,
+                                     RESAMPLER_QUALITY_DEFAULT,
+                                     &er->provider,
+                                     &er->resampler);
+                } else {
+                    rc = create_resampler(er->wr_sampling_rate,
+                                     er->rd_sampling_rate,
+                                     er->rd_channel_count,
+                                     RESAMPLER_QUALITY_DEFAULT,
+                                     &er->provider,
+                                     &er->resampler);
+                }
                 if (rc != 0) {
                     er->resampler = NULL;
                     ALOGV("echo_reference_write() failure to create resampler %d", rc);
@@ -250,8 +330,13 @@ static int echo_reference_write(struct echo_reference_itfe *echo_reference,
             // inFrames is updated by resample() with the number of frames produced
             ALOGV("echo_reference_write() ReSampling(%d, %d)",
                   er->wr_sampling_rate, er->rd_sampling_rate);
-            er->resampler->resample_from_provider(er->resampler,
-                                                     (int16_t *)er->wr_buf, &inFrames);
+            if (er->rd_format == AUDIO_FORMAT_PCM_FLOAT) {
+                resampler_resample_from_provider_float(er->resampler,
+                                                       (float *)er->wr_buf, &inFrames);
+            } else {
+                er->resampler->resample_from_provider(er->resampler,
+                                                      (int16_t *)er->wr_buf, &inFrames);
+            }
             ALOGV_IF(er->wr_frames_in != 0,
                     "echo_reference_write() er->wr_frames_in not 0 (%d) after resampler",
                     er->wr_frames_in);
@@ -273,6 +358,10 @@ static int echo_reference_write(struct echo_reference_itfe *echo_reference,
            inFrames * er->rd_frame_size);
     er->frames_in += inFrames;
 
+    echo_reference_stats_begin_l(er);
+    er->stats.writes++;
+    echo_reference_stats_end_l(er);
+
     ALOGV("echo_reference_write() frames written:[%zu], frames total:[%zu] buffer size:[%zu]\n"
           "                       er->wr_render_time:[%d].[%d], er->playback_delay:[%" PRId32 "]",
           inFrames, er->frames_in, er->buf_size,
@@ -328,7 +417,11 @@ static int echo_reference_read(struct echo_reference_itfe *echo_reference,
 //    ALOGV("echo_reference_read() %d frames", buffer->frame_count);
 
     // allow some time for new frames to arrive if not enough frames are ready for read
+    int64_t waitNs = 0;
     if (er->frames_in < buffer->frame_count) {
+        struct timespec waitStart;
+        struct timespec waitEnd;
+        clock_gettime(CLOCK_MONOTONIC, &waitStart);
         uint32_t timeoutMs = (uint32_t)((1000 * buffer->frame_count) / er->rd_sampling_rate / 2);
         struct timespec ts = {0, 0};
 
@@ -349,12 +442,22 @@ static int echo_reference_read(struct echo_reference_itfe *echo_reference,
         pthread_cond_timedwait(&er->cond, &er->lock, &ts);
 #endif
 
+        clock_gettime(CLOCK_MONOTONIC, &waitEnd);
+        waitNs = (int64_t)(waitEnd.tv_sec - waitStart.tv_sec) * 1000000000 +
+                waitEnd.tv_nsec - waitStart.tv_nsec;
+
         ALOGV_IF((er->frames_in < buffer->frame_count),
                  "echo_reference_read() waited %d ms but still not enough frames"\
                  " er->frames_in: %d, buffer->frame_count = %d",
                  timeoutMs, er->frames_in, buffer->frame_count);
     }
 
+    echo_reference_stats_begin_l(er);
+    er->stats.reads++;
+    echo_reference_stats_histogram_l(er->stats.read_wait_histogram, waitNs,
+                                     ECHO_REFERENCE_READ_WAIT_BIN_NS, 0 /* centered */);
+    echo_reference_stats_end_l(er);
+
     int64_t timeDiff;
     struct timespec tmp;
 
@@ -393,6 +496,11 @@ static int echo_reference_read(struct echo_reference_itfe *echo_reference,
 
             ALOGV("echo_reference_read(): EchoPathDelayDeviation between reference and DMA [%"
                     PRId64 "]", deltaNs);
+            echo_reference_stats_begin_l(er);
+            er->stats.last_delay_error_ns = deltaNs;
+            echo_reference_stats_histogram_l(er->stats.delay_error_histogram, deltaNs,
+                                             ECHO_REFERENCE_DELAY_ERROR_BIN_NS, 1 /* centered */);
+            echo_reference_stats_end_l(er);
             if (llabs(deltaNs) >= MIN_DELAY_DELTA_NS) {
                 // smooth the variation and update the reference buffer only
                 // if a deviation in the same direction is observed for more than MIN_DELTA_NUM
@@ -427,6 +535,10 @@ static int echo_reference_read(struct echo_reference_itfe *echo_reference,
                             memset((char *)er->buffer + previousFrameIn * er->rd_frame_size,
                                    0, offset * er->rd_frame_size);
                             ALOGV("echo_reference_read(): pushing ref buffer by [%d]", offset);
+                            echo_reference_stats_begin_l(er);
+                            er->stats.underruns++;
+                            er->stats.frames_inserted += offset;
+                            echo_reference_stats_end_l(er);
                         }
                     } else {
                         // More data available in the reference buffer than expected
@@ -436,6 +548,10 @@ static int echo_reference_read(struct echo_reference_itfe *echo_reference,
                                    er->frames_in * er->rd_frame_size);
                             ALOGV("echo_reference_read(): shifting ref buffer by [%zu]",
                                   er->frames_in);
+                            echo_reference_stats_begin_l(er);
+                            er->stats.overruns++;
+                            er->stats.frames_dropped += offset;
+                            echo_reference_stats_end_l(er);
                         }
                     }
                 }
@@ -462,6 +578,10 @@ static int echo_reference_read(struct echo_reference_itfe *echo_reference,
         // filling up the reference buffer with 0s to match the expected delay.
         memset((char *)er->buffer + er->frames_in * er->rd_frame_size,
             0, (buffer->frame_count - er->frames_in) * er->rd_frame_size);
+        echo_reference_stats_begin_l(er);
+        er->stats.underruns++;
+        er->stats.frames_inserted += buffer->frame_count - er->frames_in;
+        echo_reference_stats_end_l(er);
         er->frames_in = buffer->frame_count;
     }
 
@@ -506,13 +626,13 @@ int create_echo_reference(audio_format_t rdFormat,
 
     *echo_reference = NULL;
 
-    if (rdFormat != AUDIO_FORMAT_PCM_16_BIT ||
+    if ((rdFormat != AUDIO_FORMAT_PCM_16_BIT && rdFormat != AUDIO_FORMAT_PCM_FLOAT) ||
             rdFormat != wrFormat) {
         ALOGW("create_echo_reference bad format rd %d, wr %d", rdFormat, wrFormat);
         return -EINVAL;
     }
-    if ((rdChannelCount != 1 && rdChannelCount != 2) ||
-            wrChannelCount != 2) {
+    if (rdChannelCount == 0 || rdChannelCount > FCC_8 ||
+            wrChannelCount == 0 || wrChannelCount > FCC_8) {
         ALOGW("create_echo_reference bad channel count rd %d, wr %d", rdChannelCount,
                 wrChannelCount);
         return -EINVAL;
@@ -551,3 +671,37 @@ void release_echo_reference(struct echo_reference_itfe *echo_reference) {
     free(er);
 }
 
+
+int echo_reference_get_stats(struct echo_reference_itfe *echo_reference,
+                             struct echo_reference_stats *stats)
+{
+    struct echo_reference *er = (struct echo_reference *)echo_reference;
+
+    if (er == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    int32_t seq;
+    do {
+        seq = android_atomic_acquire_load(&er->stats_seq);
+        memcpy(stats, &er->stats, sizeof(*stats));
+        android_memory_barrier();
+    } while ((seq & 1) != 0 || seq != android_atomic_acquire_load(&er->stats_seq));
+
+    return 0;
+}
+
+void echo_reference_reset_stats(struct echo_reference_itfe *echo_reference)
+{
+    struct echo_reference *er = (struct echo_reference *)echo_reference;
+
+    if (er == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&er->lock);
+    echo_reference_stats_begin_l(er);
+    memset(&er->stats, 0, sizeof(er->stats));
+    echo_reference_stats_end_l(er);
+    pthread_mutex_unlock(&er->lock);
+}
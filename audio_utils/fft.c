@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* A real FFT of n samples is computed as a complex FFT of n / 2 points, with the even
+ * samples in the real parts and the odd samples in the imaginary parts, followed by a pass
+ * that separates the spectra of the even and odd samples and combines them. The complex
+ * FFT is an iterative radix-2 decimation in time, whose twiddle factors are stored stage
+ * by stage so that each stage reads them sequentially.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <audio_utils/fft.h>
+#include "private/simd.h"
+
+struct audio_utils_fft_plan {
+    size_t n;               // number of real samples
+    size_t m;               // number of complex points, n / 2
+    uint32_t *bitrev;       // bit reversal permutation of m points
+    float *twiddles;        // e^(-i pi j / h) for j < h, for the stages h = 1, 2, 4 .. m / 2,
+                            // complex interleaved, stage h at offset 2 * (h - 1)
+    float *real_twiddles;   // e^(-2 i pi k / n) for k <= m / 2, complex interleaved
+};
+
+int audio_utils_fft_plan_create(size_t n, struct audio_utils_fft_plan **plan)
+{
+    struct audio_utils_fft_plan *p;
+    size_t m, h, i, j, bits;
+
+    if (plan == NULL) {
+        return -EINVAL;
+    }
+    *plan = NULL;
+    if (n < 2 || (n & (n - 1)) != 0 || n > UINT32_MAX) {
+        return -EINVAL;
+    }
+
+    p = (struct audio_utils_fft_plan *)calloc(1, sizeof(struct audio_utils_fft_plan));
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    p->n = n;
+    p->m = m = n / 2;
+    p->bitrev = (uint32_t *)malloc(m * sizeof(uint32_t));
+    p->twiddles = (float *)malloc(2 * m * sizeof(float));
+    p->real_twiddles = (float *)malloc(2 * (m / 2 + 1) * sizeof(float));
+    if (p->bitrev == NULL || p->twiddles == NULL || p->real_twiddles == NULL) {
+        audio_utils_fft_plan_release(p);
+        return -ENOMEM;
+    }
+
+    for (bits = 0; ((size_t)1 << bits) < m; ++bits) {
+    }
+    for (i = 0; i < m; ++i) {
+        uint32_t r = 0;
+        for (j = 0; j < bits; ++j) {
+            r |= ((i >> j) & 1) << (bits - 1 - j);
+        }
+        p->bitrev[i] = r;
+    }
+    for (h = 1; h < m; h <<= 1) {
+        float *w = p->twiddles + 2 * (h - 1);
+        for (j = 0; j < h; ++j) {
+            const double angle = -M_PI * j / h;
+            w[2 * j] = cos(angle);
+            w[2 * j + 1] = sin(angle);
+        }
+    }
+    for (j = 0; j <= m / 2; ++j) {
+        const double angle = -2 * M_PI * j / n;
+        p->real_twiddles[2 * j] = cos(angle);
+        p->real_twiddles[2 * j + 1] = sin(angle);
+    }
+
+    *plan = p;
+    return 0;
+}
+
+void audio_utils_fft_plan_release(struct audio_utils_fft_plan *plan)
+{
+    if (plan == NULL) {
+        return;
+    }
+    free(plan->bitrev);
+    free(plan->twiddles);
+    free(plan->real_twiddles);
+    free(plan);
+}
+
+// Forward complex FFT of plan->m points in place, without scaling.
+static void fft_complex(const struct audio_utils_fft_plan *plan, float *z)
+{
+    const size_t m = plan->m;
+    size_t i, j, h;
+
+    for (i = 0; i < m; ++i) {
+        const size_t r = plan->bitrev[i];
+        if (i < r) {
+            const float re = z[2 * i];
+            const float im = z[2 * i + 1];
+            z[2 * i] = z[2 * r];
+            z[2 * i + 1] = z[2 * r + 1];
+            z[2 * r] = re;
+            z[2 * r + 1] = im;
+        }
+    }
+
+    // The first stage has no twiddle factors.
+    for (i = 0; i + 1 < m; i += 2) {
+        float *a = z + 2 * i;
+#ifdef AUDIO_UTILS_SIMD
+        const audio_v4f sign = {1.0f, 1.0f, -1.0f, -1.0f};
+        audio_v4f v;
+        AUDIO_SIMD_LOAD(v, a);
+        v = AUDIO_SIMD_SHUFFLE(v, v, 0, 1, 0, 1) + AUDIO_SIMD_SHUFFLE(v, v, 2, 3, 2, 3) * sign;
+        AUDIO_SIMD_STORE(a, v);
+#else
+        const float re = a[2];
+        const float im = a[3];
+        a[2] = a[0] - re;
+        a[3] = a[1] - im;
+        a[0] += re;
+        a[1] += im;
+#endif
+    }
+
+    for (h = 2; h < m; h <<= 1) {
+        const float *w = plan->twiddles + 2 * (h - 1);
+        for (i = 0; i < m; i += 2 * h) {
+            float *a = z + 2 * i;
+            float *b = a + 2 * h;
+            j = 0;
+#ifdef AUDIO_UTILS_SIMD
+            // two butterflies at a time
+            for (; j + 2 <= h; j += 2) {
+                const audio_v4f sign = {-1.0f, 1.0f, -1.0f, 1.0f};
+                audio_v4f va, vb, vw;
+                AUDIO_SIMD_LOAD(va, a + 2 * j);
+                AUDIO_SIMD_LOAD(vb, b + 2 * j);
+                AUDIO_SIMD_LOAD(vw, w + 2 * j);
+                const audio_v4f t = vb * AUDIO_SIMD_SHUFFLE(vw, vw, 0, 0, 2, 2)
+                        + AUDIO_SIMD_SHUFFLE(vb, vb, 1, 0, 3, 2)
+                        * AUDIO_SIMD_SHUFFLE(vw, vw, 1, 1, 3, 3) * sign;
+                const audio_v4f sum = va + t;
+                const audio_v4f difference = va - t;
+                AUDIO_SIMD_STORE(a + 2 * j, sum);
+                AUDIO_SIMD_STORE(b + 2 * j, difference);
+            }
+#endif
+            for (; j < h; ++j) {
+                const float w_re = w[2 * j], w_im = w[2 * j + 1];
+                const float b_re = b[2 * j], b_im = b[2 * j + 1];
+                const float t_re = b_re * w_re - b_im * w_im;
+                const float t_im = b_im * w_re + b_re * w_im;
+                b[2 * j] = a[2 * j] - t_re;
+                b[2 * j + 1] = a[2 * j + 1] - t_im;
+                a[2 * j] += t_re;
+                a[2 * j + 1] += t_im;
+            }
+        }
+    }
+}
+
+void audio_utils_fft_real_forward(const struct audio_utils_fft_plan *plan,
+        float *out, const float *in)
+{
+    const size_t m = plan->m;
+    size_t k;
+
+    if (out != in) {
+        memcpy(out, in, plan->n * sizeof(float));
+    }
+    fft_complex(plan, out);
+
+    // Bins k and m - k are made from the complex bins Z[k] and Z[m - k]:
+    // the spectrum of the even samples E = (Z[k] + conj(Z[m - k])) / 2,
+    // the spectrum of the odd samples O = (Z[k] - conj(Z[m - k])) / 2i,
+    // X[k] = E + W^k O and X[m - k] = conj(E - W^k O).
+    const float z_re = out[0];
+    const float z_im = out[1];
+    out[0] = z_re + z_im;
+    out[1] = z_re - z_im;
+    for (k = 1; k < m - k; ++k) {
+        float *a = out + 2 * k;
+        float *b = out + 2 * (m - k);
+        const float w_re = plan->real_twiddles[2 * k];
+        const float w_im = plan->real_twiddles[2 * k + 1];
+        const float e_re = 0.5f * (a[0] + b[0]);
+        const float e_im = 0.5f * (a[1] - b[1]);
+        const float o_re = 0.5f * (a[1] + b[1]);
+        const float o_im = 0.5f * (b[0] - a[0]);
+        const float t_re = w_re * o_re - w_im * o_im;
+        const float t_im = w_re * o_im + w_im * o_re;
+        a[0] = e_re + t_re;
+        a[1] = e_im + t_im;
+        b[0] = e_re - t_re;
+        b[1] = t_im - e_im;
+    }
+    if (m > 1) {
+        // X[m / 2] = conj(Z[m / 2])
+        out[m + 1] = -out[m + 1];
+    }
+}
+
+void audio_utils_fft_real_inverse(const struct audio_utils_fft_plan *plan,
+        float *out, const float *in)
+{
+    const size_t m = plan->m;
+    const float scale = 1.0f / plan->n;
+    size_t k;
+
+    if (out != in) {
+        memcpy(out, in, plan->n * sizeof(float));
+    }
+
+    // Undo the combination of audio_utils_fft_real_forward(), with
+    // E = (X[k] + conj(X[m - k])) / 2 and O = conj(W^k) (X[k] - conj(X[m - k])) / 2,
+    // then Z[k] = E + iO and Z[m - k] = conj(E) + i conj(O). Each Z is stored conjugated,
+    // so that the forward complex FFT computes the inverse, and scaled by 2 / n,
+    // which is the 1 / m of the inverse complex FFT.
+    const float x0 = out[0];
+    const float xm = out[1];
+    out[0] = scale * (x0 + xm);
+    out[1] = scale * (xm - x0);
+    for (k = 1; k < m - k; ++k) {
+        float *a = out + 2 * k;
+        float *b = out + 2 * (m - k);
+        const float w_re = plan->real_twiddles[2 * k];
+        const float w_im = plan->real_twiddles[2 * k + 1];
+        const float e_re = a[0] + b[0];
+        const float e_im = a[1] - b[1];
+        const float t_re = a[0] - b[0];
+        const float t_im = a[1] + b[1];
+        const float o_re = w_re * t_re + w_im * t_im;
+        const float o_im = w_re * t_im - w_im * t_re;
+        a[0] = scale * (e_re - o_im);
+        a[1] = -scale * (e_im + o_re);
+        b[0] = scale * (e_re + o_im);
+        b[1] = scale * (e_im - o_re);
+    }
+    if (m > 1) {
+        // conj(Z[m / 2]) = X[m / 2]
+        out[m] *= 2.0f * scale;
+        out[m + 1] *= 2.0f * scale;
+    }
+
+    fft_complex(plan, out);
+    for (k = 0; k < m; ++k) {
+        out[2 * k + 1] = -out[2 * k + 1];
+    }
+}
+
+struct audio_utils_stft {
+    struct audio_utils_fft_plan *plan;
+    size_t fft_size;
+    size_t hop_size;
+    audio_utils_stft_callback_t callback;
+    void *cookie;
+    float *window;          // applied both before analysis and after synthesis
+    float scale;            // normalization of the overlap-add
+    float *input;           // the last fft_size input samples, oldest first
+    size_t input_count;     // number of samples in input; a frame is taken when it is full
+    float *frame;           // spectrum of the current frame
+    float *overlap;         // overlap-add of the frames so far, fft_size samples
+    float *ready;           // hop_size output samples whose frames are all added
+};
+
+int audio_utils_stft_create(size_t fft_size, size_t hop_size, audio_utils_stft_window_t window,
+        audio_utils_stft_callback_t callback, void *cookie, struct audio_utils_stft **stft)
+{
+    struct audio_utils_stft *s;
+    size_t i;
+    int ret;
+
+    if (stft == NULL) {
+        return -EINVAL;
+    }
+    *stft = NULL;
+    if (callback == NULL || hop_size == 0 || hop_size > fft_size || fft_size % hop_size != 0) {
+        return -EINVAL;
+    }
+    switch (window) {
+    case AUDIO_UTILS_STFT_WINDOW_HANN:
+        if (hop_size > fft_size / 2) {
+            return -EINVAL;
+        }
+        break;
+    case AUDIO_UTILS_STFT_WINDOW_RECTANGULAR:
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    s = (struct audio_utils_stft *)calloc(1, sizeof(struct audio_utils_stft));
+    if (s == NULL) {
+        return -ENOMEM;
+    }
+    ret = audio_utils_fft_plan_create(fft_size, &s->plan);
+    if (ret != 0) {
+        free(s);
+        return ret;
+    }
+    s->fft_size = fft_size;
+    s->hop_size = hop_size;
+    s->callback = callback;
+    s->cookie = cookie;
+    s->window = (float *)malloc(fft_size * sizeof(float));
+    s->input = (float *)malloc(fft_size * sizeof(float));
+    s->frame = (float *)malloc(fft_size * sizeof(float));
+    s->overlap = (float *)malloc(fft_size * sizeof(float));
+    s->ready = (float *)malloc(hop_size * sizeof(float));
+    if (s->window == NULL || s->input == NULL || s->frame == NULL || s->overlap == NULL
+            || s->ready == NULL) {
+        audio_utils_stft_release(s);
+        return -ENOMEM;
+    }
+
+    // The squared window of the frames overlapping any sample adds up to the same sum,
+    // which is the sum over the whole window times hop_size / fft_size.
+    double sum = 0;
+    for (i = 0; i < fft_size; ++i) {
+        double w = 1.0;
+        if (window == AUDIO_UTILS_STFT_WINDOW_HANN) {
+            w = sqrt(0.5 - 0.5 * cos(2 * M_PI * i / fft_size));
+        }
+        s->window[i] = w;
+        sum += w * w;
+    }
+    s->scale = hop_size / sum;
+    audio_utils_stft_reset(s);
+
+    *stft = s;
+    return 0;
+}
+
+void audio_utils_stft_release(struct audio_utils_stft *stft)
+{
+    if (stft == NULL) {
+        return;
+    }
+    audio_utils_fft_plan_release(stft->plan);
+    free(stft->window);
+    free(stft->input);
+    free(stft->frame);
+    free(stft->overlap);
+    free(stft->ready);
+    free(stft);
+}
+
+void audio_utils_stft_reset(struct audio_utils_stft *stft)
+{
+    memset(stft->input, 0, stft->fft_size * sizeof(float));
+    memset(stft->overlap, 0, stft->fft_size * sizeof(float));
+    memset(stft->ready, 0, stft->hop_size * sizeof(float));
+    stft->input_count = stft->fft_size - stft->hop_size;
+}
+
+size_t audio_utils_stft_latency(const struct audio_utils_stft *stft)
+{
+    return stft->fft_size;
+}
+
+// Analyze the full input, call back, and add the resynthesized frame if synthesize.
+static void stft_frame(struct audio_utils_stft *stft, bool synthesize)
+{
+    const size_t fft_size = stft->fft_size;
+    const size_t hop_size = stft->hop_size;
+    size_t i;
+
+    for (i = 0; i < fft_size; ++i) {
+        stft->frame[i] = stft->input[i] * stft->window[i];
+    }
+    audio_utils_fft_real_forward(stft->plan, stft->frame, stft->frame);
+    stft->callback(stft->cookie, stft->frame, fft_size);
+
+    if (synthesize) {
+        audio_utils_fft_real_inverse(stft->plan, stft->frame, stft->frame);
+        for (i = 0; i < fft_size; ++i) {
+            stft->overlap[i] += stft->frame[i] * stft->window[i] * stft->scale;
+        }
+        memcpy(stft->ready, stft->overlap, hop_size * sizeof(float));
+        memmove(stft->overlap, stft->overlap + hop_size, (fft_size - hop_size) * sizeof(float));
+        memset(stft->overlap + fft_size - hop_size, 0, hop_size * sizeof(float));
+    }
+
+    memmove(stft->input, stft->input + hop_size, (fft_size - hop_size) * sizeof(float));
+    stft->input_count = fft_size - hop_size;
+}
+
+void audio_utils_stft_process(struct audio_utils_stft *stft, float *out, const float *in,
+        size_t count)
+{
+    while (count > 0) {
+        // Output is read from the ready samples at the same position as input is written
+        // in the last hop of the frame, so neither runs ahead of the other.
+        const size_t position = stft->input_count - (stft->fft_size - stft->hop_size);
+        size_t n = stft->fft_size - stft->input_count;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(stft->input + stft->input_count, in, n * sizeof(float));
+        if (out != NULL) {
+            memcpy(out, stft->ready + position, n * sizeof(float));
+            out += n;
+        }
+        in += n;
+        count -= n;
+        stft->input_count += n;
+        if (stft->input_count == stft->fft_size) {
+            stft_frame(stft, out != NULL);
+        }
+    }
+}
@@ -20,10 +20,26 @@
  * accuracy, and maintainability. To make it fast, arithmetic shifts are used
  * instead of divisions, and bitwise inverses are used instead of negates. To
  * keep it small, only radix-2 Cooley-Tukey algorithm is implemented, and only
- * half of the twiddle factors are stored. Although there are still ways to make
- * it even faster or smaller, it costs too much on one of the aspects.
+ * half of the twiddle factors are stored. Pairs of radix-2 stages are fused into
+ * radix-4 passes over the data, and butterflies are vectorized where supported;
+ * neither changes the arithmetic, so results are the same on all platforms.
+ * Although there are still ways to make it even faster or smaller, it costs too
+ * much on one of the aspects.
+ *
+ * fixed_fft_real(n, v) transforms 2 * n real samples, packed two per word with the
+ * even samples in the real parts, for n a power of 2 from 2 up to MAX_FFT_SIZE / 2.
+ * Each stage halves its outputs to avoid overflow, so the result is the spectrum
+ * divided by 2 * n. v[0] holds bins 0 and n in its real and imaginary parts, and
+ * v[k] holds bin k for 0 < k < n, conjugated for k == n / 2.
+ *
+ * fixed_ifft_real(n, v) is the inverse of fixed_fft_real(). Its stages do not halve,
+ * so it works on the parts separately and rounds to nearest to keep the errors from
+ * accumulating; they grow with the square root of n. The accuracy of a round trip is
+ * limited by the 16 bit bins of fixed_fft_real(), which is worse for large n.
  */
 
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #ifdef __arm__
@@ -31,57 +47,29 @@
 #endif
 
 #include <audio_utils/fixedfft.h>
+#include "private/simd.h"
 
-#define LOG_FFT_SIZE 10
+#define LOG_FFT_SIZE 13
 #define MAX_FFT_SIZE (1 << LOG_FFT_SIZE)
 
+// twiddle[k] is round(-32768 * sin(2 * pi * k / MAX_FFT_SIZE)) in the higher 16 bits and
+// round(-32768 * cos(2 * pi * k / MAX_FFT_SIZE)) in the lower 16 bits. Smaller transforms
+// use every (MAX_FFT_SIZE / n)th entry, which is the table generated for their own size.
+// The table is generated by init_twiddle() on the first transform.
 // Actually int32_t, but declare as uint32_t to avoid warnings due to overflow.
 // Be sure to cast all accesses before use, for example "(int32_t) twiddle[...]".
-static const uint32_t twiddle[MAX_FFT_SIZE / 4] = {
-    0x00008000, 0xff378001, 0xfe6e8002, 0xfda58006, 0xfcdc800a, 0xfc13800f,
-    0xfb4a8016, 0xfa81801e, 0xf9b88027, 0xf8ef8032, 0xf827803e, 0xf75e804b,
-    0xf6958059, 0xf5cd8068, 0xf5058079, 0xf43c808b, 0xf374809e, 0xf2ac80b2,
-    0xf1e480c8, 0xf11c80de, 0xf05580f6, 0xef8d8110, 0xeec6812a, 0xedff8146,
-    0xed388163, 0xec718181, 0xebab81a0, 0xeae481c1, 0xea1e81e2, 0xe9588205,
-    0xe892822a, 0xe7cd824f, 0xe7078276, 0xe642829d, 0xe57d82c6, 0xe4b982f1,
-    0xe3f4831c, 0xe3308349, 0xe26d8377, 0xe1a983a6, 0xe0e683d6, 0xe0238407,
-    0xdf61843a, 0xde9e846e, 0xdddc84a3, 0xdd1b84d9, 0xdc598511, 0xdb998549,
-    0xdad88583, 0xda1885be, 0xd95885fa, 0xd8988637, 0xd7d98676, 0xd71b86b6,
-    0xd65c86f6, 0xd59e8738, 0xd4e1877b, 0xd42487c0, 0xd3678805, 0xd2ab884c,
-    0xd1ef8894, 0xd13488dd, 0xd0798927, 0xcfbe8972, 0xcf0489be, 0xce4b8a0c,
-    0xcd928a5a, 0xccd98aaa, 0xcc218afb, 0xcb698b4d, 0xcab28ba0, 0xc9fc8bf5,
-    0xc9468c4a, 0xc8908ca1, 0xc7db8cf8, 0xc7278d51, 0xc6738dab, 0xc5c08e06,
-    0xc50d8e62, 0xc45b8ebf, 0xc3a98f1d, 0xc2f88f7d, 0xc2488fdd, 0xc198903e,
-    0xc0e990a1, 0xc03a9105, 0xbf8c9169, 0xbedf91cf, 0xbe329236, 0xbd86929e,
-    0xbcda9307, 0xbc2f9371, 0xbb8593dc, 0xbadc9448, 0xba3394b5, 0xb98b9523,
-    0xb8e39592, 0xb83c9603, 0xb7969674, 0xb6f196e6, 0xb64c9759, 0xb5a897ce,
-    0xb5059843, 0xb46298b9, 0xb3c09930, 0xb31f99a9, 0xb27f9a22, 0xb1df9a9c,
-    0xb1409b17, 0xb0a29b94, 0xb0059c11, 0xaf689c8f, 0xaecc9d0e, 0xae319d8e,
-    0xad979e0f, 0xacfd9e91, 0xac659f14, 0xabcd9f98, 0xab36a01c, 0xaaa0a0a2,
-    0xaa0aa129, 0xa976a1b0, 0xa8e2a238, 0xa84fa2c2, 0xa7bda34c, 0xa72ca3d7,
-    0xa69ca463, 0xa60ca4f0, 0xa57ea57e, 0xa4f0a60c, 0xa463a69c, 0xa3d7a72c,
-    0xa34ca7bd, 0xa2c2a84f, 0xa238a8e2, 0xa1b0a976, 0xa129aa0a, 0xa0a2aaa0,
-    0xa01cab36, 0x9f98abcd, 0x9f14ac65, 0x9e91acfd, 0x9e0fad97, 0x9d8eae31,
-    0x9d0eaecc, 0x9c8faf68, 0x9c11b005, 0x9b94b0a2, 0x9b17b140, 0x9a9cb1df,
-    0x9a22b27f, 0x99a9b31f, 0x9930b3c0, 0x98b9b462, 0x9843b505, 0x97ceb5a8,
-    0x9759b64c, 0x96e6b6f1, 0x9674b796, 0x9603b83c, 0x9592b8e3, 0x9523b98b,
-    0x94b5ba33, 0x9448badc, 0x93dcbb85, 0x9371bc2f, 0x9307bcda, 0x929ebd86,
-    0x9236be32, 0x91cfbedf, 0x9169bf8c, 0x9105c03a, 0x90a1c0e9, 0x903ec198,
-    0x8fddc248, 0x8f7dc2f8, 0x8f1dc3a9, 0x8ebfc45b, 0x8e62c50d, 0x8e06c5c0,
-    0x8dabc673, 0x8d51c727, 0x8cf8c7db, 0x8ca1c890, 0x8c4ac946, 0x8bf5c9fc,
-    0x8ba0cab2, 0x8b4dcb69, 0x8afbcc21, 0x8aaaccd9, 0x8a5acd92, 0x8a0cce4b,
-    0x89becf04, 0x8972cfbe, 0x8927d079, 0x88ddd134, 0x8894d1ef, 0x884cd2ab,
-    0x8805d367, 0x87c0d424, 0x877bd4e1, 0x8738d59e, 0x86f6d65c, 0x86b6d71b,
-    0x8676d7d9, 0x8637d898, 0x85fad958, 0x85beda18, 0x8583dad8, 0x8549db99,
-    0x8511dc59, 0x84d9dd1b, 0x84a3dddc, 0x846ede9e, 0x843adf61, 0x8407e023,
-    0x83d6e0e6, 0x83a6e1a9, 0x8377e26d, 0x8349e330, 0x831ce3f4, 0x82f1e4b9,
-    0x82c6e57d, 0x829de642, 0x8276e707, 0x824fe7cd, 0x822ae892, 0x8205e958,
-    0x81e2ea1e, 0x81c1eae4, 0x81a0ebab, 0x8181ec71, 0x8163ed38, 0x8146edff,
-    0x812aeec6, 0x8110ef8d, 0x80f6f055, 0x80def11c, 0x80c8f1e4, 0x80b2f2ac,
-    0x809ef374, 0x808bf43c, 0x8079f505, 0x8068f5cd, 0x8059f695, 0x804bf75e,
-    0x803ef827, 0x8032f8ef, 0x8027f9b8, 0x801efa81, 0x8016fb4a, 0x800ffc13,
-    0x800afcdc, 0x8006fda5, 0x8002fe6e, 0x8001ff37,
-};
+static uint32_t twiddle[MAX_FFT_SIZE / 4];
+static pthread_once_t twiddle_once = PTHREAD_ONCE_INIT;
+
+static void init_twiddle()
+{
+    for (int k = 0; k < MAX_FFT_SIZE / 4; ++k) {
+        double angle = 2 * M_PI * k / MAX_FFT_SIZE;
+        int32_t sin_k = (int32_t) lround(-32768 * sin(angle));
+        int32_t cos_k = (int32_t) lround(-32768 * cos(angle));
+        twiddle[k] = ((uint32_t) sin_k << 16) | (cos_k & 0xFFFF);
+    }
+}
 
 /* Returns the multiplication of \conj{a} and {b}. */
 static inline int32_t mult(int32_t a, int32_t b)
@@ -108,7 +96,196 @@ static inline int32_t half(int32_t a)
 #endif
 }
 
-void fixed_fft(int n, int32_t *v)
+/* The inverse transform does not halve, so the small biases of the arithmetic above
+ * would accumulate instead of vanishing. It works on the parts separately instead,
+ * and rounds to nearest.
+ */
+static inline int32_t pack(int32_t re, int32_t im)
+{
+    return (int32_t) (((uint32_t) re << 16) | (im & 0xFFFF));
+}
+
+/* Returns a / 2 rounded to nearest, with ties to even. */
+static inline int32_t round_half(int32_t a)
+{
+    return (a + ((a >> 1) & 1)) >> 1;
+}
+
+static inline int32_t saturate16(int32_t a)
+{
+    return a > 0x7FFF ? 0x7FFF : a < -0x8000 ? -0x8000 : a;
+}
+
+/* Returns the twiddle factor of butterfly r > 0 of the stage with the given scale. */
+static inline int32_t stage_twiddle(int r, int scale)
+{
+    int32_t w = MAX_FFT_SIZE / 4 - (r << scale);
+    int32_t i = w >> 31;
+    return ((int32_t) twiddle[(w ^ i) - i]) ^ (i << 16);
+}
+
+/* Butterfly r of a radix-2 stage, where w is stage_twiddle(r, scale) if r > 0.
+ * The forward transform (kHalve) halves the outputs, the inverse transform does not.
+ */
+template <bool kHalve>
+static inline void butterfly(int32_t *a, int32_t *b, int r, int32_t w);
+
+template <>
+inline void butterfly<true>(int32_t *a, int32_t *b, int r, int32_t w)
+{
+    int32_t x = half(*a);
+    int32_t y;
+    if (r == 0) {
+        y = half(*b);
+        *a = x + y;
+        *b = x - y;
+    } else {
+        y = mult(w, *b);
+        *a = x - y;
+        *b = x + y;
+    }
+}
+
+template <>
+inline void butterfly<false>(int32_t *a, int32_t *b, int r, int32_t w)
+{
+    int32_t x_re = *a >> 16, x_im = (int16_t)*a;
+    int32_t b_re = *b >> 16, b_im = (int16_t)*b;
+    int32_t y_re, y_im;
+    if (r == 0) {
+        y_re = -b_re;
+        y_im = -b_im;
+    } else {
+        int32_t w_re = w >> 16, w_im = (int16_t)w;
+        y_re = (w_re * b_re + w_im * b_im + 0x4000) >> 15;
+        y_im = (w_re * b_im - w_im * b_re + 0x4000) >> 15;
+    }
+    *a = pack(x_re - y_re, x_im - y_im);
+    *b = pack(x_re + y_re, x_im + y_im);
+}
+
+/* Butterfly r of the radix-2 stages p and 2p, fused into one radix-4 pass. */
+template <bool kHalve>
+static void radix4(int n, int32_t *v, int p, int r, int scale1, int scale2)
+{
+    int32_t w1 = r ? stage_twiddle(r, scale1) : 0;
+    int32_t w2 = r ? stage_twiddle(r, scale2) : 0;
+    int32_t w3 = stage_twiddle(r + p, scale2);
+    for (int i = r; i < n; i += p << 2) {
+        int32_t a = v[i], b = v[i + p], c = v[i + 2 * p], d = v[i + 3 * p];
+        butterfly<kHalve>(&a, &b, r, w1);
+        butterfly<kHalve>(&c, &d, r, w1);
+        butterfly<kHalve>(&a, &c, r, w2);
+        butterfly<kHalve>(&b, &d, r + p, w3);
+        v[i] = a;
+        v[i + p] = b;
+        v[i + 2 * p] = c;
+        v[i + 3 * p] = d;
+    }
+}
+
+/* Butterfly r of the radix-2 stage p. */
+template <bool kHalve>
+static void radix2(int n, int32_t *v, int p, int r, int scale)
+{
+    int32_t w = r ? stage_twiddle(r, scale) : 0;
+    for (int i = r; i < n; i += p << 1) {
+        butterfly<kHalve>(&v[i], &v[i + p], r, w);
+    }
+}
+
+#ifdef AUDIO_UTILS_SIMD
+
+/* Vector versions of the above for 4 consecutive butterflies r, r + 1, r + 2, r + 3,
+ * where r > 0. The results are the same as those of the scalar versions.
+ */
+
+static inline audio_v4i32 half_v(audio_v4i32 a)
+{
+    return ((a >> 1) & ~0x8000) | (a & 0x8000);
+}
+
+template <bool kHalve>
+static inline void butterfly_v(audio_v4i32 *a, audio_v4i32 *b, audio_v4i32 w);
+
+template <>
+inline void butterfly_v<true>(audio_v4i32 *a, audio_v4i32 *b, audio_v4i32 w)
+{
+    const audio_v4i32 w_re = w >> 16;
+    const audio_v4i32 w_im = (w << 16) >> 16;
+    const audio_v4i32 b_re = *b >> 16;
+    const audio_v4i32 b_im = (*b << 16) >> 16;
+    const audio_v4i32 re = w_re * b_re + w_im * b_im;
+    const audio_v4i32 im = w_re * b_im - w_im * b_re;
+    const audio_v4i32 x = half_v(*a);
+    const audio_v4i32 y = (re & ~0xFFFF) | ((im >> 16) & 0xFFFF);
+    *a = x - y;
+    *b = x + y;
+}
+
+template <>
+inline void butterfly_v<false>(audio_v4i32 *a, audio_v4i32 *b, audio_v4i32 w)
+{
+    const audio_v4i32 w_re = w >> 16;
+    const audio_v4i32 w_im = (w << 16) >> 16;
+    const audio_v4i32 b_re = *b >> 16;
+    const audio_v4i32 b_im = (*b << 16) >> 16;
+    const audio_v4i32 x_re = *a >> 16;
+    const audio_v4i32 x_im = (*a << 16) >> 16;
+    const audio_v4i32 y_re = (w_re * b_re + w_im * b_im + 0x4000) >> 15;
+    const audio_v4i32 y_im = (w_re * b_im - w_im * b_re + 0x4000) >> 15;
+    *a = ((x_re - y_re) << 16) | ((x_im - y_im) & 0xFFFF);
+    *b = ((x_re + y_re) << 16) | ((x_im + y_im) & 0xFFFF);
+}
+
+static inline audio_v4i32 stage_twiddle_v(int r, int scale)
+{
+    const audio_v4i32 w = {stage_twiddle(r, scale), stage_twiddle(r + 1, scale),
+            stage_twiddle(r + 2, scale), stage_twiddle(r + 3, scale)};
+    return w;
+}
+
+template <bool kHalve>
+static void radix4_v(int n, int32_t *v, int p, int r, int scale1, int scale2)
+{
+    const audio_v4i32 w1 = stage_twiddle_v(r, scale1);
+    const audio_v4i32 w2 = stage_twiddle_v(r, scale2);
+    const audio_v4i32 w3 = stage_twiddle_v(r + p, scale2);
+    for (int i = r; i < n; i += p << 2) {
+        audio_v4i32 a, b, c, d;
+        AUDIO_SIMD_LOAD(a, v + i);
+        AUDIO_SIMD_LOAD(b, v + i + p);
+        AUDIO_SIMD_LOAD(c, v + i + 2 * p);
+        AUDIO_SIMD_LOAD(d, v + i + 3 * p);
+        butterfly_v<kHalve>(&a, &b, w1);
+        butterfly_v<kHalve>(&c, &d, w1);
+        butterfly_v<kHalve>(&a, &c, w2);
+        butterfly_v<kHalve>(&b, &d, w3);
+        AUDIO_SIMD_STORE(v + i, a);
+        AUDIO_SIMD_STORE(v + i + p, b);
+        AUDIO_SIMD_STORE(v + i + 2 * p, c);
+        AUDIO_SIMD_STORE(v + i + 3 * p, d);
+    }
+}
+
+template <bool kHalve>
+static void radix2_v(int n, int32_t *v, int p, int r, int scale)
+{
+    const audio_v4i32 w = stage_twiddle_v(r, scale);
+    for (int i = r; i < n; i += p << 1) {
+        audio_v4i32 a, b;
+        AUDIO_SIMD_LOAD(a, v + i);
+        AUDIO_SIMD_LOAD(b, v + i + p);
+        butterfly_v<kHalve>(&a, &b, w);
+        AUDIO_SIMD_STORE(v + i, a);
+        AUDIO_SIMD_STORE(v + i + p, b);
+    }
+}
+
+#endif // AUDIO_UTILS_SIMD
+
+template <bool kHalve>
+static void fft(int n, int32_t *v)
 {
     int scale = LOG_FFT_SIZE, i, p, r;
 
@@ -121,30 +298,42 @@ void fixed_fft(int n, int32_t *v)
         }
     }
 
-    for (p = 1; p < n; p <<= 1) {
-        --scale;
-
-        for (i = 0; i < n; i += p << 1) {
-            int32_t x = half(v[i]);
-            int32_t y = half(v[i + p]);
-            v[i] = x + y;
-            v[i + p] = x - y;
+    for (p = 1; p << 1 < n; p <<= 2) {
+        int scale1 = --scale;
+        int scale2 = --scale;
+        radix4<kHalve>(n, v, p, 0, scale1, scale2);
+        r = 1;
+#ifdef AUDIO_UTILS_SIMD
+        for (; r + 4 <= p; r += 4) {
+            radix4_v<kHalve>(n, v, p, r, scale1, scale2);
         }
+#endif
+        for (; r < p; ++r) {
+            radix4<kHalve>(n, v, p, r, scale1, scale2);
+        }
+    }
 
-        for (r = 1; r < p; ++r) {
-            int32_t w = MAX_FFT_SIZE / 4 - (r << scale);
-            i = w >> 31;
-            w = ((int32_t) twiddle[(w ^ i) - i]) ^ (i << 16);
-            for (i = r; i < n; i += p << 1) {
-                int32_t x = half(v[i]);
-                int32_t y = mult(w, v[i + p]);
-                v[i] = x - y;
-                v[i + p] = x + y;
-            }
+    if (p < n) {
+        --scale;
+        radix2<kHalve>(n, v, p, 0, scale);
+        r = 1;
+#ifdef AUDIO_UTILS_SIMD
+        for (; r + 4 <= p; r += 4) {
+            radix2_v<kHalve>(n, v, p, r, scale);
+        }
+#endif
+        for (; r < p; ++r) {
+            radix2<kHalve>(n, v, p, r, scale);
         }
     }
 }
 
+void fixed_fft(int n, int32_t *v)
+{
+    pthread_once(&twiddle_once, init_twiddle);
+    fft<true>(n, v);
+}
+
 void fixed_fft_real(int n, int32_t *v)
 {
     int scale = LOG_FFT_SIZE, m = n >> 1, i;
@@ -164,3 +353,41 @@ void fixed_fft_real(int n, int32_t *v)
         v[n - i] = (x + y) ^ 0xFFFF;
     }
 }
+
+void fixed_ifft_real(int n, int32_t *v)
+{
+    int scale = LOG_FFT_SIZE, m = n >> 1, i;
+
+    pthread_once(&twiddle_once, init_twiddle);
+
+    // Undo the post-processing of fixed_fft_real(), giving half of the complex spectrum.
+    // v[m] is already half of its bin.
+    for (i = 1; i <= n; i <<= 1, --scale);
+    int32_t re = v[0] >> 16;
+    int32_t im = (int16_t) v[0];
+    v[0] = pack(round_half(re + im), round_half(re - im));
+
+    for (i = 1; i < m; ++i) {
+        int32_t x_re = v[i] >> 16, x_im = (int16_t) v[i];
+        int32_t z_re = v[n - i] >> 16, z_im = (int16_t) v[n - i];
+        int32_t w = (int32_t) twiddle[i << scale];
+        int64_t w_re = w >> 16, w_im = (int16_t) w;
+        int32_t s_re = x_re + z_re;
+        int32_t s_im = x_im - z_im;
+        int32_t d_re = z_re - x_re;
+        int32_t d_im = z_im + x_im;
+        int32_t y_re = (int32_t) ((w_re * d_re - w_im * d_im + 0x4000) >> 15);
+        int32_t y_im = (int32_t) ((w_re * d_im + w_im * d_re + 0x4000) >> 15);
+        v[i] = pack(round_half(s_re - y_re), round_half(s_im + y_im));
+        v[n - i] = pack(round_half(s_re + y_re), round_half(y_im - s_im));
+    }
+
+    // The inverse complex transform is the conjugate of the transform of the conjugate.
+    for (i = 0; i < n; ++i) {
+        v[i] = pack(v[i] >> 16, -(int16_t) v[i]);
+    }
+    fft<false>(n, v);
+    for (i = 0; i < n; ++i) {
+        v[i] = pack(saturate16((v[i] >> 16) * 2), saturate16(-(int16_t) v[i] * 2));
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_CHANNEL_MIX_H
+#define ANDROID_AUDIO_CHANNEL_MIX_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <system/audio.h>
+
+/** \cond */
+__BEGIN_DECLS
+/** \endcond */
+
+/** Maximum number of source or destination channels of a channel mix. */
+#define AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS FCC_8
+
+/** Flags for audio_utils_channel_mix_init(). */
+enum {
+    AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE = 0,
+    /** Mix the low frequency channel into the front channels at -3 dB when the destination
+     * has no low frequency channel. By default it is discarded, as in ITU-R BS.775.
+     */
+    AUDIO_UTILS_CHANNEL_MIX_FLAG_MIX_LFE = 0x1,
+};
+
+/**
+ * A channel mix applies a matrix of gains from each source channel to each destination
+ * channel. This is the DOWNMIX_TYPE_FOLD of the downmix effect generalized to any pair of
+ * channel masks, for both downmix and upmix.
+ *
+ * No user-serviceable parts within.
+ */
+struct audio_utils_channel_mix {
+    uint32_t src_channels;  // number of source channels
+    uint32_t dst_channels;  // number of destination channels
+    // coefs[src][dst] is the gain from source channel src to destination channel dst.
+    // Each row is padded with zeros to AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS for vector loads.
+    float coefs[AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS][AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS];
+};
+
+/**
+ * Initialize a channel mix from the source channel mask to the destination channel mask.
+ *
+ * Positional masks are interpreted as output channel masks. A channel present in both masks
+ * is copied. A source channel missing from the destination is folded into its neighbors with
+ * ITU-R BS.775 style gains:
+ *   - front center to front left and right at -3 dB,
+ *   - side and back channels to each other, or to the front channel of the same side at -3 dB,
+ *   - back center to the back, side or front pair at -3 dB, -6 dB for the front pair,
+ *   - top channels to the channel below them at -3 dB,
+ *   - low frequency discarded unless AUDIO_UTILS_CHANNEL_MIX_FLAG_MIX_LFE is set.
+ * Thus 5.1 and 7.1 to stereo give L = FL + 0.707 FC + 0.707 (SL + BL), and likewise for R.
+ * A mono destination is the average of the stereo downmix, and a mono source is copied to
+ * both front channels. Channels missing from the source are silent in the destination.
+ * The gains are not normalized, so a downmix may exceed full scale.
+ *
+ * If either mask uses index representation, channels are copied by index and extra
+ * destination channels are silent.
+ *
+ *  \param mix       Channel mix to initialize.
+ *  \param dst_mask  Destination channel mask.
+ *  \param src_mask  Source channel mask.
+ *  \param flags     A combination of AUDIO_UTILS_CHANNEL_MIX_FLAG_* values.
+ *
+ * \return 0 on success, or -EINVAL if a mask is invalid or has more than
+ *   AUDIO_UTILS_CHANNEL_MIX_MAX_CHANNELS channels.
+ */
+int audio_utils_channel_mix_init(struct audio_utils_channel_mix *mix,
+        audio_channel_mask_t dst_mask, audio_channel_mask_t src_mask, uint32_t flags);
+
+/**
+ * Apply a channel mix to interleaved float samples.
+ *
+ *  \param mix    Channel mix initialized by audio_utils_channel_mix_init().
+ *  \param dst    Destination buffer of count frames of mix->dst_channels samples.
+ *  \param src    Source buffer of count frames of mix->src_channels samples.
+ *  \param count  Number of frames to mix.
+ *
+ * The destination and source buffers must be completely separate (non-overlapping).
+ */
+void audio_utils_channel_mix_float(const struct audio_utils_channel_mix *mix,
+        float *dst, const float *src, size_t count);
+
+/**
+ * Apply a channel mix to interleaved 16 bit samples.
+ * Samples are mixed in float and the result is rounded and clamped to 16 bits.
+ * Parameters and buffer constraints are as for audio_utils_channel_mix_float().
+ */
+void audio_utils_channel_mix_i16(const struct audio_utils_channel_mix *mix,
+        int16_t *dst, const int16_t *src, size_t count);
+
+/** \cond */
+__END_DECLS
+/** \endcond */
+
+#endif  // ANDROID_AUDIO_CHANNEL_MIX_H
@@ -52,6 +52,15 @@ struct echo_reference_itfe {
     int (*write)(struct echo_reference_itfe *echo_reference, struct echo_reference_buffer *buffer);
 };
 
+/**
+ * Create an echo reference converting frames written in wrFormat, wrChannelCount and
+ * wrSamplingRate into frames read in rdFormat, rdChannelCount and rdSamplingRate.
+ * rdFormat and wrFormat must be equal and either AUDIO_FORMAT_PCM_16_BIT or
+ * AUDIO_FORMAT_PCM_FLOAT; samples are never converted to another format internally.
+ * Channel counts may be between 1 and FCC_8. A mono reference is the average of all written
+ * channels; otherwise written channels are kept in order, dropping extra channels or
+ * zero filling missing ones.
+ */
 int create_echo_reference(audio_format_t rdFormat,
                           uint32_t rdChannelCount,
                           uint32_t rdSamplingRate,
@@ -62,6 +71,56 @@ int create_echo_reference(audio_format_t rdFormat,
 
 void release_echo_reference(struct echo_reference_itfe *echo_reference);
 
+/** Number of bins in each echo reference histogram. */
+#define ECHO_REFERENCE_HISTOGRAM_BINS 16
+/** Width of a delay error histogram bin in ns. */
+#define ECHO_REFERENCE_DELAY_ERROR_BIN_NS 1000000
+/** Width of a read wait histogram bin in ns. */
+#define ECHO_REFERENCE_READ_WAIT_BIN_NS 1000000
+
+/**
+ * Echo reference statistics, accumulated since creation or the last
+ * echo_reference_reset_stats().
+ */
+struct echo_reference_stats {
+    uint64_t reads;                 // number of read() calls returning reference frames
+    uint64_t writes;                // number of write() calls accepted while reading
+    uint64_t underruns;             // reads which had to insert silence for lack of frames
+    uint64_t overruns;              // reads which found too many frames and dropped some
+    uint64_t frames_inserted;       // silent frames inserted by underruns
+    uint64_t frames_dropped;        // frames discarded by overruns
+    int64_t last_delay_error_ns;    // last difference between actual and expected delay
+    /**
+     * Difference between actual and expected delay, in ECHO_REFERENCE_DELAY_ERROR_BIN_NS
+     * steps centered on bin ECHO_REFERENCE_HISTOGRAM_BINS / 2 (no error).
+     * The first and last bins also count errors beyond the histogram range.
+     */
+    uint32_t delay_error_histogram[ECHO_REFERENCE_HISTOGRAM_BINS];
+    /**
+     * Time read() waited for write() to provide enough frames, in
+     * ECHO_REFERENCE_READ_WAIT_BIN_NS steps. The last bin also counts longer waits.
+     */
+    uint32_t read_wait_histogram[ECHO_REFERENCE_HISTOGRAM_BINS];
+};
+
+/**
+ * Get a consistent snapshot of the echo reference statistics.
+ * Does not block on the echo reference lock and can be called from any thread,
+ * e.g. while dumping state, concurrently with read() and write().
+ *
+ *  \param echo_reference  echo reference returned by create_echo_reference().
+ *  \param stats           receives the statistics.
+ *
+ * \return 0 on success, -EINVAL if a parameter is NULL.
+ */
+int echo_reference_get_stats(struct echo_reference_itfe *echo_reference,
+                             struct echo_reference_stats *stats);
+
+/**
+ * Clear the echo reference statistics.
+ */
+void echo_reference_reset_stats(struct echo_reference_itfe *echo_reference);
+
 __END_DECLS
 
 #endif // ANDROID_ECHO_REFERENCE_H
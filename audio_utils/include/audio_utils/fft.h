@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FFT_H
+#define ANDROID_AUDIO_FFT_H
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+/** \cond */
+__BEGIN_DECLS
+/** \endcond */
+
+/**
+ * A plan for real FFTs of one size, holding the precomputed bit reversal and twiddle
+ * factors. A plan is not modified by the transforms, so it may be shared between threads.
+ *
+ * No user-serviceable parts within.
+ */
+struct audio_utils_fft_plan;
+
+/**
+ * Create a plan for real FFTs of n samples.
+ *
+ *  \param n     Number of real samples, a power of 2 and at least 2.
+ *  \param plan  Pointer to the created plan.
+ *
+ * \return 0 on success, -EINVAL if n is invalid, or -ENOMEM if memory could not be allocated.
+ */
+int audio_utils_fft_plan_create(size_t n, struct audio_utils_fft_plan **plan);
+
+/** Release a plan created by audio_utils_fft_plan_create(). */
+void audio_utils_fft_plan_release(struct audio_utils_fft_plan *plan);
+
+/**
+ * Forward FFT of n real samples, without scaling.
+ *
+ * The n / 2 + 1 bins are packed into n floats, in the same order as fixed_fft_real():
+ * out[0] and out[1] are the real bins 0 and n / 2, and out[2 * k] and out[2 * k + 1]
+ * are the real and imaginary parts of bin k, for 0 < k < n / 2.
+ *
+ *  \param plan  Plan for n samples.
+ *  \param out   Output buffer of n floats, which may be the same as in.
+ *  \param in    Input buffer of n real samples.
+ *
+ * The destination and source buffers must either be completely separate
+ * (non-overlapping), or they must both start at the same address.
+ */
+void audio_utils_fft_real_forward(const struct audio_utils_fft_plan *plan,
+        float *out, const float *in);
+
+/**
+ * Inverse FFT to n real samples, scaled by 1 / n so that it inverts
+ * audio_utils_fft_real_forward().
+ *
+ *  \param plan  Plan for n samples.
+ *  \param out   Output buffer of n real samples, which may be the same as in.
+ *  \param in    Input buffer of n floats of bins packed as by audio_utils_fft_real_forward().
+ *
+ * The destination and source buffers must either be completely separate
+ * (non-overlapping), or they must both start at the same address.
+ */
+void audio_utils_fft_real_inverse(const struct audio_utils_fft_plan *plan,
+        float *out, const float *in);
+
+/** Windows for the short-time Fourier transform. */
+typedef enum {
+    /** The square root of a periodic Hann window, applied before analysis and again after
+     * synthesis, so that the product is a Hann window. The hop size must be at most half of
+     * the FFT size.
+     */
+    AUDIO_UTILS_STFT_WINDOW_HANN,
+    /** No window. */
+    AUDIO_UTILS_STFT_WINDOW_RECTANGULAR,
+} audio_utils_stft_window_t;
+
+/**
+ * Called once per hop with the spectrum of the windowed last fft_size input samples,
+ * packed as by audio_utils_fft_real_forward(). It may modify the spectrum in place, and the
+ * modified spectrum is resynthesized by overlap-add.
+ *
+ *  \param cookie    Cookie passed to audio_utils_stft_create().
+ *  \param spectrum  Spectrum of fft_size floats.
+ *  \param fft_size  FFT size.
+ */
+typedef void (*audio_utils_stft_callback_t)(void *cookie, float *spectrum, size_t fft_size);
+
+/**
+ * A streaming short-time Fourier transform of a single channel, with analysis of
+ * overlapping windowed frames, a callback to analyze or modify each spectrum,
+ * and resynthesis by overlap-add.
+ *
+ * No user-serviceable parts within.
+ */
+struct audio_utils_stft;
+
+/**
+ * Create a short-time Fourier transform.
+ *
+ *  \param fft_size  FFT size in samples, a power of 2 and at least 2.
+ *  \param hop_size  Number of samples between the starts of consecutive frames,
+ *                   a divisor of fft_size.
+ *  \param window    Window applied to the frames.
+ *  \param callback  Callback for each spectrum.
+ *  \param cookie    Cookie passed to the callback.
+ *  \param stft      Pointer to the created transform.
+ *
+ * \return 0 on success, -EINVAL if a parameter is invalid,
+ *   or -ENOMEM if memory could not be allocated.
+ */
+int audio_utils_stft_create(size_t fft_size, size_t hop_size, audio_utils_stft_window_t window,
+        audio_utils_stft_callback_t callback, void *cookie, struct audio_utils_stft **stft);
+
+/** Release a transform created by audio_utils_stft_create(). */
+void audio_utils_stft_release(struct audio_utils_stft *stft);
+
+/** Clear the input history and the pending output. */
+void audio_utils_stft_reset(struct audio_utils_stft *stft);
+
+/**
+ * \return the delay in samples of the output relative to the input, which is fft_size.
+ */
+size_t audio_utils_stft_latency(const struct audio_utils_stft *stft);
+
+/**
+ * Process input samples, calling the callback for every hop_size samples.
+ * The output is the input delayed by audio_utils_stft_latency() samples,
+ * as modified by the callback.
+ *
+ *  \param stft   Transform created by audio_utils_stft_create().
+ *  \param out    Output buffer of count samples, which may be the same as in. It may be NULL
+ *                if the callback only analyzes the spectrum, which skips the resynthesis;
+ *                then it should be NULL for every call.
+ *  \param in     Input buffer of count samples.
+ *  \param count  Number of samples to process.
+ */
+void audio_utils_stft_process(struct audio_utils_stft *stft, float *out, const float *in,
+        size_t count);
+
+/** \cond */
+__END_DECLS
+/** \endcond */
+
+#endif  // ANDROID_AUDIO_FFT_H
@@ -24,9 +24,15 @@
 __BEGIN_DECLS
 /** \endcond */
 
+/** Largest n accepted by fixed_fft_real() and fixed_ifft_real(), for 8192 real samples. */
+#define FIXED_FFT_MAX_SIZE 4096
+
 /** See description in fixedfft.cpp */
 extern void fixed_fft_real(int n, int32_t *v);
 
+/** See description in fixedfft.cpp */
+extern void fixed_ifft_real(int n, int32_t *v);
+
 /** \cond */
 __END_DECLS
 /** \endcond */
@@ -17,6 +17,8 @@
 #ifndef ANDROID_AUDIO_LIMITER_H
 #define ANDROID_AUDIO_LIMITER_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/cdefs.h>
 
 /** \cond */
@@ -35,6 +37,69 @@ extern "C" {
      * so the minimum and maximum outputs may not be achievable.
      */
     extern float limiter(float in);
+
+    /**
+     * Apply limiter() to each sample of a buffer.
+     * Each sample is limited independently, so the buffer may hold any number of
+     * interleaved channels.  This is vectorized where supported, and the results
+     * are the same as calling limiter() on each sample.
+     * \param dst   output buffer, which may be the same as src.
+     * \param src   input buffer, with the same sample range restrictions as limiter().
+     * \param count number of samples (not frames) to limit.
+     * The destination and source buffers must either be completely separate
+     * (non-overlapping), or they must both start at the same address.
+     */
+    extern void limiter_buffer(float *dst, const float *src, size_t count);
+
+    /**
+     * A lookahead peak limiter, which delays its input so that it can reduce the gain
+     * before a peak arrives rather than clipping it.  All channels of a frame share the
+     * same gain, so the stereo image is preserved.  The gain ramps down linearly over at most
+     * the lookahead time to meet each peak above the threshold (attack), then recovers
+     * exponentially with the release time constant.
+     *
+     * No user-serviceable parts within.
+     */
+    struct limiter_lookahead;
+
+    /**
+     * Create a lookahead peak limiter.
+     * \param channelCount  number of interleaved channels, at least 1.
+     * \param sampleRate    sample rate in Hz.
+     * \param lookaheadMs   lookahead, which is also the latency, in milliseconds.
+     *                      It is rounded to frames, with a minimum of one frame.
+     * \param releaseMs     release time constant in milliseconds.
+     * \param threshold     maximum absolute output sample value, in range (0.0, 1.0].
+     * \param limiter       pointer to the created limiter.
+     * \return 0 on success, -EINVAL if a parameter is invalid,
+     *   or -ENOMEM if memory could not be allocated.
+     */
+    extern int limiter_lookahead_create(uint32_t channelCount, uint32_t sampleRate,
+            float lookaheadMs, float releaseMs, float threshold,
+            struct limiter_lookahead **limiter);
+
+    /** Release a limiter created by limiter_lookahead_create(). */
+    extern void limiter_lookahead_release(struct limiter_lookahead *limiter);
+
+    /** Clear the delayed input, and restore the gain to unity. */
+    extern void limiter_lookahead_reset(struct limiter_lookahead *limiter);
+
+    /** \return the latency of the limiter in frames, which is the lookahead. */
+    extern size_t limiter_lookahead_latency(const struct limiter_lookahead *limiter);
+
+    /**
+     * Limit interleaved float samples.  The output is the input delayed by
+     * limiter_lookahead_latency() frames, with every sample at most the threshold in
+     * absolute value.  Input samples must be finite.
+     * \param limiter  limiter created by limiter_lookahead_create().
+     * \param dst      output buffer of frames frames, which may be the same as src.
+     * \param src      input buffer of frames frames.
+     * \param frames   number of frames to process.
+     * The destination and source buffers must either be completely separate
+     * (non-overlapping), or they must both start at the same address.
+     */
+    extern void limiter_lookahead_process(struct limiter_lookahead *limiter,
+            float *dst, const float *src, size_t frames);
 #ifdef __cplusplus
 }
 #endif
@@ -17,6 +17,7 @@
 #ifndef ANDROID_AUDIO_MINIFLOAT_H
 #define ANDROID_AUDIO_MINIFLOAT_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/cdefs.h>
 
@@ -79,6 +80,90 @@ gain_minifloat_t gain_from_float(float f);
 /** Convert the internal representation used for gains to float */
 float float_from_gain(gain_minifloat_t gain);
 
+/**
+ * Convert an array of floats to gains, as by gain_from_float().
+ *
+ *  \param dst     Destination buffer of count gains
+ *  \param src     Source buffer of count floats
+ *  \param count   Number of gains to convert
+ */
+void gain_from_float_array(gain_minifloat_t *dst, const float *src, size_t count);
+
+/**
+ * Convert an array of gains to floats, as by float_from_gain().
+ *
+ *  \param dst     Destination buffer of count floats
+ *  \param src     Source buffer of count gains
+ *  \param count   Number of gains to convert
+ */
+void float_from_gain_array(float *dst, const gain_minifloat_t *src, size_t count);
+
+/**
+ * Convert an array of interleaved left and right floats to packed pairs of gains,
+ * as by gain_from_float() and gain_minifloat_pack().
+ *
+ *  \param dst     Destination buffer of count packed gains
+ *  \param src     Source buffer of 2 * count floats
+ *  \param count   Number of packed gains to convert
+ */
+void gain_packed_from_float_array(gain_minifloat_packed_t *dst, const float *src,
+        size_t count);
+
+/**
+ * Convert an array of packed pairs of gains to interleaved left and right floats,
+ * as by gain_minifloat_unpack_left(), gain_minifloat_unpack_right() and float_from_gain().
+ *
+ *  \param dst     Destination buffer of 2 * count floats
+ *  \param src     Source buffer of count packed gains
+ *  \param count   Number of packed gains to convert
+ */
+void float_from_gain_packed_array(float *dst, const gain_minifloat_packed_t *src,
+        size_t count);
+
+/** Maximum number of channels of a gain ramp */
+#define GAIN_RAMP_MAX_CHANNELS 8
+
+/**
+ * Apply a linear gain ramp, with a separate gain per channel, to interleaved float samples.
+ * The gain of channel c at frame i is
+ *   from[c] + (to[c] - from[c]) * (i + 1) / frames
+ * so the last frame is at the target gain, and a ramp from a gain to itself applies
+ * a constant gain. The output is not clamped.
+ *
+ *  \param dst           Destination buffer, which may be the same as src
+ *  \param src           Source buffer
+ *  \param frames        Number of frames of the ramp
+ *  \param channelCount  Number of channels, from 1 to GAIN_RAMP_MAX_CHANNELS
+ *  \param from          Gain per channel before the first frame
+ *  \param to            Gain per channel at the last frame
+ *
+ * The destination and source buffers must either be completely separate (non-overlapping), or
+ * they must both start at the same address.
+ */
+void gain_ramp_float(float *dst, const float *src, size_t frames, uint32_t channelCount,
+        const gain_minifloat_t *from, const gain_minifloat_t *to);
+
+/**
+ * Apply a linear gain ramp to interleaved 16 bit samples, as gain_ramp_float() does.
+ * The output is rounded and clamped as by clamp16_from_float().
+ */
+void gain_ramp_i16(int16_t *dst, const int16_t *src, size_t frames, uint32_t channelCount,
+        const gain_minifloat_t *from, const gain_minifloat_t *to);
+
+/**
+ * Apply a linear gain ramp to interleaved stereo float samples, with the left and right
+ * gains packed. See gain_ramp_float().
+ */
+void gain_ramp_stereo_float(float *dst, const float *src, size_t frames,
+        gain_minifloat_packed_t from, gain_minifloat_packed_t to);
+
+/**
+ * Apply a linear gain ramp to interleaved stereo 16 bit samples, with the left and right
+ * gains packed. See gain_ramp_i16().
+ */
+void gain_ramp_stereo_i16(int16_t *dst, const int16_t *src, size_t frames,
+        gain_minifloat_packed_t from, gain_minifloat_packed_t to);
+
 /** \cond */
 __END_DECLS
 /** \endcond */
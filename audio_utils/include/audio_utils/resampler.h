@@ -34,6 +34,7 @@ struct resampler_buffer {
         void*       raw;
         short*      i16;
         int8_t*     i8;
+        float*      f32;
     };
     size_t frame_count;
 };
@@ -99,6 +100,36 @@ int create_resampler(uint32_t inSampleRate,
           struct resampler_buffer_provider *provider,
           struct resampler_itfe **);
 
+/**
+ * create a resampler of float samples, with the same parameters as create_resampler().
+ * It is driven with resampler_resample_from_provider_float() or
+ * resampler_resample_from_input_float() instead of the 16 bit functions of resampler_itfe,
+ * which return -EINVAL.
+ */
+int create_resampler_float(uint32_t inSampleRate,
+          uint32_t outSampleRate,
+          uint32_t channelCount,
+          uint32_t quality,
+          struct resampler_buffer_provider *provider,
+          struct resampler_itfe **);
+
+/**
+ * Same as resample_from_provider() for a resampler from create_resampler_float().
+ * The buffer provider must return float samples in buffer->f32.
+ */
+int resampler_resample_from_provider_float(struct resampler_itfe *resampler,
+          float *out,
+          size_t *outFrameCount);
+
+/**
+ * Same as resample_from_input() for a resampler from create_resampler_float().
+ */
+int resampler_resample_from_input_float(struct resampler_itfe *resampler,
+          float *in,
+          size_t *inFrameCount,
+          float *out,
+          size_t *outFrameCount);
+
 /**
  * release resampler resources.
  */
@@ -23,6 +23,7 @@
 // The API should be familiar to clients of similar libraries, but there is
 // no guarantee that it will stay exactly source-code compatible with other libraries.
 
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/cdefs.h>
 
@@ -31,7 +32,7 @@ __BEGIN_DECLS
 /** \endcond */
 
 // visible to clients
-typedef int sf_count_t;
+typedef int64_t sf_count_t;
 
 typedef struct {
     sf_count_t frames;
@@ -46,6 +47,15 @@ typedef struct SNDFILE_ SNDFILE;
 // Access modes
 #define SFM_READ    1
 #define SFM_WRITE   2
+// Modifier for SFM_READ: map the file into memory, so that reads convert directly from the
+// mapping and sf_readf_direct() can access the data without copying. If the file cannot
+// be mapped, for example because it is a pipe, reads fall back to stdio.
+#define SFM_MMAP    0x10
+// Modifier for SFM_WRITE: the write functions convert the frames to the file format and
+// queue them on a lock-free ring without blocking, and a dedicated I/O thread writes them
+// to the file. The ring holds about one second of frames; when it is full, the frames that
+// do not fit are dropped and counted by sf_overruns(). sf_close() drains the ring.
+#define SFM_ASYNC   0x20
 
 // Format
 #define SF_FORMAT_TYPEMASK  1
@@ -57,27 +67,89 @@ typedef struct SNDFILE_ SNDFILE;
 #define SF_FORMAT_PCM_32    8
 #define SF_FORMAT_PCM_24    10
 
-/** Open stream */
+/**
+ * Open stream
+ *
+ * Reads accept RIFF, RF64 and BW64 files, with classic or WAVE_FORMAT_EXTENSIBLE headers.
+ * Writes use WAVE_FORMAT_EXTENSIBLE for more than 2 channels or for 24 and 32 bit integer
+ * samples, and switch the header from RIFF to RF64 at close if the file exceeds 4 GB.
+ */
 SNDFILE *sf_open(const char *path, int mode, SF_INFO *info);
 
 /** Close stream */
 void sf_close(SNDFILE *handle);
 
 /**
- * Read interleaved frames
+ * Read interleaved frames, converted from any sample format of the file
  * \return actual number of frames read
  */
 sf_count_t sf_readf_short(SNDFILE *handle, short *ptr, sf_count_t desired);
 sf_count_t sf_readf_float(SNDFILE *handle, float *ptr, sf_count_t desired);
 sf_count_t sf_readf_int(SNDFILE *handle, int *ptr, sf_count_t desired);
+/** Read interleaved frames as packed 24 bit samples, 3 bytes per sample in host byte order */
+sf_count_t sf_readf_p24(SNDFILE *handle, uint8_t *ptr, sf_count_t desired);
+
+/**
+ * Read interleaved frames starting at a frame offset, without changing the position of
+ * the other read functions. Positional reads do not use any state of the handle, so several
+ * threads may read disjoint or overlapping regions of the same handle at once.
+ * \return actual number of frames read, which is 0 at or beyond the end of the file
+ */
+sf_count_t sf_preadf_short(SNDFILE *handle, short *ptr, sf_count_t desired, sf_count_t offset);
+sf_count_t sf_preadf_float(SNDFILE *handle, float *ptr, sf_count_t desired, sf_count_t offset);
+sf_count_t sf_preadf_int(SNDFILE *handle, int *ptr, sf_count_t desired, sf_count_t offset);
+sf_count_t sf_preadf_p24(SNDFILE *handle, uint8_t *ptr, sf_count_t desired, sf_count_t offset);
 
 /**
- * Write interleaved frames
+ * Set the position in frames of the next read of a file opened for reading,
+ * relative to the start of the file for SEEK_SET, the current position for SEEK_CUR,
+ * or the end of the file for SEEK_END.
+ * \return the new position in frames, or -1 if whence is invalid, the new position would be
+ * outside of the file, or the file is not opened for reading
+ */
+sf_count_t sf_seek(SNDFILE *handle, sf_count_t frames, int whence);
+
+/**
+ * Read interleaved frames without copying, from a file opened with SFM_READ | SFM_MMAP.
+ * Sets *ptr to the next frames within the mapping, in the sample format of the file
+ * (see SF_INFO.format), and consumes them as the other read functions do.
+ * The frames remain valid until sf_close().
+ * The pointer is into the file map and has no alignment guarantee, as the data of a WAV file
+ * may start at any even offset. Copy the frames before accessing them as wider samples.
+ * Fails if the file is not mapped, or if the samples of the file are not in host byte order.
+ * \return actual number of frames available at *ptr, or 0 on failure or at end of file
+ */
+sf_count_t sf_readf_direct(SNDFILE *handle, const void **ptr, sf_count_t desired);
+
+/**
+ * Write interleaved frames, converted to any sample format of the file
  * \return actual number of frames written
  */
 sf_count_t sf_writef_short(SNDFILE *handle, const short *ptr, sf_count_t desired);
 sf_count_t sf_writef_float(SNDFILE *handle, const float *ptr, sf_count_t desired);
 sf_count_t sf_writef_int(SNDFILE *handle, const int *ptr, sf_count_t desired);
+/** Write interleaved frames of packed 24 bit samples, 3 bytes per sample in host byte order */
+sf_count_t sf_writef_p24(SNDFILE *handle, const uint8_t *ptr, sf_count_t desired);
+
+/**
+ * \return WAVE speaker positions of the channels, which have the same bits as the positional
+ * audio_channel_mask_t, or 0 if a file opened for reading does not specify them
+ */
+uint32_t sf_get_channel_mask(SNDFILE *handle);
+
+/**
+ * Set the WAVE speaker positions of the channels of a file opened for writing, which are
+ * written at close. The default is the positional audio_channel_mask_t for the channel count.
+ * \return 0 on success, or -EINVAL if the mask does not have one bit per channel, or if the
+ * file has a classic header, which cannot store a different mask than the default
+ */
+int sf_set_channel_mask(SNDFILE *handle, uint32_t channelMask);
+
+/**
+ * \return number of frames dropped so far because the ring of an SFM_ASYNC writer was full,
+ * or 0 for other streams
+ */
+sf_count_t sf_overruns(SNDFILE *handle);
 
 /** \cond */
 __END_DECLS
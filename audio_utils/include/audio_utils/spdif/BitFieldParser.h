@@ -0,0 +1,143 @@
+/*
+ * Copyright 2015, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_BIT_FIELD_PARSER_H
+#define ANDROID_AUDIO_BIT_FIELD_PARSER_H
+
+#include <endian.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace android {
+
+/**
+ * Extract big-endian bit fields from a byte array.
+ *
+ * The parser keeps up to 64 bits in a reservoir, which it refills with
+ * a single unaligned 64-bit load while at least 8 bytes of data remain,
+ * and one byte at a time near the end of the data.
+ * It never reads beyond numBytes. Bits beyond the end of the data read as zero,
+ * and are reported by overrun().
+ */
+class BitFieldParser {
+public:
+
+    /**
+     *  \param data      Data to parse, which must remain valid while parsing.
+     *  \param numBytes  Number of bytes of data.
+     */
+    BitFieldParser(const uint8_t *data, size_t numBytes)
+     : mNext(data)
+     , mEnd(data + numBytes)
+     , mNumBits(numBytes * 8)
+     , mBitCursor(0)
+     , mReservoir(0)
+     , mReservoirBits(0)
+    {
+    }
+
+    /**
+     * Return the next numBits bits without consuming them.
+     * Fields may span byte boundaries but may not exceed 32 bits.
+     */
+    uint32_t peekBits(uint32_t numBits) {
+        if (numBits == 0) {
+            return 0;
+        }
+        if (mReservoirBits < numBits) {
+            refill();
+        }
+        return mReservoir >> (64 - numBits);
+    }
+
+    /** Consume numBits bits, which may be more than 32. */
+    void skipBits(size_t numBits) {
+        mBitCursor += numBits;
+        if (numBits <= mReservoirBits) {
+            consume(numBits);
+            return;
+        }
+        // Skip whole bytes without loading them.
+        numBits -= mReservoirBits;
+        mReservoir = 0;
+        mReservoirBits = 0;
+        const size_t bytes = numBits >> 3;
+        mNext += bytes < (size_t) (mEnd - mNext) ? bytes : mEnd - mNext;
+        refill();
+        consume(numBits & 7);
+    }
+
+    /**
+     * Read numBits bits from the data array.
+     * Fields may span byte boundaries but may not exceed 32 bits.
+     */
+    uint32_t readBits(uint32_t numBits) {
+        const uint32_t value = peekBits(numBits);
+        skipBits(numBits);
+        return value;
+    }
+
+    /** Return the number of bits consumed since the start of the data. */
+    size_t getBitCursor() const { return mBitCursor; }
+
+    /** Return the number of bits that remain before the end of the data. */
+    size_t getBitsRemaining() const { return overrun() ? 0 : mNumBits - mBitCursor; }
+
+    /** Return true if more bits were consumed than the data holds. */
+    bool overrun() const { return mBitCursor > mNumBits; }
+
+private:
+    // Shift out bits from the top of the reservoir. Bits below the valid bits are always zero.
+    void consume(uint32_t numBits) {
+        if (numBits > mReservoirBits) {
+            numBits = mReservoirBits; // past the end of the data
+        }
+        // a shift by 64 is undefined
+        mReservoir = numBits < 64 ? mReservoir << numBits : 0;
+        mReservoirBits -= numBits;
+    }
+
+    // Top up the reservoir with as many whole bytes as fit, or with all of the remaining data.
+    void refill() {
+        if (mEnd - mNext >= 8) {
+            uint64_t word;
+            memcpy(&word, mNext, sizeof(word)); // unaligned load
+            word = be64toh(word);
+            const uint32_t bytes = (64 - mReservoirBits) >> 3; // at least 1
+            word &= ~0ULL << (64 - bytes * 8); // keep only the whole bytes that fit
+            mReservoir |= word >> mReservoirBits;
+            mReservoirBits += bytes * 8;
+            mNext += bytes;
+            return;
+        }
+        while (mReservoirBits <= 56 && mNext < mEnd) {
+            mReservoir |= (uint64_t) *mNext++ << (56 - mReservoirBits);
+            mReservoirBits += 8;
+        }
+    }
+
+    const uint8_t *mNext;       // next byte to load into the reservoir
+    const uint8_t * const mEnd;
+    const size_t mNumBits;
+    size_t mBitCursor;
+    uint64_t mReservoir;        // valid bits are left aligned
+    uint32_t mReservoirBits;
+};
+
+}  // namespace android
+
+#endif  // ANDROID_AUDIO_BIT_FIELD_PARSER_H
@@ -17,6 +17,7 @@
 #ifndef ANDROID_AUDIO_FRAME_SCANNER_H
 #define ANDROID_AUDIO_FRAME_SCANNER_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace android {
@@ -45,6 +46,55 @@ public:
      */
     virtual bool scan(uint8_t byte);
 
+    /**
+     * Scan a buffer of the encoded stream up to the end of the next complete and valid header.
+     * This has the same result as passing each byte to scan(uint8_t), but searches for
+     * the sync word with memchr() and copies a header that lies within the buffer at once.
+     * Scanners that override scan(uint8_t) must override this too, with their own search
+     * or with scanEachByte().
+     * A partial sync word or header at the end of the buffer is completed by the next call.
+     * @param data address of the encoded bytes
+     * @param numBytes number of encoded bytes
+     * @param found set to true if a complete and valid header was detected
+     * @return number of bytes consumed, which is numBytes unless a header was detected
+     */
+    virtual size_t scanBytes(const uint8_t *data, size_t numBytes, bool *found);
+
+    /**
+     * Description of a frame found by findFrames().
+     */
+    struct FrameBoundary {
+        uint64_t position;          // of the sync word, in bytes scanned since construction
+        size_t   frameSizeBytes;
+        uint32_t sampleRate;
+        uint32_t rateMultiplier;
+        int      dataType;
+        int      dataTypeInfo;
+        int      sampleFramesPerSyncFrame;
+    };
+
+    /**
+     * Find the frames in a buffer of the encoded stream, several at a time.
+     * After each valid header the rest of the frame is skipped without scanning,
+     * so the next sync word is found by its first comparison in a well formed stream.
+     * Frames may span buffers. Do not mix with scan() or scanBytes() on the same scanner.
+     * @param data address of the encoded bytes
+     * @param numBytes number of encoded bytes
+     * @param frames array that receives the frames found
+     * @param maxFrames size of the frames array
+     * @param bytesConsumed set to the number of bytes consumed, which is numBytes unless
+     *        maxFrames frames were found
+     * @return number of frames found
+     */
+    size_t findFrames(const uint8_t *data, size_t numBytes,
+            FrameBoundary *frames, size_t maxFrames, size_t *bytesConsumed);
+
+    /**
+     * @return number of bytes passed to scan(), scanBytes() and findFrames()
+     *         since construction
+     */
+    uint64_t getPosition() const { return mPosition; }
+
     /**
      * @return address of where the sync header was stored by scan()
      */
@@ -102,6 +152,37 @@ public:
      */
     virtual uint16_t convertBytesToLengthCode(uint16_t numBytes) const { return numBytes * 8; }
 
+    /**
+     * @return number of channels of the PCM stream that carries the data bursts,
+     *         which is 8 for the high bitrate (HBR) layout and 2 otherwise
+     */
+    virtual int getOutputChannelCount() const { return 2; }
+
+    /**
+     * Called by the SPDIFEncoder before it writes the frame just parsed into a data burst.
+     * Formats that put codes between the frames of a burst, or that put frames at fixed
+     * positions, write the codes into the payload here.
+     * @param payload payload of the data burst, as 16-bit words with the first byte
+     *        in the most significant byte
+     * @param payloadBytes number of payload bytes already written
+     * @return offset in bytes of the frame in the payload, which is at least payloadBytes;
+     *         codes may only be written below it. The default is payloadBytes.
+     */
+    virtual size_t startFrameInBurst(uint16_t * /* payload */, size_t payloadBytes) {
+        return payloadBytes;
+    }
+
+    /**
+     * Called by the SPDIFEncoder after the last frame of a data burst.
+     * @param payload payload of the data burst, as for startFrameInBurst()
+     * @param payloadBytes number of payload bytes written
+     * @return number of payload bytes including any trailing codes, which is at least
+     *         payloadBytes; codes may only be written below it. The default is payloadBytes.
+     */
+    virtual size_t finishBurst(uint16_t * /* payload */, size_t payloadBytes) {
+        return payloadBytes;
+    }
+
 protected:
     uint32_t  mBytesSkipped;     // how many bytes were skipped looking for the start of a frame
     const uint8_t *mSyncBytes;   // pointer to the sync word specific to a format
@@ -115,6 +196,8 @@ protected:
     size_t    mFrameSizeBytes;   // encoded frame size
     int       mDataType;         // as defined in IEC61937-2 paragraph 4.2
     int       mDataTypeInfo;     // as defined in IEC61937-2 paragraph 4.1
+    uint64_t  mPosition;         // number of bytes scanned
+    size_t    mFrameBytesToSkip; // rest of the current frame, skipped by findFrames()
 
     /**
      * Parse data in mHeaderBuffer.
@@ -123,6 +206,22 @@ protected:
      */
     virtual bool parseHeader() = 0;
 
+    /**
+     * Implementation of scanBytes() that passes each byte to scan(uint8_t),
+     * for scanners that override scan(uint8_t).
+     */
+    size_t scanEachByte(const uint8_t *data, size_t numBytes, bool *found);
+
+    /**
+     * Write bytes into the payload of a data burst, at an even offset.
+     * @param payload payload of the data burst, as for startFrameInBurst()
+     * @param offset offset in bytes in the payload, which must be even
+     * @param bytes bytes to write
+     * @param numBytes number of bytes to write, which must be even
+     */
+    static void writePayloadBytes(uint16_t *payload, size_t offset,
+            const uint8_t *bytes, size_t numBytes);
+
 };
 
 
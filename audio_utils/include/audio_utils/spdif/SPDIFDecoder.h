@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SPDIF_DECODER_H
+#define ANDROID_AUDIO_SPDIF_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+/**
+ * Find the IEC 61937 data bursts in PCM captured from an HDMI or S/PDIF input,
+ * and unwrap the encoded frames from them. This is the reverse of SPDIFEncoder.
+ *
+ * The PCM is 16-bit samples in native byte order, of 2 channels, or 8 channels
+ * for the high bitrate (HBR) layout. Bursts start at the first channel of a PCM frame.
+ * Bursts with an unknown data type, a length that does not fit in the burst,
+ * or the error flag set in Pc are dropped, as are null data and pause bursts.
+ */
+class SPDIFDecoder {
+public:
+
+    /** Description of a data burst, passed with its payload to writeOutput(). */
+    struct BurstInfo {
+        int      dataType;          // Pc bits 0-6, IEC 61937-2 table 2
+        int      dataTypeInfo;      // Pc bits 8-12
+        int      bitstreamNumber;   // Pc bits 13-15
+        uint64_t position;          // index of the PCM frame of Pa, from the first write()
+        int64_t  timestampNs;       // position converted at the PCM sample rate
+        uint32_t burstFrames;       // repetition period of the data type in PCM frames
+    };
+
+    /**
+     * @param channelCount number of channels of the captured PCM, 2 or 8
+     * @param sampleRate PCM frame rate, used to derive timestamps from burst positions
+     */
+    SPDIFDecoder(int channelCount, uint32_t sampleRate);
+
+    virtual ~SPDIFDecoder();
+
+    /**
+     * Write captured PCM to be unwrapped.
+     * The payloads of bursts that lie within the buffer are byte swapped in place
+     * as needed, and passed to writeOutput() without copying them.
+     * Payloads that span buffers are assembled into an internal buffer.
+     * @param buffer PCM samples, which may be modified
+     * @param numBytes number of bytes, a multiple of the PCM frame size
+     * @return numBytes, -EINVAL if numBytes is not a whole number of PCM frames,
+     *         or the first negative error from writeOutput(), after the whole buffer is read
+     */
+    ssize_t write(void *buffer, size_t numBytes);
+
+    /**
+     * Called by SPDIFDecoder with the encoded frames of each valid data burst.
+     * The payload is only valid until this returns.
+     * Must be implemented in the subclass.
+     * @param payload the encoded frames, as they were passed to SPDIFEncoder::write()
+     * @param numBytes number of bytes of payload, from Pd
+     * @param info description of the burst
+     * @return number of bytes written or negative error
+     */
+    virtual ssize_t writeOutput(const void *payload, size_t numBytes,
+            const BurstInfo &info) = 0;
+
+    /**
+     * @return number of bytes per PCM frame
+     */
+    int getBytesPerInputFrame() const { return mChannelCount * sizeof(int16_t); }
+
+    /**
+     * @return number of bursts passed to writeOutput()
+     */
+    uint64_t getBurstCount() const { return mBurstCount; }
+
+    /**
+     * @return number of bursts that were dropped, other than null data and pause bursts
+     */
+    uint64_t getDroppedBurstCount() const { return mDroppedBurstCount; }
+
+    /**
+     * Discard a partial burst and search for the next Pa and Pb.
+     * Positions continue from the last write(). Call this after a capture overrun.
+     */
+    void reset();
+
+protected:
+    enum State {
+        STATE_SCANNING,     // searching for Pa and Pb
+        STATE_PREAMBLE,     // reading Pc and Pd
+        STATE_PAYLOAD,      // reading the payload
+    };
+
+    size_t  findSync(const uint16_t *words, size_t start, size_t numWords) const;
+    bool    startBurst();
+    ssize_t readPayload(uint16_t *words, size_t numWords, size_t *wordsRead);
+
+    const int      mChannelCount;
+    const uint32_t mSampleRate;
+    State     mState;
+    uint64_t  mWordPosition;        // number of 16-bit words passed to write()
+    uint16_t  mPreamble[4];         // Pa, Pb, Pc and Pd of the current burst
+    size_t    mPreambleWords;       // number of preamble words read
+    BurstInfo mInfo;                // current burst
+    bool      mDropPayload;         // true to skip the payload of the current burst
+    size_t    mPayloadBytes;        // payload size of the current burst
+    size_t    mPayloadWordsRemaining;
+    uint8_t  *mPayloadBuffer;       // for payloads that span buffers
+    size_t    mPayloadBufferBytes;  // number of bytes in mPayloadBuffer
+    uint64_t  mBurstCount;
+    uint64_t  mDroppedBurstCount;
+
+    static const unsigned short kSPDIFSync1; // Pa
+    static const unsigned short kSPDIFSync2; // Pb
+};
+
+}  // namespace android
+
+#endif  // ANDROID_AUDIO_SPDIF_DECODER_H
@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_SPDIF_ENCODER_H
 
 #include <stdint.h>
+#include <sys/uio.h>
 #include <hardware/audio.h>
 #include <audio_utils/spdif/FrameScanner.h>
 
@@ -54,6 +55,18 @@ public:
      */
     virtual ssize_t writeOutput( const void* buffer, size_t numBytes ) = 0;
 
+    /**
+     * Called by SPDIFEncoder when it is ready to output a data burst, as three pieces:
+     * the preamble, the payload padded with zeros to a whole PCM frame, and the zero
+     * padding to the end of the burst. All of the pieces are multiples of the PCM frame size.
+     * The default implementation passes pieces that are contiguous in memory,
+     * as they are for bursts from SPDIFEncoder, to writeOutput(const void*, size_t) at once.
+     * Override it to place the pieces without copying the burst, for example with writev(),
+     * or to fill the padding without reading it.
+     * @return number of bytes written or negative error
+     */
+    virtual ssize_t writeOutputVector(const struct iovec *iov, int iovcnt);
+
     /**
      * Get ratio of the encoded data burst sample rate to the encoded rate.
      * For example, EAC3 data bursts are 4X the encoded rate.
@@ -65,6 +78,13 @@ public:
      */
     uint32_t getBurstFrames() const { return mBurstFrames; }
 
+    /**
+     * @return number of channels of the PCM stream for the data bursts,
+     *         which is 8 for the high bitrate (HBR) layout of Dolby TrueHD and DTS-HD,
+     *         and SPDIF_ENCODED_CHANNEL_COUNT otherwise
+     */
+    int      getOutputChannelCount() const;
+
     /**
      * @return number of bytes per PCM frame for the data burst
      */
@@ -88,6 +108,7 @@ protected:
     void   sendZeroPad();
     void   flushBurstBuffer();
     void   startDataBurst();
+    bool   startFrameInBurst();
     size_t startSyncFrame();
 
     // Works with various formats including AC3.
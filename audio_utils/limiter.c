@@ -14,8 +14,12 @@
  * limitations under the License.
  */
 
+#include <errno.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <audio_utils/limiter.h>
+#include "private/limiter_simd.h"
 
 #undef USE_ATAN_APPROXIMATION
 
@@ -54,10 +58,9 @@ float limiter(float in)
     static const float B = -1.798989873;
     static const float C = 3.029437252;
     static const float D = -0.6568542495;
-    // Cubic solution Ax^3 + Bx^2 + Cx + D
+    // Cubic solution Ax^3 + Bx^2 + Cx + D, using Estrin's method P3
     if (in_abs < M_SQRT2) {
-        // TODO Use Estrin's method P3
-        out = ((A*in_abs + B)*in_abs + C)*in_abs + D;
+        out = (A*in_abs + B)*(in_abs*in_abs) + (C*in_abs + D);
     } else {
         out = 1.0;
     }
@@ -67,3 +70,259 @@ float limiter(float in)
     }
     return out;
 }
+
+void limiter_buffer(float *dst, const float *src, size_t count)
+{
+#ifdef AUDIO_UTILS_SIMD
+    for (; count >= 4; count -= 4) {
+        audio_v4f in;
+        AUDIO_SIMD_LOAD(in, src);
+        const audio_v4f out = limiter_v4f(in);
+        AUDIO_SIMD_STORE(dst, out);
+        src += 4;
+        dst += 4;
+    }
+#endif
+    while (count--) {
+        *dst++ = limiter(*src++);
+    }
+}
+
+struct limiter_lookahead {
+    uint32_t channel_count;
+    uint32_t lookahead;         // lookahead in frames, at least 1
+    float threshold;
+    float release_coef;         // one pole coefficient for the release
+    float gain;                 // gain applied to the delayed frame
+    float attack_step;          // per frame gain decrement of the current attack, or 0
+    size_t frame;               // count of input frames, modulo SIZE_MAX + 1
+    float *delay;               // lookahead frames of delayed input, circular
+    uint32_t delay_position;    // next frame of delay to output and replace
+
+    // Sliding window maximum of the frame peaks above threshold, over the last
+    // lookahead + 1 frames.  This is a circular queue of decreasing peaks,
+    // each with the frame at which it was input.
+    float *queue_peak;
+    size_t *queue_frame;
+    uint32_t queue_head;
+    uint32_t queue_count;
+};
+
+int limiter_lookahead_create(uint32_t channelCount, uint32_t sampleRate,
+        float lookaheadMs, float releaseMs, float threshold,
+        struct limiter_lookahead **limiter)
+{
+    struct limiter_lookahead *l;
+
+    if (limiter == NULL) {
+        return -EINVAL;
+    }
+    *limiter = NULL;
+    if (channelCount < 1 || sampleRate == 0 || !(lookaheadMs >= 0.0f) || !(releaseMs >= 0.0f)
+            || !(threshold > 0.0f && threshold <= 1.0f)) {
+        return -EINVAL;
+    }
+    const double lookahead = lookaheadMs * 1e-3 * sampleRate + 0.5;
+    if (lookahead > 0x10000000) {
+        return -EINVAL;
+    }
+
+    l = (struct limiter_lookahead *)calloc(1, sizeof(struct limiter_lookahead));
+    if (l == NULL) {
+        return -ENOMEM;
+    }
+    l->channel_count = channelCount;
+    l->lookahead = lookahead < 1.0 ? 1 : (uint32_t)lookahead;
+    l->threshold = threshold;
+    const double releaseFrames = releaseMs * 1e-3 * sampleRate;
+    l->release_coef = releaseFrames < 1.0 ? 1.0f : (float)(1.0 - exp(-1.0 / releaseFrames));
+    l->delay = (float *)malloc((size_t)l->lookahead * channelCount * sizeof(float));
+    l->queue_peak = (float *)malloc(((size_t)l->lookahead + 1) * sizeof(float));
+    l->queue_frame = (size_t *)malloc(((size_t)l->lookahead + 1) * sizeof(size_t));
+    if (l->delay == NULL || l->queue_peak == NULL || l->queue_frame == NULL) {
+        limiter_lookahead_release(l);
+        return -ENOMEM;
+    }
+    limiter_lookahead_reset(l);
+
+    *limiter = l;
+    return 0;
+}
+
+void limiter_lookahead_release(struct limiter_lookahead *limiter)
+{
+    if (limiter == NULL) {
+        return;
+    }
+    free(limiter->delay);
+    free(limiter->queue_peak);
+    free(limiter->queue_frame);
+    free(limiter);
+}
+
+void limiter_lookahead_reset(struct limiter_lookahead *limiter)
+{
+    memset(limiter->delay, 0,
+            (size_t)limiter->lookahead * limiter->channel_count * sizeof(float));
+    limiter->delay_position = 0;
+    limiter->gain = 1.0f;
+    limiter->attack_step = 0.0f;
+    limiter->frame = 0;
+    limiter->queue_head = 0;
+    limiter->queue_count = 0;
+}
+
+size_t limiter_lookahead_latency(const struct limiter_lookahead *limiter)
+{
+    return limiter->lookahead;
+}
+
+// Return the largest absolute value of count samples.
+static float peak_abs(const float *src, size_t count)
+{
+    float peak = 0.0f;
+#ifdef AUDIO_UTILS_SIMD
+    if (count >= 4) {
+        const audio_v4i32 abs_mask = {0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff};
+        audio_v4f peak_v = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (; count >= 4; count -= 4) {
+            audio_v4f in;
+            AUDIO_SIMD_LOAD(in, src);
+            in = (audio_v4f)((audio_v4i32)in & abs_mask);
+            peak_v = audio_simd_select_v4f(in > peak_v, in, peak_v);
+            src += 4;
+        }
+        peak = fmaxf(fmaxf(peak_v[0], peak_v[1]), fmaxf(peak_v[2], peak_v[3]));
+    }
+#endif
+    while (count--) {
+        peak = fmaxf(peak, fabsf(*src++));
+    }
+    return peak;
+}
+
+// Output count samples from the delay and replace them with count samples of input.
+static void delay_exchange(float *dst, const float *src, float *delay, size_t count)
+{
+#ifdef AUDIO_UTILS_SIMD
+    for (; count >= 4; count -= 4) {
+        audio_v4f in, out;
+        AUDIO_SIMD_LOAD(in, src);
+        AUDIO_SIMD_LOAD(out, delay);
+        AUDIO_SIMD_STORE(delay, in);
+        AUDIO_SIMD_STORE(dst, out);
+        src += 4;
+        delay += 4;
+        dst += 4;
+    }
+#endif
+    while (count--) {
+        const float out = *delay;
+        *delay++ = *src++;
+        *dst++ = out;
+    }
+}
+
+// Process frames of input, none of which wrap around the end of the delay.
+static void limiter_lookahead_process_l(struct limiter_lookahead *l,
+        float *dst, const float *src, size_t frames)
+{
+    const uint32_t channelCount = l->channel_count;
+    const uint32_t window = l->lookahead + 1;
+    float *delay = l->delay + (size_t)l->delay_position * channelCount;
+
+    // When nothing above the threshold is within the lookahead and the gain has recovered,
+    // the limiter is just a delay.
+    if (l->queue_count == 0 && l->gain == 1.0f
+            && peak_abs(src, frames * channelCount) <= l->threshold) {
+        delay_exchange(dst, src, delay, frames * channelCount);
+        l->frame += frames;
+        return;
+    }
+
+    float gain = l->gain;
+    float attack_step = l->attack_step;
+    for (; frames > 0; --frames) {
+        float peak = 0.0f;
+        for (uint32_t i = 0; i < channelCount; ++i) {
+            peak = fmaxf(peak, fabsf(src[i]));
+        }
+
+        // Only peaks above the threshold affect the gain, so only they are queued.
+        if (l->queue_count > 0 && l->frame - l->queue_frame[l->queue_head] >= window) {
+            l->queue_head = l->queue_head + 1 == window ? 0 : l->queue_head + 1;
+            --l->queue_count;
+        }
+        if (peak > l->threshold) {
+            while (l->queue_count > 0) {
+                uint32_t back = l->queue_head + l->queue_count - 1;
+                if (back >= window) {
+                    back -= window;
+                }
+                if (l->queue_peak[back] > peak) {
+                    break;
+                }
+                --l->queue_count;
+            }
+            uint32_t back = l->queue_head + l->queue_count;
+            if (back >= window) {
+                back -= window;
+            }
+            l->queue_peak[back] = peak;
+            l->queue_frame[back] = l->frame;
+            ++l->queue_count;
+        }
+        const float target = l->queue_count > 0 ?
+                l->threshold / l->queue_peak[l->queue_head] : 1.0f;
+
+        if (target < gain) {
+            // Ramp to reach the target by the time the peak is output, or sooner
+            // if an earlier attack is already steeper.
+            const float step = (gain - target) / l->lookahead;
+            if (step > attack_step) {
+                attack_step = step;
+            }
+            gain -= attack_step;
+            if (gain < target) {
+                gain = target;
+            }
+        } else {
+            attack_step = 0.0f;
+            gain += (target - gain) * l->release_coef;
+            if (target - gain < 1e-6f) {
+                gain = target;
+            }
+        }
+
+        for (uint32_t i = 0; i < channelCount; ++i) {
+            const float out = delay[i];
+            delay[i] = src[i];
+            dst[i] = out * gain;
+        }
+        src += channelCount;
+        dst += channelCount;
+        delay += channelCount;
+        ++l->frame;
+    }
+    l->gain = gain;
+    l->attack_step = attack_step;
+}
+
+void limiter_lookahead_process(struct limiter_lookahead *limiter,
+        float *dst, const float *src, size_t frames)
+{
+    while (frames > 0) {
+        size_t count = limiter->lookahead - limiter->delay_position;
+        if (count > frames) {
+            count = frames;
+        }
+        limiter_lookahead_process_l(limiter, dst, src, count);
+        limiter->delay_position += count;
+        if (limiter->delay_position == limiter->lookahead) {
+            limiter->delay_position = 0;
+        }
+        src += count * limiter->channel_count;
+        dst += count * limiter->channel_count;
+        frames -= count;
+    }
+}
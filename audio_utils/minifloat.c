@@ -15,7 +15,11 @@
  */
 
 #include <math.h>
+#include <stddef.h>
+#include <string.h>
 #include <audio_utils/minifloat.h>
+#include <audio_utils/primitives.h>
+#include "private/simd.h"
 
 #define EXPONENT_BITS   3
 #define EXPONENT_MAX    ((1 << EXPONENT_BITS) - 1)
@@ -60,3 +64,283 @@ float float_from_gain(gain_minifloat_t a)
     return ldexpf((exponent > 0 ? HIDDEN_BIT | mantissa : mantissa << 1) / ONE_FLOAT,
             exponent - EXCESS);
 }
+
+#ifdef AUDIO_UTILS_SIMD
+
+/* The float exponent bias less EXCESS and one for the hidden bit, and 2^-19 = 2^(1 - 2 * 10):
+ * a normal gain with exponent e has the float exponent e - EXCESS - 1,
+ * and a denormal gain is its mantissa times 2 / ONE_FLOAT * 2^-EXCESS.
+ */
+#define FLOAT_EXPONENT_OFFSET   (127 - EXCESS - 1)
+#define DENORMAL_SCALE          (2.0f / ONE_FLOAT / (1 << EXCESS))
+
+/* Vector version of float_from_gain(), for gains held in 32 bit lanes. */
+static inline audio_v4f float_from_gain_v4(audio_v4i32 gain)
+{
+    const audio_v4i32 mantissa = gain & MANTISSA_MAX;
+    const audio_v4i32 exponent = (gain >> MANTISSA_BITS) & EXPONENT_MAX;
+    const audio_v4i32 normal = ((exponent + FLOAT_EXPONENT_OFFSET) << 23)
+            | (mantissa << (23 - MANTISSA_BITS));
+    const audio_v4f denormal = AUDIO_SIMD_CONVERT(mantissa, audio_v4f) * DENORMAL_SCALE;
+    return audio_simd_select_v4f(exponent > 0, (audio_v4f) normal, denormal);
+}
+
+/* Vector version of gain_from_float(), working on the float representation:
+ * the gain exponent follows from the float exponent, and the gain mantissa with the
+ * hidden bit is the float significand truncated to MANTISSA_BITS + 1 bits.
+ */
+static inline audio_v4i32 gain_from_float_v4(audio_v4f v)
+{
+    const audio_v4i32 zero = {0, 0, 0, 0};
+    const audio_v4i32 max = {MINIFLOAT_MAX, MINIFLOAT_MAX, MINIFLOAT_MAX, MINIFLOAT_MAX};
+    const audio_v4i32 bits = (audio_v4i32) v;
+    const audio_v4i32 exponent = ((bits >> 23) & 0xFF) - FLOAT_EXPONENT_OFFSET;
+    const audio_v4i32 mantissa = ((bits & 0x7FFFFF) | 0x800000) >> (23 - MANTISSA_BITS);
+    const audio_v4i32 normal = (exponent << MANTISSA_BITS) | (mantissa & MANTISSA_MAX);
+    /* only shift by valid amounts, the other lanes are replaced below */
+    const audio_v4i32 denormalShift = audio_simd_select_v4i32(
+            (exponent > -MANTISSA_BITS) & (exponent <= 0), 1 - exponent, zero);
+    const audio_v4i32 denormal = audio_simd_select_v4i32(exponent > -MANTISSA_BITS,
+            (mantissa >> denormalShift) & MANTISSA_MAX, zero);
+    audio_v4i32 gain = audio_simd_select_v4i32(exponent > 0, normal, denormal);
+    gain = audio_simd_select_v4i32(exponent > EXPONENT_MAX, max, gain);
+    /* negative values, negative zero, and NaN of either sign */
+    return audio_simd_select_v4i32((bits <= 0) | (bits > 0x7F800000), zero, gain);
+}
+
+#endif
+
+void gain_from_float_array(gain_minifloat_t *dst, const float *src, size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 4 <= count; i += 4) {
+        audio_v4f v;
+        AUDIO_SIMD_LOAD(v, src + i);
+        const audio_v4i32 gain = gain_from_float_v4(v);
+        dst[i] = gain[0];
+        dst[i + 1] = gain[1];
+        dst[i + 2] = gain[2];
+        dst[i + 3] = gain[3];
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = gain_from_float(src[i]);
+    }
+}
+
+void float_from_gain_array(float *dst, const gain_minifloat_t *src, size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 4 <= count; i += 4) {
+        const audio_v4i32 gain = {src[i], src[i + 1], src[i + 2], src[i + 3]};
+        const audio_v4f v = float_from_gain_v4(gain);
+        AUDIO_SIMD_STORE(dst + i, v);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = float_from_gain(src[i]);
+    }
+}
+
+void gain_packed_from_float_array(gain_minifloat_packed_t *dst, const float *src,
+        size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 2 <= count; i += 2) {
+        audio_v4f v;
+        AUDIO_SIMD_LOAD(v, src + 2 * i);
+        const audio_v4i32 gain = gain_from_float_v4(v);
+        dst[i] = gain_minifloat_pack(gain[0], gain[1]);
+        dst[i + 1] = gain_minifloat_pack(gain[2], gain[3]);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = gain_minifloat_pack(gain_from_float(src[2 * i]),
+                gain_from_float(src[2 * i + 1]));
+    }
+}
+
+void float_from_gain_packed_array(float *dst, const gain_minifloat_packed_t *src,
+        size_t count)
+{
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    for (; i + 2 <= count; i += 2) {
+        const audio_v4i32 gain = {
+            gain_minifloat_unpack_left(src[i]), gain_minifloat_unpack_right(src[i]),
+            gain_minifloat_unpack_left(src[i + 1]), gain_minifloat_unpack_right(src[i + 1]),
+        };
+        const audio_v4f v = float_from_gain_v4(gain);
+        AUDIO_SIMD_STORE(dst + 2 * i, v);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[2 * i] = float_from_gain(gain_minifloat_unpack_left(src[i]));
+        dst[2 * i + 1] = float_from_gain(gain_minifloat_unpack_right(src[i]));
+    }
+}
+
+/* The starting gain and the increment per frame of each channel of a ramp. */
+struct gain_ramp {
+    float start[GAIN_RAMP_MAX_CHANNELS];
+    float increment[GAIN_RAMP_MAX_CHANNELS];
+};
+
+static void gain_ramp_init(struct gain_ramp *ramp, size_t frames, uint32_t channelCount,
+        const gain_minifloat_t *from, const gain_minifloat_t *to)
+{
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        ramp->start[c] = float_from_gain(from[c]);
+        ramp->increment[c] = (float_from_gain(to[c]) - ramp->start[c]) / frames;
+    }
+}
+
+/* The gain of channel c at frame i, computed identically by the vector code */
+static inline float gain_ramp_at(const struct gain_ramp *ramp, uint32_t c, size_t i)
+{
+    return ramp->start[c] + ramp->increment[c] * (float) (i + 1);
+}
+
+#ifdef AUDIO_UTILS_SIMD
+
+/* The samples of a ramp are processed in blocks of lcm(channelCount, 4) samples,
+ * which is a whole number of frames and of vectors. Each vector of a block has fixed
+ * lanes of starting gains, increments, and frame offsets within the block.
+ */
+#define GAIN_RAMP_MAX_BLOCK_VECTORS 7   /* lcm(7, 4) / 4 */
+
+struct gain_ramp_simd {
+    size_t blockFrames;
+    size_t blockVectors;
+    audio_v4f start[GAIN_RAMP_MAX_BLOCK_VECTORS];
+    audio_v4f increment[GAIN_RAMP_MAX_BLOCK_VECTORS];
+    audio_v4f frameOffset[GAIN_RAMP_MAX_BLOCK_VECTORS];
+};
+
+static void gain_ramp_simd_init(struct gain_ramp_simd *simd, const struct gain_ramp *ramp,
+        uint32_t channelCount)
+{
+    size_t blockSamples = channelCount;
+    while (blockSamples % 4 != 0) {
+        blockSamples += channelCount;
+    }
+    simd->blockFrames = blockSamples / channelCount;
+    simd->blockVectors = blockSamples / 4;
+    for (size_t s = 0; s < blockSamples; ++s) {
+        const uint32_t c = s % channelCount;
+        simd->start[s / 4][s % 4] = ramp->start[c];
+        simd->increment[s / 4][s % 4] = ramp->increment[c];
+        simd->frameOffset[s / 4][s % 4] = s / channelCount;
+    }
+}
+
+/* The gains of vector j of the block starting at frame i */
+static inline audio_v4f gain_ramp_simd_at(const struct gain_ramp_simd *simd, size_t j,
+        size_t i)
+{
+    const float frame = i + 1;
+    return simd->start[j] + simd->increment[j] * (frame + simd->frameOffset[j]);
+}
+
+#endif
+
+void gain_ramp_float(float *dst, const float *src, size_t frames, uint32_t channelCount,
+        const gain_minifloat_t *from, const gain_minifloat_t *to)
+{
+    if (frames == 0 || channelCount == 0 || channelCount > GAIN_RAMP_MAX_CHANNELS) {
+        return;
+    }
+    struct gain_ramp ramp;
+    gain_ramp_init(&ramp, frames, channelCount, from, to);
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    struct gain_ramp_simd simd;
+    gain_ramp_simd_init(&simd, &ramp, channelCount);
+    for (; i + simd.blockFrames <= frames; i += simd.blockFrames) {
+        for (size_t j = 0; j < simd.blockVectors; ++j) {
+            const size_t offset = i * channelCount + j * 4;
+            audio_v4f v;
+            AUDIO_SIMD_LOAD(v, src + offset);
+            v *= gain_ramp_simd_at(&simd, j, i);
+            AUDIO_SIMD_STORE(dst + offset, v);
+        }
+    }
+#endif
+    for (; i < frames; ++i) {
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            const size_t offset = i * channelCount + c;
+            dst[offset] = src[offset] * gain_ramp_at(&ramp, c, i);
+        }
+    }
+}
+
+void gain_ramp_i16(int16_t *dst, const int16_t *src, size_t frames, uint32_t channelCount,
+        const gain_minifloat_t *from, const gain_minifloat_t *to)
+{
+    if (frames == 0 || channelCount == 0 || channelCount > GAIN_RAMP_MAX_CHANNELS) {
+        return;
+    }
+    struct gain_ramp ramp;
+    gain_ramp_init(&ramp, frames, channelCount, from, to);
+    size_t i = 0;
+#ifdef AUDIO_UTILS_SIMD
+    /* the same offset and limits as clamp16_from_float() */
+    static const float offset = (float) (3 << (22 - 15));
+    static const int32_t limneg = (0x10f << 22) - 32768;
+    static const int32_t limpos = (0x10f << 22) + 32767;
+    const audio_v4i32 minimum = {-32768, -32768, -32768, -32768};
+    const audio_v4i32 maximum = {32767, 32767, 32767, 32767};
+    struct gain_ramp_simd simd;
+    gain_ramp_simd_init(&simd, &ramp, channelCount);
+    for (; i + simd.blockFrames <= frames; i += simd.blockFrames) {
+        for (size_t j = 0; j < simd.blockVectors; ++j) {
+            const int16_t *in = src + i * channelCount + j * 4;
+            int16_t *out = dst + i * channelCount + j * 4;
+            const audio_v4i32 s = {in[0], in[1], in[2], in[3]};
+            const audio_v4f v = AUDIO_SIMD_CONVERT(s, audio_v4f) * (1.0f / (1 << 15))
+                    * gain_ramp_simd_at(&simd, j, i) + offset;
+            audio_v4i32 bits = (audio_v4i32) v;
+            bits = audio_simd_select_v4i32(bits < limneg, minimum, bits);
+            bits = audio_simd_select_v4i32(bits > limpos, maximum, bits);
+            out[0] = bits[0];
+            out[1] = bits[1];
+            out[2] = bits[2];
+            out[3] = bits[3];
+        }
+    }
+#endif
+    for (; i < frames; ++i) {
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            const size_t offset = i * channelCount + c;
+            dst[offset] = clamp16_from_float(
+                    float_from_i16(src[offset]) * gain_ramp_at(&ramp, c, i));
+        }
+    }
+}
+
+void gain_ramp_stereo_float(float *dst, const float *src, size_t frames,
+        gain_minifloat_packed_t from, gain_minifloat_packed_t to)
+{
+    const gain_minifloat_t fromGains[2] = {
+        gain_minifloat_unpack_left(from), gain_minifloat_unpack_right(from)
+    };
+    const gain_minifloat_t toGains[2] = {
+        gain_minifloat_unpack_left(to), gain_minifloat_unpack_right(to)
+    };
+    gain_ramp_float(dst, src, frames, 2, fromGains, toGains);
+}
+
+void gain_ramp_stereo_i16(int16_t *dst, const int16_t *src, size_t frames,
+        gain_minifloat_packed_t from, gain_minifloat_packed_t to)
+{
+    const gain_minifloat_t fromGains[2] = {
+        gain_minifloat_unpack_left(from), gain_minifloat_unpack_right(from)
+    };
+    const gain_minifloat_t toGains[2] = {
+        gain_minifloat_unpack_left(to), gain_minifloat_unpack_right(to)
+    };
+    gain_ramp_i16(dst, src, frames, 2, fromGains, toGains);
+}
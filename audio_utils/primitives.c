@@ -17,6 +17,7 @@
 #include <cutils/bitops.h>  /* for popcount() */
 #include <audio_utils/primitives.h>
 #include "private/private.h"
+#include "private/simd.h"
 
 void ditherAndClamp(int32_t* out, const int32_t *sums, size_t c)
 {
@@ -62,8 +63,136 @@ void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count)
     }
 }
 
+#ifdef AUDIO_UTILS_SIMD
+
+/* Vector versions of the conversions, which give the same results as the scalar versions in
+ * primitives.h. Conversions between sizes work on 8 samples, so that both sides are whole
+ * vectors. Each vector is loaded before the results are stored, so the conversions that do
+ * not change the sample size also work in place.
+ */
+
+static const float kScale15 = 1.0f / (1 << 15);
+static const float kScale31 = 1.0f / (1UL << 31);
+
+/* As clamp16_from_float(), with the same offset and integer limits */
+static inline audio_v4i32 clamp16_from_float_v4(audio_v4f f)
+{
+    const audio_v4i32 bits = (audio_v4i32)(f + (float)(3 << (22 - 15)));
+    const audio_v4i32 limneg = {0x43bf8000, 0x43bf8000, 0x43bf8000, 0x43bf8000};
+    const audio_v4i32 limpos = {0x43c07fff, 0x43c07fff, 0x43c07fff, 0x43c07fff};
+    const audio_v4i32 minimum = {-32768, -32768, -32768, -32768};
+    const audio_v4i32 maximum = {32767, 32767, 32767, 32767};
+    audio_v4i32 i = audio_simd_select_v4i32(bits < limneg, minimum, bits);
+    /* the lower 16 bits are the result, as for the scalar version */
+    return audio_simd_select_v4i32(bits > limpos, maximum, i);
+}
+
+/* Round half away from zero, as the scalar versions do by adding +-0.5 and truncating.
+ * The addition is only exact below 2^23, and larger values are already integers.
+ */
+static inline audio_v4i32 round_to_i32_v4(audio_v4f f)
+{
+    const audio_v4f half = {0.5f, 0.5f, 0.5f, 0.5f};
+    const audio_v4f large = {8388608.0f, 8388608.0f, 8388608.0f, 8388608.0f};
+    const audio_v4f zero = {0, 0, 0, 0};
+    const audio_v4f rounded = audio_simd_select_v4f(f > zero, f + half, f - half);
+    const audio_v4f magnitude = audio_simd_select_v4f(f < zero, -f, f);
+    return AUDIO_SIMD_CONVERT(audio_simd_select_v4f(magnitude < large, rounded, f), audio_v4i32);
+}
+
+/* As clamp32_from_float() */
+static inline audio_v4i32 clamp32_from_float_v4(audio_v4f f)
+{
+    const audio_v4f one = {1.0f, 1.0f, 1.0f, 1.0f};
+    const audio_v4i32 minimum = {INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN};
+    const audio_v4i32 maximum = {INT32_MAX, INT32_MAX, INT32_MAX, INT32_MAX};
+    /* clamp before scaling, so that the conversion cannot overflow */
+    const audio_v4i32 low = f <= -one;
+    const audio_v4i32 high = f >= one;
+    const audio_v4f inside = audio_simd_select_v4f(low | high, (audio_v4f){0, 0, 0, 0}, f);
+    audio_v4i32 i = round_to_i32_v4(inside * (float)(1UL << 31));
+    i = audio_simd_select_v4i32(low, minimum, i);
+    return audio_simd_select_v4i32(high, maximum, i);
+}
+
+/* As clamp24_from_float() */
+static inline audio_v4i32 clamp24_from_float_v4(audio_v4f f)
+{
+    static const float scale = (float)(1 << 23);
+    const audio_v4f limpos = {0x7fffff / scale, 0x7fffff / scale, 0x7fffff / scale,
+            0x7fffff / scale};
+    const audio_v4f limneg = {-0x800000 / scale, -0x800000 / scale, -0x800000 / scale,
+            -0x800000 / scale};
+    const audio_v4i32 minimum = {-0x800000, -0x800000, -0x800000, -0x800000};
+    const audio_v4i32 maximum = {0x7fffff, 0x7fffff, 0x7fffff, 0x7fffff};
+    const audio_v4i32 low = f <= limneg;
+    const audio_v4i32 high = f >= limpos;
+    const audio_v4f inside = audio_simd_select_v4f(low | high, (audio_v4f){0, 0, 0, 0}, f);
+    audio_v4i32 i = round_to_i32_v4(inside * scale);
+    i = audio_simd_select_v4i32(low, minimum, i);
+    return audio_simd_select_v4i32(high, maximum, i);
+}
+
+/* Pack the lower 16 bits of the lanes of two vectors */
+static inline audio_v8i16 pack_i16_v4(audio_v4i32 a, audio_v4i32 b)
+{
+#ifdef HAVE_BIG_ENDIAN
+    return AUDIO_SIMD_SHUFFLE((audio_v8i16) a, (audio_v8i16) b, 1, 3, 5, 7, 9, 11, 13, 15);
+#else
+    return AUDIO_SIMD_SHUFFLE((audio_v8i16) a, (audio_v8i16) b, 0, 2, 4, 6, 8, 10, 12, 14);
+#endif
+}
+
+/* Sign extend the lower and upper halves of 8 int16_t to int32_t */
+static inline audio_v4i32 low_i32_from_i16_v8(audio_v8i16 v)
+{
+    return AUDIO_SIMD_CONVERT(AUDIO_SIMD_SHUFFLE(v, v, 0, 1, 2, 3), audio_v4i32);
+}
+
+static inline audio_v4i32 high_i32_from_i16_v8(audio_v8i16 v)
+{
+    return AUDIO_SIMD_CONVERT(AUDIO_SIMD_SHUFFLE(v, v, 4, 5, 6, 7), audio_v4i32);
+}
+
+#ifndef HAVE_BIG_ENDIAN
+
+/* Expand 4 packed 24 bit samples, in the first 12 of 16 loaded bytes, to the upper 24 bits
+ * of int32_t, as i32_from_p24()
+ */
+static inline audio_v4i32 i32_from_p24_v4(const uint8_t *src)
+{
+    audio_v16u8 bytes;
+    AUDIO_SIMD_LOAD(bytes, src);
+    const audio_v16u8 zero = {0};
+    return (audio_v4i32) AUDIO_SIMD_SHUFFLE(bytes, zero,
+            16, 0, 1, 2, 16, 3, 4, 5, 16, 6, 7, 8, 16, 9, 10, 11);
+}
+
+/* Store the lower 24 bits of each lane as 4 packed 24 bit samples */
+static inline void p24_from_q8_23_v4(uint8_t *dst, audio_v4i32 v)
+{
+    const audio_v16u8 bytes = AUDIO_SIMD_SHUFFLE((audio_v16u8) v, (audio_v16u8) v,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 0, 0, 0, 0);
+    memcpy(dst, &bytes, 12);
+}
+
+#endif // !HAVE_BIG_ENDIAN
+
+#endif // AUDIO_UTILS_SIMD
+
 void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count)
 {
+#ifdef AUDIO_UTILS_SIMD
+    for (; count >= 8; count -= 8) {
+        audio_v4f a, b;
+        AUDIO_SIMD_LOAD(a, src);
+        AUDIO_SIMD_LOAD(b, src + 4);
+        const audio_v8i16 v = pack_i16_v4(clamp16_from_float_v4(a), clamp16_from_float_v4(b));
+        AUDIO_SIMD_STORE(dst, v);
+        src += 8;
+        dst += 8;
+    }
+#endif
     while (count--) {
         *dst++ = clamp16_from_float(*src++);
     }
@@ -78,6 +207,18 @@ void memcpy_to_float_from_q4_27(float *dst, const int32_t *src, size_t count)
 
 void memcpy_to_float_from_i16(float *dst, const int16_t *src, size_t count)
 {
+#ifdef AUDIO_UTILS_SIMD
+    for (; count >= 8; count -= 8) {
+        audio_v8i16 v;
+        AUDIO_SIMD_LOAD(v, src);
+        const audio_v4f a = AUDIO_SIMD_CONVERT(low_i32_from_i16_v8(v), audio_v4f) * kScale15;
+        const audio_v4f b = AUDIO_SIMD_CONVERT(high_i32_from_i16_v8(v), audio_v4f) * kScale15;
+        AUDIO_SIMD_STORE(dst, a);
+        AUDIO_SIMD_STORE(dst + 4, b);
+        src += 8;
+        dst += 8;
+    }
+#endif
     while (count--) {
         *dst++ = float_from_i16(*src++);
     }
@@ -92,6 +233,15 @@ void memcpy_to_float_from_u8(float *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_float_from_p24(float *dst, const uint8_t *src, size_t count)
 {
+#if defined(AUDIO_UTILS_SIMD) && !defined(HAVE_BIG_ENDIAN)
+    /* each load reads 16 bytes for 12 bytes of samples */
+    for (; count >= 6; count -= 4) {
+        const audio_v4f v = AUDIO_SIMD_CONVERT(i32_from_p24_v4(src), audio_v4f) * kScale31;
+        AUDIO_SIMD_STORE(dst, v);
+        src += 12;
+        dst += 4;
+    }
+#endif
     while (count--) {
         *dst++ = float_from_p24(src);
         src += 3;
@@ -112,6 +262,14 @@ void memcpy_to_i16_from_p24(int16_t *dst, const uint8_t *src, size_t count)
 
 void memcpy_to_i32_from_p24(int32_t *dst, const uint8_t *src, size_t count)
 {
+#if defined(AUDIO_UTILS_SIMD) && !defined(HAVE_BIG_ENDIAN)
+    for (; count >= 6; count -= 4) {
+        const audio_v4i32 v = i32_from_p24_v4(src);
+        AUDIO_SIMD_STORE(dst, v);
+        src += 12;
+        dst += 4;
+    }
+#endif
     while (count--) {
 #ifdef HAVE_BIG_ENDIAN
         *dst++ = (src[2] << 8) | (src[1] << 16) | (src[0] << 24);
@@ -139,6 +297,15 @@ void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count)
 
 void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
 {
+#if defined(AUDIO_UTILS_SIMD) && !defined(HAVE_BIG_ENDIAN)
+    for (; count >= 4; count -= 4) {
+        audio_v4f v;
+        AUDIO_SIMD_LOAD(v, src);
+        p24_from_q8_23_v4(dst, clamp24_from_float_v4(v));
+        src += 4;
+        dst += 12;
+    }
+#endif
     while (count--) {
         int32_t ival = clamp24_from_float(*src++);
 
@@ -173,6 +340,15 @@ void memcpy_to_p24_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
 
 void memcpy_to_p24_from_i32(uint8_t *dst, const int32_t *src, size_t count)
 {
+#if defined(AUDIO_UTILS_SIMD) && !defined(HAVE_BIG_ENDIAN)
+    for (; count >= 4; count -= 4) {
+        audio_v4i32 v;
+        AUDIO_SIMD_LOAD(v, src);
+        p24_from_q8_23_v4(dst, v >> 8);
+        src += 4;
+        dst += 12;
+    }
+#endif
     while (count--) {
         int32_t ival = *src++ >> 8;
 
@@ -244,6 +420,16 @@ void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
 
 void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
 {
+#ifdef AUDIO_UTILS_SIMD
+    for (; count >= 4; count -= 4) {
+        audio_v4f v;
+        AUDIO_SIMD_LOAD(v, src);
+        const audio_v4i32 i = clamp32_from_float_v4(v);
+        AUDIO_SIMD_STORE(dst, i);
+        src += 4;
+        dst += 4;
+    }
+#endif
     while (count--) {
         *dst++ = clamp32_from_float(*src++);
     }
@@ -251,6 +437,16 @@ void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
 
 void memcpy_to_float_from_i32(float *dst, const int32_t *src, size_t count)
 {
+#ifdef AUDIO_UTILS_SIMD
+    for (; count >= 4; count -= 4) {
+        audio_v4i32 i;
+        AUDIO_SIMD_LOAD(i, src);
+        const audio_v4f v = AUDIO_SIMD_CONVERT(i, audio_v4f) * kScale31;
+        AUDIO_SIMD_STORE(dst, v);
+        src += 4;
+        dst += 4;
+    }
+#endif
     while (count--) {
         *dst++ = float_from_i32(*src++);
     }
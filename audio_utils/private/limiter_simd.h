@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_LIMITER_SIMD_H
+#define ANDROID_AUDIO_LIMITER_SIMD_H
+
+#include "private/simd.h"
+
+#ifdef AUDIO_UTILS_SIMD
+
+/* Vector version of limiter() in limiter.c, with the same polynomial spline
+ * evaluated with the same Estrin's scheme.
+ */
+static inline audio_v4f limiter_v4f(audio_v4f in)
+{
+    static const float crossover = 0.70710678f; // M_SQRT1_2
+    static const float limit = 1.41421356f;     // M_SQRT2
+    static const float A = 0.3431457505f;
+    static const float B = -1.798989873f;
+    static const float C = 3.029437252f;
+    static const float D = -0.6568542495f;
+    const audio_v4i32 sign_bit = {
+        (int32_t)0x80000000, (int32_t)0x80000000, (int32_t)0x80000000, (int32_t)0x80000000
+    };
+    const audio_v4f one = {1.0f, 1.0f, 1.0f, 1.0f};
+    const audio_v4f crossover_v = {crossover, crossover, crossover, crossover};
+    const audio_v4f limit_v = {limit, limit, limit, limit};
+
+    const audio_v4i32 sign = (audio_v4i32)in & sign_bit;
+    const audio_v4f in_abs = (audio_v4f)((audio_v4i32)in & ~sign_bit);
+    const audio_v4f in_abs2 = in_abs * in_abs;
+    const audio_v4f spline = (in_abs * A + B) * in_abs2 + (in_abs * C + D);
+    audio_v4f out = audio_simd_select_v4f(in_abs < limit_v, spline, one);
+    out = audio_simd_select_v4f(in_abs <= crossover_v, in_abs, out);
+    return (audio_v4f)((audio_v4i32)out | sign);
+}
+
+#endif
+
+#endif /*ANDROID_AUDIO_LIMITER_SIMD_H*/
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SIMD_H
+#define ANDROID_AUDIO_SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* 128 bit vector types built on the compiler generic vector extensions, which map to NEON
+ * on ARM and SSE on x86. __builtin_shufflevector is required for the shuffles, so vector
+ * code is only enabled for clang and gcc >= 12; callers must provide a scalar path
+ * for when AUDIO_UTILS_SIMD is not defined.
+ */
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 12)
+#define AUDIO_UTILS_SIMD 1
+
+typedef uint8_t audio_v16u8 __attribute__((vector_size(16)));
+typedef int16_t audio_v8i16 __attribute__((vector_size(16)));
+typedef int32_t audio_v4i32 __attribute__((vector_size(16)));
+typedef int64_t audio_v2i64 __attribute__((vector_size(16)));
+typedef float   audio_v4f   __attribute__((vector_size(16)));
+
+/* Unaligned load and store of a vector; these compile to a single vector load or store. */
+#define AUDIO_SIMD_LOAD(vec, ptr)   memcpy(&(vec), (ptr), sizeof(vec))
+#define AUDIO_SIMD_STORE(ptr, vec)  memcpy((ptr), &(vec), sizeof(vec))
+
+#define AUDIO_SIMD_SHUFFLE __builtin_shufflevector
+
+/* Element-wise conversion between vector types of the same number of elements,
+ * truncating toward zero from float to integer.
+ */
+#define AUDIO_SIMD_CONVERT __builtin_convertvector
+
+/* Selects lanes of a where mask is all ones, and lanes of b where mask is zero. */
+static inline audio_v4f audio_simd_select_v4f(audio_v4i32 mask, audio_v4f a, audio_v4f b)
+{
+    return (audio_v4f)(((audio_v4i32)a & mask) | ((audio_v4i32)b & ~mask));
+}
+
+static inline audio_v4i32 audio_simd_select_v4i32(audio_v4i32 mask, audio_v4i32 a,
+        audio_v4i32 b)
+{
+    return (a & mask) | (b & ~mask);
+}
+
+#endif
+
+#endif /*ANDROID_AUDIO_SIMD_H*/
@@ -32,7 +32,9 @@ struct resampler {
     uint32_t in_sample_rate;                    // input sampling rate in Hz
     uint32_t out_sample_rate;                   // output sampling rate in Hz
     uint32_t channel_count;                     // number of channels (interleaved)
-    int16_t *in_buf;                            // input buffer
+    audio_format_t format;                      // sample format: 16 bit or float
+    size_t frame_size;                          // frame size in bytes
+    void *in_buf;                               // input buffer
     size_t in_buf_size;                         // input buffer size
     size_t frames_in;                           // number of frames in input buffer
     size_t frames_rq;                           // cached number of output frames
@@ -68,17 +70,42 @@ static int32_t resampler_delay_ns(struct resampler_itfe *resampler)
     return delay;
 }
 
+// processes interleaved frames with the speex function matching the resampler format.
+static void resampler_process_l(struct resampler *rsmp,
+                                const void *in,
+                                spx_uint32_t *inFrames,
+                                void *out,
+                                spx_uint32_t *outFrames)
+{
+    if (rsmp->format == AUDIO_FORMAT_PCM_FLOAT) {
+        if (rsmp->channel_count == 1) {
+            speex_resampler_process_float(rsmp->speex_resampler, 0,
+                                          (const float *)in, inFrames,
+                                          (float *)out, outFrames);
+        } else {
+            speex_resampler_process_interleaved_float(rsmp->speex_resampler,
+                                          (const float *)in, inFrames,
+                                          (float *)out, outFrames);
+        }
+    } else {
+        if (rsmp->channel_count == 1) {
+            speex_resampler_process_int(rsmp->speex_resampler, 0,
+                                        (const int16_t *)in, inFrames,
+                                        (int16_t *)out, outFrames);
+        } else {
+            speex_resampler_process_interleaved_int(rsmp->speex_resampler,
+                                        (const int16_t *)in, inFrames,
+                                        (int16_t *)out, outFrames);
+        }
+    }
+}
+
 // outputs a number of frames less or equal to *outFrameCount and updates *outFrameCount
 // with the actual number of frames produced.
-int resampler_resample_from_provider(struct resampler_itfe *resampler,
-                       int16_t *out,
+static int resampler_resample_from_provider_l(struct resampler *rsmp,
+                       void *out,
                        size_t *outFrameCount)
 {
-    struct resampler *rsmp = (struct resampler *)resampler;
-
-    if (rsmp == NULL || out == NULL || outFrameCount == NULL) {
-        return -EINVAL;
-    }
     if (rsmp->provider == NULL) {
         *outFrameCount = 0;
         return -ENOSYS;
@@ -101,8 +128,7 @@ int resampler_resample_from_provider(struct resampler_itfe *resampler,
             // the output sampling rate
             if (rsmp->in_buf_size < rsmp->frames_needed) {
                 rsmp->in_buf_size = rsmp->frames_needed;
-                rsmp->in_buf = (int16_t *)realloc(rsmp->in_buf,
-                                        rsmp->in_buf_size * rsmp->channel_count * sizeof(int16_t));
+                rsmp->in_buf = realloc(rsmp->in_buf, rsmp->in_buf_size * rsmp->frame_size);
             }
             struct resampler_buffer buf;
             buf.frame_count = rsmp->frames_needed - rsmp->frames_in;
@@ -110,29 +136,17 @@ int resampler_resample_from_provider(struct resampler_itfe *resampler,
             if (buf.raw == NULL) {
                 break;
             }
-            memcpy(rsmp->in_buf + rsmp->frames_in * rsmp->channel_count,
+            memcpy((char *)rsmp->in_buf + rsmp->frames_in * rsmp->frame_size,
                     buf.raw,
-                    buf.frame_count * rsmp->channel_count * sizeof(int16_t));
+                    buf.frame_count * rsmp->frame_size);
             rsmp->frames_in += buf.frame_count;
             rsmp->provider->release_buffer(rsmp->provider, &buf);
         }
 
         spx_uint32_t outFrames = framesRq - framesWr;
         inFrames = rsmp->frames_in;
-        if (rsmp->channel_count == 1) {
-            speex_resampler_process_int(rsmp->speex_resampler,
-                                        0,
-                                        rsmp->in_buf,
-                                        &inFrames,
-                                        out + framesWr,
-                                        &outFrames);
-        } else {
-            speex_resampler_process_interleaved_int(rsmp->speex_resampler,
-                                        rsmp->in_buf,
-                                        &inFrames,
-                                        out + framesWr * rsmp->channel_count,
-                                        &outFrames);
-        }
+        resampler_process_l(rsmp, rsmp->in_buf, &inFrames,
+                            (char *)out + framesWr * rsmp->frame_size, &outFrames);
         framesWr += outFrames;
         rsmp->frames_in -= inFrames;
         ALOGW_IF((framesWr != framesRq) && (rsmp->frames_in != 0),
@@ -141,54 +155,98 @@ int resampler_resample_from_provider(struct resampler_itfe *resampler,
     }
     if (rsmp->frames_in) {
         memmove(rsmp->in_buf,
-                rsmp->in_buf + inFrames * rsmp->channel_count,
-                rsmp->frames_in * rsmp->channel_count * sizeof(int16_t));
+                (char *)rsmp->in_buf + inFrames * rsmp->frame_size,
+                rsmp->frames_in * rsmp->frame_size);
     }
     *outFrameCount = framesWr;
 
     return 0;
 }
 
-int resampler_resample_from_input(struct resampler_itfe *resampler,
-                                  int16_t *in,
-                                  size_t *inFrameCount,
-                                  int16_t *out,
-                                  size_t *outFrameCount)
+int resampler_resample_from_provider(struct resampler_itfe *resampler,
+                       int16_t *out,
+                       size_t *outFrameCount)
 {
     struct resampler *rsmp = (struct resampler *)resampler;
 
-    if (rsmp == NULL || in == NULL || inFrameCount == NULL ||
-            out == NULL || outFrameCount == NULL) {
+    if (rsmp == NULL || out == NULL || outFrameCount == NULL ||
+            rsmp->format != AUDIO_FORMAT_PCM_16_BIT) {
+        return -EINVAL;
+    }
+    return resampler_resample_from_provider_l(rsmp, out, outFrameCount);
+}
+
+int resampler_resample_from_provider_float(struct resampler_itfe *resampler,
+                       float *out,
+                       size_t *outFrameCount)
+{
+    struct resampler *rsmp = (struct resampler *)resampler;
+
+    if (rsmp == NULL || out == NULL || outFrameCount == NULL ||
+            rsmp->format != AUDIO_FORMAT_PCM_FLOAT) {
         return -EINVAL;
     }
+    return resampler_resample_from_provider_l(rsmp, out, outFrameCount);
+}
+
+static int resampler_resample_from_input_l(struct resampler *rsmp,
+                                  const void *in,
+                                  size_t *inFrameCount,
+                                  void *out,
+                                  size_t *outFrameCount)
+{
     if (rsmp->provider != NULL) {
         *outFrameCount = 0;
         return -ENOSYS;
     }
 
-    if (rsmp->channel_count == 1) {
-        speex_resampler_process_int(rsmp->speex_resampler,
-                                    0,
-                                    in,
-                                    (spx_uint32_t *)inFrameCount,
-                                    out,
-                                    (spx_uint32_t *)outFrameCount);
-    } else {
-        speex_resampler_process_interleaved_int(rsmp->speex_resampler,
-                                                in,
-                                                (spx_uint32_t *)inFrameCount,
-                                                out,
-                                                (spx_uint32_t *)outFrameCount);
-    }
+    spx_uint32_t inFrames = *inFrameCount;
+    spx_uint32_t outFrames = *outFrameCount;
+    resampler_process_l(rsmp, in, &inFrames, out, &outFrames);
+    *inFrameCount = inFrames;
+    *outFrameCount = outFrames;
 
     ALOGV("resampler_resample_from_input() DONE in %zu out %zu", *inFrameCount, *outFrameCount);
 
     return 0;
 }
 
-int create_resampler(uint32_t inSampleRate,
+int resampler_resample_from_input(struct resampler_itfe *resampler,
+                                  int16_t *in,
+                                  size_t *inFrameCount,
+                                  int16_t *out,
+                                  size_t *outFrameCount)
+{
+    struct resampler *rsmp = (struct resampler *)resampler;
+
+    if (rsmp == NULL || in == NULL || inFrameCount == NULL ||
+            out == NULL || outFrameCount == NULL ||
+            rsmp->format != AUDIO_FORMAT_PCM_16_BIT) {
+        return -EINVAL;
+    }
+    return resampler_resample_from_input_l(rsmp, in, inFrameCount, out, outFrameCount);
+}
+
+int resampler_resample_from_input_float(struct resampler_itfe *resampler,
+                                  float *in,
+                                  size_t *inFrameCount,
+                                  float *out,
+                                  size_t *outFrameCount)
+{
+    struct resampler *rsmp = (struct resampler *)resampler;
+
+    if (rsmp == NULL || in == NULL || inFrameCount == NULL ||
+            out == NULL || outFrameCount == NULL ||
+            rsmp->format != AUDIO_FORMAT_PCM_FLOAT) {
+        return -EINVAL;
+    }
+    return resampler_resample_from_input_l(rsmp, in, inFrameCount, out, outFrameCount);
+}
+
+static int create_resampler_l(uint32_t inSampleRate,
                     uint32_t outSampleRate,
                     uint32_t channelCount,
+                    audio_format_t format,
                     uint32_t quality,
                     struct resampler_buffer_provider* provider,
                     struct resampler_itfe **resampler)
@@ -196,8 +254,8 @@ int create_resampler(uint32_t inSampleRate,
     int error;
     struct resampler *rsmp;
 
-    ALOGV("create_resampler() In SR %d Out SR %d channels %d",
-         inSampleRate, outSampleRate, channelCount);
+    ALOGV("create_resampler() In SR %d Out SR %d channels %d format %#x",
+         inSampleRate, outSampleRate, channelCount, format);
 
     if (resampler == NULL) {
         return -EINVAL;
@@ -231,6 +289,8 @@ int create_resampler(uint32_t inSampleRate,
     rsmp->in_sample_rate = inSampleRate;
     rsmp->out_sample_rate = outSampleRate;
     rsmp->channel_count = channelCount;
+    rsmp->format = format;
+    rsmp->frame_size = channelCount * audio_bytes_per_sample(format);
     rsmp->in_buf = NULL;
     rsmp->in_buf_size = 0;
 
@@ -247,6 +307,28 @@ int create_resampler(uint32_t inSampleRate,
     return 0;
 }
 
+int create_resampler(uint32_t inSampleRate,
+                    uint32_t outSampleRate,
+                    uint32_t channelCount,
+                    uint32_t quality,
+                    struct resampler_buffer_provider* provider,
+                    struct resampler_itfe **resampler)
+{
+    return create_resampler_l(inSampleRate, outSampleRate, channelCount,
+                              AUDIO_FORMAT_PCM_16_BIT, quality, provider, resampler);
+}
+
+int create_resampler_float(uint32_t inSampleRate,
+                    uint32_t outSampleRate,
+                    uint32_t channelCount,
+                    uint32_t quality,
+                    struct resampler_buffer_provider* provider,
+                    struct resampler_itfe **resampler)
+{
+    return create_resampler_l(inSampleRate, outSampleRate, channelCount,
+                              AUDIO_FORMAT_PCM_FLOAT, quality, provider, resampler);
+}
+
 void release_resampler(struct resampler_itfe *resampler)
 {
     struct resampler *rsmp = (struct resampler *)resampler;
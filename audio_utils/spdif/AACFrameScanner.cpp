@@ -0,0 +1,129 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioSPDIF"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+
+#include <utils/Log.h>
+#include <audio_utils/spdif/BitFieldParser.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+#include "AACFrameScanner.h"
+
+namespace android {
+
+const uint8_t AACFrameScanner::kSyncBytes[] = { 0xFF };
+
+const uint32_t AACFrameScanner::kAACSampleRateTable[AAC_NUM_SAMPLE_RATE_TABLE_ENTRIES]
+        = { 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000 };
+
+// Defined in IEC61937-2
+#define IEC61937_DATA_TYPE_MPEG2_AAC             7
+#define IEC61937_DATA_TYPE_MPEG2_AAC_LSF_2048 0x13
+#define IEC61937_DATA_TYPE_MPEG2_AAC_LSF_4096 0x33
+
+// Size of the burst preamble Pa, Pb, Pc and Pd
+#define IEC61937_PREAMBLE_BYTES                  8
+
+// An ADTS header without the CRC
+#define ADTS_HEADER_BYTES_NEEDED                 7
+
+// Scanner for ADTS byte streams.
+AACFrameScanner::AACFrameScanner()
+ : FrameScanner(IEC61937_DATA_TYPE_MPEG2_AAC,
+    AACFrameScanner::kSyncBytes,
+    sizeof(AACFrameScanner::kSyncBytes),
+    ADTS_HEADER_BYTES_NEEDED)
+ , mSampleFramesPerSyncFrame(0)
+{
+}
+
+AACFrameScanner::~AACFrameScanner()
+{
+}
+
+// Parse ADTS header, ISO/IEC 13818-7 paragraph 6.2.
+// Sets mDataType, mFrameSizeBytes, mSampleRate, mRateMultiplier.
+//
+// @return true if valid
+bool AACFrameScanner::parseHeader()
+{
+    BitFieldParser parser(&mHeaderBuffer[mSyncLength], mHeaderLength - mSyncLength);
+
+    // These variables are named after the fields in the ADTS spec.
+    uint32_t syncword = parser.readBits(4); // the rest of the 12 bit syncword
+    (void) /* uint32_t id = */ parser.readBits(1);
+    uint32_t layer = parser.readBits(2);
+    (void) /* uint32_t protection_absent = */ parser.readBits(1);
+    (void) /* uint32_t profile = */ parser.readBits(2);
+    uint32_t samplingFrequencyIndex = parser.readBits(4);
+    (void) /* uint32_t private_bit = */ parser.readBits(1);
+    (void) /* uint32_t channel_configuration = */ parser.readBits(3);
+    (void) /* uint32_t original_copy = */ parser.readBits(1);
+    (void) /* uint32_t home = */ parser.readBits(1);
+    (void) /* uint32_t copyright_identification_bit = */ parser.readBits(1);
+    (void) /* uint32_t copyright_identification_start = */ parser.readBits(1);
+    uint32_t frameLength = parser.readBits(13);
+    (void) /* uint32_t adts_buffer_fullness = */ parser.readBits(11);
+    uint32_t numberOfRawDataBlocks = parser.readBits(2) + 1;
+    // make sure we did not read past collected data
+    ALOG_ASSERT(!parser.overrun());
+
+    // Validate fields.
+    if (syncword != 0xF || layer != 0) {
+        ALOGV("AACFrameScanner: not an ADTS header");
+        return false;
+    }
+    if (samplingFrequencyIndex >= AAC_NUM_SAMPLE_RATE_TABLE_ENTRIES) {
+        ALOGE("AACFrameScanner: ERROR - sampling_frequency_index = %u", samplingFrequencyIndex);
+        return false;
+    }
+    switch (numberOfRawDataBlocks) {
+    case 1:
+        mDataType = IEC61937_DATA_TYPE_MPEG2_AAC;
+        break;
+    case 2:
+        mDataType = IEC61937_DATA_TYPE_MPEG2_AAC_LSF_2048;
+        break;
+    case 4:
+        mDataType = IEC61937_DATA_TYPE_MPEG2_AAC_LSF_4096;
+        break;
+    default:
+        ALOGE("AACFrameScanner: ERROR - %u raw data blocks", numberOfRawDataBlocks);
+        return false;
+    }
+    mSampleFramesPerSyncFrame = numberOfRawDataBlocks * AAC_PCM_FRAMES_PER_RAW_DATA_BLOCK;
+
+    // The frame has to fit in the data burst after the preamble.
+    size_t burstBytes = mSampleFramesPerSyncFrame * getOutputChannelCount() * sizeof(int16_t);
+    if (frameLength < mHeaderLength || frameLength > burstBytes - IEC61937_PREAMBLE_BYTES) {
+        ALOGE("AACFrameScanner: ERROR - frame_length = %u", frameLength);
+        return false;
+    }
+    mFrameSizeBytes = frameLength;
+    mSampleRate = kAACSampleRateTable[samplingFrequencyIndex];
+    mRateMultiplier = 1;
+
+    ALOGI_IF((mFormatDumpCount == 0),
+            "AAC frame rate = %d * %d, size = %zu, raw data blocks = %u",
+            mSampleRate, mRateMultiplier, mFrameSizeBytes, numberOfRawDataBlocks);
+    mFormatDumpCount++;
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_AAC_FRAME_SCANNER_H
+#define ANDROID_AUDIO_AAC_FRAME_SCANNER_H
+
+#include <stdint.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+namespace android {
+
+#define AAC_NUM_SAMPLE_RATE_TABLE_ENTRIES         12
+#define AAC_PCM_FRAMES_PER_RAW_DATA_BLOCK       1024
+#define AAC_MAX_RAW_DATA_BLOCKS_PER_FRAME          4
+
+/**
+ * Scanner for MPEG-2 and MPEG-4 AAC in ADTS frames, per IEC 61937-6.
+ * Each ADTS frame, with its header, is the payload of one data burst.
+ */
+class AACFrameScanner : public FrameScanner
+{
+public:
+    AACFrameScanner();
+    virtual ~AACFrameScanner();
+
+    virtual int getMaxChannels()   const { return 7 + 1; } // 7.1 surround
+
+    virtual int getMaxSampleFramesPerSyncFrame() const {
+        return AAC_MAX_RAW_DATA_BLOCKS_PER_FRAME * AAC_PCM_FRAMES_PER_RAW_DATA_BLOCK;
+    }
+
+    virtual int getSampleFramesPerSyncFrame() const {
+        return mSampleFramesPerSyncFrame;
+    }
+
+    virtual bool isFirstInBurst() { return true; }
+    virtual bool isLastInBurst() { return true; }
+    virtual void resetBurst()  { }
+
+protected:
+
+    int mSampleFramesPerSyncFrame;
+
+    virtual bool parseHeader();
+
+    // used to recognize the start of an ADTS frame; the rest of the sync word is checked
+    // by parseHeader()
+    static const uint8_t kSyncBytes[];
+    // sample rates from ISO/IEC 14496-3 table 1.18
+    static const uint32_t kAACSampleRateTable[AAC_NUM_SAMPLE_RATE_TABLE_ENTRIES];
+};
+
+}  // namespace android
+
+#endif  // ANDROID_AUDIO_AAC_FRAME_SCANNER_H
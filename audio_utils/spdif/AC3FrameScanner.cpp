@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include <utils/Log.h>
+#include <audio_utils/spdif/BitFieldParser.h>
 #include <audio_utils/spdif/FrameScanner.h>
 
 #include "AC3FrameScanner.h"
@@ -160,16 +161,28 @@ bool AC3FrameScanner::isLastInBurst()
     return (mDataType != SPDIF_DATA_TYPE_E_AC3); // Just one AC3 frame per burst.
 }
 
-// TODO Use BitFieldParser
-
 // Parse AC3 header.
 // Detect whether the stream is AC3 or EAC3. Extract data depending on type.
 //
 // @return true if valid
 bool AC3FrameScanner::parseHeader()
 {
+    BitFieldParser parser(&mHeaderBuffer[mSyncLength], mHeaderLength - mSyncLength);
+
+    // The names fscod, frmsizcod, etc. are from the AC3 spec.
+    // The AC3 and EAC3 headers share the positions of fscod and bsid.
+    // The first 16 bits are crc1 in AC3, and strmtyp, substreamid and frmsiz in EAC3.
+    uint32_t crc1 = parser.readBits(16);
+    uint32_t fscod = parser.readBits(2);
+    // frmsizcod in AC3, and fscod2 or numblkscod, acmod and lfeon in EAC3
+    uint32_t frmsizcod = parser.readBits(6);
+    uint32_t bsid = parser.readBits(5); // bitstream ID
+    // bitstream mode, main, commentary, etc.
+    uint32_t bsmod = parser.readBits(3);
+    // make sure we did not read past collected data
+    ALOG_ASSERT(!parser.overrun());
+
     // Interpret bsid based on paragraph E2.3.1.6 of EAC3 spec.
-    uint32_t bsid = mHeaderBuffer[5] >> 3; // bitstream ID
     // Check BSID to see if this is EAC3 or regular AC3.
     // These arbitrary BSID numbers do not have any names in the spec.
     if ((bsid > 10) && (bsid <= 16)) {
@@ -181,23 +194,19 @@ bool AC3FrameScanner::parseHeader()
         return false;
     }
 
-    // bitstream mode, main, commentary, etc.
-    uint32_t bsmod = mHeaderBuffer[5] & 7;
     mDataTypeInfo = bsmod; // as per IEC61937-3, table 3.
 
-    // The names fscod, frmsiz are from the AC3 spec.
-    uint32_t fscod = mHeaderBuffer[4] >> 6;
     if (mDataType == SPDIF_DATA_TYPE_E_AC3) {
-        mStreamType = mHeaderBuffer[2] >> 6; // strmtyp in spec
-        mSubstreamID = (mHeaderBuffer[2] >> 3) & 0x07;
+        mStreamType = crc1 >> 14; // strmtyp in spec
+        mSubstreamID = (crc1 >> 11) & 0x07;
 
         // Frame size is explicit in EAC3. Paragraph E2.3.1.3
-        uint32_t frmsiz = ((mHeaderBuffer[2] & 0x07) << 8) + mHeaderBuffer[3];
+        uint32_t frmsiz = crc1 & 0x07FF;
         mFrameSizeBytes = (frmsiz + 1) * sizeof(int16_t);
 
         uint32_t numblkscod = 3; // 6 blocks default
         if (fscod == 3) {
-            uint32_t fscod2 = (mHeaderBuffer[4] >> 4) & 0x03;
+            uint32_t fscod2 = frmsizcod >> 4;
             if (fscod2 >= AC3_NUM_SAMPLE_RATE_TABLE_ENTRIES) {
                 ALOGW("Invalid EAC3 fscod2 = %d", fscod2);
                 return false;
@@ -206,7 +215,7 @@ bool AC3FrameScanner::parseHeader()
             }
         } else {
             mSampleRate = kAC3SampleRateTable[fscod];
-            numblkscod = (mHeaderBuffer[4] >> 4) & 0x03;
+            numblkscod = frmsizcod >> 4;
         }
         mRateMultiplier = EAC3_RATE_MULTIPLIER; // per IEC 61973-3 Paragraph 5.3.3
         // Don't send data burst until we have 6 blocks per substream.
@@ -225,8 +234,6 @@ bool AC3FrameScanner::parseHeader()
                 mStreamType, mSubstreamID);
     } else { // regular AC3
         // Extract sample rate and frame size from codes.
-        uint32_t frmsizcod = mHeaderBuffer[4] & 0x3F; // frame size code
-
         if (fscod >= AC3_NUM_SAMPLE_RATE_TABLE_ENTRIES) {
             ALOGW("Invalid AC3 sampleRateCode = %d", fscod);
             return false;
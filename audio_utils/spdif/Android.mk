@@ -6,10 +6,14 @@ LOCAL_MODULE := libaudiospdif
 LOCAL_MODULE_TAGS := optional
 
 LOCAL_SRC_FILES:= \
-	BitFieldParser.cpp \
 	FrameScanner.cpp \
+	AACFrameScanner.cpp \
 	AC3FrameScanner.cpp \
 	DTSFrameScanner.cpp \
+	DTSHDFrameScanner.cpp \
+	MPEGFrameScanner.cpp \
+	TrueHDFrameScanner.cpp \
+	SPDIFDecoder.cpp \
 	SPDIFEncoder.cpp
 
 LOCAL_C_INCLUDES += $(call include-path-for, audio-utils)
@@ -20,3 +24,24 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_CFLAGS := -Werror -Wall
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libaudiospdif
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES:= \
+	FrameScanner.cpp \
+	AACFrameScanner.cpp \
+	AC3FrameScanner.cpp \
+	DTSFrameScanner.cpp \
+	DTSHDFrameScanner.cpp \
+	MPEGFrameScanner.cpp \
+	TrueHDFrameScanner.cpp \
+	SPDIFDecoder.cpp \
+	SPDIFEncoder.cpp
+
+LOCAL_C_INCLUDES += $(call include-path-for, audio-utils)
+
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_HOST_STATIC_LIBRARY)
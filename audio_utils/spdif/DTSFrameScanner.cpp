@@ -21,9 +21,9 @@
 #include <string.h>
 
 #include <utils/Log.h>
+#include <audio_utils/spdif/BitFieldParser.h>
 #include <audio_utils/spdif/FrameScanner.h>
 
-#include "BitFieldParser.h"
 #include "DTSFrameScanner.h"
 
 namespace android {
@@ -53,8 +53,6 @@ const int32_t DTSFrameScanner::kDTSSampleRateTable[DTS_NUM_SAMPLE_RATE_TABLE_ENT
 #define DTS_MINIMUM_NBLKS                5
 #define DTS_MINIMUM_FSIZE               95
 
-#define DTS_HEADER_BYTES_NEEDED         12
-
 // Scanner for DTS byte streams.
 DTSFrameScanner::DTSFrameScanner()
  : FrameScanner(IEC61937_DATA_TYPE_DTS_I,
@@ -77,7 +75,7 @@ DTSFrameScanner::~DTSFrameScanner()
 // @return true if valid
 bool DTSFrameScanner::parseHeader()
 {
-    BitFieldParser parser(&mHeaderBuffer[mSyncLength]);
+    BitFieldParser parser(&mHeaderBuffer[mSyncLength], mHeaderLength - mSyncLength);
 
     // These variables are named after the fields in the DTS spec 5.3.1
     // Extract field in order.
@@ -89,8 +87,7 @@ bool DTSFrameScanner::parseHeader()
     (void) /* uint32_t amode = */ parser.readBits(6);
     uint32_t sfreq = parser.readBits(4);
     // make sure we did not read past collected data
-    ALOG_ASSERT((mSyncLength + ((parser.getBitCursor() + 7) >> 3))
-            <= mHeaderLength);
+    ALOG_ASSERT(!parser.overrun());
 
     // Validate fields.
     if (cpf != 0) {
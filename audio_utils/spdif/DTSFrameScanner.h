@@ -25,6 +25,7 @@ namespace android {
 #define DTS_NUM_SAMPLE_RATE_TABLE_ENTRIES      16
 #define DTS_PCM_FRAMES_PER_BLOCK               32
 #define DTS_MAX_BLOCKS_PER_SYNC_FRAME_BLOCK   128
+#define DTS_HEADER_BYTES_NEEDED               12
 
 class DTSFrameScanner : public FrameScanner
 {
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioSPDIF"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+
+#include <utils/Log.h>
+#include <audio_utils/spdif/BitFieldParser.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+#include "DTSHDFrameScanner.h"
+
+namespace android {
+
+const uint8_t DTSHDFrameScanner::kExtSyncBytes[] =
+        { 0x64, 0x58, 0x20, 0x25 };
+
+const uint8_t DTSHDFrameScanner::kStartCode[] =
+        { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0xFE };
+
+// Defined in IEC61937-2
+#define IEC61937_DATA_TYPE_DTS_IV       17
+
+// Repetition period of type IV subtype 0, in frames of a 2 channel stream
+#define IEC61937_DTS_IV_MIN_PERIOD     512
+#define IEC61937_DTS_IV_MAX_SUBTYPE      5
+
+// The start code is followed by the size of the rest of the payload.
+#define DTSHD_START_CODE_BYTES          (sizeof(kStartCode) + sizeof(uint16_t))
+
+// Enough for the frame size in an extension substream header, DTS spec paragraph 7.4.1
+#define DTS_EXT_HEADER_BYTES_NEEDED     10
+
+// PCM frames per core frame assumed for extension substreams without a core
+#define DTSHD_DEFAULT_PCM_FRAMES       512
+
+// Scanner for DTS-HD byte streams.
+DTSHDFrameScanner::DTSHDFrameScanner()
+ : DTSFrameScanner()
+ , mIsCore(false)
+ , mFollowsCore(false)
+ , mCoreSampleFrames(DTSHD_DEFAULT_PCM_FRAMES)
+{
+    mDataType = IEC61937_DATA_TYPE_DTS_IV;
+    mSampleRate = 48000;
+}
+
+DTSHDFrameScanner::~DTSHDFrameScanner()
+{
+}
+
+// Scan for either a core or an extension substream sync word.
+bool DTSHDFrameScanner::scan(uint8_t byte)
+{
+    // A byte that does not continue a partial sync word may start either sync word.
+    if (mCursor > 0 && mCursor < mSyncLength && byte != mSyncBytes[mCursor]) {
+        mBytesSkipped += mCursor;
+        mCursor = 0;
+    }
+    if (mCursor == 0) {
+        if (byte == kExtSyncBytes[0]) {
+            mSyncBytes = kExtSyncBytes;
+            mHeaderLength = DTS_EXT_HEADER_BYTES_NEEDED;
+        } else {
+            mSyncBytes = kSyncBytes;
+            mHeaderLength = DTS_HEADER_BYTES_NEEDED;
+        }
+    }
+    return FrameScanner::scan(byte);
+}
+
+// Search for the first byte of either sync word with memchr(), and pass the bytes from there
+// to scan() until the sync word does not match or the header is complete.
+size_t DTSHDFrameScanner::scanBytes(const uint8_t *data, size_t numBytes, bool *found)
+{
+    *found = false;
+    size_t i = 0;
+    size_t core = 0;        // offsets of the next candidates for each sync word
+    size_t extension = 0;
+    bool searched = false;
+    while (i < numBytes) {
+        if (mCursor == 0) {
+            if (!searched || core < i) {
+                const uint8_t *sync = (const uint8_t *) memchr(&data[i], kSyncBytes[0],
+                        numBytes - i);
+                core = sync != NULL ? sync - data : numBytes;
+            }
+            if (!searched || extension < i) {
+                const uint8_t *sync = (const uint8_t *) memchr(&data[i], kExtSyncBytes[0],
+                        numBytes - i);
+                extension = sync != NULL ? sync - data : numBytes;
+            }
+            searched = true;
+            const size_t start = core < extension ? core : extension;
+            mBytesSkipped += start - i;
+            mPosition += start - i;
+            i = start;
+            if (i == numBytes) {
+                break;
+            }
+        }
+        // Gather the sync word and header, which may have started in a previous buffer.
+        if (scan(data[i++])) {
+            *found = true;
+            return i;
+        }
+    }
+    return numBytes;
+}
+
+// A burst starts with a core frame, or with an extension substream that has no core.
+bool DTSHDFrameScanner::isFirstInBurst()
+{
+    return mIsCore || !mFollowsCore;
+}
+
+// An extension substream completes a burst. After a core frame we do not know
+// until we see whether the next frame is its extension substream.
+bool DTSHDFrameScanner::isLastInBurst()
+{
+    return !mIsCore;
+}
+
+// Per IEC 61937-5, the burst-length of type IV is in bytes. It is rounded so that
+// it is 8 modulo 16, which some receivers require.
+uint16_t DTSHDFrameScanner::convertBytesToLengthCode(uint16_t numBytes) const
+{
+    return ((numBytes + 8 + 15) & ~15) - 8;
+}
+
+size_t DTSHDFrameScanner::startFrameInBurst(uint16_t *payload, size_t payloadBytes)
+{
+    if (payloadBytes > 0) {
+        return payloadBytes;
+    }
+    writePayloadBytes(payload, 0, kStartCode, sizeof(kStartCode));
+    payload[sizeof(kStartCode) >> 1] = 0; // set by finishBurst()
+    return DTSHD_START_CODE_BYTES;
+}
+
+size_t DTSHDFrameScanner::finishBurst(uint16_t *payload, size_t payloadBytes)
+{
+    if (payloadBytes >= DTSHD_START_CODE_BYTES) {
+        payload[sizeof(kStartCode) >> 1] = payloadBytes - DTSHD_START_CODE_BYTES;
+    }
+    return payloadBytes;
+}
+
+// Parse a core header or an extension substream header.
+// Sets mDataType, mDataTypeInfo, mFrameSizeBytes, mSampleRate, mRateMultiplier.
+//
+// @return true if valid
+bool DTSHDFrameScanner::parseHeader()
+{
+    const bool isCore = (mSyncBytes == kSyncBytes);
+    int coreSampleFrames = mCoreSampleFrames;
+    if (isCore) {
+        // The core parser sets the parameters of type I to III bursts,
+        // which are restored here and then replaced by setBurstParameters().
+        const int sampleFrames = mSampleFramesPerSyncFrame;
+        const uint32_t rateMultiplier = mRateMultiplier;
+        const bool valid = DTSFrameScanner::parseHeader();
+        coreSampleFrames = mSampleFramesPerSyncFrame;
+        mSampleFramesPerSyncFrame = sampleFrames;
+        mRateMultiplier = rateMultiplier;
+        mDataType = IEC61937_DATA_TYPE_DTS_IV;
+        if (!valid) {
+            return false;
+        }
+    } else if (!parseExtensionHeader()) {
+        return false;
+    }
+    if (!setBurstParameters(coreSampleFrames)) {
+        return false;
+    }
+    mFollowsCore = mIsCore;
+    mIsCore = isCore;
+    return true;
+}
+
+// Parse the start of an extension substream header, DTS spec paragraph 7.4.1.
+bool DTSHDFrameScanner::parseExtensionHeader()
+{
+    BitFieldParser parser(&mHeaderBuffer[mSyncLength], mHeaderLength - mSyncLength);
+
+    // These variables are named after the fields in the DTS spec 7.4.1
+    (void) /* uint32_t UserDefinedBits = */ parser.readBits(8);
+    (void) /* uint32_t nExtSSIndex = */ parser.readBits(2);
+    uint32_t bHeaderSizeType = parser.readBits(1);
+    uint32_t nuExtSSHeaderSize;
+    uint32_t nuExtSSFsize;
+    if (bHeaderSizeType == 0) {
+        nuExtSSHeaderSize = parser.readBits(8) + 1;
+        nuExtSSFsize = parser.readBits(16) + 1;
+    } else {
+        nuExtSSHeaderSize = parser.readBits(12) + 1;
+        nuExtSSFsize = parser.readBits(20) + 1;
+    }
+    // make sure we did not read past collected data
+    ALOG_ASSERT(!parser.overrun());
+
+    if (nuExtSSFsize < mHeaderLength || nuExtSSHeaderSize > nuExtSSFsize) {
+        ALOGE("DTSHDFrameScanner: ERROR - nuExtSSHeaderSize = %u, nuExtSSFsize = %u",
+                nuExtSSHeaderSize, nuExtSSFsize);
+        return false;
+    }
+    mFrameSizeBytes = nuExtSSFsize;
+    return true;
+}
+
+// Set the data type and repetition period of type IV bursts for a core frame size.
+bool DTSHDFrameScanner::setBurstParameters(int coreSampleFrames)
+{
+    // The HBR stream has 8 channels at four times the core sample rate. The subtype is
+    // log2 of the period of an equivalent 2 channel stream, which is four times as long,
+    // divided by the period of subtype 0.
+    int sampleFrames = coreSampleFrames * DTSHD_RATE_MULTIPLIER;
+    int subtype = 0;
+    while (subtype < IEC61937_DTS_IV_MAX_SUBTYPE
+            && (IEC61937_DTS_IV_MIN_PERIOD << subtype) < sampleFrames * 4) {
+        subtype++;
+    }
+    if ((IEC61937_DTS_IV_MIN_PERIOD << subtype) != sampleFrames * 4
+            || sampleFrames > getMaxSampleFramesPerSyncFrame()) {
+        ALOGE("DTSHDFrameScanner: ERROR - %d PCM frames per frame", coreSampleFrames);
+        return false;
+    }
+    mCoreSampleFrames = coreSampleFrames;
+    mSampleFramesPerSyncFrame = sampleFrames;
+    mDataType = IEC61937_DATA_TYPE_DTS_IV;
+    mDataTypeInfo = subtype;
+    mRateMultiplier = DTSHD_RATE_MULTIPLIER;
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_DTSHD_FRAME_SCANNER_H
+#define ANDROID_AUDIO_DTSHD_FRAME_SCANNER_H
+
+#include <stdint.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+#include "DTSFrameScanner.h"
+
+namespace android {
+
+#define DTSHD_RATE_MULTIPLIER                  4
+#define DTSHD_MAX_PCM_FRAMES_PER_SYNC_FRAME 4096
+
+/**
+ * Scanner for DTS-HD streams, such as DTS-HD Master Audio, per IEC 61937-5 type IV.
+ * A core frame and the extension substream that follows it are sent in one data burst,
+ * after a DTS-HD start code, in the 8 channel high bitrate (HBR) layout at four times
+ * the core sample rate. Extension substreams without a core are sent on their own.
+ */
+class DTSHDFrameScanner : public DTSFrameScanner
+{
+public:
+    DTSHDFrameScanner();
+    virtual ~DTSHDFrameScanner();
+
+    virtual bool scan(uint8_t byte);
+    virtual size_t scanBytes(const uint8_t *data, size_t numBytes, bool *found);
+
+    virtual int getMaxChannels()   const { return 7 + 1; }
+
+    virtual int getMaxSampleFramesPerSyncFrame() const {
+        return DTSHD_MAX_PCM_FRAMES_PER_SYNC_FRAME;
+    }
+
+    virtual bool isFirstInBurst();
+    virtual bool isLastInBurst();
+
+    virtual uint16_t convertBytesToLengthCode(uint16_t numBytes) const;
+    virtual int getOutputChannelCount() const { return 8; }
+    virtual size_t startFrameInBurst(uint16_t *payload, size_t payloadBytes);
+    virtual size_t finishBurst(uint16_t *payload, size_t payloadBytes);
+
+protected:
+
+    bool mIsCore;          // true if the last frame parsed was a core frame
+    bool mFollowsCore;     // true if the frame before it was a core frame
+    int  mCoreSampleFrames;  // PCM frames per core frame, at mSampleRate
+
+    virtual bool parseHeader();
+    bool parseExtensionHeader();
+    bool setBurstParameters(int coreSampleFrames);
+
+    // used to recognize the start of an extension substream
+    static const uint8_t kExtSyncBytes[];
+    // written before the frames of a data burst
+    static const uint8_t kStartCode[];
+};
+
+}  // namespace android
+
+#endif  // ANDROID_AUDIO_DTSHD_FRAME_SCANNER_H
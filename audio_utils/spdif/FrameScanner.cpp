@@ -39,6 +39,8 @@ FrameScanner::FrameScanner(int dataType,
  , mFrameSizeBytes(0)
  , mDataType(dataType)
  , mDataTypeInfo(0)
+ , mPosition(0)
+ , mFrameBytesToSkip(0)
 {
 }
 
@@ -53,27 +55,154 @@ bool FrameScanner::scan(uint8_t byte)
     bool result = false;
     ALOGV("FrameScanner: byte = 0x%02X, mCursor = %d", byte, mCursor);
     assert(mCursor < sizeof(mHeaderBuffer));
+    mPosition++;
     if (mCursor < mSyncLength) {
         // match sync word
         if (byte == mSyncBytes[mCursor]) {
             mHeaderBuffer[mCursor++] = byte;
         } else {
-            mBytesSkipped += 1; // skip unsynchronized data
+            // skip unsynchronized data, but this byte may start the sync word
+            mBytesSkipped += mCursor;
             mCursor = 0;
+            if (byte == mSyncBytes[0]) {
+                mHeaderBuffer[mCursor++] = byte;
+            } else {
+                mBytesSkipped += 1;
+            }
         }
     } else if (mCursor < mHeaderLength) {
         // gather header for parsing
         mHeaderBuffer[mCursor++] = byte;
         if (mCursor >= mHeaderLength) {
+            mCursor = 0;
             if (parseHeader()) {
                 result = true;
             } else {
                 ALOGE("FrameScanner: ERROR - parseHeader() failed.");
+                // Skip the first byte of the sync word and scan the rest of the header again,
+                // since it may contain the next sync word. It cannot contain a whole header.
+                uint8_t rest[sizeof(mHeaderBuffer)];
+                size_t restLength = mHeaderLength - 1;
+                memcpy(rest, &mHeaderBuffer[1], restLength);
+                mBytesSkipped += 1;
+                mPosition -= restLength;
+                for (size_t i = 0; i < restLength; i++) {
+                    scan(rest[i]);
+                }
             }
-            mCursor = 0;
         }
     }
     return result;
 }
 
+size_t FrameScanner::scanBytes(const uint8_t *data, size_t numBytes, bool *found)
+{
+    *found = false;
+    size_t i = 0;
+    // Finish a sync word or header that started in a previous buffer.
+    while (mCursor > 0 && i < numBytes) {
+        if (scan(data[i++])) {
+            *found = true;
+            return i;
+        }
+    }
+    while (i < numBytes) {
+        const uint8_t *sync = (const uint8_t *) memchr(&data[i], mSyncBytes[0], numBytes - i);
+        if (sync == NULL) {
+            mBytesSkipped += numBytes - i;
+            mPosition += numBytes - i;
+            return numBytes;
+        }
+        size_t start = sync - data;
+        mBytesSkipped += start - i;
+        mPosition += start - i;
+        i = start;
+        if (numBytes - i < mHeaderLength) {
+            // Gather a partial sync word or header at the end of the buffer.
+            while (i < numBytes) {
+                if (scan(data[i++])) {
+                    *found = true;
+                    return i;
+                }
+            }
+            return numBytes;
+        }
+        if (memcmp(sync, mSyncBytes, mSyncLength) != 0) {
+            mBytesSkipped += 1;
+            mPosition += 1;
+            i += 1;
+            continue;
+        }
+        memcpy(mHeaderBuffer, sync, mHeaderLength);
+        if (parseHeader()) {
+            mPosition += mHeaderLength;
+            *found = true;
+            return i + mHeaderLength;
+        }
+        ALOGE("FrameScanner: ERROR - parseHeader() failed.");
+        // The rest of the header may contain the next sync word.
+        mBytesSkipped += 1;
+        mPosition += 1;
+        i += 1;
+    }
+    return numBytes;
+}
+
+size_t FrameScanner::scanEachByte(const uint8_t *data, size_t numBytes, bool *found)
+{
+    *found = false;
+    for (size_t i = 0; i < numBytes; ) {
+        if (scan(data[i++])) {
+            *found = true;
+            return i;
+        }
+    }
+    return numBytes;
+}
+
+void FrameScanner::writePayloadBytes(uint16_t *payload, size_t offset,
+        const uint8_t *bytes, size_t numBytes)
+{
+    assert(((offset | numBytes) & 1) == 0);
+    payload += offset >> 1;
+    for (size_t i = 0; i < numBytes; i += 2) {
+        *payload++ = (bytes[i] << 8) | bytes[i + 1];
+    }
+}
+
+size_t FrameScanner::findFrames(const uint8_t *data, size_t numBytes,
+        FrameBoundary *frames, size_t maxFrames, size_t *bytesConsumed)
+{
+    size_t numFrames = 0;
+    size_t i = 0;
+    while (numFrames < maxFrames && i < numBytes) {
+        if (mFrameBytesToSkip > 0) {
+            size_t bytesToSkip = numBytes - i;
+            if (bytesToSkip > mFrameBytesToSkip) {
+                bytesToSkip = mFrameBytesToSkip;
+            }
+            mFrameBytesToSkip -= bytesToSkip;
+            mPosition += bytesToSkip;
+            i += bytesToSkip;
+            continue;
+        }
+        bool found;
+        i += scanBytes(&data[i], numBytes - i, &found);
+        if (found) {
+            FrameBoundary *frame = &frames[numFrames++];
+            frame->position = mPosition - mHeaderLength;
+            frame->frameSizeBytes = mFrameSizeBytes;
+            frame->sampleRate = mSampleRate;
+            frame->rateMultiplier = mRateMultiplier;
+            frame->dataType = mDataType;
+            frame->dataTypeInfo = mDataTypeInfo;
+            frame->sampleFramesPerSyncFrame = getSampleFramesPerSyncFrame();
+            mFrameBytesToSkip = mFrameSizeBytes > mHeaderLength
+                    ? mFrameSizeBytes - mHeaderLength : 0;
+        }
+    }
+    *bytesConsumed = i;
+    return numFrames;
+}
+
 }  // namespace android
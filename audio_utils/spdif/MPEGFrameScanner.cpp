@@ -0,0 +1,145 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioSPDIF"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+
+#include <utils/Log.h>
+#include <audio_utils/spdif/BitFieldParser.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+#include "MPEGFrameScanner.h"
+
+namespace android {
+
+// These values are from the MPEG audio specs. Do not change them.
+
+const uint8_t MPEGFrameScanner::kSyncBytes[] = { 0xFF };
+
+const uint16_t MPEGFrameScanner::kMPEGBitRateTable[2][3][MPEG_NUM_BITRATE_TABLE_ENTRIES] = {
+    {   // MPEG-1
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+    },
+    {   // MPEG-2 low sampling frequencies
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    },
+};
+
+const uint16_t MPEGFrameScanner::kMPEGSampleRateTable[2][MPEG_NUM_SAMPLE_RATE_TABLE_ENTRIES] = {
+    { 44100, 48000, 32000 },
+    { 22050, 24000, 16000 },
+};
+
+// Defined in IEC61937-2
+#define IEC61937_DATA_TYPE_MPEG1_LAYER1          4
+#define IEC61937_DATA_TYPE_MPEG1_LAYER23         5
+#define IEC61937_DATA_TYPE_MPEG2_LAYER1_LSF      8
+#define IEC61937_DATA_TYPE_MPEG2_LAYER2_LSF      9
+#define IEC61937_DATA_TYPE_MPEG2_LAYER3_LSF     10
+
+// Values of the ID and layer fields of the header
+#define MPEG_ID_MPEG2                            0
+#define MPEG_LAYER_1                             3
+#define MPEG_LAYER_2                             2
+#define MPEG_LAYER_3                             1
+
+#define MPEG_HEADER_BYTES_NEEDED                 4
+
+// Scanner for MPEG audio byte streams.
+MPEGFrameScanner::MPEGFrameScanner()
+ : FrameScanner(IEC61937_DATA_TYPE_MPEG1_LAYER23,
+    MPEGFrameScanner::kSyncBytes,
+    sizeof(MPEGFrameScanner::kSyncBytes),
+    MPEG_HEADER_BYTES_NEEDED)
+ , mSampleFramesPerSyncFrame(0)
+{
+}
+
+MPEGFrameScanner::~MPEGFrameScanner()
+{
+}
+
+// Parse MPEG audio header, ISO/IEC 11172-3 paragraph 2.4.2.3.
+// Sets mDataType, mFrameSizeBytes, mSampleRate, mRateMultiplier.
+//
+// @return true if valid
+bool MPEGFrameScanner::parseHeader()
+{
+    BitFieldParser parser(&mHeaderBuffer[mSyncLength], mHeaderLength - mSyncLength);
+
+    // These variables are named after the fields in the MPEG audio spec.
+    uint32_t syncword = parser.readBits(4); // the rest of the 12 bit syncword
+    uint32_t id = parser.readBits(1);
+    uint32_t layer = parser.readBits(2);
+    (void) /* uint32_t protection_bit = */ parser.readBits(1);
+    uint32_t bitrateIndex = parser.readBits(4);
+    uint32_t samplingFrequency = parser.readBits(2);
+    uint32_t paddingBit = parser.readBits(1);
+    // make sure we did not read past collected data
+    ALOG_ASSERT(!parser.overrun());
+
+    // Validate fields. A sync word of 0xFFE is MPEG-2.5, which IEC 61937 does not carry.
+    if (syncword != 0xF || layer == 0) {
+        ALOGV("MPEGFrameScanner: not an MPEG audio header");
+        return false;
+    }
+    if (bitrateIndex == 0 || bitrateIndex >= MPEG_NUM_BITRATE_TABLE_ENTRIES) {
+        ALOGE("MPEGFrameScanner: ERROR - bitrate_index = %u", bitrateIndex);
+        return false;
+    }
+    if (samplingFrequency >= MPEG_NUM_SAMPLE_RATE_TABLE_ENTRIES) {
+        ALOGE("MPEGFrameScanner: ERROR - sampling_frequency = %u", samplingFrequency);
+        return false;
+    }
+
+    const bool lsf = (id == MPEG_ID_MPEG2);
+    const uint32_t bitRate = kMPEGBitRateTable[lsf][MPEG_LAYER_1 - layer][bitrateIndex] * 1000;
+    mSampleRate = kMPEGSampleRateTable[lsf][samplingFrequency];
+
+    // Frame sizes from ISO/IEC 11172-3 paragraph 2.4.3.1 and ISO/IEC 13818-3 paragraph 2.4.3.1.
+    // Frames with low sampling frequencies are sent at twice the sample rate.
+    int samplesPerFrame;
+    if (layer == MPEG_LAYER_1) {
+        samplesPerFrame = 384;
+        mFrameSizeBytes = (12 * bitRate / mSampleRate + paddingBit) * 4;
+        mDataType = lsf ? IEC61937_DATA_TYPE_MPEG2_LAYER1_LSF : IEC61937_DATA_TYPE_MPEG1_LAYER1;
+    } else if (layer == MPEG_LAYER_2 || !lsf) {
+        samplesPerFrame = 1152;
+        mFrameSizeBytes = 144 * bitRate / mSampleRate + paddingBit;
+        mDataType = lsf ? IEC61937_DATA_TYPE_MPEG2_LAYER2_LSF : IEC61937_DATA_TYPE_MPEG1_LAYER23;
+    } else {
+        samplesPerFrame = 576;
+        mFrameSizeBytes = 72 * bitRate / mSampleRate + paddingBit;
+        mDataType = IEC61937_DATA_TYPE_MPEG2_LAYER3_LSF;
+    }
+    mRateMultiplier = lsf ? MPEG_LSF_RATE_MULTIPLIER : 1;
+    mSampleFramesPerSyncFrame = samplesPerFrame * mRateMultiplier;
+    mDataTypeInfo = 0;
+
+    ALOGI_IF((mFormatDumpCount == 0),
+            "MPEG frame rate = %d * %d, size = %zu, layer = %u",
+            mSampleRate, mRateMultiplier, mFrameSizeBytes, 4 - layer);
+    mFormatDumpCount++;
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MPEG_FRAME_SCANNER_H
+#define ANDROID_AUDIO_MPEG_FRAME_SCANNER_H
+
+#include <stdint.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+namespace android {
+
+#define MPEG_NUM_BITRATE_TABLE_ENTRIES        15
+#define MPEG_NUM_SAMPLE_RATE_TABLE_ENTRIES     3
+#define MPEG_LSF_RATE_MULTIPLIER               2
+#define MPEG_MAX_PCM_FRAMES_PER_SYNC_FRAME  2304
+
+/**
+ * Scanner for MPEG-1 and MPEG-2 low sampling frequency audio, layers I, II and III,
+ * per IEC 61937-4. Each audio frame is the payload of one data burst.
+ * MPEG-2 multichannel extension streams and MPEG-2.5 are not supported.
+ */
+class MPEGFrameScanner : public FrameScanner
+{
+public:
+    MPEGFrameScanner();
+    virtual ~MPEGFrameScanner();
+
+    virtual int getMaxChannels()   const { return 2; }
+
+    virtual int getMaxSampleFramesPerSyncFrame() const {
+        return MPEG_MAX_PCM_FRAMES_PER_SYNC_FRAME;
+    }
+
+    virtual int getSampleFramesPerSyncFrame() const {
+        return mSampleFramesPerSyncFrame;
+    }
+
+    virtual bool isFirstInBurst() { return true; }
+    virtual bool isLastInBurst() { return true; }
+    virtual void resetBurst()  { }
+
+protected:
+
+    int mSampleFramesPerSyncFrame;
+
+    virtual bool parseHeader();
+
+    // used to recognize the start of an MPEG audio frame; the rest of the sync word
+    // is checked by parseHeader()
+    static const uint8_t kSyncBytes[];
+    // bit rates in kbit/s from ISO/IEC 11172-3 and ISO/IEC 13818-3,
+    // indexed by [lsf][layer - 1][bitrate_index]
+    static const uint16_t kMPEGBitRateTable[2][3][MPEG_NUM_BITRATE_TABLE_ENTRIES];
+    // sample rates indexed by [lsf][sampling_frequency]
+    static const uint16_t kMPEGSampleRateTable[2][MPEG_NUM_SAMPLE_RATE_TABLE_ENTRIES];
+};
+
+}  // namespace android
+
+#endif  // ANDROID_AUDIO_MPEG_FRAME_SCANNER_H
@@ -0,0 +1,300 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <endian.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_TAG "AudioSPDIF"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+#include <audio_utils/spdif/SPDIFDecoder.h>
+
+#include "../private/simd.h"
+#include "SwapBytePairs.h"
+
+namespace android {
+
+// Burst Preamble defined in IEC61937-1
+const unsigned short SPDIFDecoder::kSPDIFSync1 = 0xF872; // Pa
+const unsigned short SPDIFDecoder::kSPDIFSync2 = 0x4E1F; // Pb
+
+// Size of the burst preamble Pa, Pb, Pc and Pd
+static const size_t kPreambleSize = 4 * sizeof(uint16_t);
+
+// Defined in IEC61937-2
+#define IEC61937_DATA_TYPE_NULL         0
+#define IEC61937_DATA_TYPE_PAUSE        3
+#define IEC61937_DATA_TYPE_DTS_IV      17
+#define IEC61937_PC_ERROR_FLAG     0x0080
+#define IEC61937_DTS_IV_MAX_SUBTYPE     5
+
+// Data types of IEC61937-2 table 2 that SPDIFDecoder passes on.
+// The repetition period is in frames of 2 channels.
+struct DataType {
+    int      dataType;
+    uint32_t period;
+    bool     lengthInBytes; // Pd is in bytes rather than bits
+};
+
+static const DataType kDataTypes[] = {
+    { 1, 1536, false },     // AC3
+    { 4, 384, false },      // MPEG-1 layer I
+    { 5, 1152, false },     // MPEG-1 layer II or III, MPEG-2 without extension
+    { 6, 1152, false },     // MPEG-2 with extension
+    { 7, 1024, false },     // MPEG-2 AAC
+    { 8, 768, false },      // MPEG-2 layer I low sampling frequency
+    { 9, 2304, false },     // MPEG-2 layer II low sampling frequency
+    { 10, 1152, false },    // MPEG-2 layer III low sampling frequency
+    { 11, 512, false },     // DTS type I
+    { 12, 1024, false },    // DTS type II
+    { 13, 2048, false },    // DTS type III
+    { IEC61937_DATA_TYPE_DTS_IV, 512, true }, // DTS type IV, period shifted by the subtype
+    { 0x13, 2048, false },  // MPEG-2 AAC, 2 raw data blocks
+    { 0x33, 4096, false },  // MPEG-2 AAC, 4 raw data blocks
+    { 21, 6144, true },     // E-AC3
+    { 22, 15360, true },    // MAT, for Dolby TrueHD
+};
+
+// Large enough for a DTS type IV burst of the largest subtype.
+static const size_t kMaxPayloadBytes = (512 << IEC61937_DTS_IV_MAX_SUBTYPE) * 4 - kPreambleSize;
+
+static const bool kLittleEndian = __BYTE_ORDER == __LITTLE_ENDIAN;
+
+SPDIFDecoder::SPDIFDecoder(int channelCount, uint32_t sampleRate)
+  : mChannelCount(channelCount)
+  , mSampleRate(sampleRate)
+  , mState(STATE_SCANNING)
+  , mWordPosition(0)
+  , mPreambleWords(0)
+  , mDropPayload(false)
+  , mPayloadBytes(0)
+  , mPayloadWordsRemaining(0)
+  , mPayloadBuffer(NULL)
+  , mPayloadBufferBytes(0)
+  , mBurstCount(0)
+  , mDroppedBurstCount(0)
+{
+    // This a programmer error.
+    LOG_ALWAYS_FATAL_IF((channelCount != 2 && channelCount != 8) || sampleRate == 0,
+            "SPDIFDecoder: invalid channelCount = %d or sampleRate = %u",
+            channelCount, sampleRate);
+    memset(mPreamble, 0, sizeof(mPreamble));
+    memset(&mInfo, 0, sizeof(mInfo));
+    mPayloadBuffer = new uint8_t[kMaxPayloadBytes];
+}
+
+SPDIFDecoder::~SPDIFDecoder()
+{
+    delete[] mPayloadBuffer;
+}
+
+void SPDIFDecoder::reset()
+{
+    ALOGV("SPDIFDecoder: reset()");
+    mState = STATE_SCANNING;
+    mPreambleWords = 0;
+    mPayloadWordsRemaining = 0;
+    mPayloadBufferBytes = 0;
+}
+
+// Return the index of the first PCM frame at or after start that begins with Pa and Pb,
+// or numWords if there is none.
+size_t SPDIFDecoder::findSync(const uint16_t *words, size_t start, size_t numWords) const
+{
+    size_t i = (start + mChannelCount - 1) / mChannelCount * mChannelCount;
+#ifdef AUDIO_UTILS_SIMD
+    // Skip blocks of 8 words without Pa. The channel count divides 8,
+    // so the blocks stay aligned to PCM frames.
+    const int16_t pa = (int16_t) kSPDIFSync1;
+    const audio_v8i16 sync = { pa, pa, pa, pa, pa, pa, pa, pa };
+    for (; i + 8 <= numWords; i += 8) {
+        audio_v8i16 v;
+        AUDIO_SIMD_LOAD(v, &words[i]);
+        const audio_v2i64 hits = (audio_v2i64) (v == sync);
+        if ((hits[0] | hits[1]) == 0) {
+            continue;
+        }
+        for (size_t j = i; j < i + 8; j += mChannelCount) {
+            if (words[j] == kSPDIFSync1 && words[j + 1] == kSPDIFSync2) {
+                return j;
+            }
+        }
+    }
+#endif
+    // Whole PCM frames have at least 2 words, so Pb is within the buffer.
+    for (; i < numWords; i += mChannelCount) {
+        if (words[i] == kSPDIFSync1 && words[i + 1] == kSPDIFSync2) {
+            return i;
+        }
+    }
+    return numWords;
+}
+
+// Validate Pc and Pd of the preamble and prepare to read the payload.
+// @return true if the payload should be read, false to scan for the next burst
+bool SPDIFDecoder::startBurst()
+{
+    const uint16_t pc = mPreamble[2];
+    const uint16_t pd = mPreamble[3];
+    mInfo.dataType = pc & 0x7F;
+    mInfo.dataTypeInfo = (pc >> 8) & 0x1F;
+    mInfo.bitstreamNumber = pc >> 13;
+    // split the position to avoid overflow
+    mInfo.timestampNs = (int64_t) (mInfo.position / mSampleRate) * 1000000000LL
+            + (int64_t) (mInfo.position % mSampleRate) * 1000000000LL / mSampleRate;
+    mPayloadBufferBytes = 0;
+    mState = STATE_SCANNING;
+
+    if (mInfo.dataType == IEC61937_DATA_TYPE_NULL
+            || mInfo.dataType == IEC61937_DATA_TYPE_PAUSE) {
+        // Skip the payload, which is in bits.
+        mDropPayload = true;
+        mPayloadBytes = (pd + 7) >> 3;
+        mPayloadWordsRemaining = (mPayloadBytes + 1) >> 1;
+        mState = STATE_PAYLOAD;
+        return true;
+    }
+
+    const DataType *type = NULL;
+    for (const DataType &candidate : kDataTypes) {
+        if (candidate.dataType == mInfo.dataType) {
+            type = &candidate;
+            break;
+        }
+    }
+    if (type == NULL) {
+        ALOGW("SPDIFDecoder: unknown data type %d", mInfo.dataType);
+        mDroppedBurstCount++;
+        return false;
+    }
+    uint32_t period = type->period;
+    if (type->dataType == IEC61937_DATA_TYPE_DTS_IV) {
+        if (mInfo.dataTypeInfo > IEC61937_DTS_IV_MAX_SUBTYPE) {
+            ALOGW("SPDIFDecoder: invalid DTS type IV subtype %d", mInfo.dataTypeInfo);
+            mDroppedBurstCount++;
+            return false;
+        }
+        period <<= mInfo.dataTypeInfo;
+    }
+    mPayloadBytes = type->lengthInBytes ? pd : (pd + 7) >> 3;
+    if (mPayloadBytes > period * 2 * sizeof(uint16_t) - kPreambleSize) {
+        ALOGW("SPDIFDecoder: data type %d, length %zu bytes does not fit in %u frames",
+                mInfo.dataType, mPayloadBytes, period);
+        mDroppedBurstCount++;
+        return false;
+    }
+    mInfo.burstFrames = period * 2 / mChannelCount;
+
+    // Skip the payload of a burst with errors, rather than searching it for Pa and Pb.
+    mDropPayload = (pc & IEC61937_PC_ERROR_FLAG) != 0;
+    if (mDropPayload) {
+        ALOGV("SPDIFDecoder: burst error flag set");
+        mDroppedBurstCount++;
+    }
+    mPayloadWordsRemaining = (mPayloadBytes + 1) >> 1;
+    mState = STATE_PAYLOAD;
+    return true;
+}
+
+// Read up to numWords words of payload.
+// @return number of bytes written by writeOutput(), or negative error
+ssize_t SPDIFDecoder::readPayload(uint16_t *words, size_t numWords, size_t *wordsRead)
+{
+    const size_t n = numWords < mPayloadWordsRemaining ? numWords : mPayloadWordsRemaining;
+    *wordsRead = n;
+    mPayloadWordsRemaining -= n;
+    if (mPayloadWordsRemaining == 0) {
+        mState = STATE_SCANNING;
+    }
+    if (mDropPayload) {
+        return 0;
+    }
+
+    // The payload is stored most significant byte first in each word.
+    uint8_t *bytes = (uint8_t *) words;
+    if (mPayloadBufferBytes == 0 && mPayloadWordsRemaining == 0) {
+        // The whole payload is within this buffer, so pass it on in place.
+        if (kLittleEndian) {
+            swapBytePairs(bytes, bytes, n);
+        }
+        mBurstCount++;
+        return writeOutput(bytes, mPayloadBytes, mInfo);
+    }
+
+    if (kLittleEndian) {
+        swapBytePairs(&mPayloadBuffer[mPayloadBufferBytes], bytes, n);
+    } else {
+        memcpy(&mPayloadBuffer[mPayloadBufferBytes], bytes, n * sizeof(uint16_t));
+    }
+    mPayloadBufferBytes += n * sizeof(uint16_t);
+    if (mPayloadWordsRemaining > 0) {
+        return 0;
+    }
+    mBurstCount++;
+    return writeOutput(mPayloadBuffer, mPayloadBytes, mInfo);
+}
+
+ssize_t SPDIFDecoder::write(void *buffer, size_t numBytes)
+{
+    if (numBytes % getBytesPerInputFrame() != 0) {
+        ALOGE("SPDIFDecoder: %zu bytes is not a whole number of frames", numBytes);
+        return -EINVAL;
+    }
+    uint16_t *words = (uint16_t *) buffer;
+    const size_t numWords = numBytes / sizeof(uint16_t);
+    ssize_t result = numBytes;
+    size_t i = 0;
+    while (i < numWords) {
+        switch (mState) {
+        case STATE_SCANNING:
+            i = findSync(words, i, numWords);
+            if (i < numWords) {
+                mInfo.position = (mWordPosition + i) / mChannelCount;
+                mPreamble[0] = words[i++];
+                mPreamble[1] = words[i++];
+                mPreambleWords = 2;
+                mState = STATE_PREAMBLE;
+            }
+            break;
+        case STATE_PREAMBLE:
+            mPreamble[mPreambleWords++] = words[i++];
+            // An invalid burst continues the search after Pd. A burst with an empty payload
+            // is complete, so pass it on now, even if Pd is the last word of the buffer.
+            if (mPreambleWords == 4 && startBurst() && mPayloadWordsRemaining == 0) {
+                size_t wordsRead;
+                const ssize_t written = readPayload(&words[i], 0, &wordsRead);
+                if (written < 0 && result >= 0) {
+                    result = written;
+                }
+            }
+            break;
+        case STATE_PAYLOAD: {
+            size_t wordsRead;
+            const ssize_t written = readPayload(&words[i], numWords - i, &wordsRead);
+            i += wordsRead;
+            if (written < 0 && result >= 0) {
+                result = written;
+            }
+            } break;
+        }
+    }
+    mWordPosition += numWords;
+    return result;
+}
+
+}  // namespace android
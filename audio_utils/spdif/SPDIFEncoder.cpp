@@ -21,8 +21,13 @@
 #include <utils/Log.h>
 #include <audio_utils/spdif/SPDIFEncoder.h>
 
+#include "AACFrameScanner.h"
 #include "AC3FrameScanner.h"
 #include "DTSFrameScanner.h"
+#include "DTSHDFrameScanner.h"
+#include "MPEGFrameScanner.h"
+#include "SwapBytePairs.h"
+#include "TrueHDFrameScanner.h"
 
 namespace android {
 
@@ -30,6 +35,9 @@ namespace android {
 const unsigned short SPDIFEncoder::kSPDIFSync1 = 0xF872; // Pa
 const unsigned short SPDIFEncoder::kSPDIFSync2 = 0x4E1F; // Pb
 
+// Size of the burst preamble Pa, Pb, Pc and Pd
+static const size_t kPreambleSize = 4 * sizeof(uint16_t);
+
 static int32_t sEndianDetector = 1;
 #define isLittleEndian()  (*((uint8_t *)&sEndianDetector))
 
@@ -45,15 +53,27 @@ SPDIFEncoder::SPDIFEncoder(audio_format_t format)
   , mPayloadBytesPending(0)
   , mScanning(true)
 {
-    switch(format) {
+    switch(audio_get_main_format(format)) {
         case AUDIO_FORMAT_AC3:
         case AUDIO_FORMAT_E_AC3:
             mFramer = new AC3FrameScanner();
             break;
         case AUDIO_FORMAT_DTS:
-        case AUDIO_FORMAT_DTS_HD:
             mFramer = new DTSFrameScanner();
             break;
+        case AUDIO_FORMAT_DTS_HD:
+            mFramer = new DTSHDFrameScanner();
+            break;
+        case AUDIO_FORMAT_AAC_ADTS:
+            mFramer = new AACFrameScanner();
+            break;
+        case AUDIO_FORMAT_MP2:
+        case AUDIO_FORMAT_MP3:
+            mFramer = new MPEGFrameScanner();
+            break;
+        case AUDIO_FORMAT_DOLBY_TRUEHD:
+            mFramer = new TrueHDFrameScanner();
+            break;
         default:
             break;
     }
@@ -63,13 +83,13 @@ SPDIFEncoder::SPDIFEncoder(audio_format_t format)
         "SPDIFEncoder: invalid audio format = 0x%08X", format);
 
     mBurstBufferSizeBytes = sizeof(uint16_t)
-            * SPDIF_ENCODED_CHANNEL_COUNT
+            * mFramer->getOutputChannelCount()
             * mFramer->getMaxSampleFramesPerSyncFrame();
 
     ALOGI("SPDIFEncoder: mBurstBufferSizeBytes = %zu, littleEndian = %d",
             mBurstBufferSizeBytes, isLittleEndian());
     mBurstBuffer = new uint16_t[mBurstBufferSizeBytes >> 1];
-    clearBurstBuffer();
+    memset(mBurstBuffer, 0, mBurstBufferSizeBytes);
 }
 
 SPDIFEncoder::SPDIFEncoder()
@@ -85,11 +105,15 @@ SPDIFEncoder::~SPDIFEncoder()
 
 bool SPDIFEncoder::isFormatSupported(audio_format_t format)
 {
-    switch(format) {
+    switch(audio_get_main_format(format)) {
         case AUDIO_FORMAT_AC3:
         case AUDIO_FORMAT_E_AC3:
         case AUDIO_FORMAT_DTS:
         case AUDIO_FORMAT_DTS_HD:
+        case AUDIO_FORMAT_AAC_ADTS:
+        case AUDIO_FORMAT_MP2:
+        case AUDIO_FORMAT_MP3:
+        case AUDIO_FORMAT_DOLBY_TRUEHD:
             return true;
         default:
             return false;
@@ -98,7 +122,12 @@ bool SPDIFEncoder::isFormatSupported(audio_format_t format)
 
 int SPDIFEncoder::getBytesPerOutputFrame()
 {
-    return SPDIF_ENCODED_CHANNEL_COUNT * sizeof(int16_t);
+    return getOutputChannelCount() * sizeof(int16_t);
+}
+
+int SPDIFEncoder::getOutputChannelCount() const
+{
+    return mFramer->getOutputChannelCount();
 }
 
 void SPDIFEncoder::writeBurstBufferShorts(const uint16_t *buffer, size_t numShorts)
@@ -124,28 +153,29 @@ void SPDIFEncoder::writeBurstBufferShorts(const uint16_t *buffer, size_t numShor
 //   etcetera
 // This way they should come out in the correct order for SPDIF on both
 // Big and Little Endian CPUs.
+// Stream byte n is stored at byte n of the buffer on Big Endian CPUs,
+// and at byte n ^ 1 on Little Endian CPUs, which swap whole pairs in bulk.
 void SPDIFEncoder::writeBurstBufferBytes(const uint8_t *buffer, size_t numBytes)
 {
-    size_t bytesToWrite = numBytes;
-    if ((mByteCursor + bytesToWrite) > mBurstBufferSizeBytes) {
+    if ((mByteCursor + numBytes) > mBurstBufferSizeBytes) {
         ALOGE("SPDIFEncoder: Burst buffer overflow!");
         clearBurstBuffer();
         return;
     }
-    uint16_t pad = mBurstBuffer[mByteCursor >> 1];
-    for (size_t i = 0; i < bytesToWrite; i++) {
-        if (mByteCursor & 1 ) {
-            pad |= *buffer++; // put second byte in LSB
-            mBurstBuffer[mByteCursor >> 1] = pad;
-            pad = 0;
-        } else {
-            pad |= (*buffer++) << 8; // put first byte in MSB
-        }
-        mByteCursor++;
+    uint8_t *bytes = (uint8_t *) mBurstBuffer;
+    if (!isLittleEndian()) {
+        memcpy(&bytes[mByteCursor], buffer, numBytes);
+        mByteCursor += numBytes;
+        return;
     }
-    // Save partially filled short.
-    if (mByteCursor & 1 ){
-        mBurstBuffer[mByteCursor >> 1] = pad;
+    if ((mByteCursor & 1) && numBytes > 0) {
+        bytes[mByteCursor++ ^ 1] = *buffer++; // put second byte in LSB
+        numBytes--;
+    }
+    swapBytePairs(&bytes[mByteCursor], buffer, numBytes >> 1);
+    mByteCursor += numBytes & ~1;
+    if (numBytes & 1) {
+        bytes[mByteCursor++ ^ 1] = buffer[numBytes - 1]; // put first byte in MSB
     }
 }
 
@@ -153,7 +183,7 @@ void SPDIFEncoder::sendZeroPad()
 {
     // Pad remainder of burst with zeros.
     size_t burstSize = mFramer->getSampleFramesPerSyncFrame() * sizeof(uint16_t)
-            * SPDIF_ENCODED_CHANNEL_COUNT;
+            * getOutputChannelCount();
     if (mByteCursor > burstSize) {
         ALOGE("SPDIFEncoder: Burst buffer, contents too large!");
         clearBurstBuffer();
@@ -176,24 +206,69 @@ void SPDIFEncoder::reset()
     mScanning = true;
 }
 
+ssize_t SPDIFEncoder::writeOutputVector(const struct iovec *iov, int iovcnt)
+{
+    ssize_t totalBytes = 0;
+    int i = 0;
+    while (i < iovcnt) {
+        const uint8_t *base = (const uint8_t *) iov[i].iov_base;
+        size_t numBytes = iov[i++].iov_len;
+        while (i < iovcnt && iov[i].iov_base == base + numBytes) {
+            numBytes += iov[i++].iov_len;
+        }
+        if (numBytes > 0) {
+            ssize_t result = writeOutput(base, numBytes);
+            if (result < 0) {
+                return result;
+            }
+            totalBytes += result;
+        }
+    }
+    return totalBytes;
+}
+
 void SPDIFEncoder::flushBurstBuffer()
 {
-    const int preambleSize = 4 * sizeof(uint16_t);
-    if (mByteCursor > preambleSize) {
+    if (mByteCursor > kPreambleSize) {
+        // Let the framer add trailing codes.
+        size_t payloadBytes = mFramer->finishBurst(&mBurstBuffer[kPreambleSize >> 1],
+                mByteCursor - kPreambleSize);
+        mByteCursor = kPreambleSize + payloadBytes;
+
         // Set lengthCode for valid payload before zeroPad.
-        uint16_t numBytes = (mByteCursor - preambleSize);
+        uint16_t numBytes = payloadBytes;
         mBurstBuffer[3] = mFramer->convertBytesToLengthCode(numBytes);
 
-        sendZeroPad();
-        writeOutput(mBurstBuffer, mByteCursor);
+        size_t burstSize = mFramer->getSampleFramesPerSyncFrame() * sizeof(uint16_t)
+                * getOutputChannelCount();
+        if (mByteCursor > burstSize || burstSize > mBurstBufferSizeBytes) {
+            ALOGE("SPDIFEncoder: Burst buffer, contents too large!");
+        } else {
+            // The rest of the burst buffer is still zero, because clearBurstBuffer()
+            // only clears the bytes that were written, so the padding is never filled in.
+            size_t frameSize = getBytesPerOutputFrame();
+            size_t payloadEnd = (mByteCursor + frameSize - 1) / frameSize * frameSize;
+            uint8_t *bytes = (uint8_t *) mBurstBuffer;
+            struct iovec iov[3];
+            iov[0].iov_base = bytes;
+            iov[0].iov_len = kPreambleSize;
+            iov[1].iov_base = &bytes[kPreambleSize];
+            iov[1].iov_len = payloadEnd - kPreambleSize;
+            iov[2].iov_base = &bytes[payloadEnd];
+            iov[2].iov_len = burstSize - payloadEnd;
+            writeOutputVector(iov, 3);
+        }
     }
     reset();
 }
 
+// Only clear the bytes written since the last clear; the rest are still zero.
 void SPDIFEncoder::clearBurstBuffer()
 {
     if (mBurstBuffer) {
-        memset(mBurstBuffer, 0, mBurstBufferSizeBytes);
+        size_t numBytes = (mByteCursor + 1) & ~1;
+        memset(mBurstBuffer, 0,
+                numBytes < mBurstBufferSizeBytes ? numBytes : mBurstBufferSizeBytes);
     }
     mByteCursor = 0;
 }
@@ -216,6 +291,21 @@ void SPDIFEncoder::startDataBurst()
     writeBurstBufferShorts(preamble, 4);
 }
 
+// Let the framer place the frame in the burst and write codes before it.
+// @return false if it does not fit in the burst buffer
+bool SPDIFEncoder::startFrameInBurst()
+{
+    size_t frameOffset = mFramer->startFrameInBurst(&mBurstBuffer[kPreambleSize >> 1],
+            mByteCursor - kPreambleSize);
+    if ((kPreambleSize + frameOffset) > mBurstBufferSizeBytes) {
+        ALOGE("SPDIFEncoder: Burst buffer overflow!");
+        reset();
+        return false;
+    }
+    mByteCursor = kPreambleSize + frameOffset;
+    return true;
+}
+
 size_t SPDIFEncoder::startSyncFrame()
 {
     // Write start of encoded frame that was buffered in frame detector.
@@ -233,8 +323,12 @@ ssize_t SPDIFEncoder::write( const void *buffer, size_t numBytes )
         mScanning, (uint) *data, numBytes);
     while (bytesLeft > 0) {
         if (mScanning) {
-        // Look for beginning of next encoded frame.
-            if (mFramer->scan(*data)) {
+            // Look for beginning of next encoded frame.
+            bool found;
+            size_t bytesScanned = mFramer->scanBytes(data, bytesLeft, &found);
+            data += bytesScanned;
+            bytesLeft -= bytesScanned;
+            if (found) {
                 if (mByteCursor == 0) {
                     startDataBurst();
                 } else if (mFramer->isFirstInBurst()) {
@@ -242,11 +336,12 @@ ssize_t SPDIFEncoder::write( const void *buffer, size_t numBytes )
                     flushBurstBuffer();
                     startDataBurst();
                 }
+                if (!startFrameInBurst()) {
+                    continue;
+                }
                 mPayloadBytesPending = startSyncFrame();
                 mScanning = false;
             }
-            data++;
-            bytesLeft--;
         } else {
             // Write payload until we hit end of frame.
             size_t bytesToWrite = bytesLeft;
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SWAP_BYTE_PAIRS_H
+#define ANDROID_AUDIO_SWAP_BYTE_PAIRS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../private/simd.h"
+
+namespace android {
+
+// Copy pairs of bytes to pairs of bytes in the opposite order.
+// The source and destination may be the same, but must not otherwise overlap.
+static inline void swapBytePairs(uint8_t *dst, const uint8_t *src, size_t numPairs)
+{
+#ifdef AUDIO_UTILS_SIMD
+    for (; numPairs >= 8; numPairs -= 8) {
+        audio_v16u8 v;
+        AUDIO_SIMD_LOAD(v, src);
+        v = AUDIO_SIMD_SHUFFLE(v, v, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        AUDIO_SIMD_STORE(dst, v);
+        src += 16;
+        dst += 16;
+    }
+#endif
+    for (; numPairs > 0; numPairs--) {
+        const uint8_t first = src[0];
+        dst[0] = src[1];
+        dst[1] = first;
+        src += 2;
+        dst += 2;
+    }
+}
+
+}  // namespace android
+
+#endif  // ANDROID_AUDIO_SWAP_BYTE_PAIRS_H
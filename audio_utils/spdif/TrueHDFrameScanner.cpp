@@ -0,0 +1,236 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioSPDIF"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+
+#include <utils/Log.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+#include "TrueHDFrameScanner.h"
+
+namespace android {
+
+// These values are from IEC 61937-9 and the MLP spec. Do not change them.
+
+const uint8_t TrueHDFrameScanner::kSyncBytes[] = { 0xF8, 0x72, 0x6F, 0xBA };
+
+const uint8_t TrueHDFrameScanner::kMATStartCode[] = {
+    0x07, 0x9E, 0x00, 0x03, 0x84, 0x01, 0x01, 0x01, 0x80, 0x00,
+    0x56, 0xA5, 0x3B, 0xF4, 0x81, 0x83, 0x49, 0x80, 0x77, 0xE0
+};
+
+const uint8_t TrueHDFrameScanner::kMATMiddleCode[] = {
+    0xC3, 0xC1, 0x42, 0x49, 0x3B, 0xFA, 0x82, 0x83, 0x49, 0x80, 0x77, 0xE0
+};
+
+const uint8_t TrueHDFrameScanner::kMATEndCode[] = {
+    0xC3, 0xC2, 0xC0, 0xC4, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x97, 0x11, 0x00, 0x00, 0x00, 0x00
+};
+
+// Defined in IEC61937-2
+#define IEC61937_DATA_TYPE_TRUEHD            22
+
+// Size of the burst preamble Pa, Pb, Pc and Pd
+#define IEC61937_PREAMBLE_BYTES               8
+
+// Layout of the MAT frame in the payload of a data burst. Access unit n nominally starts
+// at n * MAT_FRAME_SPACING bytes from the start of the burst, except that the first one
+// follows the start code and the middle one follows the middle code.
+#define MAT_FRAME_SIZE                    61424
+#define MAT_FRAME_SPACING                  2560
+#define MAT_MIDDLE_FRAME                     12
+#define MAT_MIDDLE_CODE_OFFSET            30708
+#define MAT_END_CODE_OFFSET     (MAT_FRAME_SIZE - sizeof(kMATEndCode))
+
+// The access unit header, MLP spec paragraph 4.2
+#define TRUEHD_AU_HEADER_BYTES                4
+// The access unit header, the major sync and the sampling frequency
+#define TRUEHD_MAJOR_SYNC_HEADER_BYTES        9
+
+// Scanner for TrueHD byte streams.
+TrueHDFrameScanner::TrueHDFrameScanner()
+ : FrameScanner(IEC61937_DATA_TYPE_TRUEHD,
+    TrueHDFrameScanner::kSyncBytes,
+    sizeof(TrueHDFrameScanner::kSyncBytes),
+    TRUEHD_MAJOR_SYNC_HEADER_BYTES)
+ , mSynced(false)
+ , mFramesInBurst(0)
+{
+    mRateMultiplier = TRUEHD_RATE_MULTIPLIER;
+}
+
+TrueHDFrameScanner::~TrueHDFrameScanner()
+{
+}
+
+// Gather the header of the next access unit, or look for a major sync if not synchronized.
+// @return true if we have detected a complete and valid header.
+bool TrueHDFrameScanner::scan(uint8_t byte)
+{
+    mPosition++;
+    if (mSynced) {
+        mHeaderBuffer[mCursor++] = byte;
+        if (mCursor < TRUEHD_AU_HEADER_BYTES) {
+            return false;
+        }
+        mHeaderLength = TRUEHD_AU_HEADER_BYTES;
+    } else {
+        // Slide a window over the stream until it holds an access unit header
+        // followed by a major sync.
+        if (mCursor == TRUEHD_MAJOR_SYNC_HEADER_BYTES) {
+            memmove(mHeaderBuffer, &mHeaderBuffer[1], --mCursor);
+            mBytesSkipped += 1;
+        }
+        mHeaderBuffer[mCursor++] = byte;
+        if (mCursor < TRUEHD_MAJOR_SYNC_HEADER_BYTES || memcmp(
+                &mHeaderBuffer[TRUEHD_AU_HEADER_BYTES], kSyncBytes, sizeof(kSyncBytes)) != 0) {
+            return false;
+        }
+        mHeaderLength = TRUEHD_MAJOR_SYNC_HEADER_BYTES;
+    }
+    mCursor = 0;
+    if (parseHeader()) {
+        return true;
+    }
+    ALOGE("TrueHDFrameScanner: ERROR - parseHeader() failed.");
+    mBytesSkipped += mHeaderLength;
+    mSynced = false;
+    return false;
+}
+
+// While synchronized, pass the access unit header to scan(). Otherwise search for the first
+// byte of the major sync with memchr(), and skip to the access unit header before it, since
+// scan() would only slide the bytes before that through its window.
+size_t TrueHDFrameScanner::scanBytes(const uint8_t *data, size_t numBytes, bool *found)
+{
+    *found = false;
+    size_t i = 0;
+    // The window from a previous buffer holds no major sync after its next 4 bytes.
+    if (!mSynced && mCursor > 0) {
+        while (i < numBytes && i < TRUEHD_AU_HEADER_BYTES) {
+            if (scan(data[i++])) {
+                *found = true;
+                return i;
+            }
+        }
+    }
+    size_t from = 0;        // where to search for the next candidate major sync
+    while (i < numBytes) {
+        if (mSynced) {
+            if (scan(data[i++])) {
+                *found = true;
+                return i;
+            }
+            from = i;
+            continue;
+        }
+        const uint8_t *sync = (const uint8_t *) memchr(&data[from], kSyncBytes[0],
+                numBytes - from);
+        const size_t candidate = sync != NULL ? sync - data : numBytes;
+        if (candidate > i + TRUEHD_AU_HEADER_BYTES) {
+            const size_t skipped = candidate - TRUEHD_AU_HEADER_BYTES - i;
+            mBytesSkipped += mCursor + skipped;
+            mPosition += skipped;
+            mCursor = 0;
+            i += skipped;
+        }
+        // The window holds the candidate as the major sync once the byte after it is passed.
+        const size_t end = candidate + TRUEHD_AU_HEADER_BYTES + 1 < numBytes ?
+                candidate + TRUEHD_AU_HEADER_BYTES + 1 : numBytes;
+        while (i < end) {
+            if (scan(data[i++])) {
+                *found = true;
+                return i;
+            }
+        }
+        from = candidate < numBytes ? candidate + 1 : numBytes;
+    }
+    return numBytes;
+}
+
+size_t TrueHDFrameScanner::startFrameInBurst(uint16_t *payload, size_t payloadBytes)
+{
+    size_t frameOffset;
+    if (mFramesInBurst == 0) {
+        writePayloadBytes(payload, 0, kMATStartCode, sizeof(kMATStartCode));
+        frameOffset = sizeof(kMATStartCode);
+    } else if (mFramesInBurst == MAT_MIDDLE_FRAME) {
+        writePayloadBytes(payload, MAT_MIDDLE_CODE_OFFSET, kMATMiddleCode,
+                sizeof(kMATMiddleCode));
+        frameOffset = MAT_MIDDLE_CODE_OFFSET + sizeof(kMATMiddleCode);
+    } else {
+        frameOffset = mFramesInBurst * MAT_FRAME_SPACING - IEC61937_PREAMBLE_BYTES;
+    }
+    mFramesInBurst++;
+    if (payloadBytes > frameOffset) {
+        ALOGW("TrueHDFrameScanner: access unit %d is late by %zu bytes",
+                mFramesInBurst - 1, payloadBytes - frameOffset);
+        frameOffset = payloadBytes;
+    }
+    return frameOffset;
+}
+
+size_t TrueHDFrameScanner::finishBurst(uint16_t *payload, size_t payloadBytes)
+{
+    if (payloadBytes > MAT_END_CODE_OFFSET) {
+        ALOGW("TrueHDFrameScanner: MAT frame overflow by %zu bytes",
+                payloadBytes - MAT_END_CODE_OFFSET);
+    }
+    writePayloadBytes(payload, MAT_END_CODE_OFFSET, kMATEndCode, sizeof(kMATEndCode));
+    return payloadBytes > MAT_FRAME_SIZE ? payloadBytes : MAT_FRAME_SIZE;
+}
+
+// Parse the access unit header, and the major sync if present.
+// Sets mFrameSizeBytes, and mSampleRate from a major sync.
+//
+// @return true if valid
+bool TrueHDFrameScanner::parseHeader()
+{
+    // access_unit_length is in 16 bit words
+    size_t frameSizeBytes = (((mHeaderBuffer[0] & 0x0F) << 8) | mHeaderBuffer[1]) * 2;
+    if (frameSizeBytes < mHeaderLength || frameSizeBytes > MAT_FRAME_SPACING) {
+        ALOGE("TrueHDFrameScanner: ERROR - access_unit_length = %zu", frameSizeBytes >> 1);
+        return false;
+    }
+    if (mHeaderLength == TRUEHD_MAJOR_SYNC_HEADER_BYTES) {
+        // audio_sampling_frequency, in the first 4 bits of format_info
+        uint32_t samplingFrequency = mHeaderBuffer[TRUEHD_MAJOR_SYNC_HEADER_BYTES - 1] >> 4;
+        switch (samplingFrequency) {
+        case 0: case 1: case 2:     // 48, 96 and 192 kHz
+            mSampleRate = 48000;
+            break;
+        case 8: case 9: case 10:    // 44.1, 88.2 and 176.4 kHz
+            mSampleRate = 44100;
+            break;
+        default:
+            ALOGE("TrueHDFrameScanner: ERROR - audio_sampling_frequency = %u",
+                    samplingFrequency);
+            return false;
+        }
+        ALOGI_IF((mFormatDumpCount == 0), "TrueHD frame rate = %d * %d",
+                mSampleRate, mRateMultiplier);
+        mFormatDumpCount++;
+        mSynced = true;
+    }
+    mFrameSizeBytes = frameSizeBytes;
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2016, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_TRUEHD_FRAME_SCANNER_H
+#define ANDROID_AUDIO_TRUEHD_FRAME_SCANNER_H
+
+#include <stdint.h>
+#include <audio_utils/spdif/FrameScanner.h>
+
+namespace android {
+
+#define TRUEHD_RATE_MULTIPLIER                   4
+#define MAT_TRUEHD_FRAMES_PER_MAT_FRAME         24
+#define MAT_PCM_FRAMES_PER_MAT_FRAME          3840
+
+/**
+ * Scanner for Dolby TrueHD streams, per IEC 61937-9.
+ * 24 access units are sent in each data burst, at fixed positions in a MAT frame
+ * between its start, middle and end codes, in the 8 channel high bitrate (HBR) layout
+ * at four times the base sample rate of 48000 or 44100 Hz.
+ *
+ * Only some access units have a major sync, so the scanner synchronizes on one
+ * and then finds each following access unit from the length of the one before.
+ */
+class TrueHDFrameScanner : public FrameScanner
+{
+public:
+    TrueHDFrameScanner();
+    virtual ~TrueHDFrameScanner();
+
+    virtual bool scan(uint8_t byte);
+    virtual size_t scanBytes(const uint8_t *data, size_t numBytes, bool *found);
+
+    virtual int getMaxChannels()   const { return 7 + 1; }
+
+    virtual int getMaxSampleFramesPerSyncFrame() const { return MAT_PCM_FRAMES_PER_MAT_FRAME; }
+    virtual int getSampleFramesPerSyncFrame() const { return MAT_PCM_FRAMES_PER_MAT_FRAME; }
+
+    virtual bool isFirstInBurst() { return false; }
+    virtual bool isLastInBurst() { return mFramesInBurst >= MAT_TRUEHD_FRAMES_PER_MAT_FRAME; }
+    virtual void resetBurst() { mFramesInBurst = 0; }
+
+    // Per IEC 61937-9, the burst-length of TrueHD is in bytes.
+    virtual uint16_t convertBytesToLengthCode(uint16_t numBytes) const { return numBytes; }
+    virtual int getOutputChannelCount() const { return 8; }
+    virtual size_t startFrameInBurst(uint16_t *payload, size_t payloadBytes);
+    virtual size_t finishBurst(uint16_t *payload, size_t payloadBytes);
+
+protected:
+
+    bool mSynced;         // true if the next access unit follows the last one parsed
+    int  mFramesInBurst;  // number of access units started in the current burst
+
+    virtual bool parseHeader();
+
+    // major sync of TrueHD, after the access unit header
+    static const uint8_t kSyncBytes[];
+    // codes of the MAT frame
+    static const uint8_t kMATStartCode[];
+    static const uint8_t kMATMiddleCode[];
+    static const uint8_t kMATEndCode[];
+};
+
+}  // namespace android
+
+#endif  // ANDROID_AUDIO_TRUEHD_FRAME_SCANNER_H
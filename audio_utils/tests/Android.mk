@@ -31,6 +31,157 @@ LOCAL_MODULE_TAGS := tests
 LOCAL_CFLAGS := -Werror -Wall
 include $(BUILD_HOST_NATIVE_TEST)
 
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils \
+	libaudioutils
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	fft_tests.cpp
+LOCAL_MODULE := fft_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils
+LOCAL_STATIC_LIBRARIES := \
+	libaudioutils
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	fft_tests.cpp
+LOCAL_MODULE := fft_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils \
+	libaudioutils
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	fixedfft_tests.cpp
+LOCAL_MODULE := fixedfft_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils
+LOCAL_STATIC_LIBRARIES := \
+	libaudioutils
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	fixedfft_tests.cpp
+LOCAL_MODULE := fixedfft_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils \
+	libaudioutils
+LOCAL_STATIC_LIBRARIES := \
+	libsndfile
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	sndfile_tests.cpp
+LOCAL_MODULE := sndfile_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils
+LOCAL_STATIC_LIBRARIES := \
+	libsndfile \
+	libaudioutils
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	sndfile_tests.cpp
+LOCAL_MODULE := sndfile_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_HOST_NATIVE_TEST)
+
+# tinysndfile with a small RIFF size limit, to test the switch to RF64
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils \
+	libaudioutils
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	sndfile_rf64_tests.cpp \
+	../tinysndfile.c
+LOCAL_MODULE := sndfile_rf64_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall -DRIFF_SIZE_MAX=65536
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils
+LOCAL_STATIC_LIBRARIES := \
+	libaudioutils
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	sndfile_rf64_tests.cpp \
+	../tinysndfile.c
+LOCAL_MODULE := sndfile_rf64_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall -DRIFF_SIZE_MAX=65536
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils \
+	libaudiospdif
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	spdif_tests.cpp
+LOCAL_MODULE := spdif_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+LOCAL_SHARED_LIBRARIES := \
+	liblog \
+	libcutils
+LOCAL_STATIC_LIBRARIES := \
+	libaudiospdif
+LOCAL_C_INCLUDES := \
+	$(call include-path-for, audio-utils)
+LOCAL_SRC_FILES := \
+	spdif_tests.cpp
+LOCAL_MODULE := spdif_tests
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_HOST_NATIVE_TEST)
+
 include $(CLEAR_VARS)
 LOCAL_SRC_FILES := fifo_tests.cpp
 LOCAL_MODULE := fifo_tests
@@ -57,3 +208,43 @@ LOCAL_C_INCLUDES := $(call include-path-for, audio-utils)
 LOCAL_STATIC_LIBRARIES := libaudioutils
 LOCAL_CFLAGS := -Werror -Wall
 include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := mono_blend_benchmark.cpp
+LOCAL_MODULE := mono_blend_benchmark
+LOCAL_C_INCLUDES := $(call include-path-for, audio-utils)
+LOCAL_SHARED_LIBRARIES := libaudioutils
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := mono_blend_benchmark.cpp
+LOCAL_MODULE := mono_blend_benchmark
+LOCAL_C_INCLUDES := $(call include-path-for, audio-utils)
+LOCAL_STATIC_LIBRARIES := libaudioutils liblog
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := spdif_benchmark.cpp
+LOCAL_MODULE := spdif_benchmark
+LOCAL_C_INCLUDES := $(call include-path-for, audio-utils)
+LOCAL_SHARED_LIBRARIES := libaudiospdif
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := spdif_benchmark.cpp
+LOCAL_MODULE := spdif_benchmark
+LOCAL_C_INCLUDES := $(call include-path-for, audio-utils)
+LOCAL_STATIC_LIBRARIES := libaudiospdif liblog
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := spdif_fuzzer.cpp
+LOCAL_MODULE := spdif_fuzzer
+LOCAL_C_INCLUDES := $(call include-path-for, audio-utils)
+LOCAL_STATIC_LIBRARIES := libaudiospdif liblog
+LOCAL_CFLAGS := -Werror -Wall
+include $(BUILD_FUZZ_TEST)
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fft_tests"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <complex>
+#include <vector>
+#include <gtest/gtest.h>
+#include <audio_utils/fft.h>
+
+static std::vector<float> makeSignal(size_t n)
+{
+    std::vector<float> x(n);
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = 0.5 * sin(2 * M_PI * 5.3 * i / n) + 0.2 * ((float) rand() / RAND_MAX - 0.5);
+    }
+    return x;
+}
+
+TEST(audio_utils_fft, real_forward_inverse)
+{
+    for (size_t n = 2; n <= 4096; n <<= 1) {
+        struct audio_utils_fft_plan *plan;
+        ASSERT_EQ(0, audio_utils_fft_plan_create(n, &plan));
+        const std::vector<float> x = makeSignal(n);
+        std::vector<float> spectrum(n);
+        audio_utils_fft_real_forward(plan, spectrum.data(), x.data());
+
+        // compare to a double precision DFT; errors grow with log(n)
+        const double tolerance = 1e-6 * n;
+        for (size_t k = 0; k <= n / 2; ++k) {
+            std::complex<double> sum = 0;
+            for (size_t i = 0; i < n; ++i) {
+                sum += (double) x[i] * std::polar(1., -2 * M_PI * i * k / n);
+            }
+            if (k == 0) {
+                EXPECT_NEAR(sum.real(), spectrum[0], tolerance) << "n " << n;
+            } else if (k == n / 2) {
+                EXPECT_NEAR(sum.real(), spectrum[1], tolerance) << "n " << n;
+            } else {
+                EXPECT_NEAR(sum.real(), spectrum[2 * k], tolerance) << "n " << n << " bin " << k;
+                EXPECT_NEAR(sum.imag(), spectrum[2 * k + 1], tolerance)
+                        << "n " << n << " bin " << k;
+            }
+        }
+
+        // the inverse in place restores the input
+        audio_utils_fft_real_inverse(plan, spectrum.data(), spectrum.data());
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_NEAR(x[i], spectrum[i], 1e-6 * log2(n) + 1e-6) << "n " << n << " i " << i;
+        }
+        audio_utils_fft_plan_release(plan);
+    }
+
+    struct audio_utils_fft_plan *plan;
+    EXPECT_EQ(-EINVAL, audio_utils_fft_plan_create(1, &plan));
+    EXPECT_EQ(-EINVAL, audio_utils_fft_plan_create(96, &plan));
+}
+
+static void countFrames(void *cookie, float * /* spectrum */, size_t /* fft_size */)
+{
+    ++*(size_t *) cookie;
+}
+
+TEST(audio_utils_fft, stft_identity)
+{
+    static const size_t kFftSize = 256;
+    static const size_t kSamples = 10000;
+    const audio_utils_stft_window_t windows[] = {
+        AUDIO_UTILS_STFT_WINDOW_HANN, AUDIO_UTILS_STFT_WINDOW_RECTANGULAR
+    };
+
+    for (audio_utils_stft_window_t window : windows) {
+        for (size_t hop = kFftSize / 8; hop <= kFftSize / 2; hop <<= 1) {
+            size_t frames = 0;
+            struct audio_utils_stft *stft;
+            ASSERT_EQ(0, audio_utils_stft_create(kFftSize, hop, window, countFrames, &frames,
+                    &stft));
+            const size_t latency = audio_utils_stft_latency(stft);
+            const std::vector<float> x = makeSignal(kSamples);
+
+            // process in place, in pieces of varying size, without modifying the spectrum
+            std::vector<float> y(x);
+            for (size_t i = 0, count = 1; i < kSamples; i += count, count = count * 3 % 113) {
+                count = std::min(count, kSamples - i);
+                audio_utils_stft_process(stft, y.data() + i, y.data() + i, count);
+            }
+            EXPECT_EQ(kSamples / hop, frames);
+            for (size_t i = 0; i < kSamples; ++i) {
+                const float expected = i < latency ? 0.0f : x[i - latency];
+                EXPECT_NEAR(expected, y[i], 1e-5) << "window " << window << " hop " << hop
+                        << " i " << i;
+            }
+            audio_utils_stft_release(stft);
+        }
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fixedfft_tests"
+
+#include <math.h>
+#include <algorithm>
+#include <complex>
+#include <vector>
+#include <gtest/gtest.h>
+#include <audio_utils/fixedfft.h>
+
+static const double kLsb = 1. / 32768;
+
+static inline int32_t pack(double re, double im)
+{
+    return (int32_t) (((uint32_t) lrint(re * 32768) << 16) | (lrint(im * 32768) & 0xFFFF));
+}
+
+static inline double real(int32_t v)
+{
+    return (v >> 16) * kLsb;
+}
+
+static inline double imag(int32_t v)
+{
+    return (int16_t) v * kLsb;
+}
+
+// A tone plus noise at about -6 dBFS, packed two samples per word as fixed_fft_real() expects.
+static std::vector<int32_t> makeSignal(int n)
+{
+    std::vector<int32_t> v(n);
+    uint32_t seed = 1;
+    for (int i = 0; i < n; ++i) {
+        double s[2];
+        for (int j = 0; j < 2; ++j) {
+            seed = seed * 1103515245 + 12345;
+            s[j] = 0.4 * sin(2 * M_PI * 13.3 * (2 * i + j) / (2 * n))
+                    + 0.1 * ((double) (seed >> 16) / 32768. - 1.);
+        }
+        v[i] = pack(s[0], s[1]);
+    }
+    return v;
+}
+
+// Returns the spectrum of 2 * n real samples packed in v, divided by 2 * n,
+// for bins 0 to n.
+static std::vector<std::complex<double> > referenceFft(const std::vector<int32_t> &v)
+{
+    const int n = v.size();
+    std::vector<std::complex<double> > bins(n + 1);
+    for (int k = 0; k <= n; ++k) {
+        std::complex<double> sum = 0;
+        for (int i = 0; i < 2 * n; ++i) {
+            const double x = i & 1 ? imag(v[i >> 1]) : real(v[i >> 1]);
+            sum += x * std::polar(1., -M_PI * i * k / n);
+        }
+        bins[k] = sum / (2. * n);
+    }
+    return bins;
+}
+
+TEST(audio_utils_fixedfft, forward)
+{
+    for (int n = 2; n <= FIXED_FFT_MAX_SIZE; n <<= 1) {
+        std::vector<int32_t> v = makeSignal(n);
+        const std::vector<std::complex<double> > bins = referenceFft(v);
+        fixed_fft_real(n, v.data());
+
+        EXPECT_NEAR(bins[0].real(), real(v[0]), 8 * kLsb) << "n " << n;
+        EXPECT_NEAR(bins[n].real(), imag(v[0]), 8 * kLsb) << "n " << n;
+        for (int k = 1; k < n; ++k) {
+            const std::complex<double> bin = k == n / 2 ? std::conj(bins[k]) : bins[k];
+            EXPECT_NEAR(bin.real(), real(v[k]), 8 * kLsb) << "n " << n << " bin " << k;
+            EXPECT_NEAR(bin.imag(), imag(v[k]), 8 * kLsb) << "n " << n << " bin " << k;
+        }
+    }
+}
+
+TEST(audio_utils_fixedfft, inverse)
+{
+    for (int n = 2; n <= FIXED_FFT_MAX_SIZE; n <<= 1) {
+        std::vector<int32_t> v = makeSignal(n);
+        fixed_fft_real(n, v.data());
+
+        // the exact inverse of the spectrum produced by fixed_fft_real()
+        std::vector<std::complex<double> > bins(2 * n);
+        bins[0] = real(v[0]);
+        bins[n] = imag(v[0]);
+        for (int k = 1; k < n; ++k) {
+            bins[k] = std::complex<double>(real(v[k]), k == n / 2 ? -imag(v[k]) : imag(v[k]));
+            bins[2 * n - k] = std::conj(bins[k]);
+        }
+        std::vector<double> expected(2 * n);
+        for (int i = 0; i < 2 * n; ++i) {
+            std::complex<double> sum = 0;
+            for (int k = 0; k < 2 * n; ++k) {
+                sum += bins[k] * std::polar(1., M_PI * i * k / n);
+            }
+            expected[i] = sum.real();
+        }
+
+        fixed_ifft_real(n, v.data());
+        double maxError = 0, sumSquaredError = 0;
+        for (int i = 0; i < 2 * n; ++i) {
+            const double actual = i & 1 ? imag(v[i >> 1]) : real(v[i >> 1]);
+            const double error = fabs(actual - expected[i]);
+            maxError = std::max(maxError, error);
+            sumSquaredError += error * error;
+        }
+        // rounding errors accumulate over the log2(n) stages
+        EXPECT_LT(sqrt(sumSquaredError / (2 * n)), (sqrt(n) + 2) * kLsb) << "n " << n;
+        EXPECT_LT(maxError, (8 * sqrt(n) + 4) * kLsb) << "n " << n;
+    }
+}
@@ -19,9 +19,74 @@
 #include <stdlib.h>
 #include <audio_utils/limiter.h>
 
+// Check that limiter_buffer() agrees with limiter(), and that the lookahead limiter
+// bounds its output and delays it by its latency.  Failures are reported on stderr.
+static int check()
+{
+    int errors = 0;
+    float in[301], out[301];
+    int i;
+    for (i = 0; i < 301; i++) {
+        in[i] = (float) ((double) (i - 150) * 0.01);
+    }
+    limiter_buffer(out, in, 301);
+    for (i = 0; i < 301; i++) {
+        if (fabsf(out[i] - limiter(in[i])) > 1e-6f) {
+            fprintf(stderr, "limiter_buffer(%g)=%g != %g\n", in[i], out[i], limiter(in[i]));
+            errors++;
+        }
+    }
+
+    static const uint32_t kChannelCount = 2;
+    static const size_t kFrames = 4800;
+    static const float kThreshold = 0.9f;
+    struct limiter_lookahead *l;
+    if (limiter_lookahead_create(kChannelCount, 48000, 1.0f, 50.0f, kThreshold, &l) != 0) {
+        fprintf(stderr, "limiter_lookahead_create failed\n");
+        return 1;
+    }
+    const size_t latency = limiter_lookahead_latency(l);
+    float *buf = (float *) malloc(kFrames * kChannelCount * sizeof(float));
+    float *orig = (float *) malloc(kFrames * kChannelCount * sizeof(float));
+    size_t j;
+    for (j = 0; j < kFrames * kChannelCount; j++) {
+        // a quiet tone with loud bursts
+        float x = 0.5f * sinf((float) j * 0.01f);
+        if (j % 1000 < 10) {
+            x *= 3.0f;
+        }
+        buf[j] = orig[j] = x;
+    }
+    // process in place, in odd sized pieces
+    for (j = 0; j < kFrames; ) {
+        size_t count = kFrames - j < 37 ? kFrames - j : 37;
+        limiter_lookahead_process(l, buf + j * kChannelCount, buf + j * kChannelCount, count);
+        j += count;
+    }
+    for (j = 0; j < kFrames * kChannelCount; j++) {
+        if (fabsf(buf[j]) > kThreshold * 1.00001f) {
+            fprintf(stderr, "lookahead output[%zu]=%g exceeds threshold\n", j, buf[j]);
+            errors++;
+        }
+        // the output is the delayed input, scaled down by a gain in [0, 1]
+        const float expected = j < latency * kChannelCount ? 0.0f : orig[j - latency * kChannelCount];
+        if (fabsf(buf[j]) > fabsf(expected) + 1e-6f || buf[j] * expected < 0.0f) {
+            fprintf(stderr, "lookahead output[%zu]=%g for input %g\n", j, buf[j], expected);
+            errors++;
+        }
+    }
+    free(buf);
+    free(orig);
+    limiter_lookahead_release(l);
+    return errors;
+}
+
 int main(int argc, char **argv)
 {
     int i;
+    if (check() != 0) {
+        return EXIT_FAILURE;
+    }
     if (argc > 1) {
         for (i = 1; i < argc; i++) {
             float x = atof(argv[i]);
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares mono_blend() with a frame by frame reference implementation,
+// checks that they agree, and prints the speedup for each format and channel count.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <audio_utils/conversion.h>
+#include <audio_utils/limiter.h>
+
+// the original, one frame at a time, implementation of mono_blend()
+static void mono_blend_reference(void *buf, audio_format_t format, size_t channelCount,
+        size_t frames, bool limit)
+{
+    if (format == AUDIO_FORMAT_PCM_16_BIT) {
+        int16_t *out = (int16_t *)buf;
+        for (size_t i = 0; i < frames; ++i) {
+            const int16_t *in = out;
+            int accum = 0;
+            for (size_t j = 0; j < channelCount; ++j) {
+                accum += *in++;
+            }
+            accum /= (int)channelCount; // round to 0
+            for (size_t j = 0; j < channelCount; ++j) {
+                *out++ = accum;
+            }
+        }
+    } else {
+        float *out = (float *)buf;
+        const float recipdiv = 1. / channelCount;
+        for (size_t i = 0; i < frames; ++i) {
+            const float *in = out;
+            float accum = 0;
+            for (size_t j = 0; j < channelCount; ++j) {
+                accum += *in++;
+            }
+            if (limit && channelCount == 2) {
+                accum = limiter(accum * M_SQRT1_2);
+            } else {
+                accum *= recipdiv;
+            }
+            for (size_t j = 0; j < channelCount; ++j) {
+                *out++ = accum;
+            }
+        }
+    }
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+template <typename T>
+static void fill(std::vector<T> &buf);
+
+template <>
+void fill(std::vector<int16_t> &buf)
+{
+    for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = (int16_t)(rand() - RAND_MAX / 2);
+    }
+}
+
+template <>
+void fill(std::vector<float> &buf)
+{
+    for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+    }
+}
+
+template <typename T>
+static bool run(audio_format_t format, size_t channelCount, bool limit)
+{
+    static const size_t kFrames = 960;      // 20 ms at 48 kHz
+    static const int kIterations = 20000;
+
+    std::vector<T> input(kFrames * channelCount);
+    fill(input);
+
+    // correctness
+    std::vector<T> expected(input);
+    std::vector<T> actual(input);
+    mono_blend_reference(expected.data(), format, channelCount, kFrames, limit);
+    mono_blend(actual.data(), format, channelCount, kFrames, limit);
+    for (size_t i = 0; i < input.size(); ++i) {
+        if (fabs((double)expected[i] - (double)actual[i]) > 1e-6) {
+            printf("mismatch at %zu: %g != %g\n", i, (double)expected[i], (double)actual[i]);
+            return false;
+        }
+    }
+
+    std::vector<T> work(input);
+    double start = now_ns();
+    for (int i = 0; i < kIterations; ++i) {
+        mono_blend_reference(work.data(), format, channelCount, kFrames, limit);
+    }
+    const double reference_ns = (now_ns() - start) / kIterations;
+
+    work = input;
+    start = now_ns();
+    for (int i = 0; i < kIterations; ++i) {
+        mono_blend(work.data(), format, channelCount, kFrames, limit);
+    }
+    const double optimized_ns = (now_ns() - start) / kIterations;
+
+    printf("%-6s %zu ch%s: reference %8.0f ns, mono_blend %8.0f ns, speedup %.2fx\n",
+            format == AUDIO_FORMAT_PCM_16_BIT ? "i16" : "float", channelCount,
+            limit ? " limit" : "      ", reference_ns, optimized_ns,
+            reference_ns / optimized_ns);
+    return true;
+}
+
+int main(int argc __unused, char **argv __unused)
+{
+    bool ok = true;
+    static const size_t channelCounts[] = {2, 4, 6, 8};
+    for (size_t i = 0; i < sizeof(channelCounts) / sizeof(channelCounts[0]); ++i) {
+        ok &= run<int16_t>(AUDIO_FORMAT_PCM_16_BIT, channelCounts[i], false);
+        ok &= run<float>(AUDIO_FORMAT_PCM_FLOAT, channelCounts[i], false);
+    }
+    ok &= run<float>(AUDIO_FORMAT_PCM_FLOAT, 2, true);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -18,12 +18,15 @@
 #define LOG_TAG "audio_utils_primitives_tests"
 
 #include <math.h>
+#include <algorithm>
 #include <vector>
 #include <cutils/log.h>
 #include <gtest/gtest.h>
 #include <audio_utils/primitives.h>
 #include <audio_utils/format.h>
+#include <audio_utils/channel_mix.h>
 #include <audio_utils/channels.h>
+#include <audio_utils/minifloat.h>
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
@@ -339,6 +342,65 @@ void checkMonotoneOrZero(const T *ary, size_t size)
     }
 }
 
+TEST(audio_utils_primitives, memcpy_matches_scalar) {
+    // the bulk conversions, which may be vectorized, give the same result as the inline
+    // scalar conversions, for values at and beyond the limits, and for an odd count
+    std::vector<float> f;
+    const float special[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.5f, -0.5f, 2.0f, -2.0f, 1e-10f, -1e-10f,
+        0.99999994f, -0.99999994f, 1.0f / 32768, 1.5f / 32768, -1.5f / 32768,
+        2.5f / 32768, 0.5f / 8388608, -0.5f / 8388608, 1.5f / 8388608, 8388607.5f / 8388608,
+        0.5f / 2147483648.0f, 8388609.5f / 2147483648.0f, -8388609.5f / 2147483648.0f,
+    };
+    f.insert(f.end(), special, special + ARRAY_SIZE(special));
+    for (int i = 0; i < 100003; ++i) {
+        f.push_back(ldexpf((float) ((i * 2654435761u) & 0xFFFFFF) - 8388608.0f,
+                -23 + (i % 3) - (i % 29)));
+    }
+    const size_t count = f.size();
+    std::vector<int16_t> i16(count);
+    std::vector<int32_t> i32(count);
+    std::vector<uint8_t> p24(count * 3);
+    for (size_t i = 0; i < count; ++i) {
+        i16[i] = (int16_t) (i * 40503);
+        i32[i] = (int32_t) (i * 2654435761u);
+    }
+
+    std::vector<int16_t> i16out(count);
+    memcpy_to_i16_from_float(i16out.data(), f.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(clamp16_from_float(f[i]), i16out[i]) << f[i];
+    }
+    std::vector<int32_t> i32out(count);
+    memcpy_to_i32_from_float(i32out.data(), f.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(clamp32_from_float(f[i]), i32out[i]) << f[i];
+    }
+    memcpy_to_p24_from_float(p24.data(), f.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        const int32_t expected = clamp24_from_float(f[i]);
+        ASSERT_EQ(expected, (int32_t) (i32_from_p24(&p24[i * 3]) >> 8)) << f[i];
+    }
+    memcpy_to_p24_from_i32(p24.data(), i32.data(), count);
+    memcpy_to_i32_from_p24(i32out.data(), p24.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(i32[i] & ~0xFF, i32out[i]);
+    }
+    std::vector<float> fout(count);
+    memcpy_to_float_from_p24(fout.data(), p24.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(float_from_p24(&p24[i * 3]), fout[i]);
+    }
+    memcpy_to_float_from_i16(fout.data(), i16.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(float_from_i16(i16[i]), fout[i]);
+    }
+    memcpy_to_float_from_i32(fout.data(), i32.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(float_from_i32(i32[i]), fout[i]);
+    }
+}
+
 TEST(audio_utils_primitives, memcpy_by_channel_mask) {
     uint32_t dst_mask;
     uint32_t src_mask;
@@ -687,3 +749,240 @@ TEST(audio_utils_channels, adjust_channels) {
     delete[] u16expand;
     delete[] u16ary;
 }
+
+// Reference implementation of adjust_channels(), one sample at a time.
+static void adjust_channels_ref(const uint8_t *in, size_t in_chans, uint8_t *out,
+        size_t out_chans, size_t sample_size, size_t frames)
+{
+    for (size_t i = 0; i < frames; ++i) {
+        const uint8_t *src = in + i * in_chans * sample_size;
+        uint8_t *dst = out + i * out_chans * sample_size;
+        if (in_chans == 2 && out_chans == 1) {
+            int32_t l = 0, r = 0;
+            memcpy(&l, src, sample_size);
+            memcpy(&r, src + sample_size, sample_size);
+            // sign extend
+            l = (int32_t)((uint32_t)l << (32 - 8 * sample_size)) >> (32 - 8 * sample_size);
+            r = (int32_t)((uint32_t)r << (32 - 8 * sample_size)) >> (32 - 8 * sample_size);
+            int32_t mean = (int32_t)(((int64_t)l + r) >> 1);
+            memcpy(dst, &mean, sample_size);
+        } else if (in_chans == 1) {
+            memcpy(dst, src, sample_size);
+            memcpy(dst + sample_size, src, sample_size);
+            memset(dst + 2 * sample_size, 0, (out_chans - 2) * sample_size);
+        } else {
+            size_t copy = in_chans < out_chans ? in_chans : out_chans;
+            memcpy(dst, src, copy * sample_size);
+            memset(dst + copy * sample_size, 0, (out_chans - copy) * sample_size);
+        }
+    }
+}
+
+TEST(audio_utils_channels, adjust_channels_specialized) {
+    static const size_t pairs[][2] = {
+        {1, 2}, {2, 1}, {2, 4}, {2, 6}, {2, 8}, {6, 2}, {8, 2}, {1, 4}, {4, 2},
+    };
+    const size_t frames = 1031; // not a multiple of any vector block size
+    std::vector<uint8_t> in(frames * 8 * 4);
+    for (size_t i = 0; i < in.size(); ++i) {
+        in[i] = (uint8_t)(i * 7919 >> 3);
+    }
+    for (size_t sample_size = 2; sample_size <= 4; ++sample_size) {
+        for (size_t p = 0; p < ARRAY_SIZE(pairs); ++p) {
+            const size_t in_chans = pairs[p][0];
+            const size_t out_chans = pairs[p][1];
+            const size_t in_bytes = frames * in_chans * sample_size;
+            const size_t out_bytes = frames * out_chans * sample_size;
+            std::vector<uint8_t> expected(out_bytes);
+            adjust_channels_ref(in.data(), in_chans, expected.data(), out_chans,
+                    sample_size, frames);
+
+            std::vector<uint8_t> out(out_bytes);
+            EXPECT_EQ(out_bytes, adjust_channels(in.data(), in_chans, out.data(), out_chans,
+                    sample_size, in_bytes));
+            EXPECT_EQ(0, memcmp(expected.data(), out.data(), out_bytes))
+                    << sample_size << " bytes " << in_chans << "->" << out_chans;
+
+            // in place
+            std::vector<uint8_t> inplace(in.begin(), in.begin() + std::max(in_bytes, out_bytes));
+            EXPECT_EQ(out_bytes, adjust_channels(inplace.data(), in_chans,
+                    inplace.data(), out_chans, sample_size, in_bytes));
+            EXPECT_EQ(0, memcmp(expected.data(), inplace.data(), out_bytes))
+                    << "in place " << sample_size << " bytes " << in_chans << "->" << out_chans;
+        }
+    }
+}
+
+TEST(audio_utils_channel_mix, coefficients) {
+    struct audio_utils_channel_mix mix;
+
+    // 5.1 to stereo: FL FR FC LFE BL BR
+    ASSERT_EQ(0, audio_utils_channel_mix_init(&mix, AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_CHANNEL_OUT_5POINT1, AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE));
+    EXPECT_EQ(6u, mix.src_channels);
+    EXPECT_EQ(2u, mix.dst_channels);
+    const float expected51[6][2] = {
+        {1, 0}, {0, 1}, {M_SQRT1_2, M_SQRT1_2}, {0, 0}, {M_SQRT1_2, 0}, {0, M_SQRT1_2},
+    };
+    for (size_t s = 0; s < 6; ++s) {
+        for (size_t d = 0; d < 2; ++d) {
+            EXPECT_FLOAT_EQ(expected51[s][d], mix.coefs[s][d]) << s << "->" << d;
+        }
+    }
+
+    // LFE is only mixed on request
+    ASSERT_EQ(0, audio_utils_channel_mix_init(&mix, AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_CHANNEL_OUT_5POINT1, AUDIO_UTILS_CHANNEL_MIX_FLAG_MIX_LFE));
+    EXPECT_FLOAT_EQ(M_SQRT1_2, mix.coefs[3][0]);
+    EXPECT_FLOAT_EQ(M_SQRT1_2, mix.coefs[3][1]);
+
+    // 7.1 to stereo folds both side and back channels
+    ASSERT_EQ(0, audio_utils_channel_mix_init(&mix, AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_CHANNEL_OUT_7POINT1, AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE));
+    EXPECT_EQ(8u, mix.src_channels);
+    float left = 0, right = 0;
+    for (size_t s = 0; s < 8; ++s) {
+        left += mix.coefs[s][0];
+        right += mix.coefs[s][1];
+    }
+    EXPECT_FLOAT_EQ(1 + 3 * M_SQRT1_2, left);
+    EXPECT_FLOAT_EQ(1 + 3 * M_SQRT1_2, right);
+
+    // stereo to mono averages, mono to stereo duplicates
+    ASSERT_EQ(0, audio_utils_channel_mix_init(&mix, AUDIO_CHANNEL_OUT_MONO,
+            AUDIO_CHANNEL_OUT_STEREO, AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE));
+    EXPECT_FLOAT_EQ(0.5f, mix.coefs[0][0]);
+    EXPECT_FLOAT_EQ(0.5f, mix.coefs[1][0]);
+    ASSERT_EQ(0, audio_utils_channel_mix_init(&mix, AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_CHANNEL_OUT_MONO, AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE));
+    EXPECT_FLOAT_EQ(1.0f, mix.coefs[0][0]);
+    EXPECT_FLOAT_EQ(1.0f, mix.coefs[0][1]);
+
+    // upmix leaves new channels silent
+    ASSERT_EQ(0, audio_utils_channel_mix_init(&mix, AUDIO_CHANNEL_OUT_5POINT1,
+            AUDIO_CHANNEL_OUT_STEREO, AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE));
+    for (size_t d = 0; d < 6; ++d) {
+        EXPECT_FLOAT_EQ(d == 0 ? 1 : 0, mix.coefs[0][d]);
+        EXPECT_FLOAT_EQ(d == 1 ? 1 : 0, mix.coefs[1][d]);
+    }
+
+    EXPECT_EQ(-EINVAL, audio_utils_channel_mix_init(&mix, AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_CHANNEL_NONE, AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE));
+}
+
+TEST(audio_utils_channel_mix, apply) {
+    static const audio_channel_mask_t masks[] = {
+        AUDIO_CHANNEL_OUT_MONO, AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_QUAD,
+        AUDIO_CHANNEL_OUT_5POINT1, AUDIO_CHANNEL_OUT_7POINT1,
+    };
+    const size_t frames = 257;
+    for (size_t i = 0; i < ARRAY_SIZE(masks); ++i) {
+        for (size_t j = 0; j < ARRAY_SIZE(masks); ++j) {
+            struct audio_utils_channel_mix mix;
+            ASSERT_EQ(0, audio_utils_channel_mix_init(&mix, masks[j], masks[i],
+                    AUDIO_UTILS_CHANNEL_MIX_FLAG_NONE));
+            const size_t src_channels = mix.src_channels;
+            const size_t dst_channels = mix.dst_channels;
+            std::vector<float> srcf(frames * src_channels);
+            std::vector<int16_t> src16(frames * src_channels);
+            for (size_t k = 0; k < srcf.size(); ++k) {
+                src16[k] = (int16_t)((k * 2017) % 16384 - 8192);
+                srcf[k] = float_from_i16(src16[k]);
+            }
+            std::vector<float> dstf(frames * dst_channels);
+            std::vector<int16_t> dst16(frames * dst_channels);
+            audio_utils_channel_mix_float(&mix, dstf.data(), srcf.data(), frames);
+            audio_utils_channel_mix_i16(&mix, dst16.data(), src16.data(), frames);
+            for (size_t f = 0; f < frames; ++f) {
+                for (size_t d = 0; d < dst_channels; ++d) {
+                    float expected = 0;
+                    for (size_t s = 0; s < src_channels; ++s) {
+                        expected += mix.coefs[s][d] * srcf[f * src_channels + s];
+                    }
+                    EXPECT_NEAR(expected, dstf[f * dst_channels + d], 1e-6);
+                    EXPECT_NEAR(clamp16_from_float(expected), dst16[f * dst_channels + d], 1);
+                }
+            }
+        }
+    }
+}
+
+TEST(audio_utils_minifloat, array_conversion) {
+    // every gain, then every gain as a float and a range of other values
+    const size_t count = 1 << 16;
+    std::vector<gain_minifloat_t> gains(count);
+    for (size_t i = 0; i < count; ++i) {
+        gains[i] = i;
+    }
+    std::vector<float> floats(count);
+    float_from_gain_array(floats.data(), gains.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(float_from_gain(gains[i]), floats[i]) << "gain " << i;
+    }
+
+    const float special[] = {
+        0.0f, -0.0f, -1.0f, 2.0f, 1e-30f, INFINITY, -INFINITY, NAN, -NAN, 1.999f, 1e-5f,
+    };
+    for (size_t i = 0; i < count; ++i) {
+        floats.push_back(ldexpf((float)((i * 2654435761u) & 0xFFFFFF), -24 - (int)(i % 24)));
+    }
+    floats.insert(floats.end(), special, special + ARRAY_SIZE(special));
+    std::vector<gain_minifloat_t> actual(floats.size());
+    gain_from_float_array(actual.data(), floats.data(), floats.size());
+    for (size_t i = 0; i < floats.size(); ++i) {
+        ASSERT_EQ(gain_from_float(floats[i]), actual[i]) << "float " << floats[i];
+    }
+
+    const size_t pairs = floats.size() / 2;
+    std::vector<gain_minifloat_packed_t> packed(pairs);
+    gain_packed_from_float_array(packed.data(), floats.data(), pairs);
+    std::vector<float> unpacked(2 * pairs);
+    float_from_gain_packed_array(unpacked.data(), packed.data(), pairs);
+    for (size_t i = 0; i < pairs; ++i) {
+        ASSERT_EQ(gain_minifloat_pack(actual[2 * i], actual[2 * i + 1]), packed[i]);
+        EXPECT_EQ(float_from_gain(actual[2 * i]), unpacked[2 * i]);
+        EXPECT_EQ(float_from_gain(actual[2 * i + 1]), unpacked[2 * i + 1]);
+    }
+}
+
+TEST(audio_utils_minifloat, gain_ramp) {
+    const size_t frames = 253;
+    for (uint32_t channels = 1; channels <= GAIN_RAMP_MAX_CHANNELS; ++channels) {
+        gain_minifloat_t from[GAIN_RAMP_MAX_CHANNELS];
+        gain_minifloat_t to[GAIN_RAMP_MAX_CHANNELS];
+        for (uint32_t c = 0; c < channels; ++c) {
+            from[c] = gain_from_float(0.25f * c);
+            to[c] = gain_from_float(1.5f - 0.125f * c);
+        }
+        std::vector<float> srcf(frames * channels);
+        std::vector<int16_t> src16(frames * channels);
+        for (size_t k = 0; k < srcf.size(); ++k) {
+            src16[k] = (int16_t)((k * 2017) % 65536 - 32768);
+            srcf[k] = float_from_i16(src16[k]);
+        }
+        std::vector<float> dstf(srcf);
+        std::vector<int16_t> dst16(src16);
+        gain_ramp_float(dstf.data(), dstf.data(), frames, channels, from, to);
+        gain_ramp_i16(dst16.data(), dst16.data(), frames, channels, from, to);
+        for (size_t i = 0; i < frames; ++i) {
+            for (uint32_t c = 0; c < channels; ++c) {
+                const float start = float_from_gain(from[c]);
+                const float gain = start + (float_from_gain(to[c]) - start) * (i + 1) / frames;
+                const size_t k = i * channels + c;
+                EXPECT_NEAR(srcf[k] * gain, dstf[k], 1e-6) << channels << " " << k;
+                EXPECT_NEAR(clamp16_from_float(srcf[k] * gain), dst16[k], 1)
+                        << channels << " " << k;
+            }
+        }
+    }
+
+    // a stereo ramp to the same gain is a constant gain
+    const gain_minifloat_packed_t half =
+            gain_minifloat_pack(gain_from_float(0.5f), gain_from_float(0.5f));
+    float stereo[6] = {1.0f, -1.0f, 0.5f, 0.25f, -0.125f, 0.0f};
+    gain_ramp_stereo_float(stereo, stereo, 3, half, half);
+    const float expected[6] = {0.5f, -0.5f, 0.25f, 0.125f, -0.0625f, 0.0f};
+    for (size_t k = 0; k < 6; ++k) {
+        EXPECT_EQ(expected[k], stereo[k]);
+    }
+}
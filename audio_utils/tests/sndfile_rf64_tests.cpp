@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Built with tinysndfile.c and a RIFF_SIZE_MAX of 65536, so that small files switch to RF64.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_sndfile_rf64_tests"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <audio_utils/sndfile.h>
+
+static std::string tempPath(const char *name)
+{
+#ifdef __ANDROID__
+    return std::string("/data/local/tmp/") + name;
+#else
+    return std::string("/tmp/") + name;
+#endif
+}
+
+static uint64_t little8(const unsigned char *ptr)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | ptr[i];
+    }
+    return value;
+}
+
+TEST(audio_utils_sndfile, rf64_at_close)
+{
+    static const struct {
+        int format;
+        int channels;
+        sf_count_t frames;
+        size_t bytesPerSample;
+        bool rf64;
+    } kFiles[] = {
+        { SF_FORMAT_PCM_16, 2, 1001, 2, false },
+        { SF_FORMAT_PCM_16, 2, 20000, 2, true },
+        { SF_FORMAT_FLOAT, 8, 3001, 4, true },      // extensible, with a fact chunk
+        { SF_FORMAT_PCM_U8, 1, 70001, 1, true },    // padded data chunk
+    };
+    const std::string path = tempPath("sndfile_rf64_tests.wav");
+    for (const auto &file : kFiles) {
+        std::vector<short> samples(file.frames * file.channels);
+        for (size_t i = 0; i < samples.size(); ++i) {
+            samples[i] = (short) (i * 7919) & ~0xFF;    // exact in 8 bit
+        }
+        SF_INFO info;
+        info.frames = 0;
+        info.samplerate = 48000;
+        info.channels = file.channels;
+        info.format = SF_FORMAT_WAV | file.format;
+        SNDFILE *handle = sf_open(path.c_str(), SFM_WRITE, &info);
+        ASSERT_TRUE(handle != NULL);
+        EXPECT_EQ(file.frames, sf_writef_short(handle, samples.data(), file.frames));
+        sf_close(handle);
+
+        // the header is rewritten at close, with the sizes in ds64 once they are too large
+        unsigned char header[44];
+        FILE *stream = fopen(path.c_str(), "rb");
+        ASSERT_TRUE(stream != NULL);
+        ASSERT_EQ(1u, fread(header, sizeof(header), 1, stream));
+        fclose(stream);
+        const uint64_t dataSize = file.frames * file.channels * file.bytesPerSample;
+        if (file.rf64) {
+            EXPECT_EQ(0, memcmp(header, "RF64", 4));
+            EXPECT_EQ(0, memcmp(&header[12], "ds64", 4));
+            EXPECT_EQ(dataSize, little8(&header[28]));
+            EXPECT_EQ((uint64_t) file.frames, little8(&header[36]));
+        } else {
+            EXPECT_EQ(0, memcmp(header, "RIFF", 4));
+            EXPECT_EQ(0, memcmp(&header[12], "JUNK", 4));
+        }
+
+        for (int mode : {SFM_READ, SFM_READ | SFM_MMAP}) {
+            handle = sf_open(path.c_str(), mode, &info);
+            ASSERT_TRUE(handle != NULL);
+            EXPECT_EQ(file.frames, info.frames);
+            EXPECT_EQ(file.channels, info.channels);
+            EXPECT_EQ(SF_FORMAT_WAV | file.format, info.format);
+            std::vector<short> actual(samples.size());
+            EXPECT_EQ(file.frames, sf_readf_short(handle, actual.data(), file.frames));
+            EXPECT_EQ(samples, actual);
+            sf_close(handle);
+        }
+    }
+    unlink(path.c_str());
+}
@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_sndfile_tests"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <audio_utils/primitives.h>
+#include <audio_utils/sndfile.h>
+#include <system/audio.h>
+
+static std::string tempPath(const char *name)
+{
+#ifdef __ANDROID__
+    return std::string("/data/local/tmp/") + name;
+#else
+    return std::string("/tmp/") + name;
+#endif
+}
+
+static const int kChannels = 2;
+static const int kFrames = 1001;
+
+static std::vector<short> makeSamples()
+{
+    std::vector<short> samples(kFrames * kChannels);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = (short) (i * 7919);
+    }
+    return samples;
+}
+
+static void writeFile(const std::string &path, int format, const std::vector<short> &samples)
+{
+    SF_INFO info;
+    info.frames = 0;
+    info.samplerate = 48000;
+    info.channels = kChannels;
+    info.format = SF_FORMAT_WAV | format;
+    SNDFILE *handle = sf_open(path.c_str(), SFM_WRITE, &info);
+    ASSERT_TRUE(handle != NULL);
+    EXPECT_EQ(kFrames, sf_writef_short(handle, samples.data(), kFrames));
+    sf_close(handle);
+}
+
+// Reads the whole file as each type, in pieces of varying size
+template <typename T>
+static std::vector<T> readFile(const std::string &path, int mode,
+        sf_count_t (*readf)(SNDFILE *, T *, sf_count_t))
+{
+    SF_INFO info;
+    SNDFILE *handle = sf_open(path.c_str(), mode, &info);
+    EXPECT_TRUE(handle != NULL);
+    if (handle == NULL) {
+        return std::vector<T>();
+    }
+    EXPECT_EQ(kFrames, info.frames);
+    EXPECT_EQ(kChannels, info.channels);
+    std::vector<T> samples(kFrames * kChannels);
+    sf_count_t frames = 0;
+    for (sf_count_t desired = 1; frames < kFrames; desired = desired * 3 % 97 + 1) {
+        sf_count_t actual = readf(handle, &samples[frames * kChannels], desired);
+        EXPECT_EQ(std::min(desired, (sf_count_t) kFrames - frames), actual);
+        if (actual <= 0) {
+            break;
+        }
+        frames += actual;
+    }
+    EXPECT_EQ(0, readf(handle, samples.data(), 1));
+    sf_close(handle);
+    return samples;
+}
+
+TEST(audio_utils_sndfile, mmap_read)
+{
+    const std::vector<short> samples = makeSamples();
+    const int formats[] = {SF_FORMAT_PCM_16, SF_FORMAT_FLOAT};
+    for (int format : formats) {
+        const std::string path = tempPath("sndfile_tests_mmap.wav");
+        writeFile(path, format, samples);
+
+        // reads from the mapping are the same as reads through stdio
+        EXPECT_EQ(readFile(path, SFM_READ, sf_readf_short),
+                readFile(path, SFM_READ | SFM_MMAP, sf_readf_short));
+        EXPECT_EQ(readFile(path, SFM_READ, sf_readf_float),
+                readFile(path, SFM_READ | SFM_MMAP, sf_readf_float));
+        EXPECT_EQ(readFile(path, SFM_READ, sf_readf_int),
+                readFile(path, SFM_READ | SFM_MMAP, sf_readf_int));
+        EXPECT_EQ(samples, readFile(path, SFM_READ | SFM_MMAP, sf_readf_short));
+
+        // direct reads see the samples in the file format without copying
+        SF_INFO info;
+        SNDFILE *handle = sf_open(path.c_str(), SFM_READ | SFM_MMAP, &info);
+        ASSERT_TRUE(handle != NULL);
+        const void *data;
+        ASSERT_EQ(10, sf_readf_direct(handle, &data, 10));
+        std::vector<short> head(10 * kChannels);
+        if (format == SF_FORMAT_PCM_16) {
+            memcpy(head.data(), data, head.size() * sizeof(short));
+        } else {
+            // the mapped data may not be aligned for floats
+            std::vector<float> floats(head.size());
+            memcpy(floats.data(), data, floats.size() * sizeof(float));
+            memcpy_to_i16_from_float(head.data(), floats.data(), head.size());
+        }
+        EXPECT_TRUE(std::equal(head.begin(), head.end(), samples.begin()));
+        short next[kChannels];
+        ASSERT_EQ(1, sf_readf_short(handle, next, 1));
+        EXPECT_EQ(samples[10 * kChannels], next[0]);
+        EXPECT_EQ(kFrames - 11, sf_readf_direct(handle, &data, kFrames));
+        EXPECT_EQ(0, sf_readf_direct(handle, &data, 1));
+        sf_close(handle);
+
+        // direct reads need a mapping
+        handle = sf_open(path.c_str(), SFM_READ, &info);
+        ASSERT_TRUE(handle != NULL);
+        EXPECT_EQ(0, sf_readf_direct(handle, &data, 1));
+        sf_close(handle);
+        unlink(path.c_str());
+    }
+}
+
+TEST(audio_utils_sndfile, async_write)
+{
+    const std::string path = tempPath("sndfile_tests_async.wav");
+    const std::vector<short> samples = makeSamples();
+    SF_INFO info;
+    info.frames = 0;
+    info.samplerate = 48000;
+    info.channels = kChannels;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    SNDFILE *handle = sf_open(path.c_str(), SFM_WRITE | SFM_ASYNC, &info);
+    ASSERT_TRUE(handle != NULL);
+    for (sf_count_t frames = 0, count = 1; frames < kFrames; frames += count, count *= 2) {
+        count = std::min(count, (sf_count_t) kFrames - frames);
+        EXPECT_EQ(count, sf_writef_short(handle, &samples[frames * kChannels], count));
+    }
+    EXPECT_EQ(0, sf_overruns(handle));
+    sf_close(handle);
+    EXPECT_EQ(samples, readFile(path, SFM_READ, sf_readf_short));
+
+    // a write larger than the ring is truncated and counts the frames dropped
+    const sf_count_t longFrames = 10 * info.samplerate;
+    std::vector<short> longSamples(longFrames * kChannels);
+    for (size_t i = 0; i < longSamples.size(); ++i) {
+        longSamples[i] = (short) i;
+    }
+    handle = sf_open(path.c_str(), SFM_WRITE | SFM_ASYNC, &info);
+    ASSERT_TRUE(handle != NULL);
+    sf_count_t accepted = sf_writef_short(handle, longSamples.data(), longFrames);
+    EXPECT_GT(accepted, 0);
+    EXPECT_LT(accepted, longFrames);
+    EXPECT_EQ(longFrames - accepted, sf_overruns(handle));
+    sf_close(handle);
+
+    handle = sf_open(path.c_str(), SFM_READ, &info);
+    ASSERT_TRUE(handle != NULL);
+    EXPECT_EQ(accepted, info.frames);
+    std::vector<short> actual(accepted * kChannels);
+    EXPECT_EQ(accepted, sf_readf_short(handle, actual.data(), accepted));
+    EXPECT_TRUE(std::equal(actual.begin(), actual.end(), longSamples.begin()));
+    sf_close(handle);
+    unlink(path.c_str());
+}
+
+TEST(audio_utils_sndfile, extensible)
+{
+    // 24 bit 7.1 round trips with its channel mask
+    const std::string path = tempPath("sndfile_tests_extensible.wav");
+    const int channels = 8;
+    const sf_count_t frames = 101;  // an odd data size, which is padded
+    std::vector<int> samples(frames * channels);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = (int) (i * 2654435761u) & ~0xFF;
+    }
+    SF_INFO info;
+    info.frames = 0;
+    info.samplerate = 96000;
+    info.channels = channels;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_24;
+    SNDFILE *handle = sf_open(path.c_str(), SFM_WRITE, &info);
+    ASSERT_TRUE(handle != NULL);
+    EXPECT_EQ(AUDIO_CHANNEL_OUT_7POINT1, sf_get_channel_mask(handle));
+    EXPECT_EQ(-EINVAL, sf_set_channel_mask(handle, AUDIO_CHANNEL_OUT_5POINT1));
+    const uint32_t mask = AUDIO_CHANNEL_OUT_5POINT1 | AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER
+            | AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER;
+    EXPECT_EQ(0, sf_set_channel_mask(handle, mask));
+    EXPECT_EQ(frames, sf_writef_int(handle, samples.data(), frames));
+    sf_close(handle);
+
+    handle = sf_open(path.c_str(), SFM_READ, &info);
+    ASSERT_TRUE(handle != NULL);
+    EXPECT_EQ(frames, info.frames);
+    EXPECT_EQ(channels, info.channels);
+    EXPECT_EQ(96000, info.samplerate);
+    EXPECT_EQ(SF_FORMAT_WAV | SF_FORMAT_PCM_24, info.format);
+    EXPECT_EQ(mask, sf_get_channel_mask(handle));
+    std::vector<int> actual(frames * channels);
+    EXPECT_EQ(frames, sf_readf_int(handle, actual.data(), frames));
+    EXPECT_EQ(samples, actual);
+    sf_close(handle);
+
+    // a stereo float file keeps the classic header
+    info.channels = 2;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    handle = sf_open(path.c_str(), SFM_WRITE, &info);
+    ASSERT_TRUE(handle != NULL);
+    EXPECT_EQ(-EINVAL, sf_set_channel_mask(handle, AUDIO_CHANNEL_OUT_BACK_LEFT
+            | AUDIO_CHANNEL_OUT_BACK_RIGHT));
+    sf_close(handle);
+    handle = sf_open(path.c_str(), SFM_READ, &info);
+    ASSERT_TRUE(handle != NULL);
+    EXPECT_EQ(0u, sf_get_channel_mask(handle));
+    EXPECT_EQ(SF_FORMAT_WAV | SF_FORMAT_FLOAT, info.format);
+    sf_close(handle);
+    unlink(path.c_str());
+}
+
+TEST(audio_utils_sndfile, multichannel_float)
+{
+    // the largest header: extensible fmt and fact
+    const std::string path = tempPath("sndfile_tests_multichannel.wav");
+    const int channels = 8;
+    const sf_count_t frames = 1001;
+    std::vector<float> samples(frames * channels);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = (float) ((int) (i * 7919 % 65536) - 32768) / 32768.f;
+    }
+    SF_INFO info;
+    info.frames = 0;
+    info.samplerate = 48000;
+    info.channels = channels;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    SNDFILE *handle = sf_open(path.c_str(), SFM_WRITE, &info);
+    ASSERT_TRUE(handle != NULL);
+    EXPECT_EQ(frames, sf_writef_float(handle, samples.data(), frames));
+    sf_close(handle);
+
+    for (int mode : {SFM_READ, SFM_READ | SFM_MMAP}) {
+        handle = sf_open(path.c_str(), mode, &info);
+        ASSERT_TRUE(handle != NULL);
+        EXPECT_EQ(frames, info.frames);
+        EXPECT_EQ(channels, info.channels);
+        EXPECT_EQ(SF_FORMAT_WAV | SF_FORMAT_FLOAT, info.format);
+        EXPECT_EQ(AUDIO_CHANNEL_OUT_7POINT1, sf_get_channel_mask(handle));
+        std::vector<float> actual(samples.size());
+        EXPECT_EQ(frames, sf_readf_float(handle, actual.data(), frames));
+        EXPECT_EQ(samples, actual);
+        sf_close(handle);
+    }
+    unlink(path.c_str());
+}
+
+static void put4(std::vector<unsigned char> &v, uint32_t u)
+{
+    for (int i = 0; i < 4; ++i) {
+        v.push_back(u >> (8 * i));
+    }
+}
+
+static void put8(std::vector<unsigned char> &v, uint64_t u)
+{
+    put4(v, (uint32_t) u);
+    put4(v, (uint32_t) (u >> 32));
+}
+
+TEST(audio_utils_sndfile, rf64)
+{
+    // an RF64 file with its sizes in ds64, as written for files larger than 4 GB
+    const std::string path = tempPath("sndfile_tests_rf64.wav");
+    const std::vector<short> samples = makeSamples();
+    const uint64_t dataSize = samples.size() * sizeof(short);
+    std::vector<unsigned char> wav;
+    const char *tag = "RF64";
+    wav.insert(wav.end(), tag, tag + 4);
+    put4(wav, 0xFFFFFFFF);
+    tag = "WAVEds64";
+    wav.insert(wav.end(), tag, tag + 8);
+    put4(wav, 28);
+    put8(wav, 4 + 36 + 24 + 8 + dataSize);  // RIFF size
+    put8(wav, dataSize);
+    put8(wav, kFrames);
+    put4(wav, 0);                           // table length
+    tag = "fmt ";
+    wav.insert(wav.end(), tag, tag + 4);
+    put4(wav, 16);
+    put4(wav, 1 | (kChannels << 16));       // PCM
+    put4(wav, 44100);
+    put4(wav, 44100 * kChannels * 2);
+    put4(wav, (kChannels * 2) | (16 << 16));
+    tag = "data";
+    wav.insert(wav.end(), tag, tag + 4);
+    put4(wav, 0xFFFFFFFF);
+    const unsigned char *data = (const unsigned char *) samples.data();
+    wav.insert(wav.end(), data, data + dataSize);
+    FILE *file = fopen(path.c_str(), "wb");
+    ASSERT_TRUE(file != NULL);
+    ASSERT_EQ(1u, fwrite(wav.data(), wav.size(), 1, file));
+    fclose(file);
+
+    EXPECT_EQ(samples, readFile(path, SFM_READ, sf_readf_short));
+    unlink(path.c_str());
+}
+
+TEST(audio_utils_sndfile, conversions)
+{
+    // every file format can be written and read as every sample format, including as
+    // packed 24 bit, with the precision of the narrowest format
+    const std::string path = tempPath("sndfile_tests_conversions.wav");
+    const int formats[] = {
+        SF_FORMAT_PCM_U8, SF_FORMAT_PCM_16, SF_FORMAT_PCM_24, SF_FORMAT_PCM_32, SF_FORMAT_FLOAT,
+    };
+    // more than one block of frames
+    const sf_count_t frames = 20000;
+    std::vector<short> samples(frames * kChannels);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = (short) (i * 7919) & ~0xFF;    // exact in 8 bit
+    }
+    std::vector<float> floats(samples.size());
+    memcpy_to_float_from_i16(floats.data(), samples.data(), samples.size());
+    std::vector<int> ints(samples.size());
+    memcpy_to_i32_from_i16(ints.data(), samples.data(), samples.size());
+    std::vector<uint8_t> p24(samples.size() * 3);
+    memcpy_to_p24_from_i16(p24.data(), samples.data(), samples.size());
+
+    for (int format : formats) {
+        for (int writer = 0; writer < 4; ++writer) {
+            SF_INFO info;
+            info.frames = 0;
+            info.samplerate = 48000;
+            info.channels = kChannels;
+            info.format = SF_FORMAT_WAV | format;
+            SNDFILE *handle = sf_open(path.c_str(), SFM_WRITE, &info);
+            ASSERT_TRUE(handle != NULL);
+            sf_count_t written;
+            switch (writer) {
+            case 0:
+                written = sf_writef_short(handle, samples.data(), frames);
+                break;
+            case 1:
+                written = sf_writef_float(handle, floats.data(), frames);
+                break;
+            case 2:
+                written = sf_writef_int(handle, ints.data(), frames);
+                break;
+            default:
+                written = sf_writef_p24(handle, p24.data(), frames);
+                break;
+            }
+            EXPECT_EQ(frames, written) << "format " << format << " writer " << writer;
+            sf_close(handle);
+
+            for (int mode : {SFM_READ, SFM_READ | SFM_MMAP}) {
+                handle = sf_open(path.c_str(), mode, &info);
+                ASSERT_TRUE(handle != NULL);
+                std::vector<float> actualFloats(samples.size());
+                EXPECT_EQ(frames, sf_readf_float(handle, actualFloats.data(), frames));
+                EXPECT_EQ(floats, actualFloats) << "format " << format << " writer " << writer;
+                sf_close(handle);
+
+                handle = sf_open(path.c_str(), mode, &info);
+                ASSERT_TRUE(handle != NULL);
+                std::vector<uint8_t> actualP24(p24.size());
+                EXPECT_EQ(frames, sf_readf_p24(handle, actualP24.data(), frames));
+                EXPECT_EQ(p24, actualP24) << "format " << format << " writer " << writer;
+                sf_close(handle);
+            }
+        }
+    }
+    unlink(path.c_str());
+}
+
+TEST(audio_utils_sndfile, seek_and_pread)
+{
+    const std::vector<short> samples = makeSamples();
+    const int formats[] = {SF_FORMAT_PCM_16, SF_FORMAT_PCM_24, SF_FORMAT_FLOAT};
+    const int modes[] = {SFM_READ, SFM_READ | SFM_MMAP};
+    for (int format : formats) {
+        const std::string path = tempPath("sndfile_tests_seek.wav");
+        writeFile(path, format, samples);
+        for (int mode : modes) {
+            SF_INFO info;
+            SNDFILE *handle = sf_open(path.c_str(), mode, &info);
+            ASSERT_TRUE(handle != NULL);
+            short frame[kChannels];
+
+            EXPECT_EQ(500, sf_seek(handle, 500, SEEK_SET));
+            ASSERT_EQ(1, sf_readf_short(handle, frame, 1));
+            EXPECT_EQ(samples[500 * kChannels], frame[0]);
+            EXPECT_EQ(491, sf_seek(handle, -10, SEEK_CUR));
+            ASSERT_EQ(1, sf_readf_short(handle, frame, 1));
+            EXPECT_EQ(samples[491 * kChannels + 1], frame[1]);
+            EXPECT_EQ(kFrames - 1, sf_seek(handle, -1, SEEK_END));
+            ASSERT_EQ(1, sf_readf_short(handle, frame, 1));
+            EXPECT_EQ(samples[(kFrames - 1) * kChannels], frame[0]);
+            EXPECT_EQ(0, sf_readf_short(handle, frame, 1));
+            EXPECT_EQ(-1, sf_seek(handle, 1, SEEK_END));
+            EXPECT_EQ(-1, sf_seek(handle, -1, SEEK_SET));
+            EXPECT_EQ(-1, sf_seek(handle, 0, 42));
+
+            // positional reads of disjoint regions, from several threads, in any order,
+            // return the same frames as a sequential read and leave the position unchanged
+            EXPECT_EQ(100, sf_seek(handle, 100, SEEK_SET));
+            static const int kRegions = 4;
+            static const int kRegionFrames = (kFrames + kRegions - 1) / kRegions;
+            std::vector<short> actual(samples.size());
+            std::vector<std::thread> workers;
+            for (int i = kRegions - 1; i >= 0; --i) {
+                workers.emplace_back([handle, &actual, i] {
+                    sf_count_t offset = i * kRegionFrames;
+                    sf_count_t frames = std::min(kRegionFrames, kFrames - (int) offset);
+                    EXPECT_EQ(frames, sf_preadf_short(handle, &actual[offset * kChannels],
+                            kRegionFrames, offset));
+                });
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            EXPECT_EQ(samples, actual);
+            ASSERT_EQ(1, sf_readf_short(handle, frame, 1));
+            EXPECT_EQ(samples[100 * kChannels], frame[0]);
+
+            std::vector<float> f(kFrames * kChannels), g(kFrames * kChannels);
+            EXPECT_EQ(kFrames - 3, sf_preadf_float(handle, f.data(), kFrames, 3));
+            memcpy_to_float_from_i16(g.data(), &samples[3 * kChannels], (kFrames - 3) * kChannels);
+            EXPECT_EQ(g, f);
+            EXPECT_EQ(0, sf_preadf_float(handle, f.data(), 1, kFrames));
+            sf_close(handle);
+        }
+        unlink(path.c_str());
+    }
+}
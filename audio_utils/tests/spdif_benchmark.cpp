@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Pushes synthetic AC3, E-AC3 and DTS elementary streams through SPDIFEncoder,
+// checks the number of bursts, and prints the throughput and the number of
+// allocations made while encoding.
+//
+// With -c <directory>, also writes a short stream of each format as a seed
+// for spdif_fuzzer, prefixed with the fuzzer's format and write size bytes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+#include <audio_utils/spdif/SPDIFEncoder.h>
+
+using namespace android;
+
+static size_t sAllocations;
+
+// Count every allocation through the replaceable global allocation functions.
+// All the variants are replaced, so that each delete matches its new.
+static void *countedAlloc(size_t size) noexcept
+{
+    ++sAllocations;
+    return malloc(size > 0 ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+    void *p = countedAlloc(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t /* size */) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t /* size */) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Counts the output instead of sending it anywhere.
+class NullEncoder : public SPDIFEncoder {
+public:
+    explicit NullEncoder(audio_format_t format) : SPDIFEncoder(format), mOutputBytes(0) { }
+
+    virtual ssize_t writeOutput(const void * /* buffer */, size_t numBytes) {
+        mOutputBytes += numBytes;
+        return numBytes;
+    }
+
+    size_t mOutputBytes;
+};
+
+static void appendRandom(std::vector<uint8_t> &stream, size_t numBytes)
+{
+    for (size_t i = 0; i < numBytes; ++i) {
+        stream.push_back(rand());
+    }
+}
+
+// AC3 at 448 kbit/s and 48 kHz, 1792 bytes per frame.
+static void appendAC3Frame(std::vector<uint8_t> &stream)
+{
+    static const size_t kFrameBytes = 1792;
+    const uint8_t header[] = {
+        0x0B, 0x77,             // sync
+        0x12, 0x34,             // crc1
+        (0 << 6) | 30,          // fscod, frmsizcod
+        (8 << 3) | 0,           // bsid, bsmod
+    };
+    stream.insert(stream.end(), header, header + sizeof(header));
+    appendRandom(stream, kFrameBytes - sizeof(header));
+}
+
+// E-AC3 with 6 blocks per frame at 48 kHz, 1536 bytes per frame.
+static void appendEAC3Frame(std::vector<uint8_t> &stream)
+{
+    static const size_t kFrameBytes = 1536;
+    static const size_t frmsiz = kFrameBytes / 2 - 1;
+    const uint8_t header[] = {
+        0x0B, 0x77,             // sync
+        (uint8_t) ((0 << 6) | (0 << 3) | (frmsiz >> 8)), // strmtyp, substreamid, frmsiz
+        (uint8_t) frmsiz,
+        (0 << 6) | (3 << 4) | (2 << 1), // fscod, numblkscod, acmod, lfeon
+        (16 << 3),              // bsid, dialnorm
+    };
+    stream.insert(stream.end(), header, header + sizeof(header));
+    appendRandom(stream, kFrameBytes - sizeof(header));
+}
+
+// DTS core of 512 frames at 48 kHz, 2012 bytes per frame.
+static void appendDTSFrame(std::vector<uint8_t> &stream)
+{
+    static const size_t kFrameBytes = 2012;
+    static const uint32_t fsize = kFrameBytes - 1;
+    const uint8_t header[] = {
+        0x7F, 0xFE, 0x80, 0x01, // sync
+        // ftype 1, deficit 31, cpf 0, nblks 15, fsize, amode 9, sfreq 13
+        0xFC, (15 << 2) | (fsize >> 12), (uint8_t) (fsize >> 4),
+        (uint8_t) ((fsize << 4) | (9 >> 2)), (uint8_t) ((9 << 6) | (13 << 2)),
+        0x00, 0x00, 0x00,
+    };
+    stream.insert(stream.end(), header, header + sizeof(header));
+    appendRandom(stream, kFrameBytes - sizeof(header));
+}
+
+struct Format {
+    const char *name;
+    audio_format_t format;
+    void (*appendFrame)(std::vector<uint8_t> &stream);
+    size_t burstBytes;
+    bool flushedByNextFrame;    // true if a burst is only complete when the next one starts
+    uint8_t fuzzerFormat;       // index of the format in spdif_fuzzer
+};
+
+static const Format kFormats[] = {
+    { "ac3", AUDIO_FORMAT_AC3, appendAC3Frame, 1536 * 4, false, 0 },
+    { "eac3", AUDIO_FORMAT_E_AC3, appendEAC3Frame, 6144 * 4, true, 1 },
+    { "dts", AUDIO_FORMAT_DTS, appendDTSFrame, 512 * 4, false, 2 },
+};
+
+static bool writeSeed(const std::string &directory, const Format &format)
+{
+    std::vector<uint8_t> seed = { format.fuzzerFormat, 0xFF };
+    for (int i = 0; i < 4; ++i) {
+        format.appendFrame(seed);
+    }
+    const std::string path = directory + "/" + format.name;
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+        printf("cannot create %s\n", path.c_str());
+        return false;
+    }
+    const bool ok = fwrite(seed.data(), 1, seed.size(), file) == seed.size();
+    return fclose(file) == 0 && ok;
+}
+
+static bool run(const Format &format)
+{
+    static const size_t kFrames = 1000;
+    static const size_t kWriteBytes = 4096;
+    static const int kIterations = 20;
+
+    std::vector<uint8_t> stream;
+    for (size_t i = 0; i < kFrames; ++i) {
+        format.appendFrame(stream);
+    }
+    // one burst per frame
+    const size_t outputBytes = (kFrames - format.flushedByNextFrame) * format.burstBytes;
+
+    double elapsed_ns = 0;
+    size_t allocations = 0;
+    for (int i = 0; i < kIterations; ++i) {
+        NullEncoder encoder(format.format);
+        const double start = now_ns();
+        const size_t startAllocations = sAllocations;
+        for (size_t offset = 0; offset < stream.size(); offset += kWriteBytes) {
+            const size_t numBytes = std::min(kWriteBytes, stream.size() - offset);
+            if (encoder.write(&stream[offset], numBytes) != (ssize_t) numBytes) {
+                printf("%s: write failed\n", format.name);
+                return false;
+            }
+        }
+        allocations += sAllocations - startAllocations;
+        elapsed_ns += now_ns() - start;
+
+        if (encoder.mOutputBytes != outputBytes) {
+            printf("%s: %zu bytes of bursts, expected %zu\n", format.name,
+                    encoder.mOutputBytes, outputBytes);
+            return false;
+        }
+    }
+    const double inputMBps = (double) stream.size() * kIterations / elapsed_ns * 1e3;
+    const double outputMBps = (double) outputBytes * kIterations / elapsed_ns * 1e3;
+    printf("%-4s: input %8.1f MB/s, output %8.1f MB/s, %zu allocations in %zu writes\n",
+            format.name, inputMBps, outputMBps, allocations,
+            kIterations * ((stream.size() + kWriteBytes - 1) / kWriteBytes));
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *corpus = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:")) != -1) {
+        switch (opt) {
+        case 'c':
+            corpus = optarg;
+            break;
+        default:
+            printf("usage: %s [-c <corpus directory>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool ok = true;
+    for (const Format &format : kFormats) {
+        ok &= run(format);
+        if (corpus != NULL) {
+            ok &= writeSeed(corpus, format);
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
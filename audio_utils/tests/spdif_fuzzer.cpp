@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// libFuzzer target for the frame scanners, SPDIFEncoder and BitFieldParser.
+//
+// The first byte of the input selects the format from kFormats, the second byte
+// the size of the writes, and the rest is the elementary stream.
+// spdif_benchmark -c <directory> writes seeds in this layout.
+
+#include <stdlib.h>
+#include <algorithm>
+#include <audio_utils/spdif/BitFieldParser.h>
+#include <audio_utils/spdif/SPDIFEncoder.h>
+
+#include "../spdif/AACFrameScanner.h"
+#include "../spdif/AC3FrameScanner.h"
+#include "../spdif/DTSFrameScanner.h"
+#include "../spdif/DTSHDFrameScanner.h"
+#include "../spdif/MPEGFrameScanner.h"
+#include "../spdif/TrueHDFrameScanner.h"
+
+using namespace android;
+
+// The order is part of the seed format, so only append.
+static const audio_format_t kFormats[] = {
+    AUDIO_FORMAT_AC3,
+    AUDIO_FORMAT_E_AC3,
+    AUDIO_FORMAT_DTS,
+    AUDIO_FORMAT_DTS_HD,
+    AUDIO_FORMAT_AAC_ADTS_LC,
+    AUDIO_FORMAT_MP2,
+    AUDIO_FORMAT_MP3,
+    AUDIO_FORMAT_DOLBY_TRUEHD,
+};
+
+// Checks the bursts instead of sending them anywhere.
+class CheckingEncoder : public SPDIFEncoder {
+public:
+    explicit CheckingEncoder(audio_format_t format) : SPDIFEncoder(format) { }
+
+    virtual ssize_t writeOutput(const void *buffer, size_t numBytes) {
+        if (buffer == NULL || numBytes % getBytesPerOutputFrame() != 0) {
+            abort();
+        }
+        return numBytes;
+    }
+};
+
+static FrameScanner *createFrameScanner(audio_format_t format)
+{
+    switch (format) {
+    case AUDIO_FORMAT_AC3:
+    case AUDIO_FORMAT_E_AC3:
+        return new AC3FrameScanner();
+    case AUDIO_FORMAT_DTS:
+        return new DTSFrameScanner();
+    case AUDIO_FORMAT_DTS_HD:
+        return new DTSHDFrameScanner();
+    case AUDIO_FORMAT_AAC_ADTS_LC:
+        return new AACFrameScanner();
+    case AUDIO_FORMAT_MP2:
+    case AUDIO_FORMAT_MP3:
+        return new MPEGFrameScanner();
+    case AUDIO_FORMAT_DOLBY_TRUEHD:
+        return new TrueHDFrameScanner();
+    default:
+        return NULL;
+    }
+}
+
+static void fuzzEncoder(audio_format_t format, size_t writeBytes, const uint8_t *data,
+        size_t size)
+{
+    CheckingEncoder encoder(format);
+    for (size_t offset = 0; offset < size; offset += writeBytes) {
+        const size_t numBytes = std::min(writeBytes, size - offset);
+        if (encoder.write(&data[offset], numBytes) != (ssize_t) numBytes) {
+            abort();
+        }
+    }
+}
+
+static void fuzzFindFrames(audio_format_t format, const uint8_t *data, size_t size)
+{
+    FrameScanner *scanner = createFrameScanner(format);
+    FrameScanner::FrameBoundary frames[4];
+    uint64_t position = 0;
+    while (size > 0) {
+        size_t bytesConsumed;
+        const size_t numFrames = scanner->findFrames(data, size, frames, 4, &bytesConsumed);
+        if (bytesConsumed == 0 || bytesConsumed > size) {
+            abort();
+        }
+        for (size_t i = 0; i < numFrames; ++i) {
+            if (frames[i].position < position || frames[i].frameSizeBytes == 0) {
+                abort();
+            }
+            position = frames[i].position;
+        }
+        data += bytesConsumed;
+        size -= bytesConsumed;
+    }
+    delete scanner;
+}
+
+// Use the data both as the bit stream and as the sequence of field widths.
+static void fuzzBitFieldParser(const uint8_t *data, size_t size)
+{
+    BitFieldParser parser(data, size);
+    for (size_t i = 0; i < size && !parser.overrun(); ++i) {
+        const uint32_t numBits = data[i] % 33;
+        const size_t cursor = parser.getBitCursor();
+        if (data[i] & 0x80) {
+            parser.skipBits(numBits * 3);
+        } else if (parser.peekBits(numBits) != parser.readBits(numBits)) {
+            abort();
+        }
+        if (parser.getBitCursor() < cursor) {
+            abort();
+        }
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < 2) {
+        return 0;
+    }
+    const audio_format_t format = kFormats[data[0] % (sizeof(kFormats) / sizeof(kFormats[0]))];
+    const size_t writeBytes = data[1] * 16 + 1;
+    data += 2;
+    size -= 2;
+
+    fuzzEncoder(format, writeBytes, data, size);
+    fuzzFindFrames(format, data, size);
+    fuzzBitFieldParser(data, size);
+    return 0;
+}
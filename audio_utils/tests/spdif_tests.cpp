@@ -0,0 +1,652 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_spdif_tests"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+#include <audio_utils/spdif/BitFieldParser.h>
+#include <audio_utils/spdif/SPDIFDecoder.h>
+#include <audio_utils/spdif/SPDIFEncoder.h>
+
+#include "../spdif/AC3FrameScanner.h"
+#include "../spdif/DTSHDFrameScanner.h"
+#include "../spdif/TrueHDFrameScanner.h"
+
+using namespace android;
+
+// AC3 frames of 256 bytes at 48 kHz, from frmsizcod 8 in AC3 spec table 5.13
+static const size_t kAC3FrameSize = 256;
+
+// Append an AC3 frame with bsid 8 and a random payload.
+static void appendAC3Frame(std::vector<uint8_t> &stream, uint8_t bsmod)
+{
+    const uint8_t header[] = { 0x0B, 0x77, 0x12, 0x34, (0 << 6) | 8,
+            (uint8_t) ((8 << 3) | bsmod) };
+    stream.insert(stream.end(), header, header + sizeof(header));
+    for (size_t i = sizeof(header); i < kAC3FrameSize; ++i) {
+        stream.push_back(rand());
+    }
+}
+
+// Frames separated by garbage, some of which looks like the start of a sync word.
+static std::vector<uint8_t> makeAC3Stream(size_t numFrames, std::vector<uint64_t> &positions)
+{
+    std::vector<uint8_t> stream;
+    for (size_t i = 0; i < numFrames; ++i) {
+        const size_t garbage = i % 3 == 0 ? 0 : rand() % 40;
+        for (size_t j = 0; j < garbage; ++j) {
+            stream.push_back(j % 5 == 0 ? 0x0B : 0x42);
+        }
+        positions.push_back(stream.size());
+        appendAC3Frame(stream, i & 7);
+    }
+    return stream;
+}
+
+// Scan the stream byte by byte with the reference, and with scanBytes() in buffers of varying
+// size, which split sync words and headers. Both find the same headers.
+static void expectScanBytesMatchesScan(FrameScanner &reference, FrameScanner &scanner,
+        const std::vector<uint8_t> &stream, size_t minHeaders)
+{
+    std::vector<uint64_t> expected;
+    for (size_t i = 0; i < stream.size(); ++i) {
+        if (reference.scan(stream[i])) {
+            expected.push_back(reference.getPosition() - reference.getHeaderSizeBytes());
+        }
+    }
+    EXPECT_LE(minHeaders, expected.size());
+
+    std::vector<uint64_t> actual;
+    for (size_t i = 0, count = 1; i < stream.size(); count = count * 7 % 101 + 1) {
+        const size_t numBytes = std::min(count, stream.size() - i);
+        bool found;
+        const size_t scanned = scanner.scanBytes(&stream[i], numBytes, &found);
+        ASSERT_LE(scanned, numBytes);
+        i += scanned;
+        EXPECT_EQ(i, scanner.getPosition());
+        if (found) {
+            actual.push_back(scanner.getPosition() - scanner.getHeaderSizeBytes());
+            EXPECT_EQ(0, memcmp(&stream[actual.back()], scanner.getHeaderAddress(),
+                    scanner.getHeaderSizeBytes()));
+        } else {
+            ASSERT_EQ(numBytes, scanned);
+        }
+    }
+    EXPECT_EQ(expected, actual);
+}
+
+TEST(audio_utils_spdif, scan_bytes_matches_scan)
+{
+    std::vector<uint64_t> positions;
+    const std::vector<uint8_t> stream = makeAC3Stream(50, positions);
+    AC3FrameScanner reference;
+    AC3FrameScanner scanner;
+    expectScanBytesMatchesScan(reference, scanner, stream, positions.size());
+}
+
+TEST(audio_utils_spdif, find_frames)
+{
+    std::vector<uint64_t> positions;
+    const std::vector<uint8_t> stream = makeAC3Stream(100, positions);
+
+    AC3FrameScanner scanner;
+    std::vector<FrameScanner::FrameBoundary> frames;
+    FrameScanner::FrameBoundary batch[4];
+    for (size_t i = 0, count = 1; i < stream.size(); count = count * 13 % 997 + 1) {
+        const size_t numBytes = std::min(count, stream.size() - i);
+        size_t consumed;
+        const size_t numFrames = scanner.findFrames(&stream[i], numBytes, batch, 4, &consumed);
+        ASSERT_LE(consumed, numBytes);
+        if (numFrames < 4) {
+            ASSERT_EQ(numBytes, consumed);
+        }
+        frames.insert(frames.end(), batch, batch + numFrames);
+        i += consumed;
+    }
+
+    // The payloads are skipped, so sync words within them are not found.
+    ASSERT_EQ(positions.size(), frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        EXPECT_EQ(positions[i], frames[i].position);
+        EXPECT_EQ(kAC3FrameSize, frames[i].frameSizeBytes);
+        EXPECT_EQ(48000u, frames[i].sampleRate);
+        EXPECT_EQ(1u, frames[i].rateMultiplier);
+        EXPECT_EQ(1, frames[i].dataType);
+        EXPECT_EQ((int) (i & 7), frames[i].dataTypeInfo);
+        EXPECT_EQ(1536, frames[i].sampleFramesPerSyncFrame);
+    }
+}
+
+class CollectingEncoder : public SPDIFEncoder {
+public:
+    CollectingEncoder(audio_format_t format = AUDIO_FORMAT_AC3) : SPDIFEncoder(format) { }
+
+    virtual ssize_t writeOutput(const void *buffer, size_t numBytes) {
+        const uint16_t *shorts = (const uint16_t *) buffer;
+        mOutput.insert(mOutput.end(), shorts, shorts + numBytes / sizeof(uint16_t));
+        return numBytes;
+    }
+
+    std::vector<uint16_t> mOutput;
+};
+
+TEST(audio_utils_spdif, encoder_bursts)
+{
+    std::vector<uint64_t> positions;
+    const std::vector<uint8_t> stream = makeAC3Stream(20, positions);
+
+    CollectingEncoder whole;
+    EXPECT_EQ((ssize_t) stream.size(), whole.write(stream.data(), stream.size()));
+    CollectingEncoder pieces;
+    for (size_t i = 0, count = 1; i < stream.size(); i += count, count = count * 3 % 17 + 1) {
+        count = std::min(count, stream.size() - i);
+        EXPECT_EQ((ssize_t) count, pieces.write(&stream[i], count));
+    }
+    EXPECT_EQ(whole.mOutput, pieces.mOutput);
+
+    // one AC3 frame per burst of 1536 stereo frames
+    const size_t burstShorts = 1536 * 2;
+    ASSERT_EQ(positions.size() * burstShorts, whole.mOutput.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const uint16_t *burst = &whole.mOutput[i * burstShorts];
+        EXPECT_EQ(0xF872, burst[0]);
+        EXPECT_EQ(0x4E1F, burst[1]);
+        EXPECT_EQ(((i & 7) << 8) | 1, burst[2]);
+        EXPECT_EQ(kAC3FrameSize * 8, burst[3]);
+        for (size_t j = 0; j < kAC3FrameSize / 2; ++j) {
+            EXPECT_EQ((stream[positions[i] + 2 * j] << 8) | stream[positions[i] + 2 * j + 1],
+                    burst[4 + j]);
+        }
+        for (size_t j = 4 + kAC3FrameSize / 2; j < burstShorts; ++j) {
+            EXPECT_EQ(0, burst[j]);
+        }
+    }
+}
+
+class VectorEncoder : public CollectingEncoder {
+public:
+    virtual ssize_t writeOutputVector(const struct iovec *iov, int iovcnt) {
+        EXPECT_EQ(3, iovcnt);
+        ssize_t totalBytes = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            EXPECT_EQ(0u, iov[i].iov_len % getBytesPerOutputFrame());
+            mPieceSizes.push_back(iov[i].iov_len);
+            totalBytes += writeOutput(iov[i].iov_base, iov[i].iov_len);
+        }
+        return totalBytes;
+    }
+
+    std::vector<size_t> mPieceSizes;
+};
+
+TEST(audio_utils_spdif, encoder_output_vector)
+{
+    std::vector<uint64_t> positions;
+    const std::vector<uint8_t> stream = makeAC3Stream(10, positions);
+
+    CollectingEncoder whole;
+    whole.write(stream.data(), stream.size());
+    VectorEncoder pieces;
+    for (size_t i = 0, count = 1; i < stream.size(); i += count, count = count * 5 % 23 + 1) {
+        count = std::min(count, stream.size() - i);
+        pieces.write(&stream[i], count);
+    }
+    EXPECT_EQ(whole.mOutput, pieces.mOutput);
+
+    // preamble, payload and padding of each burst
+    ASSERT_EQ(3 * positions.size(), pieces.mPieceSizes.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        EXPECT_EQ(8u, pieces.mPieceSizes[3 * i]);
+        EXPECT_EQ(kAC3FrameSize, pieces.mPieceSizes[3 * i + 1]);
+        EXPECT_EQ(1536 * 4 - 8 - kAC3FrameSize, pieces.mPieceSizes[3 * i + 2]);
+    }
+}
+
+// Encode a stream written in pieces of varying size.
+static std::vector<uint16_t> encode(CollectingEncoder &encoder, const std::vector<uint8_t> &stream)
+{
+    for (size_t i = 0, count = 1; i < stream.size(); i += count, count = count * 7 % 1999 + 1) {
+        count = std::min(count, stream.size() - i);
+        EXPECT_EQ((ssize_t) count, encoder.write(&stream[i], count));
+    }
+    return encoder.mOutput;
+}
+
+// A data burst built from IEC 61937-1: the preamble, the payload packed into 16-bit words
+// with the first byte in the most significant byte, and zeros to the end of the burst.
+static void appendBurst(std::vector<uint16_t> &bursts, uint16_t pc, uint16_t pd,
+        const std::vector<uint8_t> &payload, size_t burstBytes)
+{
+    std::vector<uint16_t> burst(burstBytes / 2);
+    burst[0] = 0xF872;
+    burst[1] = 0x4E1F;
+    burst[2] = pc;
+    burst[3] = pd;
+    for (size_t i = 0; i < payload.size(); ++i) {
+        burst[4 + i / 2] |= payload[i] << (i & 1 ? 0 : 8);
+    }
+    bursts.insert(bursts.end(), burst.begin(), burst.end());
+}
+
+static void appendRandom(std::vector<uint8_t> &v, size_t numBytes)
+{
+    for (size_t i = 0; i < numBytes; ++i) {
+        v.push_back(rand());
+    }
+}
+
+// Write fields most significant bit first.
+class BitWriter {
+public:
+    void write(uint32_t value, int numBits) {
+        for (int i = numBits - 1; i >= 0; --i) {
+            if ((mBits & 7) == 0) {
+                mBytes.push_back(0);
+            }
+            mBytes.back() |= ((value >> i) & 1) << (7 - (mBits & 7));
+            ++mBits;
+        }
+    }
+    std::vector<uint8_t> mBytes;
+private:
+    size_t mBits = 0;
+};
+
+// An ADTS frame of AAC LC at 48 kHz, stereo.
+static std::vector<uint8_t> makeADTSFrame(size_t frameLength, int rawDataBlocks)
+{
+    BitWriter header;
+    header.write(0xFFF, 12);        // syncword
+    header.write(0, 1);             // id
+    header.write(0, 2);             // layer
+    header.write(1, 1);             // protection_absent
+    header.write(1, 2);             // profile
+    header.write(3, 4);             // sampling_frequency_index
+    header.write(0, 1);             // private_bit
+    header.write(2, 3);             // channel_configuration
+    header.write(0, 4);             // original_copy to copyright_identification_start
+    header.write(frameLength, 13);  // frame_length
+    header.write(0x7FF, 11);        // adts_buffer_fullness
+    header.write(rawDataBlocks - 1, 2);
+    std::vector<uint8_t> frame = header.mBytes;
+    appendRandom(frame, frameLength - frame.size());
+    return frame;
+}
+
+TEST(audio_utils_spdif, aac_bursts)
+{
+    ASSERT_TRUE(SPDIFEncoder::isFormatSupported(AUDIO_FORMAT_AAC_ADTS_LC));
+    std::vector<uint8_t> stream;
+    std::vector<uint16_t> expected;
+    const size_t lengths[] = { 300, 301, 4088, 7 };
+    for (size_t length : lengths) {
+        const std::vector<uint8_t> frame = makeADTSFrame(length, 1);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        appendBurst(expected, 7, length * 8, frame, 1024 * 4);
+    }
+    // frames of 2 raw data blocks are type 0x13, with twice the repetition period
+    const std::vector<uint8_t> frame = makeADTSFrame(5000, 2);
+    stream.insert(stream.end(), frame.begin(), frame.end());
+    appendBurst(expected, 0x13, 5000 * 8, frame, 2048 * 4);
+
+    CollectingEncoder encoder(AUDIO_FORMAT_AAC_ADTS_LC);
+    EXPECT_EQ(expected, encode(encoder, stream));
+    EXPECT_EQ(2, encoder.getOutputChannelCount());
+    EXPECT_EQ(1u, encoder.getRateMultiplier());
+}
+
+// An MPEG audio frame header without CRC.
+static std::vector<uint8_t> makeMPEGHeader(int id, int layer, int bitrateIndex,
+        int samplingFrequency, int padding)
+{
+    BitWriter header;
+    header.write(0xFFF, 12);        // syncword
+    header.write(id, 1);
+    header.write(4 - layer, 2);
+    header.write(1, 1);             // protection_bit
+    header.write(bitrateIndex, 4);
+    header.write(samplingFrequency, 2);
+    header.write(padding, 1);
+    header.write(0, 9);             // private_bit to emphasis
+    return header.mBytes;
+}
+
+TEST(audio_utils_spdif, mpeg_bursts)
+{
+    struct {
+        int id, layer, bitrateIndex, samplingFrequency, padding;
+        size_t frameSize;
+        uint16_t pc;
+        size_t burstFrames;
+        uint32_t rateMultiplier;
+    } cases[] = {
+        { 1, 2, 10, 1, 0, 576, 5, 1152, 1 },    // MPEG-1 layer II, 192 kbit/s at 48 kHz
+        { 1, 3, 9, 0, 1, 418, 5, 1152, 1 },     // MPEG-1 layer III, 128 kbit/s at 44.1 kHz
+        { 1, 1, 12, 1, 0, 384, 4, 384, 1 },     // MPEG-1 layer I, 384 kbit/s at 48 kHz
+        { 0, 3, 8, 1, 1, 193, 10, 1152, 2 },    // MPEG-2 layer III, 64 kbit/s at 24 kHz
+        { 0, 2, 8, 1, 0, 384, 9, 2304, 2 },     // MPEG-2 layer II, 64 kbit/s at 24 kHz
+        { 0, 1, 8, 1, 0, 256, 8, 768, 2 },       // MPEG-2 layer I, 128 kbit/s at 24 kHz
+    };
+    for (const auto &c : cases) {
+        std::vector<uint8_t> stream;
+        std::vector<uint16_t> expected;
+        appendRandom(stream, 3);
+        for (int i = 0; i < 3; ++i) {
+            std::vector<uint8_t> frame = makeMPEGHeader(c.id, c.layer, c.bitrateIndex,
+                    c.samplingFrequency, c.padding);
+            appendRandom(frame, c.frameSize - frame.size());
+            stream.insert(stream.end(), frame.begin(), frame.end());
+            appendBurst(expected, c.pc, c.frameSize * 8, frame, c.burstFrames * 4);
+        }
+        CollectingEncoder encoder(c.layer == 3 ? AUDIO_FORMAT_MP3 : AUDIO_FORMAT_MP2);
+        EXPECT_EQ(expected, encode(encoder, stream)) << "pc " << c.pc;
+        EXPECT_EQ(c.rateMultiplier, encoder.getRateMultiplier());
+    }
+}
+
+// A TrueHD access unit, with a major sync for 48 kHz if requested.
+static std::vector<uint8_t> makeTrueHDAccessUnit(size_t numBytes, bool majorSync)
+{
+    std::vector<uint8_t> unit = { (uint8_t) (0xF0 | (numBytes >> 9)), (uint8_t) (numBytes >> 1),
+            0x12, 0x34 };
+    if (majorSync) {
+        const uint8_t sync[] = { 0xF8, 0x72, 0x6F, 0xBA, 0x00 };
+        unit.insert(unit.end(), sync, sync + sizeof(sync));
+    }
+    appendRandom(unit, numBytes - unit.size());
+    return unit;
+}
+
+TEST(audio_utils_spdif, truehd_mat_bursts)
+{
+    ASSERT_TRUE(SPDIFEncoder::isFormatSupported(AUDIO_FORMAT_DOLBY_TRUEHD));
+    static const uint8_t startCode[] = { 0x07, 0x9E, 0x00, 0x03, 0x84, 0x01, 0x01, 0x01,
+            0x80, 0x00, 0x56, 0xA5, 0x3B, 0xF4, 0x81, 0x83, 0x49, 0x80, 0x77, 0xE0 };
+    static const uint8_t middleCode[] = { 0xC3, 0xC1, 0x42, 0x49, 0x3B, 0xFA, 0x82, 0x83,
+            0x49, 0x80, 0x77, 0xE0 };
+    static const uint8_t endCode[] = { 0xC3, 0xC2, 0xC0, 0xC4, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00, 0x97, 0x11, 0x00, 0x00, 0x00, 0x00 };
+
+    // garbage, then two MAT frames of access units, the first with a major sync
+    std::vector<uint8_t> stream;
+    appendRandom(stream, 37);
+    std::vector<uint16_t> expected;
+    for (int burst = 0; burst < 2; ++burst) {
+        std::vector<uint8_t> mat(61424);
+        memcpy(&mat[0], startCode, sizeof(startCode));
+        memcpy(&mat[30708], middleCode, sizeof(middleCode));
+        memcpy(&mat[61424 - sizeof(endCode)], endCode, sizeof(endCode));
+        for (int i = 0; i < 24; ++i) {
+            const size_t size = 2 * (600 + rand() % 600);
+            const std::vector<uint8_t> unit = makeTrueHDAccessUnit(size, burst == 0 && i == 0);
+            stream.insert(stream.end(), unit.begin(), unit.end());
+            const size_t offset = i == 0 ? 20 : i == 12 ? 30720 : i * 2560 - 8;
+            memcpy(&mat[offset], unit.data(), unit.size());
+        }
+        appendBurst(expected, 22, 61424, mat, 61440);
+    }
+
+    CollectingEncoder encoder(AUDIO_FORMAT_DOLBY_TRUEHD);
+    EXPECT_EQ(expected, encode(encoder, stream));
+    EXPECT_EQ(8, encoder.getOutputChannelCount());
+    EXPECT_EQ(16, encoder.getBytesPerOutputFrame());
+    EXPECT_EQ(4u, encoder.getRateMultiplier());
+}
+
+// A DTS core frame of 512 PCM frames at 48 kHz.
+static std::vector<uint8_t> makeDTSCoreFrame(size_t numBytes)
+{
+    BitWriter frame;
+    frame.write(0x7FFE8001, 32);    // sync
+    frame.write(1, 1);              // ftype
+    frame.write(31, 5);             // deficit
+    frame.write(0, 1);              // cpf
+    frame.write(15, 7);             // nblks
+    frame.write(numBytes - 1, 14);  // fsize
+    frame.write(9, 6);              // amode
+    frame.write(13, 4);             // sfreq
+    frame.write(0, 26);
+    appendRandom(frame.mBytes, numBytes - frame.mBytes.size());
+    return frame.mBytes;
+}
+
+// A DTS extension substream.
+static std::vector<uint8_t> makeDTSExtension(size_t numBytes)
+{
+    BitWriter frame;
+    frame.write(0x64582025, 32);    // sync
+    frame.write(0, 8);              // UserDefinedBits
+    frame.write(0, 2);              // nExtSSIndex
+    frame.write(1, 1);              // bHeaderSizeType
+    frame.write(15, 12);            // nuExtSSHeaderSize
+    frame.write(numBytes - 1, 20);  // nuExtSSFsize
+    frame.write(0, 5);
+    appendRandom(frame.mBytes, numBytes - frame.mBytes.size());
+    return frame.mBytes;
+}
+
+TEST(audio_utils_spdif, dtshd_hbr_bursts)
+{
+    static const uint8_t startCode[] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0xFE, 0xFE };
+    // cores with and without extension substreams, of odd and even sizes
+    const size_t coreSizes[] = { 1005, 2012, 1003, 998 };
+    const size_t extensionSizes[] = { 3000, 15001, 0, 7 * 1024 };
+    std::vector<uint8_t> stream;
+    std::vector<uint16_t> expected;
+    for (size_t i = 0; i < sizeof(coreSizes) / sizeof(coreSizes[0]); ++i) {
+        std::vector<uint8_t> payload(startCode, startCode + sizeof(startCode));
+        const size_t frameBytes = coreSizes[i] + extensionSizes[i];
+        payload.push_back(frameBytes >> 8);
+        payload.push_back(frameBytes);
+        std::vector<uint8_t> frames = makeDTSCoreFrame(coreSizes[i]);
+        if (extensionSizes[i] > 0) {
+            const std::vector<uint8_t> extension = makeDTSExtension(extensionSizes[i]);
+            frames.insert(frames.end(), extension.begin(), extension.end());
+        }
+        stream.insert(stream.end(), frames.begin(), frames.end());
+        payload.insert(payload.end(), frames.begin(), frames.end());
+        // type IV with subtype 4 for 512 frames at 48 kHz, length rounded to 8 modulo 16
+        appendBurst(expected, (4 << 8) | 17, ((payload.size() + 8 + 15) & ~15) - 8, payload,
+                2048 * 16);
+    }
+
+    CollectingEncoder encoder(AUDIO_FORMAT_DTS_HD);
+    EXPECT_EQ(expected, encode(encoder, stream));
+    EXPECT_EQ(8, encoder.getOutputChannelCount());
+    EXPECT_EQ(4u, encoder.getRateMultiplier());
+}
+
+// Garbage between frames, some of which looks like the start of a sync word.
+static void appendGarbage(std::vector<uint8_t> &stream, const uint8_t *syncBytes)
+{
+    const size_t garbage = rand() % 40;
+    for (size_t j = 0; j < garbage; ++j) {
+        stream.push_back(j % 5 == 0 ? syncBytes[j % 2] : 0x42);
+    }
+}
+
+TEST(audio_utils_spdif, scan_bytes_matches_scan_hd)
+{
+    // cores and extension substreams, and the first bytes of both sync words
+    std::vector<uint8_t> stream;
+    static const uint8_t dtsSyncBytes[] = { 0x7F, 0x64 };
+    for (size_t i = 0; i < 20; ++i) {
+        appendGarbage(stream, dtsSyncBytes);
+        const std::vector<uint8_t> frame =
+                i % 2 == 0 ? makeDTSCoreFrame(100 + i) : makeDTSExtension(100 + i);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    DTSHDFrameScanner dtsReference;
+    DTSHDFrameScanner dtsScanner;
+    expectScanBytesMatchesScan(dtsReference, dtsScanner, stream, 20);
+
+    // access units with and without a major sync, which are found while synchronized
+    stream.clear();
+    static const uint8_t trueHDSyncBytes[] = { 0xF8, 0x72 };
+    for (size_t i = 0; i < 40; ++i) {
+        if (i % 4 == 0) {
+            appendGarbage(stream, trueHDSyncBytes);
+        }
+        const std::vector<uint8_t> unit = makeTrueHDAccessUnit(2 * (10 + i), i % 4 < 2);
+        stream.insert(stream.end(), unit.begin(), unit.end());
+    }
+    TrueHDFrameScanner trueHDReference;
+    TrueHDFrameScanner trueHDScanner;
+    expectScanBytesMatchesScan(trueHDReference, trueHDScanner, stream, 10);
+}
+
+// Read a big-endian field one bit at a time, with zeros past the end of the data.
+static uint32_t referenceBits(const std::vector<uint8_t> &data, size_t bitCursor, uint32_t numBits)
+{
+    uint32_t value = 0;
+    for (size_t i = bitCursor; i < bitCursor + numBits; ++i) {
+        const uint32_t bit = i / 8 < data.size() ? (data[i / 8] >> (7 - i % 8)) & 1 : 0;
+        value = (value << 1) | bit;
+    }
+    return value;
+}
+
+TEST(audio_utils_spdif, bit_field_parser)
+{
+    for (size_t numBytes = 0; numBytes < 40; ++numBytes) {
+        std::vector<uint8_t> data;
+        appendRandom(data, numBytes);
+        BitFieldParser parser(data.data(), data.size());
+        size_t cursor = 0;
+        // fields of every width up to 32 bits, with occasional long skips
+        for (uint32_t i = 0; cursor <= numBytes * 8 + 32; ++i) {
+            const uint32_t numBits = i * 7 % 33;
+            ASSERT_EQ(referenceBits(data, cursor, numBits), parser.peekBits(numBits));
+            if (i % 5 == 4) {
+                const size_t skip = numBits * 3;
+                parser.skipBits(skip);
+                cursor += skip;
+            } else {
+                ASSERT_EQ(referenceBits(data, cursor, numBits), parser.readBits(numBits))
+                        << "numBytes " << numBytes << " cursor " << cursor;
+                cursor += numBits;
+            }
+            ASSERT_EQ(cursor, parser.getBitCursor());
+            EXPECT_EQ(cursor > numBytes * 8, parser.overrun());
+            EXPECT_EQ(cursor > numBytes * 8 ? 0 : numBytes * 8 - cursor,
+                    parser.getBitsRemaining());
+        }
+    }
+}
+
+class CollectingDecoder : public SPDIFDecoder {
+public:
+    CollectingDecoder(int channelCount, uint32_t sampleRate)
+        : SPDIFDecoder(channelCount, sampleRate) { }
+
+    virtual ssize_t writeOutput(const void *payload, size_t numBytes, const BurstInfo &info) {
+        const uint8_t *bytes = (const uint8_t *) payload;
+        mPayloads.push_back(std::vector<uint8_t>(bytes, bytes + numBytes));
+        mInfos.push_back(info);
+        return numBytes;
+    }
+
+    std::vector<std::vector<uint8_t> > mPayloads;
+    std::vector<BurstInfo> mInfos;
+};
+
+// Decode PCM written in pieces of a varying number of frames.
+static void decode(CollectingDecoder &decoder, const std::vector<uint16_t> &pcm)
+{
+    const size_t frameWords = decoder.getBytesPerInputFrame() / sizeof(uint16_t);
+    for (size_t i = 0, frames = 1; i < pcm.size(); frames = frames * 11 % 3001 + 1) {
+        const size_t count = std::min(frames * frameWords, pcm.size() - i);
+        std::vector<uint16_t> buffer(pcm.begin() + i, pcm.begin() + i + count);
+        EXPECT_EQ((ssize_t) (count * sizeof(uint16_t)),
+                decoder.write(buffer.data(), count * sizeof(uint16_t)));
+        i += count;
+    }
+}
+
+TEST(audio_utils_spdif, decoder_round_trip)
+{
+    static const size_t kSilenceFrames = 100;
+    static const uint32_t kSampleRate = 48000;
+    std::vector<uint64_t> positions;
+    const std::vector<uint8_t> stream = makeAC3Stream(20, positions);
+    CollectingEncoder encoder;
+    std::vector<uint16_t> pcm(kSilenceFrames * 2);
+    const std::vector<uint16_t> bursts = encode(encoder, stream);
+    pcm.insert(pcm.end(), bursts.begin(), bursts.end());
+
+    // a burst with the error flag set, one of an unknown data type, then a good one
+    std::vector<uint8_t> frame;
+    appendAC3Frame(frame, 0);
+    appendBurst(pcm, 0x80 | 1, kAC3FrameSize * 8, frame, 1536 * 4);
+    appendBurst(pcm, 0x1F, kAC3FrameSize * 8, frame, 1536 * 4);
+    appendBurst(pcm, 1, kAC3FrameSize * 8, frame, 1536 * 4);
+
+    CollectingDecoder decoder(2, kSampleRate);
+    EXPECT_EQ(-EINVAL, decoder.write(pcm.data(), 2));
+    decode(decoder, pcm);
+    ASSERT_EQ(positions.size() + 1, decoder.mPayloads.size());
+    EXPECT_EQ(positions.size() + 1, decoder.getBurstCount());
+    EXPECT_EQ(2u, decoder.getDroppedBurstCount());
+    for (size_t i = 0; i <= positions.size(); ++i) {
+        const uint8_t *start = i < positions.size() ? &stream[positions[i]] : frame.data();
+        const std::vector<uint8_t> expected(start, start + kAC3FrameSize);
+        EXPECT_EQ(expected, decoder.mPayloads[i]) << "burst " << i;
+        const SPDIFDecoder::BurstInfo &info = decoder.mInfos[i];
+        EXPECT_EQ(1, info.dataType);
+        EXPECT_EQ(i < positions.size() ? (int) (i & 7) : 0, info.dataTypeInfo);
+        const uint64_t position = kSilenceFrames + (i < positions.size() ? i : i + 2) * 1536;
+        EXPECT_EQ(position, info.position);
+        EXPECT_EQ((int64_t) (position * 1000000000 / kSampleRate), info.timestampNs);
+        EXPECT_EQ(1536u, info.burstFrames);
+    }
+}
+
+TEST(audio_utils_spdif, decoder_hbr)
+{
+    std::vector<uint8_t> stream;
+    std::vector<std::vector<uint8_t> > frames;
+    for (size_t i = 0; i < 5; ++i) {
+        std::vector<uint8_t> frame = makeDTSCoreFrame(1001 + i);
+        const std::vector<uint8_t> extension = makeDTSExtension(5000 + i * 3);
+        frame.insert(frame.end(), extension.begin(), extension.end());
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        frames.push_back(frame);
+    }
+    CollectingEncoder encoder(AUDIO_FORMAT_DTS_HD);
+    const std::vector<uint16_t> pcm = encode(encoder, stream);
+
+    CollectingDecoder decoder(8, 192000);
+    decode(decoder, pcm);
+    ASSERT_EQ(frames.size(), decoder.mPayloads.size());
+    EXPECT_EQ(0u, decoder.getDroppedBurstCount());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        // the start code and frame size, the frames, then padding to 8 modulo 16
+        const std::vector<uint8_t> &payload = decoder.mPayloads[i];
+        ASSERT_EQ(((frames[i].size() + 12 + 8 + 15) & ~15) - 8, payload.size());
+        EXPECT_EQ(0x01, payload[0]);
+        EXPECT_EQ(frames[i].size(), (size_t) ((payload[10] << 8) | payload[11]));
+        EXPECT_TRUE(std::equal(frames[i].begin(), frames[i].end(), payload.begin() + 12));
+        EXPECT_EQ(17, decoder.mInfos[i].dataType);
+        EXPECT_EQ(4, decoder.mInfos[i].dataTypeInfo);
+        EXPECT_EQ(2048u, decoder.mInfos[i].burstFrames);
+        EXPECT_EQ(i * 2048, decoder.mInfos[i].position);
+    }
+}
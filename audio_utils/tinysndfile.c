@@ -14,7 +14,12 @@
  * limitations under the License.
  */
 
+// 64-bit file offsets for RF64 files on 32-bit hosts
+#define _FILE_OFFSET_BITS 64
+
 #include <system/audio.h>
+#include <audio_utils/fifo.h>
+#include <audio_utils/format.h>
 #include <audio_utils/sndfile.h>
 #include <audio_utils/primitives.h>
 #ifdef HAVE_STDERR
@@ -22,18 +27,67 @@
 #endif
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define WAVE_FORMAT_PCM         1
 #define WAVE_FORMAT_IEEE_FLOAT  3
 #define WAVE_FORMAT_EXTENSIBLE  0xFFFE
 
+// A RIFF or data chunk size of 0xFFFFFFFF in an RF64 file means that the size is in the ds64 chunk
+#define RF64_SIZE_IN_DS64       0xFFFFFFFFu
+#define DS64_SIZE               28
+
+// Largest RIFF size of a classic header; larger files are written as RF64.
+// Tests build with a small limit to exercise the switch.
+#ifndef RIFF_SIZE_MAX
+#define RIFF_SIZE_MAX           UINT32_MAX
+#endif
+
+// Size of the blocks of frames converted by reads and writes
+#define BLOCK_BYTES             65536
+
+// Size of the stack buffer of positional reads
+#define PREAD_BLOCK_BYTES       4096
+
+// Largest header written by sf_write_header(): RIFF, JUNK or ds64, extensible fmt, fact and data
+#define HEADER_MAX              (12 + 8 + DS64_SIZE + 8 + 40 + 12 + 8)
+
+// Ring capacity and polling period of the I/O thread for SFM_ASYNC
+#define ASYNC_RING_MS           1000
+#define ASYNC_MIN_RING_FRAMES   4096
+#define ASYNC_POLL_US           10000
+#define ASYNC_CHUNK_BYTES       65536
+
+// State of an SFM_ASYNC writer. The caller thread is the only writer to the FIFO
+// and the I/O thread is the only reader.
+struct sf_async {
+    struct audio_utils_fifo fifo;
+    void *ring;                     // buffer of the FIFO
+    uint8_t *chunk;                 // I/O thread buffer for fwrite
+    size_t chunkFrames;
+    pthread_t thread;
+    atomic_bool exit;               // set by sf_close to drain and stop the I/O thread
+    atomic_uint_least64_t overruns; // frames dropped because the ring was full
+};
+
 struct SNDFILE_ {
     int mode;
-    uint8_t *temp;  // realloc buffer used for shrinking 16 bits to 8 bits and byte-swapping
+    uint8_t *temp;  // buffer for converting and byte-swapping blocks of frames
+    size_t tempSize;
     FILE *stream;
     size_t bytesPerFrame;
-    size_t remaining;   // frames unread for SFM_READ, frames written for SFM_WRITE
+    sf_count_t remaining;   // frames unread for SFM_READ, frames written for SFM_WRITE
     SF_INFO info;
+    uint32_t channelMask;   // WAVE speaker positions, or 0 if not specified
+    struct sf_async *async;    // for SFM_ASYNC, or NULL
+    uint8_t *map;       // mapping of the whole file for SFM_MMAP, or NULL
+    size_t mapSize;     // size of map in bytes
+    size_t dataOffset;  // offset of the first frame of the data chunk
 };
 
 static unsigned little2u(unsigned char *ptr)
@@ -43,7 +97,12 @@ static unsigned little2u(unsigned char *ptr)
 
 static unsigned little4u(unsigned char *ptr)
 {
-    return (ptr[3] << 24) + (ptr[2] << 16) + (ptr[1] << 8) + ptr[0];
+    return ((unsigned) ptr[3] << 24) + (ptr[2] << 16) + (ptr[1] << 8) + ptr[0];
+}
+
+static uint64_t little8u(unsigned char *ptr)
+{
+    return ((uint64_t) little4u(&ptr[4]) << 32) + little4u(ptr);
 }
 
 static int isLittleEndian(void)
@@ -62,7 +121,30 @@ static void my_swab(short *ptr, size_t numToSwap)
     }
 }
 
-static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
+// Map the whole file for SFM_MMAP; on failure reads continue through stdio
+static void sf_map(SNDFILE *handle)
+{
+    struct stat st;
+    int fd = fileno(handle->stream);
+    if (fstat(fd, &st) < 0 || st.st_size <= 0 || (uint64_t) st.st_size > SIZE_MAX) {
+#ifdef HAVE_STDERR
+        fprintf(stderr, "not mapping, fstat errno %d\n", errno);
+#endif
+        return;
+    }
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+#ifdef HAVE_STDERR
+        fprintf(stderr, "mmap failed errno %d\n", errno);
+#endif
+        return;
+    }
+    (void) madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+    handle->map = (uint8_t *) map;
+    handle->mapSize = (size_t) st.st_size;
+}
+
+static SNDFILE *sf_open_read(const char *path, SF_INFO *info, int mmapped)
 {
     FILE *stream = fopen(path, "rb");
     if (stream == NULL) {
@@ -75,8 +157,13 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
     SNDFILE *handle = (SNDFILE *) malloc(sizeof(SNDFILE));
     handle->mode = SFM_READ;
     handle->temp = NULL;
+    handle->tempSize = 0;
     handle->stream = stream;
     handle->info.format = SF_FORMAT_WAV;
+    handle->channelMask = 0;
+    handle->async = NULL;
+    handle->map = NULL;
+    handle->mapSize = 0;
 
     // don't attempt to parse all valid forms, just the most common ones
     unsigned char wav[12];
@@ -88,29 +175,62 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
 #endif
         goto close;
     }
-    if (memcmp(wav, "RIFF", 4)) {
+    // RF64 (EBU Tech 3306) and BW64 have the same layout as RIFF, with 64-bit sizes in ds64
+    int rf64 = !memcmp(wav, "RF64", 4) || !memcmp(wav, "BW64", 4);
+    if (memcmp(wav, "RIFF", 4) && !rf64) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "wav != RIFF\n");
+        fprintf(stderr, "wav != RIFF or RF64\n");
 #endif
         goto close;
     }
-    unsigned riffSize = little4u(&wav[4]);
-    if (riffSize < 4) {
+    uint64_t riffSize = little4u(&wav[4]);
+    if (memcmp(&wav[8], "WAVE", 4)) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "riffSize %u < 4\n", riffSize);
+        fprintf(stderr, "missing WAVE\n");
 #endif
         goto close;
     }
-    if (memcmp(&wav[8], "WAVE", 4)) {
+    uint64_t dataSize64 = 0;
+    if (rf64) {
+        // ds64 must be the first chunk
+        unsigned char ds64[8 + DS64_SIZE];
+        actual = fread(ds64, sizeof(char), sizeof(ds64), stream);
+        if (actual != sizeof(ds64) || memcmp(ds64, "ds64", 4) ||
+                little4u(&ds64[4]) < DS64_SIZE) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "missing WAVE\n");
+            fprintf(stderr, "missing ds64\n");
+#endif
+            goto close;
+        }
+        unsigned ds64Size = little4u(&ds64[4]);
+        if (riffSize == RF64_SIZE_IN_DS64) {
+            riffSize = little8u(&ds64[8]);
+        }
+        dataSize64 = little8u(&ds64[16]);
+        // ignore sample count and table
+        if (ds64Size > DS64_SIZE) {
+            fseeko(stream, (off_t) (ds64Size - DS64_SIZE + (ds64Size & 1)), SEEK_CUR);
+        }
+        // the chunk loop below starts after ds64
+        uint64_t ds64Bytes = 8 + ds64Size + (ds64Size & 1);
+        if (riffSize < 4 + ds64Bytes) {
+#ifdef HAVE_STDERR
+            fprintf(stderr, "riffSize %llu too small for ds64\n", (unsigned long long) riffSize);
+#endif
+            goto close;
+        }
+        riffSize -= ds64Bytes;
+    }
+    if (riffSize < 4) {
+#ifdef HAVE_STDERR
+        fprintf(stderr, "riffSize %llu < 4\n", (unsigned long long) riffSize);
 #endif
         goto close;
     }
-    size_t remaining = riffSize - 4;
+    uint64_t remaining = riffSize - 4;
     int hadFmt = 0;
     int hadData = 0;
-    long dataTell = 0L;
+    off_t dataTell = 0;
     while (remaining >= 8) {
         unsigned char chunk[8];
         actual = fread(chunk, sizeof(char), sizeof(chunk), stream);
@@ -121,13 +241,19 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             goto close;
         }
         remaining -= 8;
-        unsigned chunkSize = little4u(&chunk[4]);
+        uint64_t chunkSize = little4u(&chunk[4]);
+        if (rf64 && chunkSize == RF64_SIZE_IN_DS64 && !memcmp(&chunk[0], "data", 4)) {
+            chunkSize = dataSize64;
+        }
         if (chunkSize > remaining) {
 #ifdef HAVE_STDERR
-            fprintf(stderr, "chunkSize %u > remaining %zu\n", chunkSize, remaining);
+            fprintf(stderr, "chunkSize %llu > remaining %llu\n", (unsigned long long) chunkSize,
+                    (unsigned long long) remaining);
 #endif
             goto close;
         }
+        // chunks are padded to an even size
+        uint64_t padding = (chunkSize & 1) && remaining > chunkSize ? 1 : 0;
         if (!memcmp(&chunk[0], "fmt ", 4)) {
             if (hadFmt) {
 #ifdef HAVE_STDERR
@@ -137,7 +263,7 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             }
             if (chunkSize < 2) {
 #ifdef HAVE_STDERR
-                fprintf(stderr, "chunkSize %u < 2\n", chunkSize);
+                fprintf(stderr, "chunkSize %llu < 2\n", (unsigned long long) chunkSize);
 #endif
                 goto close;
             }
@@ -167,19 +293,20 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             }
             if (chunkSize < minSize) {
 #ifdef HAVE_STDERR
-                fprintf(stderr, "chunkSize %u < minSize %zu\n", chunkSize, minSize);
+                fprintf(stderr, "chunkSize %llu < minSize %zu\n", (unsigned long long) chunkSize,
+                        minSize);
 #endif
                 goto close;
             }
             actual = fread(&fmt[2], sizeof(char), minSize - 2, stream);
             if (actual != minSize - 2) {
 #ifdef HAVE_STDERR
-                fprintf(stderr, "actual %zu != %zu\n", actual, minSize - 16);
+                fprintf(stderr, "actual %zu != %zu\n", actual, minSize - 2);
 #endif
                 goto close;
             }
-            if (chunkSize > minSize) {
-                fseek(stream, (long) (chunkSize - minSize), SEEK_CUR);
+            if (chunkSize + padding > minSize) {
+                fseeko(stream, (off_t) (chunkSize + padding - minSize), SEEK_CUR);
             }
             unsigned channels = little2u(&fmt[2]);
             if ((channels < 1) || (channels > FCC_8)) {
@@ -198,6 +325,18 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             // ignore byte rate
             // ignore block alignment
             unsigned bitsPerSample = little2u(&fmt[14]);
+            if (format == WAVE_FORMAT_EXTENSIBLE) {
+                // ignore valid bits per sample
+                handle->channelMask = little4u(&fmt[20]);
+                // the sub-format GUID starts with the format code
+                format = little2u(&fmt[24]);
+                if (format != WAVE_FORMAT_PCM && format != WAVE_FORMAT_IEEE_FLOAT) {
+#ifdef HAVE_STDERR
+                    fprintf(stderr, "unsupported sub-format %u\n", format);
+#endif
+                    goto close;
+                }
+            }
             if (bitsPerSample != 8 && bitsPerSample != 16 && bitsPerSample != 24 &&
                     bitsPerSample != 32) {
 #ifdef HAVE_STDERR
@@ -242,15 +381,15 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             }
             handle->remaining = chunkSize / handle->bytesPerFrame;
             handle->info.frames = handle->remaining;
-            dataTell = ftell(stream);
-            if (chunkSize > 0) {
-                fseek(stream, (long) chunkSize, SEEK_CUR);
+            dataTell = ftello(stream);
+            if (chunkSize + padding > 0) {
+                fseeko(stream, (off_t) (chunkSize + padding), SEEK_CUR);
             }
             hadData = 1;
-        } else if (!memcmp(&chunk[0], "fact", 4)) {
-            // ignore fact
-            if (chunkSize > 0) {
-                fseek(stream, (long) chunkSize, SEEK_CUR);
+        } else if (!memcmp(&chunk[0], "fact", 4) || !memcmp(&chunk[0], "JUNK", 4)) {
+            // ignore fact, and JUNK reserved for ds64
+            if (chunkSize + padding > 0) {
+                fseeko(stream, (off_t) (chunkSize + padding), SEEK_CUR);
             }
         } else {
             // ignore unknown chunk
@@ -258,15 +397,16 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
             fprintf(stderr, "ignoring unknown chunk %c%c%c%c\n",
                     chunk[0], chunk[1], chunk[2], chunk[3]);
 #endif
-            if (chunkSize > 0) {
-                fseek(stream, (long) chunkSize, SEEK_CUR);
+            if (chunkSize + padding > 0) {
+                fseeko(stream, (off_t) (chunkSize + padding), SEEK_CUR);
             }
         }
-        remaining -= chunkSize;
+        remaining -= chunkSize + padding;
     }
     if (remaining > 0) {
 #ifdef HAVE_STDERR
-        fprintf(stderr, "partial chunk at end of RIFF, remaining %zu\n", remaining);
+        fprintf(stderr, "partial chunk at end of RIFF, remaining %llu\n",
+                (unsigned long long) remaining);
 #endif
         goto close;
     }
@@ -276,7 +416,11 @@ static SNDFILE *sf_open_read(const char *path, SF_INFO *info)
 #endif
         goto close;
     }
-    (void) fseek(stream, dataTell, SEEK_SET);
+    (void) fseeko(stream, dataTell, SEEK_SET);
+    handle->dataOffset = dataTell;
+    if (mmapped) {
+        sf_map(handle);
+    }
     *info = handle->info;
     return handle;
 
@@ -294,7 +438,214 @@ static void write4u(unsigned char *ptr, unsigned u)
     ptr[3] = u >> 24;
 }
 
-static SNDFILE *sf_open_write(const char *path, SF_INFO *info)
+static void write2u(unsigned char *ptr, unsigned u)
+{
+    ptr[0] = u;
+    ptr[1] = u >> 8;
+}
+
+static void write8u(unsigned char *ptr, uint64_t u)
+{
+    write4u(ptr, (unsigned) u);
+    write4u(&ptr[4], (unsigned) (u >> 32));
+}
+
+static unsigned bitsPerSampleOf(int sub)
+{
+    switch (sub) {
+    case SF_FORMAT_PCM_16:
+        return 16;
+    case SF_FORMAT_PCM_U8:
+        return 8;
+    case SF_FORMAT_FLOAT:
+        return 32;
+    case SF_FORMAT_PCM_24:
+        return 24;
+    case SF_FORMAT_PCM_32:
+        return 32;
+    default:    // not reachable
+        return 0;
+    }
+}
+
+// WAVE_FORMAT_EXTENSIBLE is required for more than 2 channels or integer samples of more than
+// 16 bits; other files use the classic header that older readers expect
+static int isExtensible(const SF_INFO *info)
+{
+    int sub = info->format & SF_FORMAT_SUBMASK;
+    return info->channels > 2 || sub == SF_FORMAT_PCM_24 || sub == SF_FORMAT_PCM_32;
+}
+
+// The WAVE speaker positions have the same bits as the positional audio_channel_mask_t
+static uint32_t defaultChannelMask(int channels)
+{
+    return channels == 1 ? AUDIO_CHANNEL_OUT_FRONT_CENTER :
+            audio_channel_out_mask_from_count(channels);
+}
+
+// Build the header for a file of the given number of frames, and return its size.
+// The size depends only on the format, so the header written at open with no frames is
+// rewritten in place at close. A JUNK chunk reserves room for the ds64 chunk, and becomes
+// ds64 when the file is too large for RIFF.
+static size_t sf_write_header(const SNDFILE *handle, unsigned char *wav, uint64_t frames)
+{
+    int sub = handle->info.format & SF_FORMAT_SUBMASK;
+    int extensible = isExtensible(&handle->info);
+    unsigned bitsPerSample = bitsPerSampleOf(sub);
+    unsigned format = sub == SF_FORMAT_FLOAT ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    size_t fmtSize = extensible ? 40 : sub == SF_FORMAT_FLOAT ? 18 : 16;
+    memset(wav, 0, HEADER_MAX);
+    size_t size = 12 + 8 + DS64_SIZE;
+    memcpy(&wav[size], "fmt ", 4);
+    write4u(&wav[size + 4], fmtSize);
+    unsigned char *fmt = &wav[size + 8];
+    write2u(&fmt[0], extensible ? WAVE_FORMAT_EXTENSIBLE : format);
+    write2u(&fmt[2], handle->info.channels);
+    write4u(&fmt[4], handle->info.samplerate);
+    write4u(&fmt[8], handle->info.samplerate * handle->bytesPerFrame);    // byte rate
+    write2u(&fmt[12], handle->bytesPerFrame);                             // block alignment
+    write2u(&fmt[14], bitsPerSample);
+    if (extensible) {
+        write2u(&fmt[16], 22);                                  // extension size
+        write2u(&fmt[18], bitsPerSample);                       // valid bits per sample
+        write4u(&fmt[20], handle->channelMask);
+        // sub-format GUID: the format code, then the suffix 0000-0010-8000-00aa00389b71
+        static const unsigned char guid[14] = {
+            0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71
+        };
+        write2u(&fmt[24], format);
+        memcpy(&fmt[26], guid, sizeof(guid));
+    }
+    size += 8 + fmtSize;
+    int rf64 = 0;
+    uint64_t dataSize = frames * handle->bytesPerFrame;
+    // the data chunk is padded to an even size
+    uint64_t riffSize = size + (sub == SF_FORMAT_FLOAT ? 12 : 0) + 8 + dataSize + (dataSize & 1)
+            - 8;
+    if (riffSize > RIFF_SIZE_MAX) {
+        rf64 = 1;
+    }
+    if (sub == SF_FORMAT_FLOAT) {
+        memcpy(&wav[size], "fact", 4);
+        write4u(&wav[size + 4], 4);
+        write4u(&wav[size + 8], rf64 ? RF64_SIZE_IN_DS64 : (unsigned) frames);
+        size += 12;
+    }
+    memcpy(&wav[size], "data", 4);
+    write4u(&wav[size + 4], rf64 ? RF64_SIZE_IN_DS64 : (unsigned) dataSize);
+    size += 8;
+
+    memcpy(wav, rf64 ? "RF64" : "RIFF", 4);
+    write4u(&wav[4], rf64 ? RF64_SIZE_IN_DS64 : (unsigned) riffSize);
+    memcpy(&wav[8], "WAVE", 4);
+    memcpy(&wav[12], rf64 ? "ds64" : "JUNK", 4);
+    write4u(&wav[16], DS64_SIZE);
+    if (rf64) {
+        write8u(&wav[20], riffSize);
+        write8u(&wav[28], dataSize);
+        write8u(&wav[36], frames);
+        // no table
+    }
+    return size;
+}
+
+// The I/O thread of an SFM_ASYNC writer: moves frames from the ring to the file,
+// and counts the frames written for the header. Drains the ring before exiting.
+static void *sf_async_thread(void *arg)
+{
+    SNDFILE *handle = (SNDFILE *) arg;
+    struct sf_async *async = handle->async;
+    for (;;) {
+        // read the exit request first, so that all frames written before it are drained
+        bool exiting = atomic_load_explicit(&async->exit, memory_order_acquire);
+        ssize_t frames = audio_utils_fifo_read(&async->fifo, async->chunk, async->chunkFrames);
+        if (frames > 0) {
+            size_t actualBytes = fwrite(async->chunk, sizeof(char),
+                    frames * handle->bytesPerFrame, handle->stream);
+            handle->remaining += actualBytes / handle->bytesPerFrame;
+        } else if (exiting) {
+            break;
+        } else {
+            usleep(ASYNC_POLL_US);
+        }
+    }
+    return NULL;
+}
+
+static void sf_async_free(struct sf_async *async)
+{
+    if (async == NULL) {
+        return;
+    }
+    audio_utils_fifo_deinit(&async->fifo);
+    free(async->ring);
+    free(async->chunk);
+    free(async);
+}
+
+// Start the ring and I/O thread of an SFM_ASYNC writer
+static int sf_async_start(SNDFILE *handle)
+{
+    struct sf_async *async = (struct sf_async *) calloc(1, sizeof(struct sf_async));
+    if (async == NULL) {
+        return -ENOMEM;
+    }
+    size_t ringFrames = (size_t) handle->info.samplerate * ASYNC_RING_MS / 1000;
+    if (ringFrames < ASYNC_MIN_RING_FRAMES) {
+        ringFrames = ASYNC_MIN_RING_FRAMES;
+    }
+    async->chunkFrames = ASYNC_CHUNK_BYTES / handle->bytesPerFrame;
+    async->ring = malloc(ringFrames * handle->bytesPerFrame);
+    async->chunk = (uint8_t *) malloc(async->chunkFrames * handle->bytesPerFrame);
+    if (async->ring == NULL || async->chunk == NULL) {
+        sf_async_free(async);
+        return -ENOMEM;
+    }
+    audio_utils_fifo_init(&async->fifo, ringFrames, handle->bytesPerFrame, async->ring);
+    atomic_init(&async->exit, false);
+    atomic_init(&async->overruns, 0);
+    handle->async = async;
+    int err = pthread_create(&async->thread, NULL, sf_async_thread, handle);
+    if (err != 0) {
+        handle->async = NULL;
+        sf_async_free(async);
+        return -err;
+    }
+    return 0;
+}
+
+// Stop the I/O thread after it has drained the ring
+static void sf_async_stop(SNDFILE *handle)
+{
+    atomic_store_explicit(&handle->async->exit, true, memory_order_release);
+    (void) pthread_join(handle->async->thread, NULL);
+    sf_async_free(handle->async);
+    handle->async = NULL;
+}
+
+// Write frames that are in the file format, either directly or to the ring of an SFM_ASYNC
+// writer, and count them for the header. Returns the number of bytes accepted.
+static size_t sf_write_bytes(SNDFILE *handle, const void *ptr, size_t bytes)
+{
+    size_t frames = bytes / handle->bytesPerFrame;
+    if (handle->async != NULL) {
+        ssize_t actualFrames = audio_utils_fifo_write(&handle->async->fifo, ptr, frames);
+        if (actualFrames < 0) {
+            actualFrames = 0;
+        }
+        if ((size_t) actualFrames < frames) {
+            atomic_fetch_add_explicit(&handle->async->overruns, frames - actualFrames,
+                    memory_order_relaxed);
+        }
+        // the I/O thread counts the frames when it writes them
+        return actualFrames * handle->bytesPerFrame;
+    }
+    size_t actualBytes = fwrite(ptr, sizeof(char), bytes, handle->stream);
+    handle->remaining += actualBytes / handle->bytesPerFrame;
+    return actualBytes;
+}
+
+static SNDFILE *sf_open_write(const char *path, SF_INFO *info, int async)
 {
     int sub = info->format & SF_FORMAT_SUBMASK;
     if (!(
@@ -313,64 +664,30 @@ static SNDFILE *sf_open_write(const char *path, SF_INFO *info)
 #endif
         return NULL;
     }
-    unsigned char wav[58];
-    memset(wav, 0, sizeof(wav));
-    memcpy(wav, "RIFF", 4);
-    memcpy(&wav[8], "WAVEfmt ", 8);
-    if (sub == SF_FORMAT_FLOAT) {
-        wav[4] = 50;    // riffSize
-        wav[16] = 18;   // fmtSize
-        wav[20] = WAVE_FORMAT_IEEE_FLOAT;
-    } else {
-        wav[4] = 36;    // riffSize
-        wav[16] = 16;   // fmtSize
-        wav[20] = WAVE_FORMAT_PCM;
-    }
-    wav[22] = info->channels;
-    write4u(&wav[24], info->samplerate);
-    unsigned bitsPerSample;
-    switch (sub) {
-    case SF_FORMAT_PCM_16:
-        bitsPerSample = 16;
-        break;
-    case SF_FORMAT_PCM_U8:
-        bitsPerSample = 8;
-        break;
-    case SF_FORMAT_FLOAT:
-        bitsPerSample = 32;
-        break;
-    case SF_FORMAT_PCM_24:
-        bitsPerSample = 24;
-        break;
-    case SF_FORMAT_PCM_32:
-        bitsPerSample = 32;
-        break;
-    default:    // not reachable
-        bitsPerSample = 0;
-        break;
-    }
-    unsigned blockAlignment = (bitsPerSample >> 3) * info->channels;
-    unsigned byteRate = info->samplerate * blockAlignment;
-    write4u(&wav[28], byteRate);
-    wav[32] = blockAlignment;
-    wav[34] = bitsPerSample;
-    size_t extra = 0;
-    if (sub == SF_FORMAT_FLOAT) {
-        memcpy(&wav[38], "fact", 4);
-        wav[42] = 4;
-        memcpy(&wav[50], "data", 4);
-        extra = 14;
-    } else
-        memcpy(&wav[36], "data", 4);
-    // dataSize is initially zero
-    (void) fwrite(wav, 44 + extra, 1, stream);
     SNDFILE *handle = (SNDFILE *) malloc(sizeof(SNDFILE));
     handle->mode = SFM_WRITE;
     handle->temp = NULL;
+    handle->tempSize = 0;
     handle->stream = stream;
-    handle->bytesPerFrame = blockAlignment;
+    handle->bytesPerFrame = (bitsPerSampleOf(sub) >> 3) * info->channels;
     handle->remaining = 0;
     handle->info = *info;
+    handle->channelMask = defaultChannelMask(info->channels);
+    handle->async = NULL;
+    handle->map = NULL;
+    handle->mapSize = 0;
+    unsigned char wav[HEADER_MAX];
+    // dataSize is initially zero
+    handle->dataOffset = sf_write_header(handle, wav, 0);
+    (void) fwrite(wav, handle->dataOffset, 1, stream);
+    if (async && sf_async_start(handle) != 0) {
+#ifdef HAVE_STDERR
+        fprintf(stderr, "failed to start the I/O thread\n");
+#endif
+        fclose(stream);
+        free(handle);
+        return NULL;
+    }
     return handle;
 }
 
@@ -384,9 +701,13 @@ SNDFILE *sf_open(const char *path, int mode, SF_INFO *info)
     }
     switch (mode) {
     case SFM_READ:
-        return sf_open_read(path, info);
+        return sf_open_read(path, info, 0 /*mmapped*/);
+    case SFM_READ | SFM_MMAP:
+        return sf_open_read(path, info, 1 /*mmapped*/);
     case SFM_WRITE:
-        return sf_open_write(path, info);
+        return sf_open_write(path, info, 0 /*async*/);
+    case SFM_WRITE | SFM_ASYNC:
+        return sf_open_write(path, info, 1 /*async*/);
     default:
 #ifdef HAVE_STDERR
         fprintf(stderr, "mode=%d\n", mode);
@@ -399,250 +720,446 @@ void sf_close(SNDFILE *handle)
 {
     if (handle == NULL)
         return;
+    if (handle->async != NULL) {
+        sf_async_stop(handle);
+    }
     free(handle->temp);
     if (handle->mode == SFM_WRITE) {
+        if ((handle->remaining * handle->bytesPerFrame) & 1) {
+            (void) fputc(0, handle->stream);    // pad byte
+        }
         (void) fflush(handle->stream);
+        unsigned char wav[HEADER_MAX];
+        size_t size = sf_write_header(handle, wav, handle->remaining);
         rewind(handle->stream);
-        unsigned char wav[58];
-        size_t extra = (handle->info.format & SF_FORMAT_SUBMASK) == SF_FORMAT_FLOAT ? 14 : 0;
-        (void) fread(wav, 44 + extra, 1, handle->stream);
-        unsigned dataSize = handle->remaining * handle->bytesPerFrame;
-        write4u(&wav[4], dataSize + 36 + extra);    // riffSize
-        write4u(&wav[40 + extra], dataSize);        // dataSize
-        rewind(handle->stream);
-        (void) fwrite(wav, 44 + extra, 1, handle->stream);
+        (void) fwrite(wav, size, 1, handle->stream);
+    }
+    if (handle->map != NULL) {
+        (void) munmap(handle->map, handle->mapSize);
     }
     (void) fclose(handle->stream);
     free(handle);
 }
 
-sf_count_t sf_readf_short(SNDFILE *handle, short *ptr, sf_count_t desiredFrames)
+// Byte offset within the file of the next frame to read
+static size_t sf_read_offset(const SNDFILE *handle)
 {
-    if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || !handle->remaining ||
-            desiredFrames <= 0) {
-        return 0;
+    return handle->dataOffset + (handle->info.frames - handle->remaining) * handle->bytesPerFrame;
+}
+
+// Returns the next frames of file data, in the sample format of the file, and consumes them.
+// For a mapped file they are within the mapping, otherwise they are read into buf, which must
+// have room for desiredFrames frames. For a mapped file that is shorter than its data chunk
+// claims, stops at the end of the mapping.
+static const void *sf_read_frames(SNDFILE *handle, void *buf, size_t desiredFrames,
+        size_t *actualFrames)
+{
+    size_t frames;
+    const void *src;
+    if (handle->map != NULL) {
+        size_t offset = sf_read_offset(handle);
+        size_t mapped = offset < handle->mapSize ?
+                (handle->mapSize - offset) / handle->bytesPerFrame : 0;
+        frames = desiredFrames < mapped ? desiredFrames : mapped;
+        src = handle->map + offset;
+    } else {
+        // does not check for numeric overflow
+        size_t actualBytes = fread(buf, sizeof(char), desiredFrames * handle->bytesPerFrame,
+                handle->stream);
+        frames = actualBytes / handle->bytesPerFrame;
+        src = buf;
     }
-    if (handle->remaining < (size_t) desiredFrames) {
-        desiredFrames = handle->remaining;
+    handle->remaining -= frames;
+    *actualFrames = frames;
+    return src;
+}
+
+// Return a buffer of at least the given size, which is kept for later calls
+static void *sf_temp(SNDFILE *handle, size_t bytes)
+{
+    if (bytes > handle->tempSize) {
+        free(handle->temp);
+        handle->temp = (uint8_t *) malloc(bytes);
+        handle->tempSize = handle->temp != NULL ? bytes : 0;
     }
-    // does not check for numeric overflow
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes;
-    void *temp = NULL;
-    unsigned format = handle->info.format & SF_FORMAT_SUBMASK;
-    if (format == SF_FORMAT_PCM_32 || format == SF_FORMAT_FLOAT || format == SF_FORMAT_PCM_24) {
-        temp = malloc(desiredBytes);
-        actualBytes = fread(temp, sizeof(char), desiredBytes, handle->stream);
-    } else {
-        actualBytes = fread(ptr, sizeof(char), desiredBytes, handle->stream);
+    return handle->temp;
+}
+
+// The conversions access whole samples, so copy mapped frames that are not suitably aligned
+// into the buffer of the handle, which the caller has allocated for them.
+static const void *sf_align(SNDFILE *handle, const void *src, size_t frames)
+{
+    if (((uintptr_t) src & (sizeof(int32_t) - 1)) == 0) {
+        return src;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining -= actualFrames;
-    switch (format) {
+    memcpy(handle->temp, src, frames * handle->bytesPerFrame);
+    return handle->temp;
+}
+
+// The audio format of the samples in the file, in host byte order
+static audio_format_t sf_audio_format(const SNDFILE *handle)
+{
+    switch (handle->info.format & SF_FORMAT_SUBMASK) {
     case SF_FORMAT_PCM_U8:
-        memcpy_to_i16_from_u8(ptr, (unsigned char *) ptr, actualFrames * handle->info.channels);
-        break;
+        return AUDIO_FORMAT_PCM_8_BIT;
     case SF_FORMAT_PCM_16:
-        if (!isLittleEndian())
-            my_swab(ptr, actualFrames * handle->info.channels);
-        break;
+        return AUDIO_FORMAT_PCM_16_BIT;
+    case SF_FORMAT_PCM_24:
+        return AUDIO_FORMAT_PCM_24_BIT_PACKED;
     case SF_FORMAT_PCM_32:
-        memcpy_to_i16_from_i32(ptr, (const int *) temp, actualFrames * handle->info.channels);
-        free(temp);
-        break;
+        return AUDIO_FORMAT_PCM_32_BIT;
     case SF_FORMAT_FLOAT:
-        memcpy_to_i16_from_float(ptr, (const float *) temp, actualFrames * handle->info.channels);
-        free(temp);
-        break;
-    case SF_FORMAT_PCM_24:
-        memcpy_to_i16_from_p24(ptr, (const uint8_t *) temp, actualFrames * handle->info.channels);
-        free(temp);
-        break;
-    default:
-        memset(ptr, 0, actualFrames * handle->info.channels * sizeof(short));
-        break;
+        return AUDIO_FORMAT_PCM_FLOAT;
+    default:    // not reachable
+        return AUDIO_FORMAT_INVALID;
     }
-    return actualFrames;
 }
 
-sf_count_t sf_readf_float(SNDFILE *handle, float *ptr, sf_count_t desiredFrames)
+// Convert samples between any two of the file formats. memcpy_by_audio_format() converts
+// 8 bit samples only to and from 16 bit and float, so other conversions of 8 bit samples
+// go through 16 bit, which keeps all of their bits.
+static void sf_convert(void *dst, audio_format_t dstFormat, const void *src,
+        audio_format_t srcFormat, size_t count)
+{
+    if (srcFormat == dstFormat ||
+            (srcFormat != AUDIO_FORMAT_PCM_8_BIT && dstFormat != AUDIO_FORMAT_PCM_8_BIT) ||
+            srcFormat == AUDIO_FORMAT_PCM_16_BIT || dstFormat == AUDIO_FORMAT_PCM_16_BIT ||
+            srcFormat == AUDIO_FORMAT_PCM_FLOAT || dstFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        memcpy_by_audio_format(dst, dstFormat, src, srcFormat, count);
+        return;
+    }
+    int16_t i16[256];
+    size_t srcSize = audio_bytes_per_sample(srcFormat);
+    size_t dstSize = audio_bytes_per_sample(dstFormat);
+    while (count > 0) {
+        size_t n = count < sizeof(i16) / sizeof(i16[0]) ? count : sizeof(i16) / sizeof(i16[0]);
+        memcpy_by_audio_format(i16, AUDIO_FORMAT_PCM_16_BIT, src, srcFormat, n);
+        memcpy_by_audio_format(dst, dstFormat, i16, AUDIO_FORMAT_PCM_16_BIT, n);
+        src = (const uint8_t *) src + n * srcSize;
+        dst = (uint8_t *) dst + n * dstSize;
+        count -= n;
+    }
+}
+
+// Read up to desiredFrames frames into ptr, converted to format. Frames that need conversion
+// are read and converted in blocks of BLOCK_BYTES through a buffer kept by the handle,
+// and frames of a mapped file are converted straight from the mapping.
+static sf_count_t sf_readf_format(SNDFILE *handle, void *ptr, audio_format_t format,
+        sf_count_t desiredFrames)
 {
     if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || !handle->remaining ||
             desiredFrames <= 0) {
         return 0;
     }
-    if (handle->remaining < (size_t) desiredFrames) {
+    if (handle->remaining < desiredFrames) {
         desiredFrames = handle->remaining;
     }
-    // does not check for numeric overflow
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes;
-    void *temp = NULL;
-    unsigned format = handle->info.format & SF_FORMAT_SUBMASK;
-    if (format == SF_FORMAT_PCM_16 || format == SF_FORMAT_PCM_U8 || format == SF_FORMAT_PCM_24) {
-        temp = malloc(desiredBytes);
-        actualBytes = fread(temp, sizeof(char), desiredBytes, handle->stream);
-    } else {
-        actualBytes = fread(ptr, sizeof(char), desiredBytes, handle->stream);
+    const audio_format_t fileFormat = sf_audio_format(handle);
+    const size_t channels = handle->info.channels;
+    const size_t frameSize = audio_bytes_per_sample(format) * channels;
+    // 16 bit samples are little endian in the file
+    const int swab16 = fileFormat == AUDIO_FORMAT_PCM_16_BIT && !isLittleEndian();
+    if (handle->map == NULL && fileFormat == format) {
+        size_t actualFrames;
+        (void) sf_read_frames(handle, ptr, desiredFrames, &actualFrames);
+        if (swab16) {
+            my_swab((short *) ptr, actualFrames * channels);
+        }
+        return actualFrames;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining -= actualFrames;
-    switch (format) {
-    case SF_FORMAT_PCM_U8:
-#if 0
-        // TODO - implement
-        memcpy_to_float_from_u8(ptr, (const unsigned char *) temp,
-                actualFrames * handle->info.channels);
-#endif
-        free(temp);
-        break;
-    case SF_FORMAT_PCM_16:
-        memcpy_to_float_from_i16(ptr, (const short *) temp, actualFrames * handle->info.channels);
-        free(temp);
-        break;
-    case SF_FORMAT_PCM_32:
-        memcpy_to_float_from_i32(ptr, (const int *) ptr, actualFrames * handle->info.channels);
+    size_t blockFrames = BLOCK_BYTES / handle->bytesPerFrame;
+    // Frames are consumed as they are read, so allocate the buffer for reading, aligning or
+    // byte-swapping them first, and fail without losing any. Mapped frames are all aligned
+    // if the data and the frame size are.
+    const int copies = handle->map == NULL || swab16 ||
+            ((handle->dataOffset | handle->bytesPerFrame) & (sizeof(int32_t) - 1)) != 0;
+    if (copies && sf_temp(handle, blockFrames * handle->bytesPerFrame) == NULL) {
+        return 0;
+    }
+    uint8_t *dst = (uint8_t *) ptr;
+    sf_count_t totalFrames = 0;
+    while (totalFrames < desiredFrames) {
+        size_t frames = desiredFrames - totalFrames < (sf_count_t) blockFrames ?
+                (size_t) (desiredFrames - totalFrames) : blockFrames;
+        size_t actualFrames;
+        const void *src = sf_read_frames(handle, handle->map != NULL ? NULL : handle->temp,
+                frames, &actualFrames);
+        if (actualFrames == 0) {
+            break;
+        }
+        if (handle->map != NULL) {
+            src = sf_align(handle, src, actualFrames);
+        }
+        if (swab16) {
+            if (src != handle->temp) {
+                memcpy(handle->temp, src, actualFrames * handle->bytesPerFrame);
+                src = handle->temp;
+            }
+            my_swab((short *) handle->temp, actualFrames * channels);
+        }
+        sf_convert(dst, format, src, fileFormat, actualFrames * channels);
+        dst += actualFrames * frameSize;
+        totalFrames += actualFrames;
+        if (actualFrames < frames) {
+            break;
+        }
+    }
+    return totalFrames;
+}
+
+sf_count_t sf_readf_short(SNDFILE *handle, short *ptr, sf_count_t desiredFrames)
+{
+    return sf_readf_format(handle, ptr, AUDIO_FORMAT_PCM_16_BIT, desiredFrames);
+}
+
+sf_count_t sf_readf_float(SNDFILE *handle, float *ptr, sf_count_t desiredFrames)
+{
+    return sf_readf_format(handle, ptr, AUDIO_FORMAT_PCM_FLOAT, desiredFrames);
+}
+
+sf_count_t sf_readf_int(SNDFILE *handle, int *ptr, sf_count_t desiredFrames)
+{
+    return sf_readf_format(handle, ptr, AUDIO_FORMAT_PCM_32_BIT, desiredFrames);
+}
+
+sf_count_t sf_readf_p24(SNDFILE *handle, uint8_t *ptr, sf_count_t desiredFrames)
+{
+    return sf_readf_format(handle, ptr, AUDIO_FORMAT_PCM_24_BIT_PACKED, desiredFrames);
+}
+
+sf_count_t sf_seek(SNDFILE *handle, sf_count_t frames, int whence)
+{
+    if (handle == NULL || handle->mode != SFM_READ) {
+        return -1;
+    }
+    sf_count_t position;
+    switch (whence) {
+    case SEEK_SET:
+        position = frames;
         break;
-    case SF_FORMAT_FLOAT:
+    case SEEK_CUR:
+        position = handle->info.frames - handle->remaining + frames;
         break;
-    case SF_FORMAT_PCM_24:
-        memcpy_to_float_from_p24(ptr, (const uint8_t *) temp, actualFrames * handle->info.channels);
-        free(temp);
+    case SEEK_END:
+        position = handle->info.frames + frames;
         break;
     default:
-        memset(ptr, 0, actualFrames * handle->info.channels * sizeof(float));
-        break;
+        return -1;
     }
-    return actualFrames;
+    if (position < 0 || position > handle->info.frames) {
+        return -1;
+    }
+    // a mapped file is read at the position computed from remaining, without the stream
+    if (handle->map == NULL && fseeko(handle->stream,
+            (off_t) (handle->dataOffset + position * handle->bytesPerFrame), SEEK_SET) != 0) {
+        return -1;
+    }
+    handle->remaining = handle->info.frames - position;
+    return position;
 }
 
-sf_count_t sf_readf_int(SNDFILE *handle, int *ptr, sf_count_t desiredFrames)
+// Read up to desiredFrames frames starting at frame offset into ptr, converted to format,
+// without using or changing the stream position or any other state of the handle, so that
+// several threads may read at once. Reads a mapped file from the mapping, and other files
+// with pread() through a buffer on the stack.
+static sf_count_t sf_preadf_format(SNDFILE *handle, void *ptr, audio_format_t format,
+        sf_count_t desiredFrames, sf_count_t offset)
 {
-    if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || !handle->remaining ||
-            desiredFrames <= 0) {
+    if (handle == NULL || handle->mode != SFM_READ || ptr == NULL || desiredFrames <= 0 ||
+            offset < 0 || offset >= handle->info.frames) {
         return 0;
     }
-    if (handle->remaining < (size_t) desiredFrames) {
-        desiredFrames = handle->remaining;
+    if (handle->info.frames - offset < desiredFrames) {
+        desiredFrames = handle->info.frames - offset;
     }
-    // does not check for numeric overflow
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    void *temp = NULL;
-    unsigned format = handle->info.format & SF_FORMAT_SUBMASK;
-    size_t actualBytes;
-    if (format == SF_FORMAT_PCM_16 || format == SF_FORMAT_PCM_U8 || format == SF_FORMAT_PCM_24) {
-        temp = malloc(desiredBytes);
-        actualBytes = fread(temp, sizeof(char), desiredBytes, handle->stream);
-    } else {
-        actualBytes = fread(ptr, sizeof(char), desiredBytes, handle->stream);
+    const audio_format_t fileFormat = sf_audio_format(handle);
+    const size_t channels = handle->info.channels;
+    const size_t frameSize = audio_bytes_per_sample(format) * channels;
+    const int swab16 = fileFormat == AUDIO_FORMAT_PCM_16_BIT && !isLittleEndian();
+    const int fd = fileno(handle->stream);
+    uint64_t fileOffset = handle->dataOffset + offset * handle->bytesPerFrame;
+    if (handle->map == NULL && fileFormat == format) {
+        // does not check for numeric overflow
+        ssize_t actualBytes = pread(fd, ptr, desiredFrames * handle->bytesPerFrame,
+                (off_t) fileOffset);
+        if (actualBytes <= 0) {
+            return 0;
+        }
+        sf_count_t actualFrames = actualBytes / handle->bytesPerFrame;
+        if (swab16) {
+            my_swab((short *) ptr, actualFrames * channels);
+        }
+        return actualFrames;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining -= actualFrames;
-    switch (format) {
-    case SF_FORMAT_PCM_U8:
-#if 0
-        // TODO - implement
-        memcpy_to_i32_from_u8(ptr, (const unsigned char *) temp,
-                actualFrames * handle->info.channels);
-#endif
-        free(temp);
-        break;
-    case SF_FORMAT_PCM_16:
-        memcpy_to_i32_from_i16(ptr, (const short *) temp, actualFrames * handle->info.channels);
-        free(temp);
-        break;
-    case SF_FORMAT_PCM_32:
-        break;
-    case SF_FORMAT_FLOAT:
-        memcpy_to_i32_from_float(ptr, (const float *) ptr, actualFrames * handle->info.channels);
-        break;
-    case SF_FORMAT_PCM_24:
-        memcpy_to_i32_from_p24(ptr, (const uint8_t *) temp, actualFrames * handle->info.channels);
-        free(temp);
-        break;
-    default:
-        memset(ptr, 0, actualFrames * handle->info.channels * sizeof(int));
-        break;
+    int32_t block[PREAD_BLOCK_BYTES / sizeof(int32_t)];
+    const size_t blockFrames = sizeof(block) / handle->bytesPerFrame;
+    uint8_t *dst = (uint8_t *) ptr;
+    sf_count_t totalFrames = 0;
+    while (totalFrames < desiredFrames) {
+        size_t frames = desiredFrames - totalFrames < (sf_count_t) blockFrames ?
+                (size_t) (desiredFrames - totalFrames) : blockFrames;
+        size_t bytes = frames * handle->bytesPerFrame;
+        const void *src = block;
+        if (handle->map != NULL) {
+            // stop at the end of the mapping if the file is shorter than its data chunk
+            if (fileOffset + bytes > handle->mapSize) {
+                frames = fileOffset < handle->mapSize ?
+                        (handle->mapSize - fileOffset) / handle->bytesPerFrame : 0;
+                bytes = frames * handle->bytesPerFrame;
+            }
+            src = handle->map + fileOffset;
+            if (swab16 || ((uintptr_t) src & (sizeof(int32_t) - 1)) != 0) {
+                memcpy(block, src, bytes);
+                src = block;
+            }
+        } else {
+            ssize_t actualBytes = pread(fd, block, bytes, (off_t) fileOffset);
+            frames = actualBytes > 0 ? actualBytes / handle->bytesPerFrame : 0;
+            bytes = frames * handle->bytesPerFrame;
+        }
+        if (frames == 0) {
+            break;
+        }
+        if (swab16) {
+            my_swab((short *) block, frames * channels);
+        }
+        sf_convert(dst, format, src, fileFormat, frames * channels);
+        dst += frames * frameSize;
+        fileOffset += bytes;
+        totalFrames += frames;
+    }
+    return totalFrames;
+}
+
+sf_count_t sf_preadf_short(SNDFILE *handle, short *ptr, sf_count_t desiredFrames,
+        sf_count_t offset)
+{
+    return sf_preadf_format(handle, ptr, AUDIO_FORMAT_PCM_16_BIT, desiredFrames, offset);
+}
+
+sf_count_t sf_preadf_float(SNDFILE *handle, float *ptr, sf_count_t desiredFrames,
+        sf_count_t offset)
+{
+    return sf_preadf_format(handle, ptr, AUDIO_FORMAT_PCM_FLOAT, desiredFrames, offset);
+}
+
+sf_count_t sf_preadf_int(SNDFILE *handle, int *ptr, sf_count_t desiredFrames,
+        sf_count_t offset)
+{
+    return sf_preadf_format(handle, ptr, AUDIO_FORMAT_PCM_32_BIT, desiredFrames, offset);
+}
+
+sf_count_t sf_preadf_p24(SNDFILE *handle, uint8_t *ptr, sf_count_t desiredFrames,
+        sf_count_t offset)
+{
+    return sf_preadf_format(handle, ptr, AUDIO_FORMAT_PCM_24_BIT_PACKED, desiredFrames, offset);
+}
+
+sf_count_t sf_readf_direct(SNDFILE *handle, const void **ptr, sf_count_t desiredFrames)
+{
+    if (handle == NULL || handle->mode != SFM_READ || handle->map == NULL || ptr == NULL ||
+            !handle->remaining || desiredFrames <= 0) {
+        return 0;
+    }
+    // only 8 bit samples are in host byte order on a big endian host
+    if (!isLittleEndian() && (handle->info.format & SF_FORMAT_SUBMASK) != SF_FORMAT_PCM_U8) {
+        return 0;
+    }
+    if (handle->remaining < desiredFrames) {
+        desiredFrames = handle->remaining;
     }
+    size_t actualFrames;
+    *ptr = sf_read_frames(handle, NULL, desiredFrames, &actualFrames);
     return actualFrames;
 }
 
-sf_count_t sf_writef_short(SNDFILE *handle, const short *ptr, sf_count_t desiredFrames)
+// Write desiredFrames frames from ptr, which are in format. Frames that need conversion
+// are converted and written in blocks of BLOCK_BYTES through a buffer kept by the handle.
+static sf_count_t sf_writef_format(SNDFILE *handle, const void *ptr, audio_format_t format,
+        sf_count_t desiredFrames)
 {
     if (handle == NULL || handle->mode != SFM_WRITE || ptr == NULL || desiredFrames <= 0)
         return 0;
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes = 0;
-    switch (handle->info.format & SF_FORMAT_SUBMASK) {
-    case SF_FORMAT_PCM_U8:
-        handle->temp = realloc(handle->temp, desiredBytes);
-        memcpy_to_u8_from_i16(handle->temp, ptr, desiredBytes);
-        actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
-        break;
-    case SF_FORMAT_PCM_16:
+    const audio_format_t fileFormat = sf_audio_format(handle);
+    const size_t channels = handle->info.channels;
+    const size_t frameSize = audio_bytes_per_sample(format) * channels;
+    // 16 bit samples are little endian in the file
+    const int swab16 = fileFormat == AUDIO_FORMAT_PCM_16_BIT && !isLittleEndian();
+    if (fileFormat == format && !swab16) {
         // does not check for numeric overflow
-        if (isLittleEndian()) {
-            actualBytes = fwrite(ptr, sizeof(char), desiredBytes, handle->stream);
-        } else {
-            handle->temp = realloc(handle->temp, desiredBytes);
-            memcpy(handle->temp, ptr, desiredBytes);
-            my_swab((short *) handle->temp, desiredFrames * handle->info.channels);
-            actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
+        return sf_write_bytes(handle, ptr, desiredFrames * handle->bytesPerFrame) /
+                handle->bytesPerFrame;
+    }
+    size_t blockFrames = BLOCK_BYTES / handle->bytesPerFrame;
+    uint8_t *temp = (uint8_t *) sf_temp(handle, blockFrames * handle->bytesPerFrame);
+    if (temp == NULL) {
+        return 0;
+    }
+    const uint8_t *src = (const uint8_t *) ptr;
+    sf_count_t totalFrames = 0;
+    while (totalFrames < desiredFrames) {
+        size_t frames = desiredFrames - totalFrames < (sf_count_t) blockFrames ?
+                (size_t) (desiredFrames - totalFrames) : blockFrames;
+        sf_convert(temp, fileFormat, src, format, frames * channels);
+        if (swab16) {
+            my_swab((short *) temp, frames * channels);
         }
-        break;
-    case SF_FORMAT_FLOAT:
-        handle->temp = realloc(handle->temp, desiredBytes);
-        memcpy_to_float_from_i16((float *) handle->temp, ptr,
-                desiredFrames * handle->info.channels);
-        actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
-        break;
-    default:
-        break;
+        size_t actualFrames = sf_write_bytes(handle, temp, frames * handle->bytesPerFrame) /
+                handle->bytesPerFrame;
+        totalFrames += actualFrames;
+        if (actualFrames < frames) {
+            break;
+        }
+        src += frames * frameSize;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining += actualFrames;
-    return actualFrames;
+    return totalFrames;
+}
+
+sf_count_t sf_writef_short(SNDFILE *handle, const short *ptr, sf_count_t desiredFrames)
+{
+    return sf_writef_format(handle, ptr, AUDIO_FORMAT_PCM_16_BIT, desiredFrames);
 }
 
 sf_count_t sf_writef_float(SNDFILE *handle, const float *ptr, sf_count_t desiredFrames)
 {
-    if (handle == NULL || handle->mode != SFM_WRITE || ptr == NULL || desiredFrames <= 0)
+    return sf_writef_format(handle, ptr, AUDIO_FORMAT_PCM_FLOAT, desiredFrames);
+}
+
+sf_count_t sf_writef_int(SNDFILE *handle, const int *ptr, sf_count_t desiredFrames)
+{
+    return sf_writef_format(handle, ptr, AUDIO_FORMAT_PCM_32_BIT, desiredFrames);
+}
+
+sf_count_t sf_writef_p24(SNDFILE *handle, const uint8_t *ptr, sf_count_t desiredFrames)
+{
+    return sf_writef_format(handle, ptr, AUDIO_FORMAT_PCM_24_BIT_PACKED, desiredFrames);
+}
+
+sf_count_t sf_overruns(SNDFILE *handle)
+{
+    if (handle == NULL || handle->async == NULL) {
         return 0;
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes = 0;
-    switch (handle->info.format & SF_FORMAT_SUBMASK) {
-    case SF_FORMAT_FLOAT:
-        actualBytes = fwrite(ptr, sizeof(char), desiredBytes, handle->stream);
-        break;
-    case SF_FORMAT_PCM_16:
-        handle->temp = realloc(handle->temp, desiredBytes);
-        memcpy_to_i16_from_float((short *) handle->temp, ptr,
-                desiredFrames * handle->info.channels);
-        actualBytes = fwrite(handle->temp, sizeof(char), desiredBytes, handle->stream);
-        break;
-    case SF_FORMAT_PCM_U8:  // transcoding from float to byte not yet implemented
-    default:
-        break;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining += actualFrames;
-    return actualFrames;
+    return (sf_count_t) atomic_load_explicit(&handle->async->overruns, memory_order_relaxed);
 }
 
-sf_count_t sf_writef_int(SNDFILE *handle, const int *ptr, sf_count_t desiredFrames)
+uint32_t sf_get_channel_mask(SNDFILE *handle)
 {
-    if (handle == NULL || handle->mode != SFM_WRITE || ptr == NULL || desiredFrames <= 0)
+    if (handle == NULL) {
         return 0;
-    size_t desiredBytes = desiredFrames * handle->bytesPerFrame;
-    size_t actualBytes = 0;
-    switch (handle->info.format & SF_FORMAT_SUBMASK) {
-    case SF_FORMAT_PCM_32:
-        actualBytes = fwrite(ptr, sizeof(char), desiredBytes, handle->stream);
-        break;
-    default:    // transcoding from other formats not yet implemented
-        break;
     }
-    size_t actualFrames = actualBytes / handle->bytesPerFrame;
-    handle->remaining += actualFrames;
-    return actualFrames;
+    return handle->channelMask;
+}
+
+int sf_set_channel_mask(SNDFILE *handle, uint32_t channelMask)
+{
+    if (handle == NULL || handle->mode != SFM_WRITE ||
+            __builtin_popcount(channelMask) != handle->info.channels) {
+        return -EINVAL;
+    }
+    if (!isExtensible(&handle->info) && channelMask != handle->channelMask) {
+        return -EINVAL;
+    }
+    handle->channelMask = channelMask;
+    return 0;
 }